@@ -0,0 +1,45 @@
+#pragma once
+
+/**
+ * Small helpers shared by the host-side benchmarks in this directory.
+ * Benchmarks run on the development machine (not on the ESP32), so they may use the standard library freely.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double elapsedNs(Clock::time_point start, Clock::time_point end) {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// Keeps the optimizer from throwing away results that are only computed for timing
+template<typename T>
+inline void doNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Deterministic pseudo random numbers, so every run of a benchmark sees the same input
+class Xorshift {
+public:
+    explicit Xorshift(uint32_t seed) : state(seed ? seed : 1) {}
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+private:
+    uint32_t state;
+};
+
+inline void printHeader(const char *title) {
+    std::printf("\n=== %s ===\n", title);
+}
+
+}  // namespace bench
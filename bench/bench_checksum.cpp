@@ -0,0 +1,95 @@
+// benchmark: CRC32 throughput of each implementation, and what the incremental table checksum saves at send time
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "checksum.h"
+#include "config.h"
+#include "data.h"
+#include "data_codec.h"
+#include "hal_sim.h"
+#include "traces.h"
+
+namespace {
+
+using Crc32Function = uint32_t (*)(uint32_t, const void *, size_t);
+
+struct Implementation {
+    const char *name;
+    Crc32Function update;
+};
+
+constexpr Implementation IMPLEMENTATIONS[] = {
+    {"bitwise", crc32UpdateBitwise},
+    {"nibble (16 entries)", crc32UpdateNibble},
+    {"slice-by-8", crc32UpdateSliceBy8},
+};
+
+// the sizes the firmware checksums: a wifi SSID, a transfer chunk, a day's encoded table, a log file
+constexpr size_t SIZES[] = {32, TRANSFER_CHUNK_SIZE, 1700, LOG_FILE_SIZE, 64 * 1024};
+constexpr size_t BYTES_PER_SIZE = 16 * 1024 * 1024;    // hashed per implementation and size
+
+double megabytesPerSecond(Crc32Function update, const std::vector<uint8_t> &data, size_t size) {
+    size_t runs = BYTES_PER_SIZE / size;
+    uint32_t crc = 0;
+    auto start = bench::Clock::now();
+    for (size_t run = 0; run < runs; run++) {
+        crc = update(crc, data.data() + run % 8, size);     // every alignment
+    }
+    double ns = bench::elapsedNs(start, bench::Clock::now());
+    bench::doNotOptimize(crc);
+    return static_cast<double>(runs * size) / ns * 1000;
+}
+
+}  // namespace
+
+void benchChecksum() {
+    bench::printHeader("CRC32 throughput (host). the ESP32-C3 uses the ROM's crc32_le, timed on target only");
+    bench::Xorshift rng(2024);
+    std::vector<uint8_t> data(SIZES[sizeof(SIZES) / sizeof(SIZES[0]) - 1] + 8);
+    for (uint8_t &byte : data) {
+        byte = static_cast<uint8_t>(rng.next());
+    }
+    std::printf("%-20s", "MB/s, block bytes:");
+    for (size_t size : SIZES) {
+        std::printf(" %10zu", size);
+    }
+    std::printf("\n");
+    for (const Implementation &implementation : IMPLEMENTATIONS) {
+        std::printf("%-20s", implementation.name);
+        for (size_t size : SIZES) {
+            std::printf(" %10.0f", megabytesPerSecond(implementation.update, data, size));
+        }
+        std::printf("\n");
+    }
+
+    // the table's CRC, kept as records are appended vs. computed over the encoded payload before sending
+    static uint8_t payload[maxEncodedDataSize(DATA_TABLE_CAPACITY)];
+    static DataTable table(DATA_TABLE_CAPACITY);
+    hal::sim::reset();
+    table.createDataTable();
+    std::vector<Record> day = bench::syntheticBinDay(1000);
+    const int runs = 200;
+    double appendNs = 0;
+    for (int run = 0; run < runs; run++) {
+        DataChecksum checksum;
+        auto start = bench::Clock::now();
+        for (const Record &record : day) {
+            checksum.add(record);
+        }
+        appendNs += bench::elapsedNs(start, bench::Clock::now());
+        bench::doNotOptimize(checksum.value());
+    }
+    for (const Record &record : day) {
+        table.updateTable(record);
+    }
+    size_t length = encodeDataTable(table.readTable(), payload, sizeof(payload));
+    double passNs = 0;
+    for (int run = 0; run < runs; run++) {
+        auto start = bench::Clock::now();
+        bench::doNotOptimize(crc32UpdateNibble(0, payload, length - DATA_CHECKSUM_SIZE));
+        passNs += bench::elapsedNs(start, bench::Clock::now());
+    }
+    std::printf("day's table (%zu records, %zu B): %.2f ns per append, vs. a %.1f us nibble pass before sending\n",
+                day.size(), length, appendNs / runs / static_cast<double>(day.size()), passNs / runs / 1000);
+}
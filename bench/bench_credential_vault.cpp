@@ -0,0 +1,134 @@
+// benchmark: credential vault (credential_vault.h): one record's decrypt per lookup vs. decrypting every password
+#include <cstdio>
+#include <cstring>
+
+#include "aes_gcm.h"
+#include "bench.h"
+#include "config.h"
+#include "credential_vault.h"
+#include "hal.h"
+#include "hal_sim.h"
+
+namespace {
+
+constexpr int RUNS = 20000;
+const char *const SSIDS[WIFI_MAX_NETWORKS] = {"daphi-depot", "city hall", "library", "cafe"};
+
+// the vault's alternative: every network in one sealed blob, decrypted whole to find one password
+struct Blob {
+    uint8_t nonce[AES_GCM_NONCE_SIZE];
+    WifiNetwork networks[WIFI_MAX_NETWORKS];
+    uint8_t tag[AES_GCM_TAG_SIZE];
+};
+
+bool findInBlob(AesGcm &gcm, const Blob &blob, const char *ssid, char password[65]) {
+    WifiNetwork networks[WIFI_MAX_NETWORKS];
+    if (!gcm.open(blob.nonce, nullptr, 0, blob.networks, sizeof(networks), blob.tag, networks)) {
+        return false;
+    }
+    bool found = false;
+    for (const WifiNetwork &network : networks) {
+        if (!found && std::strcmp(network.ssid, ssid) == 0) {
+            std::memcpy(password, network.password, sizeof(network.password));
+            found = true;
+        }
+    }
+    wipeSecret(networks, sizeof(networks));
+    return found;
+}
+
+}  // namespace
+
+void benchCredentialVault() {
+    bench::printHeader("Credential vault (host, software AES). the ESP32-C3 uses mbedtls on its AES accelerator, "
+                       "timed on target only");
+    uint8_t key[AES_GCM_KEY_SIZE] = {7};
+    uint8_t nonce[AES_GCM_NONCE_SIZE] = {1};
+    AesGcm gcm;
+    gcm.setKey(key);
+
+    // one record: its password sealed whole, with the slot and an SSID as AAD
+    uint8_t aad[1 + 11] = {0, 'd', 'a', 'p', 'h', 'i', '-', 'd', 'e', 'p', 'o', 't'};
+    char plain[65] = "compost-heap";
+    VaultRecord record;
+    auto start = bench::Clock::now();
+    for (int run = 0; run < RUNS; run++) {
+        nonce[0] = static_cast<uint8_t>(run);
+        gcm.seal(nonce, aad, sizeof(aad), plain, sizeof(plain), record.password, record.tag);
+        bench::doNotOptimize(record.tag[0]);
+    }
+    double sealNs = bench::elapsedNs(start, bench::Clock::now()) / RUNS;
+    char opened[65];
+    start = bench::Clock::now();
+    for (int run = 0; run < RUNS; run++) {
+        bench::doNotOptimize(gcm.open(nonce, aad, sizeof(aad), record.password, sizeof(plain), record.tag, opened));
+    }
+    double openNs = bench::elapsedNs(start, bench::Clock::now()) / RUNS;
+    std::printf("one record (%zu B sealed, %zu B AAD): seal %.0f ns, open %.0f ns\n", sizeof(plain), sizeof(aad),
+                sealNs, openNs);
+
+    // a lookup at connect time: the vault's one record vs. the whole blob, by networks stored
+    std::printf("%-10s %16s %16s %16s\n", "networks", "vault find ns", "decrypts/find", "whole blob ns");
+    for (uint8_t stored = 1; stored <= WIFI_MAX_NETWORKS; stored++) {
+        hal::sim::reset();
+        CredentialVault vault;
+        vault.mount();
+        Blob blob = {};
+        for (uint8_t i = 0; i < stored; i++) {
+            vault.add(SSIDS[i], "a-password-of-some-length");
+            std::strcpy(blob.networks[i].ssid, SSIDS[i]);
+            std::strcpy(blob.networks[i].password, "a-password-of-some-length");
+        }
+        gcm.seal(blob.nonce, nullptr, 0, blob.networks, sizeof(blob.networks), blob.networks, blob.tag);
+
+        char password[65];
+        const char *last = SSIDS[stored - 1];
+        start = bench::Clock::now();
+        for (int run = 0; run < RUNS; run++) {
+            bench::doNotOptimize(vault.find(last, password));
+        }
+        double vaultNs = bench::elapsedNs(start, bench::Clock::now()) / RUNS;
+        double decrypts = static_cast<double>(vault.stats().decrypts) / RUNS;
+        start = bench::Clock::now();
+        for (int run = 0; run < RUNS; run++) {
+            bench::doNotOptimize(findInBlob(gcm, blob, last, password));
+        }
+        double blobNs = bench::elapsedNs(start, bench::Clock::now()) / RUNS;
+        std::printf("%-10u %16.0f %16.1f %16.0f\n", stored, vaultNs, decrypts, blobNs);
+    }
+    std::printf("(vault find includes the simulated NVS read; the blob is %zu B, decrypted whole each time)\n",
+                sizeof(Blob::networks));
+
+    // mount, and the NVS writes of the changes
+    hal::sim::reset();
+    CredentialVault vault;
+    vault.mount();
+    for (const char *ssid : SSIDS) {
+        vault.add(ssid, "a-password-of-some-length");
+    }
+    const int changes = 2000;
+    start = bench::Clock::now();
+    for (int run = 0; run < changes; run++) {
+        vault.mount();
+    }
+    double mountNs = bench::elapsedNs(start, bench::Clock::now()) / changes;
+    uint32_t commits = hal::sim::nvsCommitCount();
+    start = bench::Clock::now();
+    for (int run = 0; run < changes; run++) {
+        vault.add(SSIDS[run % WIFI_MAX_NETWORKS], run % 2 == 0 ? "another-password" : "a-password-of-some-length");
+    }
+    double replaceNs = bench::elapsedNs(start, bench::Clock::now()) / changes;
+    uint32_t replaceCommits = hal::sim::nvsCommitCount() - commits;
+    commits = hal::sim::nvsCommitCount();
+    start = bench::Clock::now();
+    for (int run = 0; run < changes; run++) {
+        vault.remove(SSIDS[0]);
+        vault.add(SSIDS[0], "a-password-of-some-length");
+    }
+    double cycleNs = bench::elapsedNs(start, bench::Clock::now()) / changes;
+    uint32_t cycleCommits = hal::sim::nvsCommitCount() - commits;
+    std::printf("mount (key, index, orphan scan): %.1f us; replace a password: %.1f us, %.1f NVS commits; "
+                "remove + add: %.1f us, %.1f NVS commits\n", mountNs / 1000, replaceNs / 1000,
+                static_cast<double>(replaceCommits) / changes, cycleNs / 1000,
+                static_cast<double>(cycleCommits) / changes);
+}
@@ -0,0 +1,98 @@
+// benchmark: packed flash DataTable vs. a naive array of 4 byte records
+#include <cstdio>
+
+#include "bench.h"
+#include "config.h"
+#include "data.h"
+#include "hal_sim.h"
+
+namespace {
+
+constexpr int DAYS = 200;
+
+// The layout DataTable replaced: 2 bytes of minute + 2 bytes of weight, kept in RAM
+struct NaiveRecord {
+    uint16_t recordTime;
+    uint16_t weight;
+};
+
+// 840 readings from 06:00, one a minute, a slowly filling bin
+Record dayRecord(uint16_t i) {
+    return Record{static_cast<recordTimeType>(360 + i), 2000U + i * 37U};
+}
+
+void printRow(const char *layout, double ramPerRecord, double flashPerRecord, double appendNs) {
+    std::printf("%-28s %14.2f %16.2f %12.1f\n", layout, ramPerRecord, flashPerRecord, appendNs);
+}
+
+}  // namespace
+
+void benchData() {
+    bench::printHeader("DataTable: bytes per record and append cost (840 records, one day)");
+    std::printf("%-28s %14s %16s %12s\n", "layout", "RAM B/record", "flash B/record", "append ns");
+
+    // naive: RAM array
+    static NaiveRecord naive[DATA_TABLE_CAPACITY];
+    auto start = bench::Clock::now();
+    for (int day = 0; day < DAYS; day++) {
+        for (uint16_t i = 0; i < DATA_TABLE_CAPACITY; i++) {
+            Record record = dayRecord(i);
+            naive[i] = NaiveRecord{record.recordTime, static_cast<uint16_t>(record.weight)};
+        }
+        bench::doNotOptimize(naive[day % DATA_TABLE_CAPACITY]);
+    }
+    double naiveRamNs = bench::elapsedNs(start, bench::Clock::now()) / (static_cast<double>(DAYS) * DATA_TABLE_CAPACITY);
+    printRow("naive 4 B records, RAM", sizeof(NaiveRecord), 0, naiveRamNs);
+
+    // naive: the same 4 byte records appended to flash
+    hal::sim::reset();
+    hal::sim::setFlashPartition("naive", 0x10000);
+    hal::FlashPartition partition;
+    partition.open("naive");
+    start = bench::Clock::now();
+    for (int day = 0; day < DAYS; day++) {
+        for (uint16_t i = 0; i < DATA_TABLE_CAPACITY; i++) {
+            Record record = dayRecord(i);
+            NaiveRecord packed{record.recordTime, static_cast<uint16_t>(record.weight)};
+            partition.write(i * sizeof(NaiveRecord), &packed, sizeof(packed));
+        }
+        for (uint32_t sector = 0; sector * hal::FLASH_SECTOR_SIZE < DATA_TABLE_CAPACITY * sizeof(NaiveRecord); sector++) {
+            partition.eraseSector(sector);
+        }
+    }
+    double naiveFlashNs = bench::elapsedNs(start, bench::Clock::now()) / (static_cast<double>(DAYS) * DATA_TABLE_CAPACITY);
+    printRow("naive 4 B records, flash", 0, sizeof(NaiveRecord), naiveFlashNs);
+
+    // packed DataTable
+    hal::sim::reset();
+    static DataTable table(DATA_TABLE_CAPACITY);
+    table.createDataTable();
+    uint32_t flashBytes = 0;
+    start = bench::Clock::now();
+    for (int day = 0; day < DAYS; day++) {
+        for (uint16_t i = 0; i < DATA_TABLE_CAPACITY; i++) {
+            table.updateTable(dayRecord(i));
+        }
+        flashBytes = table.flashBytesUsed();
+        table.deleteTable();
+    }
+    double packedNs = bench::elapsedNs(start, bench::Clock::now()) / (static_cast<double>(DAYS) * DATA_TABLE_CAPACITY);
+    printRow("packed 3 B records, flash", static_cast<double>(sizeof(DataTable)) / DATA_TABLE_CAPACITY,
+             static_cast<double>(flashBytes) / DATA_TABLE_CAPACITY, packedNs);
+
+    // reading it back in place
+    for (uint16_t i = 0; i < DATA_TABLE_CAPACITY; i++) {
+        table.updateTable(dayRecord(i));
+    }
+    start = bench::Clock::now();
+    uint64_t sum = 0;
+    for (int day = 0; day < DAYS; day++) {
+        for (Record record : table.readTable()) {
+            sum += record.weight;
+        }
+    }
+    bench::doNotOptimize(sum);
+    double readNs = bench::elapsedNs(start, bench::Clock::now()) / (static_cast<double>(DAYS) * DATA_TABLE_CAPACITY);
+    std::printf("zero-copy readTable: %.1f ns per record, %zu bytes of RAM for the whole table object\n", readNs,
+                sizeof(DataTable));
+}
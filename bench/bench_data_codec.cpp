@@ -0,0 +1,48 @@
+// benchmark: delta + varint encoding of a day's data table
+#include <cstdio>
+
+#include "bench.h"
+#include "config.h"
+#include "data.h"
+#include "data_codec.h"
+#include "hal_sim.h"
+#include "traces.h"
+
+namespace {
+
+constexpr int RUNS = 2000;
+constexpr int DAYS = 7;
+
+}  // namespace
+
+void benchDataCodec() {
+    bench::printHeader("Data table encoding (delta time + zig-zag varint weight + CRC32), 840-reading days");
+    std::printf("%5s %12s %12s %12s %8s %12s\n", "day", "raw 4 B", "flash 3 B", "encoded", "ratio", "encode us");
+
+    static uint8_t payload[maxEncodedDataSize(DATA_TABLE_CAPACITY)];
+    static DataTable table(DATA_TABLE_CAPACITY);
+    double totalRatio = 0;
+    for (int day = 0; day < DAYS; day++) {
+        hal::sim::reset();
+        table.createDataTable();
+        for (const Record &record : bench::syntheticBinDay(1000 + day)) {
+            table.updateTable(record);
+        }
+
+        size_t length = 0;
+        auto start = bench::Clock::now();
+        for (int run = 0; run < RUNS; run++) {
+            length = encodeDataTable(table.readTable(), payload, sizeof(payload));
+            bench::doNotOptimize(payload[length - 1]);
+        }
+        double encodeUs = bench::elapsedNs(start, bench::Clock::now()) / RUNS / 1000.0;
+
+        size_t raw = table.length() * 4U;
+        double ratio = static_cast<double>(raw) / static_cast<double>(length);
+        totalRatio += ratio;
+        std::printf("%5d %12zu %12u %12zu %7.2fx %12.1f\n", day, raw, static_cast<unsigned>(table.flashBytesUsed()),
+                    length, ratio, encodeUs);
+    }
+    std::printf("mean compression vs. 4 byte records: %.2fx (bytes on air, so radio-on time, shrink by the same factor)\n",
+                totalRatio / DAYS);
+}
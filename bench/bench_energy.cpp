@@ -0,0 +1,82 @@
+// benchmark: the energy ledger's report of a simulated day, and days to empty by sensing interval
+#include <cstdio>
+
+#include "bench.h"
+#include "config.h"
+#include "energy.h"
+#include "hal.h"
+#include "hal_sim.h"
+
+namespace {
+
+// the device's day, as measured on the bench: CPU ms per wakeup, and the radio at the two tx times
+constexpr uint32_t SCHEDULER_MS = 1;
+constexpr uint32_t SENSE_CPU_MS = 10;
+constexpr uint32_t SAMPLING_MS = 2100;      // parked while the HX711 converts
+constexpr uint32_t STATUS_MS = 30;
+constexpr uint32_t RADIO_MS = 1700;         // a cached Wi-Fi connect and the uplink flush
+constexpr uint32_t TX_BYTES = 6000;
+
+const char *const STATE_NAMES[POWER_STATE_COUNT] = {"deep sleep", "light sleep", "CPU active", "radio TX", "radio RX"};
+const char *const TASK_NAMES[ENERGY_TASK_COUNT] = {"getLoadCellData", "display", "scheduler", "networkings", "loop"};
+
+void work(EnergyLedger &ledger, EnergyTask task, uint32_t ms) {
+    ledger.taskAwake(task);
+    hal::sleepMs(ms);
+    ledger.taskAsleep(task);
+}
+
+EnergyReport simulateDay(uint32_t senseIntervalS) {
+    hal::sim::reset();
+    EnergyLedger ledger(ENERGY_PROFILE);
+    ledger.start();
+    for (uint32_t second = 0; second < 86400; second += senseIntervalS) {
+        uint64_t start = hal::micros();
+        work(ledger, EnergyTask::Scheduler, SCHEDULER_MS);
+        work(ledger, EnergyTask::LoadCell, SENSE_CPU_MS);
+        hal::sleepMs(SAMPLING_MS);
+        if (second % 3600 < senseIntervalS) {
+            work(ledger, EnergyTask::Events, STATUS_MS);
+        }
+        if ((second + senseIntervalS) % 43200 < senseIntervalS) {     // twice a day
+            ledger.taskAwake(EnergyTask::Networkings);
+            ledger.radioOn(EnergyTask::Networkings);
+            hal::sleepMs(RADIO_MS);
+            ledger.radioSent(TX_BYTES);
+            ledger.radioOff();
+            ledger.taskAsleep(EnergyTask::Networkings);
+        }
+        hal::sleepMs(static_cast<uint32_t>(senseIntervalS * 1000ULL - (hal::micros() - start) / 1000));
+    }
+    return ledger.report();
+}
+
+}  // namespace
+
+void benchEnergy() {
+    bench::printHeader("Energy ledger: a simulated day, and days to empty by sensing interval");
+    std::printf("profile: light sleep %u uA, CPU %u uA, TX %u uA, RX %u uA. battery %u mAh\n",
+                static_cast<unsigned>(LIGHT_SLEEP_MICROAMPS), static_cast<unsigned>(CPU_ACTIVE_MICROAMPS),
+                static_cast<unsigned>(RADIO_TX_MICROAMPS), static_cast<unsigned>(RADIO_RX_MICROAMPS),
+                static_cast<unsigned>(BATTERY_CAPACITY_MAH));
+
+    EnergyReport day = simulateDay(60);
+    std::printf("%-16s %12s %10s %8s\n", "power state", "s/day", "mAh/day", "share");
+    for (uint8_t state = 0; state < POWER_STATE_COUNT; state++) {
+        std::printf("%-16s %12.3f %10.3f %7.1f%%\n", STATE_NAMES[state], static_cast<double>(day.stateUs[state]) / 1e6,
+                    day.stateMah[state], 100 * day.stateMah[state] / day.totalMah);
+    }
+    std::printf("%-16s %12s %10s\n", "task", "awake s/day", "mAh/day");
+    for (uint8_t task = 0; task < ENERGY_TASK_COUNT; task++) {
+        std::printf("%-16s %12.3f %10.3f\n", TASK_NAMES[task], static_cast<double>(day.taskUs[task]) / 1e6,
+                    day.taskMah[task]);
+    }
+    std::printf("total %.3f mAh/day, %.3f mA average\n\n", day.totalMah, day.averageMilliAmps);
+
+    std::printf("%-18s %10s %14s\n", "sense interval s", "mAh/day", "days to empty");
+    for (uint32_t intervalS : {30U, 60U, 120U, 300U}) {
+        EnergyReport report = simulateDay(intervalS);
+        std::printf("%-18u %10.3f %14u\n", static_cast<unsigned>(intervalS), report.totalMah,
+                    static_cast<unsigned>(daysToEmpty(report, BATTERY_CAPACITY_MAH)));
+    }
+}
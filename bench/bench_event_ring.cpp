@@ -0,0 +1,107 @@
+// benchmark: lock-free EventRing vs. a mutex-wrapped Queue<Event>, with std::thread producers
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "event_ring.h"
+#include "queue.h"
+#include "types.h"
+
+namespace {
+
+constexpr uint16_t CAPACITY = 64;
+constexpr uint32_t EVENTS_PER_PRODUCER = 20000;
+constexpr uint32_t LATENCY_SAMPLE_EVERY = 64;
+
+// What the tasks would have had to use without the ring: one lock around the priority queue
+class MutexQueue {
+public:
+    bool tryPush(const Event &event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.tryEnqueue(event);
+    }
+    bool tryPop(Event &event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.tryDequeue(event);
+    }
+
+private:
+    std::mutex mutex;
+    Queue<Event, CAPACITY> queue;
+};
+
+struct Result {
+    double eventsPerSecond;
+    double p50Ns;
+    double p99Ns;
+};
+
+template<typename Channel>
+Result run(Channel &channel, unsigned producerCount) {
+    std::atomic<bool> go(false);
+    std::vector<std::vector<double>> latencies(producerCount);
+    std::vector<std::thread> producers;
+    for (unsigned p = 0; p < producerCount; p++) {
+        producers.emplace_back([&, p] {
+            latencies[p].reserve(EVENTS_PER_PRODUCER / LATENCY_SAMPLE_EVERY + 1);
+            while (!go.load()) {
+            }
+            Event event{EventType::SendData, static_cast<uint8_t>(p)};
+            for (uint32_t i = 0; i < EVENTS_PER_PRODUCER; i++) {
+                bool sample = i % LATENCY_SAMPLE_EVERY == 0;
+                auto start = bench::Clock::now();
+                while (!channel.tryPush(event)) {
+                    std::this_thread::yield();
+                    start = bench::Clock::now();   // only time pushes that succeed, not the back-pressure wait
+                }
+                if (sample) {
+                    latencies[p].push_back(bench::elapsedNs(start, bench::Clock::now()));
+                }
+            }
+        });
+    }
+
+    uint64_t total = static_cast<uint64_t>(producerCount) * EVENTS_PER_PRODUCER;
+    uint64_t received = 0;
+    Event event{};
+    auto start = bench::Clock::now();
+    go.store(true);
+    while (received < total) {
+        if (channel.tryPop(event)) {
+            received++;
+        }
+    }
+    double ns = bench::elapsedNs(start, bench::Clock::now());
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+
+    std::vector<double> all;
+    for (const std::vector<double> &perProducer : latencies) {
+        all.insert(all.end(), perProducer.begin(), perProducer.end());
+    }
+    std::sort(all.begin(), all.end());
+    return Result{static_cast<double>(total) / (ns / 1e9), all[all.size() / 2], all[all.size() * 99 / 100]};
+}
+
+}  // namespace
+
+void benchEventRing() {
+    bench::printHeader("EventRing vs. mutex + Queue<Event> (capacity 64)");
+    std::printf("%9s %-12s %14s %12s %12s\n", "producers", "channel", "events/s", "push p50 ns", "push p99 ns");
+    const unsigned producerCounts[] = {1, 2, 4};
+    for (unsigned producerCount : producerCounts) {
+        static EventRing<Event, CAPACITY> ring;
+        static MutexQueue locked;
+        Result ringResult = run(ring, producerCount);
+        Result lockedResult = run(locked, producerCount);
+        std::printf("%9u %-12s %14.0f %12.0f %12.0f\n", producerCount, "ring", ringResult.eventsPerSecond,
+                    ringResult.p50Ns, ringResult.p99Ns);
+        std::printf("%9u %-12s %14.0f %12.0f %12.0f\n", producerCount, "mutex+queue", lockedResult.eventsPerSecond,
+                    lockedResult.p50Ns, lockedResult.p99Ns);
+    }
+}
@@ -0,0 +1,145 @@
+// benchmark: flash wear over a simulated year, fixed partitions erased on delete vs. the log-structured flash store
+#include <cstdio>
+
+#include "bench.h"
+#include "config.h"
+#include "data.h"
+#include "flash_log.h"
+#include "hal_sim.h"
+#include "logging.h"
+#include "traces.h"
+
+namespace {
+
+constexpr int DAYS = 365;
+constexpr uint32_t PARTITION_SIZE = 0x20000;    // the storage partition, or the old datatable + logfile pair
+constexpr uint32_t OLD_PARTITION_SIZE = PARTITION_SIZE / 2;
+constexpr uint16_t LOG_ROWS_PER_DAY = 40;
+constexpr uint16_t LOG_ROW_BYTES = 24;
+constexpr uint16_t SEND_AFTER_READING = 420;    // the first of the two daily transmissions, halfway through the day
+constexpr double SECTOR_ERASE_MS = 45;          // typical 4 KB erase of the ESP32-C3's SPI NOR flash
+constexpr double ENDURANCE_CYCLES = 100000;
+constexpr uint32_t JAN_1_2026 = 1767225600;
+
+struct Wear {
+    uint32_t total = 0;
+    uint32_t most = 0;
+    uint32_t onSendPath = 0;    // erases done while deleting, i.e. between the server's ack and the next reading
+};
+
+void countWear(const char *label, uint32_t size, Wear &wear) {
+    for (uint32_t sector = 0; sector < size / hal::FLASH_SECTOR_SIZE; sector++) {
+        uint32_t erases = hal::sim::flashEraseCount(label, sector);
+        wear.total += erases;
+        wear.most = erases > wear.most ? erases : wear.most;
+    }
+}
+
+// What the DataTable and the LogFile did before the flash store: each in its own partition,
+// written from offset 0 and erased sector by sector on every delete
+class FixedPartition {
+public:
+    explicit FixedPartition(const char *label) : label(label) {
+        hal::sim::setFlashPartition(label, OLD_PARTITION_SIZE);
+        partition.open(label);
+    }
+    void append(const void *data, uint16_t length) {
+        partition.write(used, data, length);
+        used += length;
+    }
+    uint32_t erase() {
+        uint32_t sectors = (used + hal::FLASH_SECTOR_SIZE - 1) / hal::FLASH_SECTOR_SIZE;
+        for (uint32_t sector = 0; sector < sectors; sector++) {
+            partition.eraseSector(sector);
+        }
+        used = 0;
+        return sectors;
+    }
+
+    const char *label;
+
+private:
+    hal::FlashPartition partition;
+    uint32_t used = 0;
+};
+
+void printRow(const char *layout, const Wear &wear, uint32_t sectors) {
+    double mean = static_cast<double>(wear.total) / sectors;
+    double years = wear.most > 0 ? ENDURANCE_CYCLES / wear.most : 0;
+    std::printf("%-26s %10u %10u %10.1f %14.1f %12.0f\n", layout, static_cast<unsigned>(wear.total),
+                static_cast<unsigned>(wear.most), mean, wear.onSendPath * SECTOR_ERASE_MS / DAYS, years);
+}
+
+}  // namespace
+
+void benchFlashLog() {
+    bench::printHeader("Flash store: erases over a simulated year (840 records and 40 log entries a day, 2 sends a day)");
+    std::printf("%-26s %10s %10s %10s %14s %12s\n", "layout", "erases", "max/sector", "mean", "send ms/day",
+                "years@100k");
+
+    // fixed partitions: the DataTable and the LogFile erase their first sectors on every delete
+    hal::sim::reset();
+    FixedPartition oldTable("old_datatable");
+    FixedPartition oldLog("old_logfile");
+    Wear fixed;
+    uint8_t row[LOG_ROW_BYTES];
+    for (uint16_t i = 0; i < LOG_ROW_BYTES; i++) {
+        row[i] = 'a' + i % 26;
+    }
+    row[LOG_ROW_BYTES - 1] = '\n';
+    for (int day = 0; day < DAYS; day++) {
+        std::vector<Record> trace = bench::syntheticBinDay(static_cast<uint32_t>(day + 1));
+        for (uint16_t i = 0; i < trace.size(); i++) {
+            uint8_t packed[PACKED_RECORD_SIZE] = {static_cast<uint8_t>(trace[i].weight),
+                                                  static_cast<uint8_t>(trace[i].weight >> 8), 2};
+            oldTable.append(packed, sizeof(packed));
+            if (i % (trace.size() / LOG_ROWS_PER_DAY) == 0) {
+                oldLog.append(row, sizeof(row));
+            }
+            if (i + 1U == SEND_AFTER_READING || i + 1U == trace.size()) {
+                fixed.onSendPath += oldTable.erase();
+            }
+        }
+        fixed.onSendPath += oldLog.erase();
+    }
+    countWear(oldTable.label, OLD_PARTITION_SIZE, fixed);
+    countWear(oldLog.label, OLD_PARTITION_SIZE, fixed);
+    printRow("fixed partitions", fixed, 2 * OLD_PARTITION_SIZE / hal::FLASH_SECTOR_SIZE);
+
+    // the flash store: both streams on one partition, deleted by an epoch bump
+    hal::sim::reset();
+    hal::sim::setFlashPartition("year_storage", PARTITION_SIZE);
+    static FlashLog store;
+    store.mount("year_storage");
+    static DataTable table(DATA_TABLE_CAPACITY, store);
+    static LogFile log(LOG_FILE_SIZE, store);
+    table.createDataTable();
+    log.createLogFile();
+    Wear logStructured;
+    auto start = bench::Clock::now();
+    for (int day = 0; day < DAYS; day++) {
+        std::vector<Record> trace = bench::syntheticBinDay(static_cast<uint32_t>(day + 1));
+        for (uint16_t i = 0; i < trace.size(); i++) {
+            hal::setEpochSeconds(JAN_1_2026 + day * 86400U + trace[i].recordTime * 60U);
+            table.updateTable(trace[i]);
+            if (i % (trace.size() / LOG_ROWS_PER_DAY) == 0) {
+                log.addLogRow(LogCode::BatteryMilliVolts, 3912);
+            }
+            if (i + 1U == SEND_AFTER_READING || i + 1U == trace.size()) {
+                table.deleteTable();
+            }
+        }
+        log.deleteLogFile();
+    }
+    double elapsedMs = bench::elapsedNs(start, bench::Clock::now()) / 1e6;
+    countWear("year_storage", PARTITION_SIZE, logStructured);
+    printRow("log-structured flash store", logStructured, PARTITION_SIZE / hal::FLASH_SECTOR_SIZE);
+
+    uint32_t least = UINT32_MAX;
+    for (uint32_t sector = 0; sector < PARTITION_SIZE / hal::FLASH_SECTOR_SIZE; sector++) {
+        uint32_t erases = hal::sim::flashEraseCount("year_storage", sector);
+        least = erases < least ? erases : least;
+    }
+    std::printf("flash store: %u to %u erases per sector, none on the send path. simulated the year in %.0f ms\n",
+                static_cast<unsigned>(least), static_cast<unsigned>(logStructured.most), elapsedMs);
+}
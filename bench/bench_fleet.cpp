@@ -0,0 +1,52 @@
+// simulation: a fleet of devices sending to one main server, with everyone on the default tx times vs. spread out
+// $DAPHI_FLEET_DEVICES sets the fleet size (10000 by default), $DAPHI_FLEET_DAYS the simulated days (1).
+#include <cstdio>
+
+#include "bench.h"
+#include "config.h"
+#include "fleet.h"
+
+namespace {
+
+void printRow(const char *txTimes, const fleet::Report &report, uint32_t days) {
+    uint32_t peakS = static_cast<uint32_t>((report.peakAtMs / 1000) % fleet::SECONDS_PER_DAY);
+    std::printf("%-22s %10u %7llu %02u:%02u:%02u %11llu %11llu %13llu %12.0f %10.1f %9.1f\n", txTimes,
+                report.peakConcurrent, static_cast<unsigned long long>(report.collisions / days), peakS / 3600,
+                peakS / 60 % 60, peakS % 60, static_cast<unsigned long long>(report.sessions / days),
+                static_cast<unsigned long long>(report.serverBytes / days),
+                static_cast<unsigned long long>(report.peakBytesPerMinute), report.meanBytesPerMinute,
+                report.meanUploadDelayS, report.wallS);
+}
+
+}  // namespace
+
+void benchFleet() {
+    fleet::Config config;
+    config.devices = fleet::fromEnvironment("DAPHI_FLEET_DEVICES", config.devices);
+    config.days = fleet::fromEnvironment("DAPHI_FLEET_DAYS", config.days);
+
+    char title[160];
+    std::snprintf(title, sizeof(title), "Fleet: %u devices, %u simulated day(s), a server taking %u connections at once",
+                  config.devices, config.days, config.serverConnections);
+    bench::printHeader(title);
+    std::printf("%-22s %10s %7s %8s %11s %11s %13s %12s %10s %9s\n", "tx times", "peak conns", "busy", "peak at",
+                "sessions/d", "bytes/day", "peak bytes/m", "mean bytes/m", "upload s", "wall s");
+
+    fleet::Report everyone = fleet::run(config);
+    printRow("default (13:00, 20:00)", everyone, config.days);
+
+    // onChangeTxTimes, with the server spreading the fleet evenly along the day, the second 7 hours after the first
+    uint32_t devices = config.devices;
+    config.txMinutes = [devices](uint32_t deviceId, recordTimeType startMinutes[2]) {
+        uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(deviceId) * MINUTES_PER_DAY / devices);
+        startMinutes[0] = static_cast<recordTimeType>(first);
+        startMinutes[1] = static_cast<recordTimeType>((first + 7 * 60) % MINUTES_PER_DAY);
+    };
+    fleet::Report spread = fleet::run(config);
+    printRow("spread by the server", spread, config.days);
+
+    std::printf("(%u threads, %.1f M events/s; %llu Wi-Fi connects, %llu NTP syncs a day; busy: tx-slot collisions)\n",
+                spread.threads, static_cast<double>(spread.events) / spread.wallS / 1e6,
+                static_cast<unsigned long long>(spread.wifiConnects / config.days),
+                static_cast<unsigned long long>(spread.ntpSyncs / config.days));
+}
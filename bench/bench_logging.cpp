@@ -0,0 +1,138 @@
+// benchmark: binary log entries vs. the text rows they replaced, bytes per entry and addLogRow cost
+#include <cstdio>
+
+#include "bench.h"
+#include "config.h"
+#include "flash_log.h"
+#include "hal_sim.h"
+#include "logging.h"
+
+namespace {
+
+constexpr int DAYS = 20;
+constexpr uint32_t JAN_1_2026 = 1767225600;
+
+// A device's day: an hourly status check with the battery level, two sends, a clock calibration
+struct DayEntry {
+    uint16_t minute;
+    LogCode code;
+    bool hasPayload;
+    uint32_t payload;
+    const char *text;   // the row as the text log wrote it
+    const char *unit;
+};
+
+constexpr DayEntry HOURLY[] = {
+    {0, LogCode::StatusCheck, false, 0, "device status check", ""},
+    {0, LogCode::BatteryMilliVolts, true, 3912, "battery", " mV"},
+};
+constexpr DayEntry DAILY[] = {
+    {180, LogCode::ClockCalibrated, true, static_cast<uint32_t>(-2), "clock calibrated, corrected by", " s"},
+    {780, LogCode::SendingData, true, 1689, "sending data", " B"},
+    {780, LogCode::SendOk, false, 0, "sent, checksums match", ""},
+    {780, LogCode::SendingLogFile, true, 300, "sending log file", " B"},
+    {780, LogCode::SendOk, false, 0, "sent, checksums match", ""},
+    {1230, LogCode::SendingData, true, 1201, "sending data", " B"},
+    {1230, LogCode::CommError, false, 0, "communication error", ""},
+};
+
+// The text log addLogRow wrote before: "HHmm msg\n" rows
+class TextLog {
+public:
+    explicit TextLog(FlashLog &store) : store(store) {}
+    bool addLogRow(const char *msg) {
+        uint32_t secondOfDay = hal::epochSeconds() % 86400;
+        char row[96];
+        int length = std::snprintf(row, sizeof(row), "%02u%02u %s\n", static_cast<unsigned>(secondOfDay / 3600),
+                                   static_cast<unsigned>(secondOfDay / 60 % 60), msg);
+        if (bytesUsed + length > LOG_FILE_SIZE) {
+            return false;
+        }
+        bytesUsed += length;
+        return store.append(StreamId::LogFile, row, static_cast<uint16_t>(length));
+    }
+    void clear() {
+        store.clear(StreamId::LogFile);
+        bytesUsed = 0;
+    }
+    uint32_t bytesUsed = 0;
+
+private:
+    FlashLog &store;
+};
+
+template<typename AddRow>
+void runDay(int day, AddRow addRow, uint32_t &entries) {
+    for (uint16_t hour = 0; hour < 24; hour++) {
+        for (const DayEntry &entry : HOURLY) {
+            hal::setEpochSeconds(JAN_1_2026 + day * 86400U + (hour * 60U + entry.minute) * 60U);
+            addRow(entry);
+            entries++;
+        }
+    }
+    for (const DayEntry &entry : DAILY) {
+        hal::setEpochSeconds(JAN_1_2026 + day * 86400U + entry.minute * 60U);
+        addRow(entry);
+        entries++;
+    }
+}
+
+void printRow(const char *format, double bytesPerEntry, double addNs, double entriesInFile, double bytesPerDay) {
+    std::printf("%-8s %12.2f %14.1f %16.0f %14.0f\n", format, bytesPerEntry, addNs, entriesInFile, bytesPerDay);
+}
+
+}  // namespace
+
+void benchLogging() {
+    bench::printHeader("LogFile: binary entries vs. text rows (hourly status + battery, 2 sends, a day)");
+    std::printf("%-8s %12s %14s %16s %14s\n", "format", "B/entry", "addLogRow ns", "entries/4 KB", "B sent/day");
+
+    // text rows
+    hal::sim::reset();
+    flashStore.mount(STORAGE_PARTITION);
+    TextLog text(flashStore);
+    uint32_t entries = 0;
+    uint64_t bytes = 0;
+    auto start = bench::Clock::now();
+    for (int day = 0; day < DAYS; day++) {
+        text.clear();
+        runDay(day, [&](const DayEntry &entry) {
+            char msg[64];
+            if (entry.hasPayload) {
+                std::snprintf(msg, sizeof(msg), "%s %ld%s", entry.text, static_cast<long>(static_cast<int32_t>(entry.payload)),
+                              entry.unit);
+            } else {
+                std::snprintf(msg, sizeof(msg), "%s", entry.text);
+            }
+            text.addLogRow(msg);
+        }, entries);
+        bytes += text.bytesUsed;
+    }
+    double textNs = bench::elapsedNs(start, bench::Clock::now()) / entries;
+    double textBytes = static_cast<double>(bytes) / entries;
+    printRow("text", textBytes, textNs, LOG_FILE_SIZE / textBytes, static_cast<double>(bytes) / DAYS);
+
+    // binary entries
+    hal::sim::reset();
+    flashStore.mount(STORAGE_PARTITION);
+    LogFile log(LOG_FILE_SIZE);
+    log.createLogFile();
+    entries = 0;
+    bytes = 0;
+    start = bench::Clock::now();
+    for (int day = 0; day < DAYS; day++) {
+        log.deleteLogFile();
+        runDay(day, [&](const DayEntry &entry) {
+            if (entry.hasPayload) {
+                log.addLogRow(entry.code, entry.payload);
+            } else {
+                log.addLogRow(entry.code);
+            }
+        }, entries);
+        bytes += log.length();
+    }
+    double binaryNs = bench::elapsedNs(start, bench::Clock::now()) / entries;
+    double binaryBytes = static_cast<double>(bytes) / entries;
+    printRow("binary", binaryBytes, binaryNs, LOG_FILE_SIZE / binaryBytes, static_cast<double>(bytes) / DAYS);
+    std::printf("binary is %.1fx smaller per entry (deviceID and date rows included)\n", textBytes / binaryBytes);
+}
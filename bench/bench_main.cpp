@@ -0,0 +1,70 @@
+// benchmark runner
+// Runs every benchmark, or only the ones whose names are given on the command line.
+#include <cstdio>
+#include <cstring>
+
+void benchQueue();
+void benchEventRing();
+void benchData();
+void benchDataCodec();
+void benchFlashLog();
+void benchLogging();
+void benchScheduler();
+void benchSensors();
+void benchSampling();
+void benchUplink();
+void benchTransfer();
+void benchChecksum();
+void benchEnergy();
+void benchFleet();
+void benchTxSlots();
+void benchCredentialVault();
+
+namespace {
+
+struct Benchmark {
+    const char *name;
+    void (*run)();
+};
+
+constexpr Benchmark BENCHMARKS[] = {
+    {"queue", benchQueue},
+    {"event_ring", benchEventRing},
+    {"data", benchData},
+    {"data_codec", benchDataCodec},
+    {"flash_log", benchFlashLog},
+    {"logging", benchLogging},
+    {"scheduler", benchScheduler},
+    {"sensors", benchSensors},
+    {"sampling", benchSampling},
+    {"uplink", benchUplink},
+    {"transfer", benchTransfer},
+    {"checksum", benchChecksum},
+    {"energy", benchEnergy},
+    {"fleet", benchFleet},
+    {"tx_slots", benchTxSlots},
+    {"credential_vault", benchCredentialVault},
+};
+
+bool isSelected(const char *name, int argc, char **argv) {
+    if (argc < 2) {
+        return true;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    for (const Benchmark &benchmark : BENCHMARKS) {
+        if (isSelected(benchmark.name, argc, argv)) {
+            benchmark.run();
+        }
+    }
+    return 0;
+}
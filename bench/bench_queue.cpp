@@ -0,0 +1,114 @@
+// benchmark: heap Queue<T, CAPACITY> vs. the previous sort-on-insert design
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "queue.h"
+#include "types.h"
+
+namespace {
+
+constexpr int PRIORITY_LEVELS = 4;
+constexpr int STEADY_OPS = 200000;
+
+/* The design the Queue replaced: append, then re-sort the whole array on every enqueue,
+ * and shift the array left on every dequeue. */
+template<typename T>
+class SortOnInsertQueue {
+public:
+    explicit SortOnInsertQueue(uint16_t capacity) : capacity(capacity) { items.reserve(capacity); }
+    bool enqueue(const T &item) {
+        if (items.size() == capacity) {
+            return false;
+        }
+        items.push_back(item);
+        sortByPriority();
+        return true;
+    }
+    T dequeue() {
+        T item = items.front();
+        items.erase(items.begin());
+        return item;
+    }
+    bool isEmpty() const { return items.empty(); }
+
+private:
+    void sortByPriority() {
+        std::stable_sort(items.begin(), items.end(),
+                         [](const T &a, const T &b) { return a.priority < b.priority; });
+    }
+    uint16_t capacity;
+    std::vector<T> items;
+};
+
+Event randomEvent(bench::Xorshift &rng) {
+    uint32_t r = rng.next();
+    return Event{static_cast<EventType>(r % 9), static_cast<uint8_t>((r >> 8) % PRIORITY_LEVELS)};
+}
+
+// Fill to capacity and drain again. returns ns per (enqueue + dequeue) pair
+template<typename Q>
+double fillAndDrain(Q &queue, uint16_t capacity, int rounds) {
+    bench::Xorshift rng(42);
+    auto start = bench::Clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (uint16_t i = 0; i < capacity; i++) {
+            queue.enqueue(randomEvent(rng));
+        }
+        while (!queue.isEmpty()) {
+            bench::doNotOptimize(queue.dequeue());
+        }
+    }
+    return bench::elapsedNs(start, bench::Clock::now()) / (static_cast<double>(rounds) * capacity);
+}
+
+// Keep the queue half full and alternate enqueue / dequeue, like the events queue under load
+template<typename Q>
+double steadyState(Q &queue, uint16_t capacity) {
+    bench::Xorshift rng(7);
+    for (uint16_t i = 0; i < capacity / 2; i++) {
+        queue.enqueue(randomEvent(rng));
+    }
+    auto start = bench::Clock::now();
+    for (int i = 0; i < STEADY_OPS; i++) {
+        queue.enqueue(randomEvent(rng));
+        bench::doNotOptimize(queue.dequeue());
+    }
+    double ns = bench::elapsedNs(start, bench::Clock::now()) / STEADY_OPS;
+    while (!queue.isEmpty()) {
+        queue.dequeue();
+    }
+    return ns;
+}
+
+template<uint16_t CAPACITY>
+void runCapacity() {
+    int rounds = std::max(1, 200000 / CAPACITY);
+
+    static Queue<Event, CAPACITY> heap;     // static: at 1024 slots it is too big to be a polite stack object
+    SortOnInsertQueue<Event> sorted(CAPACITY);
+
+    double heapFill = fillAndDrain(heap, CAPACITY, rounds);
+    double sortedFill = fillAndDrain(sorted, CAPACITY, rounds);
+    double heapSteady = steadyState(heap, CAPACITY);
+    double sortedSteady = steadyState(sorted, CAPACITY);
+
+    std::printf("%8u %12.1f %12.1f %8.1fx %12.1f %12.1f %8.1fx %10zu\n", CAPACITY, heapFill, sortedFill,
+                sortedFill / heapFill, heapSteady, sortedSteady, sortedSteady / heapSteady, sizeof(heap));
+}
+
+}  // namespace
+
+void benchQueue() {
+    bench::printHeader("Queue: binary heap vs. sort-on-insert (ns per enqueue+dequeue)");
+    std::printf("%8s %12s %12s %9s %12s %12s %9s %10s\n", "capacity", "heap fill", "sort fill", "speedup",
+                "heap steady", "sort steady", "speedup", "heap bytes");
+    runCapacity<10>();
+    runCapacity<32>();
+    runCapacity<64>();
+    runCapacity<128>();
+    runCapacity<256>();
+    runCapacity<512>();
+    runCapacity<1024>();
+}
@@ -0,0 +1,107 @@
+// replay: adaptive sampling vs. a reading every minute, on minute-level weight traces
+// Replays the CSV trace in $DAPHI_TRACE ("minute,grams" lines, see traces.h) if it's set, or 30 synthetic bin days.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+#include "config.h"
+#include "data_codec.h"
+#include "sensors.h"
+#include "traces.h"
+
+namespace {
+
+constexpr int SYNTHETIC_DAYS = 30;
+
+struct ReplayStats {
+    double readings = 0;
+    double records = 0;
+    double bytes = 0;
+    double absErrorSum = 0;
+    double minutes = 0;
+    double worstError = 0;
+};
+
+size_t encodedBytes(const std::vector<Record> &records) {
+    std::vector<uint8_t> payload(maxEncodedDataSize(static_cast<uint16_t>(records.size())));
+    DataEncoder encoder(payload.data(), payload.size());
+    for (const Record &record : records) {
+        encoder.add(record);
+    }
+    return encoder.finish();
+}
+
+/* Replays one trace: a reading is taken every `stepMinutes` (a fixed rate), or whenever the sampler asks.
+ * The server reconstructs every minute by holding the last stored record. */
+void replay(const std::vector<Record> &trace, uint16_t stepMinutes, AdaptiveSampler *sampler, ReplayStats &stats) {
+    std::vector<Record> stored;
+    std::vector<bool> storedAt(trace.size(), false);
+    for (size_t i = 0; i < trace.size();) {
+        stats.readings++;
+        bool store = sampler != nullptr ? sampler->onReading(trace[i]) : true;
+        if (store) {
+            stored.push_back(trace[i]);
+            storedAt[i] = true;
+        }
+        i += sampler != nullptr ? sampler->intervalS() / 60 : stepMinutes;
+    }
+    weightType held = stored.empty() ? 0 : stored.front().weight;
+    for (size_t i = 0; i < trace.size(); i++) {
+        if (storedAt[i]) {
+            held = trace[i].weight;
+        }
+        double error = std::fabs(static_cast<double>(trace[i].weight) - held);
+        stats.absErrorSum += error;
+        stats.worstError = std::max(stats.worstError, error);
+        stats.minutes++;
+    }
+    stats.records += static_cast<double>(stored.size());
+    stats.bytes += static_cast<double>(encodedBytes(stored));
+}
+
+void printRow(const char *mode, const ReplayStats &stats, double days) {
+    std::printf("%-26s %14.0f %14.0f %12.0f %14.2f %12.0f\n", mode, stats.readings / days, stats.records / days,
+                stats.bytes / days, stats.absErrorSum / stats.minutes, stats.worstError);
+}
+
+}  // namespace
+
+void benchSampling() {
+    std::vector<std::vector<Record>> traces;
+    const char *path = std::getenv("DAPHI_TRACE");
+    if (path != nullptr) {
+        traces.push_back(bench::loadTraceCsv(path));
+        if (traces.back().empty()) {
+            std::printf("can't read the trace %s\n", path);
+            return;
+        }
+        bench::printHeader("Sampling modes, replayed on the trace from $DAPHI_TRACE");
+    } else {
+        for (int day = 0; day < SYNTHETIC_DAYS; day++) {
+            traces.push_back(bench::syntheticBinDay(static_cast<uint32_t>(500 + day)));
+        }
+        bench::printHeader("Sampling modes, replayed on 30 synthetic bin days (14 h of readings each)");
+    }
+    std::printf("%-26s %14s %14s %12s %14s %12s\n", "mode", "readings/day", "records/day", "B sent/day", "mean error g",
+                "worst g");
+
+    double days = path != nullptr ? 1 : SYNTHETIC_DAYS;
+    ReplayStats everyMinute;
+    ReplayStats everyFive;
+    ReplayStats adaptive;
+    for (const std::vector<Record> &trace : traces) {
+        replay(trace, 1, nullptr, everyMinute);
+        replay(trace, 5, nullptr, everyFive);
+        AdaptiveSampler sampler(AdaptiveConfig{ADAPTIVE_DEAD_BAND_GRAMS, ADAPTIVE_SETTLE_BAND_GRAMS,
+                                               ADAPTIVE_HEARTBEAT_MINUTES, senseInterval / 1000U,
+                                               ADAPTIVE_IDLE_INTERVAL_S, ADAPTIVE_QUIET_READINGS});
+        replay(trace, 1, &sampler, adaptive);
+    }
+    printRow("every minute (baseline)", everyMinute, days);
+    printRow("every 5 minutes", everyFive, days);
+    printRow("adaptive", adaptive, days);
+    std::printf("adaptive: %.1fx fewer readings, %.1fx fewer bytes sent than every minute\n",
+                everyMinute.readings / adaptive.readings, everyMinute.bytes / adaptive.bytes);
+}
@@ -0,0 +1,89 @@
+// benchmark: wakeups per day and awake time, with and without timer coalescing
+#include <cstdio>
+
+#include "bench.h"
+#include "scheduler.h"
+
+namespace {
+
+constexpr uint32_t DAY = 86400;
+constexpr uint32_t MIDNIGHT = 1792195200;   // 17/10/2026 00:00 UTC
+constexpr uint32_t BOOT = MIDNIGHT + 6 * 3600 + 29;
+constexpr int DAYS = 30;
+
+// Awake time model (ms). A wakeup pays the sleep exit and going back to sleep once, however many jobs it runs,
+// and the Wi-Fi jobs share one connection when they run together.
+constexpr double WAKEUP_MS = 40;            // deep sleep exit, boot from the RTC, and back
+constexpr double WIFI_CONNECT_MS = 1500;
+constexpr double JOB_MS[JOB_COUNT] = {
+    110,    // Sense: one HX711 conversion at 10 SPS, and storing it
+    800,    // TxFirst: encode and send the table and the log
+    800,    // TxSecond
+    300,    // CalibrateClock: an NTP round trip
+    60,     // CheckDeviceStatus: battery and sensors (the server ping is counted as Wi-Fi)
+    800,    // TxRetry: the table again, after a busy server's backoff (never due here)
+};
+constexpr bool NEEDS_WIFI[JOB_COUNT] = {false, true, true, true, true, true};
+
+struct DayStats {
+    double wakeups = 0;
+    double awakeMs = 0;
+    double jobs = 0;
+};
+
+DayStats simulate(bool sensing, uint32_t slackS) {
+    // tx times with the per-device seconds offset the server spreads the load with
+    SchedulerConfig config{60, {13 * 3600 + 17, 20 * 3600 + 43}, 3 * 3600 + 5, 3600, slackS};
+    Scheduler scheduler(config);
+    scheduler.setEnabled(Job::Sense, sensing, BOOT);
+    scheduler.start(BOOT);
+    DayStats stats;
+    while (scheduler.nextWakeup() < BOOT + DAYS * DAY) {
+        Job due[JOB_COUNT];
+        uint8_t count = scheduler.runDue(scheduler.nextWakeup(), due);
+        bool wifi = false;
+        stats.wakeups++;
+        stats.awakeMs += WAKEUP_MS;
+        for (uint8_t i = 0; i < count; i++) {
+            uint8_t job = static_cast<uint8_t>(due[i]);
+            stats.awakeMs += JOB_MS[job];
+            wifi = wifi || NEEDS_WIFI[job];
+        }
+        stats.awakeMs += wifi ? WIFI_CONNECT_MS : 0;
+        stats.jobs += count;
+    }
+    stats.wakeups /= DAYS;
+    stats.awakeMs /= DAYS;
+    stats.jobs /= DAYS;
+    return stats;
+}
+
+void printRow(const char *scenario, uint32_t slackS, const DayStats &stats) {
+    std::printf("%-22s %8u %12.0f %10.0f %14.1f\n", scenario, static_cast<unsigned>(slackS), stats.wakeups, stats.jobs,
+                stats.awakeMs / 1000);
+}
+
+}  // namespace
+
+void benchScheduler() {
+    bench::printHeader("Scheduler: wakeups and awake time per day (30 simulated days)");
+    std::printf("%-22s %8s %12s %10s %14s\n", "scenario", "slack s", "wakeups/day", "jobs/day", "awake s/day");
+
+    const uint32_t slacks[] = {0, 15, 30, 45};     // shorter than the sense interval, see scheduler.h
+    for (bool sensing : {true, false}) {
+        for (uint32_t slackS : slacks) {
+            printRow(sensing ? "sensing every minute" : "inactive (no sensing)", slackS, simulate(sensing, slackS));
+        }
+    }
+
+    auto start = bench::Clock::now();
+    uint32_t wakeups = 0;
+    SchedulerConfig config{60, {13 * 3600 + 17, 20 * 3600 + 43}, 3 * 3600 + 5, 3600, 30};
+    Scheduler scheduler(config);
+    scheduler.start(BOOT);
+    for (; wakeups < 100000; wakeups++) {
+        Job due[JOB_COUNT];
+        bench::doNotOptimize(scheduler.runDue(scheduler.nextWakeup(), due));
+    }
+    std::printf("runDue + reschedule: %.0f ns per wakeup\n", bench::elapsedNs(start, bench::Clock::now()) / wakeups);
+}
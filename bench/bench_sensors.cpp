@@ -0,0 +1,189 @@
+// benchmark: load-cell sample filters (accuracy, cost) and CPU duty cycle, interrupt-driven vs. busy-waiting on DOUT
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "bench.h"
+#include "config.h"
+#include "hal.h"
+#include "hal_sim.h"
+#include "sensors.h"
+
+namespace {
+
+constexpr int READINGS = 2000;
+constexpr int32_t TARE_RAW = 84000;
+constexpr double TRUE_GRAMS = 3500;    // a bin with 3.5 kg of waste
+constexpr double NOISE_COUNTS = 60;    // HX711 RMS noise at gain 128, 10 SPS (~3 g)
+
+// CPU model (us). a wakeup from light sleep pays the exit and going back, plus the interrupt's own entry and exit
+constexpr double LIGHT_SLEEP_WAKE_US = 500;
+constexpr double ISR_OVERHEAD_US = 5;
+
+// the simulated HX711's signal: the load plus noise, and now and then a spike
+bench::Xorshift rng(12345);
+double spikeRate = 0;
+
+double gaussian() {
+    double u1 = (rng.next() + 1.0) / 4294967297.0;
+    double u2 = (rng.next() + 1.0) / 4294967297.0;
+    return std::sqrt(-2 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+}
+
+int32_t plateSignal(uint32_t nowMs) {
+    (void) nowMs;
+    double raw = TARE_RAW + TRUE_GRAMS * LOAD_CELL_DEFAULT_COUNTS_PER_GRAM + NOISE_COUNTS * gaussian();
+    if (rng.next() % 10000 < spikeRate * 10000) {
+        raw += (rng.next() % 2 ? 1 : -1) * (20000.0 + rng.next() % 60000);    // something brushing the plate, 1-4 kg
+    }
+    return static_cast<int32_t>(std::lround(raw));
+}
+
+struct FilterStats {
+    double rmsGrams = 0;
+    double worstGrams = 0;
+};
+
+FilterStats measureFilter(SampleFilter filter, double spikes) {
+    hal::sim::reset();
+    hal::sim::setLoadCellSource(plateSignal);
+    spikeRate = spikes;
+    hal::loadCellBegin();
+    hal::loadCellPowerDown();
+    LoadCellCalibration calibration{TARE_RAW, LOAD_CELL_DEFAULT_COUNTS_PER_GRAM};
+    FilterStats stats;
+    double squares = 0;
+    for (int i = 0; i < READINGS; i++) {
+        int32_t raw = 0;
+        sampleLoadCell(filter, raw);
+        double error = static_cast<double>(rawToGrams(raw, calibration)) - TRUE_GRAMS;
+        squares += error * error;
+        stats.worstGrams = std::max(stats.worstGrams, std::fabs(error));
+        hal::sleepMs(senseInterval - hal::millis() % senseInterval);
+    }
+    stats.rmsGrams = std::sqrt(squares / READINGS);
+    return stats;
+}
+
+double reduceNs(SampleFilter filter) {
+    int32_t burst[LOAD_CELL_RING_LENGTH];
+    for (int32_t &sample : burst) {
+        sample = static_cast<int32_t>(rng.next() % 100000);
+    }
+    constexpr int CALLS = 200000;
+    auto start = bench::Clock::now();
+    for (int i = 0; i < CALLS; i++) {
+        int32_t samples[LOAD_CELL_RING_LENGTH];
+        std::copy(burst, burst + LOAD_CELL_RING_LENGTH, samples);
+        bench::doNotOptimize(reduceSamples(samples, LOAD_CELL_RING_LENGTH, filter));
+    }
+    return bench::elapsedNs(start, bench::Clock::now()) / CALLS;
+}
+
+// what getLoadCellData did before the interrupt: spin on DOUT for each sample of the burst
+double busyWaitBurstMs() {
+    hal::sim::reset();
+    hal::sim::setLoadCellRaw(TARE_RAW);
+    hal::loadCellBegin();
+    uint64_t start = hal::micros();
+    for (uint16_t i = 0; i < LOAD_CELL_SETTLE_SAMPLES + LOAD_CELL_RING_LENGTH; i++) {
+        while (!hal::loadCellIsReady()) {
+            hal::sim::advanceUs(10);    // one poll
+        }
+        bench::doNotOptimize(hal::loadCellReadRaw());
+    }
+    hal::loadCellPowerDown();
+    return static_cast<double>(hal::micros() - start) / 1000;
+}
+
+void printDuty(const char *strategy, double awakeMs, double wakeups) {
+    std::printf("%-26s %16.2f %14.3f %18.0f\n", strategy, awakeMs, 100 * awakeMs / senseInterval, wakeups);
+}
+
+// the legacy LoadCell.start(2000, true) at every wakeup: stabilising, a tare over HX711_ADC's 16 sample dataset, a burst
+constexpr uint32_t LEGACY_STABILISING_MS = 2000;
+constexpr uint32_t LEGACY_TARE_SAMPLES = 16;
+
+// how long the chip stays up for a reading started from state: from the wakeup until the HX711 is powered down again
+double startAwakeMs(LoadCellWarmState &state, LoadCellReading &reading) {
+    uint64_t start = hal::micros();
+    readLoadCell(LOAD_CELL_FILTER, reading, state);
+    return static_cast<double>(hal::micros() - start) / 1000;
+}
+
+uint32_t driftUntilMs = 0;
+
+int32_t driftingPlate(uint32_t nowMs) {
+    int32_t settled = plateSignal(nowMs);
+    return nowMs < driftUntilMs ? settled - static_cast<int32_t>(driftUntilMs - nowMs) : settled;
+}
+
+void printStart(const char *start, double awakeMs, double baselineMs) {
+    std::printf("%-26s %16.0f %14.2f %18.2f\n", start, awakeMs, 100 * awakeMs / senseInterval, baselineMs / awakeMs);
+}
+
+}  // namespace
+
+void benchSensors() {
+    bench::printHeader("Load cell: filters over a 16-sample burst (2000 readings of 3.5 kg, 3 g RMS noise)");
+    std::printf("%-14s %8s %14s %14s %12s\n", "filter", "spikes", "RMS error g", "worst error g", "reduce ns");
+    const struct {
+        const char *name;
+        SampleFilter filter;
+    } filters[] = {{"mean", SampleFilter::Mean}, {"median", SampleFilter::Median}, {"trimmed mean", SampleFilter::TrimmedMean}};
+    for (double spikes : {0.0, 0.05}) {
+        for (const auto &entry : filters) {
+            FilterStats stats = measureFilter(entry.filter, spikes);
+            std::printf("%-14s %7.0f%% %14.2f %14.0f %12.1f\n", entry.name, spikes * 100, stats.rmsGrams, stats.worstGrams,
+                        reduceNs(entry.filter));
+        }
+    }
+
+    bench::printHeader("Load cell: CPU awake time per reading (one reading a minute)");
+    std::printf("%-26s %16s %14s %18s\n", "strategy", "awake ms/reading", "duty cycle %", "wakeups/reading");
+
+    // one interrupt-driven burst: the CPU wakes only for the conversions, and each read is measured on the bit-bang model
+    hal::sim::reset();
+    hal::sim::setLoadCellRaw(TARE_RAW);
+    hal::loadCellBegin();
+    hal::loadCellPowerDown();
+    int32_t raw = 0;
+    sampleLoadCell(LOAD_CELL_FILTER, raw);
+    uint32_t reads = hal::sim::loadCellReads();
+    hal::loadCellPowerUp();
+    hal::sleepMs(LOAD_CELL_SAMPLE_PERIOD_MS - 1);   // just before a conversion
+    hal::sleepMs(1);
+    uint64_t readStart = hal::micros();
+    hal::loadCellReadRaw();
+    double readUs = static_cast<double>(hal::micros() - readStart);
+    double interruptMs = (reads * (LIGHT_SLEEP_WAKE_US + ISR_OVERHEAD_US + readUs) + 2 * LIGHT_SLEEP_WAKE_US) / 1000;
+
+    printDuty("busy-wait on DOUT", busyWaitBurstMs(), 1);
+    printDuty("DOUT interrupt, sleeping", interruptMs, reads + 2.0);
+    std::printf("(%u conversions per reading, %.0f us to shift one out)\n", static_cast<unsigned>(reads), readUs);
+
+    bench::printHeader("Load cell: awake ms per reading, by start (a wakeup from deep sleep every minute)");
+    std::printf("%-26s %16s %14s %18s\n", "start", "awake ms/reading", "duty cycle %", "vs legacy, x less");
+    hal::sim::reset();
+    hal::sim::setLoadCellSource(plateSignal);
+    spikeRate = 0;
+    hal::loadCellBegin();
+    hal::loadCellPowerDown();
+    LoadCellCalibration calibration{TARE_RAW, LOAD_CELL_DEFAULT_COUNTS_PER_GRAM};
+    hal::nvsSet(NVS_KEY_LOAD_CELL_CAL, &calibration, sizeof(calibration));
+    LoadCellWarmState state{};
+    LoadCellReading reading;
+    double legacyMs = LEGACY_STABILISING_MS + (LEGACY_TARE_SAMPLES + LOAD_CELL_RING_LENGTH + 1) * LOAD_CELL_SAMPLE_PERIOD_MS;
+    double coldMs = startAwakeMs(state, reading);           // a power-up: the RTC state is zeroed
+    double warmMs = 0;
+    for (int i = 0; i < READINGS; i++) {
+        warmMs += startAwakeMs(state, reading) / READINGS;
+    }
+    driftUntilMs = hal::millis() + 2000;     // creeping 1 count a ms, as after a cold night
+    hal::sim::setLoadCellSource(driftingPlate);
+    double fallbackMs = startAwakeMs(state, reading);
+    printStart("legacy start(2000, true)", legacyMs, legacyMs);
+    printStart("cold (power-up)", coldMs, legacyMs);
+    printStart("warm (RTC calibration)", warmMs, legacyMs);
+    printStart(reading.driftFallback ? "warm, drifted, then cold" : "warm, drift not caught", fallbackMs, legacyMs);
+}
@@ -0,0 +1,256 @@
+// benchmark: bytes and round trips to deliver a data table over a lossy link, chunked resume vs. whole-file retry
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "checksum.h"
+#include "config.h"
+#include "credential_vault.h"
+#include "data.h"
+#include "data_codec.h"
+#include "hal.h"
+#include "hal_sim.h"
+#include "networkings.h"
+#include "traces.h"
+#include "wifi_link.h"
+
+namespace {
+
+constexpr int TRIALS = 300;
+
+/* A loopback main server that speaks both protocols, and a lossy link in front of it: every message is corrupted
+ * with a probability that grows with its size (lossPerKiB, independently per KiB), and the link breaks the same way
+ * (dropPerKiB). A corrupted whole file fails its checksum, a corrupted chunk its CRC. */
+class LossyServer : public hal::sim::SocketPeer {
+public:
+    LossyServer(double lossPerKiB, double dropPerKiB, uint32_t seed) : loss(lossPerKiB), drop(dropPerKiB), rng(seed) {}
+
+    uint32_t bytesIn = 0;
+    uint32_t bytesOut = 0;
+    uint32_t connects = 0;
+    bool delivered = false;
+
+    bool onConnect(const char *host, uint16_t port) override {
+        (void) host;
+        (void) port;
+        pending.clear();
+        connects++;
+        return true;
+    }
+
+    void onReceive(int socket, const uint8_t *data, size_t length, std::vector<uint8_t> &reply) override {
+        pending.insert(pending.end(), data, data + length);
+        while (pending.size() >= 5) {
+            uint32_t payloadLength = load32(&pending[1]);
+            if (pending.size() < 5 + payloadLength) {
+                return;
+            }
+            MessageType type = static_cast<MessageType>(pending[0]);
+            std::vector<uint8_t> payload(pending.begin() + 5, pending.begin() + 5 + payloadLength);
+            pending.erase(pending.begin(), pending.begin() + 5 + payloadLength);
+            bytesIn += 5 + payloadLength;
+            if (happens(drop, payload.size())) {
+                hal::sim::dropSocket(socket);
+                pending.clear();
+                return;
+            }
+            bool corrupt = happens(loss, payload.size());
+            size_t before = reply.size();
+            if (type == MessageType::DataTable) {       // whole file: reply with the CRC of what arrived
+                uint32_t crc = crc32(payload.data(), payload.size() - DATA_CHECKSUM_SIZE) ^ (corrupt ? 1 : 0);
+                for (int i = 0; i < 4; i++) {
+                    reply.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+                }
+            } else if (type == MessageType::ChecksumOk) {
+                delivered = true;
+            } else if (type == MessageType::TransferOffer) {
+                onOffer(payload, reply);
+            } else if (type == MessageType::TransferChunk && !corrupt && load32(&payload[0]) == transferId) {
+                received[payload[4] | (payload[5] << 8)] = true;
+            }
+            bytesOut += static_cast<uint32_t>(reply.size() - before);
+        }
+    }
+
+private:
+    static uint32_t load32(const uint8_t *bytes) {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    bool happens(double perKiB, size_t bytes) {
+        double probability = 1 - std::pow(1 - perKiB, static_cast<double>(bytes) / 1024);
+        return static_cast<double>(rng.next() % 1000000) < probability * 1000000;
+    }
+
+    void onOffer(const std::vector<uint8_t> &offer, std::vector<uint8_t> &reply) {
+        uint32_t id = load32(&offer[0]);
+        uint16_t count = static_cast<uint16_t>(offer[11] | (offer[12] << 8));
+        if (id != transferId) {
+            transferId = id;
+            received.assign(count, false);
+        }
+        reply.insert(reply.end(), offer.begin(), offer.begin() + 4);
+        reply.push_back(static_cast<uint8_t>(count));
+        reply.push_back(static_cast<uint8_t>(count >> 8));
+        bool complete = true;
+        for (uint16_t byte = 0; byte < (count + 7) / 8; byte++) {
+            uint8_t bits = 0;
+            for (uint16_t bit = 0; bit < 8 && byte * 8 + bit < count; bit++) {
+                bits |= received[byte * 8 + bit] ? 1 << bit : 0;
+                complete = complete && received[byte * 8 + bit];
+            }
+            reply.push_back(bits);
+        }
+        delivered = delivered || complete;
+    }
+
+    double loss;
+    double drop;
+    bench::Xorshift rng;
+    std::vector<uint8_t> pending;
+    uint32_t transferId = 0;
+    std::vector<bool> received;
+};
+
+/* ---- the whole-file protocol onSendData used before chunking ----
+ * A message as networkings.h frames it, the whole payload at once; the server replies with the CRC32 of what it got */
+int connectToServer() {
+    char serverIp[16] = {};
+    if (!hal::nvsGet(NVS_KEY_SERVER_IP, serverIp, sizeof(serverIp))) {
+        return hal::INVALID_SOCKET;
+    }
+    serverIp[sizeof(serverIp) - 1] = '\0';
+    return hal::socketConnect(serverIp, MAIN_SERVER_PORT, MAIN_SERVER_TIMEOUT_MS);
+}
+
+bool sendMessage(int socket, MessageType type, const uint8_t *payload, size_t length) {
+    uint8_t header[5] = {static_cast<uint8_t>(type), static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+                         static_cast<uint8_t>(length >> 16), static_cast<uint8_t>(length >> 24)};
+    return hal::socketSend(socket, header, sizeof(header)) == static_cast<int32_t>(sizeof(header)) &&
+           (length == 0 || hal::socketSend(socket, payload, length) == static_cast<int32_t>(length));
+}
+
+// false on a communication error. serverChecksum is set only on true
+bool sendWhole(MessageType type, const uint8_t *payload, size_t length, uint32_t &serverChecksum) {
+    WifiHold link(EnergyTask::Events);
+    int socket = connectToServer();
+    if (socket == hal::INVALID_SOCKET) {
+        return false;
+    }
+    uint8_t reply[4];
+    size_t received = 0;
+    bool ok = sendMessage(socket, type, payload, length);
+    while (ok && received < sizeof(reply)) {
+        int32_t count = hal::socketReceive(socket, reply + received, sizeof(reply) - received, MAIN_SERVER_TIMEOUT_MS);
+        ok = count > 0;
+        received += ok ? static_cast<size_t>(count) : 0;
+    }
+    hal::socketClose(socket);
+    if (ok) {
+        serverChecksum = static_cast<uint32_t>(reply[0]) | (static_cast<uint32_t>(reply[1]) << 8) |
+                         (static_cast<uint32_t>(reply[2]) << 16) | (static_cast<uint32_t>(reply[3]) << 24);
+    }
+    return ok;
+}
+
+void notify(MessageType type) {
+    WifiHold link(EnergyTask::Events);
+    int socket = connectToServer();
+    if (socket != hal::INVALID_SOCKET) {
+        sendMessage(socket, type, nullptr, 0);
+        hal::socketClose(socket);
+    }
+}
+
+// the exchange: send, compare the server's CRC, resend it all on a mismatch
+bool sendWholeFile(const uint8_t *payload, size_t length, uint32_t &roundTrips) {
+    uint32_t checksum = dataPayloadChecksum(payload, length);
+    for (uint8_t attempt = 0; attempt < MAX_SEND_ATTEMPTS; attempt++) {
+        uint32_t serverChecksum = 0;
+        roundTrips++;
+        if (!sendWhole(MessageType::DataTable, payload, length, serverChecksum)) {
+            return false;   // communication error: kept for the next tx time
+        }
+        if (serverChecksum == checksum) {
+            notify(MessageType::ChecksumOk);
+            return true;
+        }
+        notify(MessageType::ChecksumMismatch);
+    }
+    return false;
+}
+
+struct Cost {
+    double bytes = 0;           // both ways, message headers included
+    double roundTrips = 0;
+    double connects = 0;
+    double firstTry = 0;        // share of tables delivered by the first call, i.e. at their tx time
+};
+
+// the stored network the sessions' WifiHold joins, in range
+void storeReachableNetwork() {
+    hal::sim::addAccessPoint({"daphi-depot", "compost-heap", {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01}, 6, -55});
+    credentialVault.mount();
+    credentialVault.add("daphi-depot", "compost-heap");
+}
+
+Cost deliver(bool chunked, const std::vector<uint8_t> &table, double lossPerKiB, double dropPerKiB) {
+    Cost cost;
+    for (int trial = 0; trial < TRIALS; trial++) {
+        hal::sim::reset();
+        char serverIp[16] = "192.168.0.118";
+        hal::nvsSet(NVS_KEY_SERVER_IP, serverIp, sizeof(serverIp));
+        storeReachableNetwork();
+        LossyServer server(lossPerKiB, dropPerKiB, 7919U * (trial + 1));
+        hal::sim::setSocketPeer(&server);
+        uint32_t roundTrips = 0;
+        for (int call = 0; call < 50 && !server.delivered; call++) {    // a call per tx time, until it's through
+            if (chunked) {
+                TransferStats stats;
+                sendChunkedToMainServer(MessageType::DataTable, table.data(), table.size(), &stats);
+                roundTrips += stats.roundTrips;
+            } else {
+                sendWholeFile(table.data(), table.size(), roundTrips);
+            }
+            cost.firstTry += call == 0 && server.delivered ? 1 : 0;
+        }
+        cost.bytes += server.bytesIn + server.bytesOut;
+        cost.roundTrips += roundTrips;
+        cost.connects += server.connects;
+        hal::sim::setSocketPeer(nullptr);
+    }
+    cost.bytes /= TRIALS;
+    cost.roundTrips /= TRIALS;
+    cost.connects /= TRIALS;
+    cost.firstTry = 100 * cost.firstTry / TRIALS;
+    return cost;
+}
+
+}  // namespace
+
+void benchTransfer() {
+    bench::printHeader("Data table delivery over a lossy link: chunked resume vs. whole-file retry");
+    static uint8_t payload[maxEncodedDataSize(DATA_TABLE_CAPACITY)];
+    static DataTable table(DATA_TABLE_CAPACITY);
+    hal::sim::reset();
+    table.createDataTable();
+    for (const Record &record : bench::syntheticBinDay(1000)) {
+        table.updateTable(record);
+    }
+    std::vector<uint8_t> encoded(payload, payload + encodeDataTable(table.readTable(), payload, sizeof(payload)));
+    std::printf("table: %zu bytes, %u chunks of %u. %d trials per row, mean per delivered table\n", encoded.size(),
+                static_cast<unsigned>((encoded.size() + TRANSFER_CHUNK_SIZE - 1) / TRANSFER_CHUNK_SIZE),
+                static_cast<unsigned>(TRANSFER_CHUNK_SIZE), TRIALS);
+    std::printf("%10s %10s | %10s %8s %8s %8s | %10s %8s %8s %8s\n", "loss/KiB", "drop/KiB", "whole B", "RTTs",
+                "conns", "1st %", "chunked B", "RTTs", "conns", "1st %");
+
+    const double rates[][2] = {{0, 0}, {0.05, 0}, {0.2, 0}, {0.4, 0}, {0, 0.1}, {0.2, 0.1}};
+    for (const auto &rate : rates) {
+        Cost whole = deliver(false, encoded, rate[0], rate[1]);
+        Cost chunked = deliver(true, encoded, rate[0], rate[1]);
+        std::printf("%10.2f %10.2f | %10.0f %8.2f %8.2f %8.1f | %10.0f %8.2f %8.2f %8.1f\n", rate[0], rate[1],
+                    whole.bytes, whole.roundTrips, whole.connects, whole.firstTry, chunked.bytes, chunked.roundTrips,
+                    chunked.connects, chunked.firstTry);
+    }
+}
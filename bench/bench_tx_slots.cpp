@@ -0,0 +1,55 @@
+// simulation: tx slots (tx_slots.h) on a fleet: fixed tx times vs. jittered ones, busy backoff and renegotiation
+// $DAPHI_FLEET_DEVICES sets the fleet size (10000 by default), $DAPHI_FLEET_DAYS the simulated days (2).
+#include <cstdio>
+
+#include "bench.h"
+#include "config.h"
+#include "fleet.h"
+
+namespace {
+
+void printRow(const char *policy, const fleet::Report &report, uint32_t days) {
+    std::printf("%-30s %9u %9u %9llu %13llu %10.1f %8llu %11u %8llu %9.1f\n", policy, report.peakOfferedPerMinute,
+                report.peakAcceptedPerMinute,
+                static_cast<unsigned long long>(report.collisions / days),
+                static_cast<unsigned long long>(report.peakBytesPerMinute), report.meanUploadDelayS,
+                static_cast<unsigned long long>(report.retries / days), report.undelivered,
+                static_cast<unsigned long long>(report.renegotiations), report.wallS);
+}
+
+}  // namespace
+
+void benchTxSlots() {
+    fleet::Config config;
+    config.devices = fleet::fromEnvironment("DAPHI_FLEET_DEVICES", config.devices);
+    config.days = fleet::fromEnvironment("DAPHI_FLEET_DAYS", 2);
+    config.serverConnections = 16;      // a small server, so the slots fill up
+    config.retryAfterS = 5;
+
+    char title[160];
+    std::snprintf(title, sizeof(title), "Tx slots: %u devices, %u simulated days, a server taking %u connections at once",
+                  config.devices, config.days, config.serverConnections);
+    bench::printHeader(title);
+    std::printf("%-30s %9s %9s %9s %13s %10s %8s %11s %8s %9s\n", "policy", "tried/m", "taken/m", "busy/day",
+                "peak bytes/m", "upload s", "retry/d", "undelivered", "new slot", "wall s");
+
+    printRow("fixed (13:00, 20:00)", fleet::run(config), config.days);
+
+    config.txWindowS = 60;
+    printRow("jittered over 1 min", fleet::run(config), config.days);
+    config.backoff = true;
+    printRow("  + busy backoff", fleet::run(config), config.days);
+    config.renegotiate = true;
+    printRow("  + renegotiation", fleet::run(config), config.days);
+
+    config.txWindowS = DEFAULT_TX_WINDOW_S;
+    config.backoff = false;
+    config.renegotiate = false;
+    printRow("jittered over 15 min", fleet::run(config), config.days);
+    config.backoff = true;
+    config.renegotiate = true;
+    printRow("  + backoff, renegotiation", fleet::run(config), config.days);
+
+    std::printf("(tried/m, taken/m: the busiest minute's connections, offered and accepted; upload s: from the slot's "
+                "start to the DataTable's delivery; busy: connections turned away)\n");
+}
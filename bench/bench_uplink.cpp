@@ -0,0 +1,228 @@
+// benchmark: radio-on time and bytes per day of the MQTT uplink, per message vs. batched and pipelined, and an outage
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "config.h"
+#include "credential_vault.h"
+#include "data.h"
+#include "data_codec.h"
+#include "hal_sim.h"
+#include "traces.h"
+#include "uplink.h"
+#include "wifi_link.h"
+
+namespace {
+
+constexpr int DAYS = 7;
+constexpr uint32_t MIDNIGHT = 1792195200;   // 17/10/2026 00:00 UTC
+constexpr uint16_t TX_MINUTES[2] = {13 * 60, 20 * 60};
+constexpr size_t STATUS_BYTES = 24;         // an hourly status message
+constexpr size_t LOG_BYTES = 180;           // the log chunk sent with each half of the table
+
+// Radio-on time model. Every connection pays the Wi-Fi association and DHCP, and the TCP handshake; every wait
+// for the broker a round trip; every byte its airtime; and every TCP segment its TCP/IP and 802.11 headers.
+constexpr double WIFI_CONNECT_MS = 1500;
+constexpr double RTT_MS = 60;               // to the broker, over the Internet
+constexpr double US_PER_BYTE = 8;           // ~1 Mbit/s effective at the low rates a far bin links at
+constexpr uint32_t SEGMENT_OVERHEAD = 40 + 34;  // IPv4 + TCP, and the 802.11 MAC header and FCS
+
+/* A broker stand-in: acknowledges CONNECT and every QoS 1 PUBLISH, counting the TCP segments both ways */
+class BenchBroker : public hal::sim::SocketPeer {
+public:
+    bool online = true;
+    uint32_t segments = 0;
+
+    bool onConnect(const char *host, uint16_t port) override {
+        (void) host;
+        (void) port;
+        pending.clear();
+        segments += online ? 3 : 2;     // SYN, SYN-ACK, ACK, or SYN and the RST
+        return online;
+    }
+
+    void onReceive(int socket, const uint8_t *data, size_t length, std::vector<uint8_t> &reply) override {
+        (void) socket;
+        segments++;
+        pending.insert(pending.end(), data, data + length);
+        while (pending.size() >= 2) {
+            size_t remaining = 0;
+            size_t header = 1;
+            for (int shift = 0; header < pending.size(); shift += 7) {
+                remaining |= static_cast<size_t>(pending[header] & 0x7F) << shift;
+                if ((pending[header++] & 0x80) == 0) {
+                    break;
+                }
+            }
+            if (pending.size() < header + remaining) {
+                return;
+            }
+            uint8_t type = pending[0];
+            if (type == 0x10) {
+                reply.insert(reply.end(), {0x20, 0x02, 0x00, 0x00});
+                segments++;
+            } else if (type == 0x32) {
+                size_t idAt = header + 2 + ((pending[header] << 8) | pending[header + 1]);
+                reply.insert(reply.end(), {0x40, 0x02, pending[idAt], pending[idAt + 1]});
+                segments++;
+            }
+            pending.erase(pending.begin(), pending.begin() + header + remaining);
+        }
+    }
+
+    void onClose(int socket) override {
+        (void) socket;
+        segments += 2;      // FIN both ways
+    }
+
+private:
+    std::vector<uint8_t> pending;
+};
+
+struct Message {
+    uint32_t atS;
+    MessageType type;
+    std::vector<uint8_t> payload;
+};
+
+// A week of messages: a status every hour, and at each tx time half of the day's table and a log chunk
+std::vector<Message> weekOfMessages() {
+    std::vector<Message> messages;
+    static uint8_t payload[maxEncodedDataSize(DATA_TABLE_CAPACITY)];
+    static DataTable table(DATA_TABLE_CAPACITY);
+    for (int day = 0; day < DAYS; day++) {
+        std::vector<Record> trace = bench::syntheticBinDay(1000 + day);
+        uint32_t midnight = MIDNIGHT + day * 86400U;
+        for (uint32_t hour = 0; hour < 24; hour++) {
+            messages.push_back(Message{midnight + hour * 3600 + 60, MessageType::Status,
+                                       std::vector<uint8_t>(STATUS_BYTES, static_cast<uint8_t>(hour))});
+        }
+        for (int half = 0; half < 2; half++) {
+            table.createDataTable();
+            for (size_t i = half * trace.size() / 2; i < (half + 1) * trace.size() / 2; i++) {
+                table.updateTable(trace[i]);
+            }
+            size_t length = encodeDataTable(table.readTable(), payload, sizeof(payload));
+            uint32_t at = midnight + TX_MINUTES[half] * 60U;
+            messages.push_back(Message{at, MessageType::DataTable, std::vector<uint8_t>(payload, payload + length)});
+            messages.push_back(Message{at, MessageType::LogFile, std::vector<uint8_t>(LOG_BYTES, 0x5A)});
+        }
+    }
+    std::sort(messages.begin(), messages.end(), [](const Message &a, const Message &b) { return a.atS < b.atS; });
+    return messages;
+}
+
+struct DayCost {
+    double connects = 0;
+    double failedConnects = 0;
+    double publishes = 0;
+    double roundTrips = 0;
+    double bytes = 0;           // on air, headers included
+    double radioMs = 0;
+};
+
+enum class Policy : uint8_t {
+    PerMessage,     // every message in its own connection, when it's made
+    AtTxTimes,      // the backlog at the tx times, batched and pipelined
+};
+
+// the stored network the sessions' WifiHold joins, in range
+void storeReachableNetwork() {
+    hal::sim::addAccessPoint({"daphi-depot", "compost-heap", {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01}, 6, -55});
+    credentialVault.mount();
+    credentialVault.add("daphi-depot", "compost-heap");
+}
+
+DayCost simulate(const std::vector<Message> &messages, Policy policy, uint32_t outageFromS, uint32_t outageToS) {
+    hal::sim::reset();
+    flashStore.mount(STORAGE_PARTITION);
+    char serverIp[16] = "192.168.0.118";
+    hal::nvsSet(NVS_KEY_SERVER_IP, serverIp, sizeof(serverIp));
+    storeReachableNetwork();
+    BenchBroker broker;
+    hal::sim::setSocketPeer(&broker);
+    Uplink link(flashStore);
+    DayCost cost;
+
+    size_t next = 0;
+    for (uint32_t now = MIDNIGHT; now < MIDNIGHT + DAYS * 86400U; now += 60) {
+        bool txTime = false;
+        for (; next < messages.size() && messages[next].atS <= now; next++) {
+            link.enqueue(messages[next].type, messages[next].payload.data(), messages[next].payload.size());
+            txTime = txTime || messages[next].type == MessageType::DataTable;
+            if (policy == Policy::PerMessage) {
+                broker.online = now < outageFromS || now >= outageToS;
+                Uplink::Stats before = link.stats();
+                link.flush(link.retryAtS() > now ? link.retryAtS() : now);     // no backoff between messages
+                cost.failedConnects += link.stats().connects == before.connects ? 1 : 0;
+            }
+        }
+        bool due = policy == Policy::AtTxTimes ? txTime || (link.retryAtS() != 0 && now >= link.retryAtS())
+                                               : link.retryAtS() != 0 && now >= link.retryAtS();
+        if (due) {
+            broker.online = now < outageFromS || now >= outageToS;
+            Uplink::Stats before = link.stats();
+            link.flush(now);
+            cost.failedConnects += link.stats().connects == before.connects ? 1 : 0;
+        }
+    }
+    const Uplink::Stats &stats = link.stats();
+    cost.connects = stats.connects;
+    cost.publishes = stats.publishes;
+    cost.roundTrips = stats.roundTrips;
+    cost.bytes = stats.bytesSent + stats.bytesReceived + static_cast<double>(broker.segments) * SEGMENT_OVERHEAD;
+    cost.radioMs = (cost.connects + cost.failedConnects) * (WIFI_CONNECT_MS + RTT_MS) + cost.roundTrips * RTT_MS +
+                   cost.bytes * US_PER_BYTE / 1000;
+    hal::sim::setSocketPeer(nullptr);
+    for (double *value : {&cost.connects, &cost.failedConnects, &cost.publishes, &cost.roundTrips, &cost.bytes,
+                          &cost.radioMs}) {
+        *value /= DAYS;
+    }
+    return cost;
+}
+
+void printRow(const char *scenario, const DayCost &cost) {
+    std::printf("%-36s %9.1f %8.1f %10.1f %8.1f %10.0f %12.2f\n", scenario, cost.connects, cost.failedConnects,
+                cost.publishes, cost.roundTrips, cost.bytes, cost.radioMs / 1000);
+}
+
+}  // namespace
+
+void benchUplink() {
+    bench::printHeader("MQTT uplink: radio-on time and bytes per day (7 simulated days, fake broker)");
+    std::printf("model: Wi-Fi connect %.0f ms, RTT %.0f ms, %.0f us/B, %u B per TCP segment\n", WIFI_CONNECT_MS, RTT_MS,
+                US_PER_BYTE, static_cast<unsigned>(SEGMENT_OVERHEAD));
+    std::printf("%-36s %9s %8s %10s %8s %10s %12s\n", "scenario", "connects", "failed", "publishes", "RTTs",
+                "bytes", "radio s/day");
+
+    std::vector<Message> messages = weekOfMessages();
+    const uint32_t outageFrom = MIDNIGHT + 2 * 86400U;     // the broker is down for days 2 and 3
+    const uint32_t outageTo = MIDNIGHT + 4 * 86400U;
+    printRow("per message, when made", simulate(messages, Policy::PerMessage, 0, 0));
+    printRow("batched + pipelined, at tx times", simulate(messages, Policy::AtTxTimes, 0, 0));
+    printRow("per message, 2 day outage", simulate(messages, Policy::PerMessage, outageFrom, outageTo));
+    printRow("batched + pipelined, 2 day outage", simulate(messages, Policy::AtTxTimes, outageFrom, outageTo));
+
+    hal::sim::reset();
+    flashStore.mount(STORAGE_PARTITION);
+    char serverIp[16] = "192.168.0.118";
+    hal::nvsSet(NVS_KEY_SERVER_IP, serverIp, sizeof(serverIp));
+    storeReachableNetwork();
+    BenchBroker broker;
+    hal::sim::setSocketPeer(&broker);
+    Uplink link(flashStore);
+    WifiHold wifi(EnergyTask::Networkings);    // connected once: the flushes share it
+    const int runs = 200;
+    double totalNs = 0;
+    for (int run = 0; run < runs; run++) {
+        for (size_t i = 0; i < 24 + 4; i++) {
+            link.enqueue(messages[i].type, messages[i].payload.data(), messages[i].payload.size());
+        }
+        auto start = bench::Clock::now();
+        bench::doNotOptimize(link.flush(MIDNIGHT));
+        totalNs += bench::elapsedNs(start, bench::Clock::now());
+    }
+    hal::sim::setSocketPeer(nullptr);
+    std::printf("flush of a day's backlog (CPU only): %.1f us\n", totalNs / runs / 1000);
+}
@@ -0,0 +1,610 @@
+#pragma once
+
+/**
+ * A fleet of virtual devices on a discrete-event clock, all sending to one fake main server.
+ *
+ * Each device runs the firmware's own Scheduler (the same jobs, deadlines and coalescing as on the bin), senses a
+ * synthetic bin (traces.h) through the load cell every minute, and encodes what it keeps with the firmware's
+ * RecordDeltas, so its DataTable payload is the size the real one would be. What talks to the outside is modelled:
+ *  - Wi-Fi: the first connect after power-up scans every channel, later ones join the cached access point and reuse
+ *    the DHCP lease while it's younger than WIFI_LEASE_REUSE_S (the timings of hal_sim.h)
+ *  - NTP: the daily CalibrateClock connects and syncs. Between syncs every device's clock is off by up to
+ *    CLOCK_SPREAD_MS, so devices sharing a tx time wake a little apart, as they do in the field
+ *  - the main server: at a tx time a device sends its DataTable and its log as chunked transfers
+ *    (sendChunkedToMainServer: 2 round trips on a good link), then flushes the uplink's status backlog over MQTT.
+ *    Each is a TCP connection of its own. A connection lasts its handshake, its round trips and its bytes' airtime
+ * The fake server takes up to serverConnections connections at once and replies busy to the next ones (a tx-slot
+ * collision). The tx slots are the firmware's (tx_slots.h): with a txWindowS, each device sends at its own offset into
+ * the window; a busy DataTable is retried after TxSlotState's backoff (or, without `backoff`, waits for the next tx
+ * time, as the log always does); and with `renegotiate` a device that fails too often asks the server for other slots,
+ * which hands out its least crowded windows. The uplink backs off on its own.
+ *
+ * Running it on every core: devices are split into shards, one per thread, each with its own event heap. Time moves in
+ * windows of WINDOW_MS: every shard runs its events of the window (sessions it wants to open go into a list), then the
+ * connection requests of all shards are admitted by the server in time order (ties by device, so the result doesn't
+ * depend on the thread count), then each shard takes its answers. No answer is due back sooner than a round trip,
+ * so a window of one round trip never needs one from itself. Empty windows are skipped.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "config.h"
+#include "data.h"
+#include "data_codec.h"
+#include "hal_sim.h"
+#include "scheduler.h"
+#include "traces.h"
+#include "tx_slots.h"
+
+namespace fleet {
+
+constexpr uint32_t MIDNIGHT = 1792195200;       // 17/10/2026 00:00 UTC, the first simulated day
+constexpr uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+constexpr uint32_t RTT_MS = 60;                 // to the main server, over the Internet
+constexpr uint32_t WINDOW_MS = RTT_MS;
+constexpr uint32_t CLOCK_SPREAD_MS = 2000;      // +-, the clock error a device gathers in the day between NTP syncs
+constexpr uint32_t STATUS_BYTES = 24;           // an hourly status message (bench_uplink)
+constexpr uint32_t LOG_BYTES = 180;             // the log rows between two tx times (bench_uplink)
+constexpr uint32_t MESSAGE_HEADER = 5;          // [MessageType][length, 4]
+constexpr uint32_t OFFER_SIZE = 13;
+constexpr uint32_t OFFER_REPLY_SIZE = 6;        // and the bitmap
+constexpr uint32_t CHUNK_HEADER = 10;
+constexpr uint32_t MQTT_CONNECT_BYTES = 40;     // CONNECT and CONNACK
+constexpr uint32_t MQTT_PUBLISH_OVERHEAD = 30;  // fixed header, topic and packet id, and the PUBACK
+
+// a $DAPHI_... override of a Config field
+inline uint32_t fromEnvironment(const char *name, uint32_t fallback) {
+    const char *value = std::getenv(name);
+    long parsed = value != nullptr ? std::strtol(value, nullptr, 10) : 0;
+    return parsed > 0 ? static_cast<uint32_t>(parsed) : fallback;
+}
+
+struct Config {
+    uint32_t devices = 10000;
+    uint32_t days = 1;
+    uint16_t serverConnections = 64;    // the server's accept backlog and workers: more at once get a busy reply
+    uint16_t retryAfterS = 0;           // the hint in its busy replies
+    unsigned threads = 0;               // 0: one per core
+    uint16_t txWindowS = 0;             // of every tx slot. 0: everyone sends at the slot's start
+    bool backoff = false;               // a busy DataTable is retried after the backoff, not at the next tx time
+    bool renegotiate = false;           // devices failing too often ask the server for other slots
+    // a device's tx slot starts, minutes of day. unset: DEFAULT_TX_MINUTES for everyone, as until the server sends others
+    std::function<void(uint32_t deviceId, recordTimeType startMinutes[2])> txMinutes;
+};
+
+struct Report {
+    uint32_t devices = 0;
+    unsigned threads = 0;
+    uint64_t events = 0;
+    uint64_t wifiConnects = 0;
+    uint64_t ntpSyncs = 0;
+    uint64_t sessions = 0;              // connections the server accepted
+    uint64_t collisions = 0;            // and replied busy
+    uint32_t peakConcurrent = 0;        // capped by serverConnections
+    uint64_t peakAtMs = 0;              // since the first midnight
+    uint32_t peakOfferedPerMinute = 0;  // connections tried in a minute, busy or not: the load the devices make
+    uint32_t peakAcceptedPerMinute = 0; // of them, the ones the server took
+    uint64_t serverBytes = 0;           // both ways
+    uint64_t peakBytesPerMinute = 0;
+    double meanBytesPerMinute = 0;
+    uint64_t uploads = 0;               // DataTables delivered
+    double meanUploadDelayS = 0;        // from the tx time the readings were first due at, to their delivery
+    uint32_t undelivered = 0;           // devices left with readings that missed a tx time
+    uint64_t retries = 0;               // of a DataTable, after a busy reply
+    uint64_t renegotiations = 0;        // new slots a device got from the server
+    double wallS = 0;
+};
+
+// What one connection to the main server costs. Good links: nothing is resent
+struct SessionCost {
+    uint32_t bytes;
+    uint32_t roundTrips;
+};
+
+inline SessionCost chunkedTransferCost(uint32_t length) {
+    uint32_t chunks = length == 0 ? 1 : (length + TRANSFER_CHUNK_SIZE - 1) / TRANSFER_CHUNK_SIZE;
+    uint32_t offers = 2 * (MESSAGE_HEADER + OFFER_SIZE + OFFER_REPLY_SIZE + (chunks + 7) / 8);
+    return SessionCost{offers + chunks * (MESSAGE_HEADER + CHUNK_HEADER) + length, 2};
+}
+
+inline SessionCost uplinkFlushCost(uint32_t backlog) {
+    uint32_t messages = (backlog + UPLINK_CHUNK_SIZE - 1) / UPLINK_CHUNK_SIZE;
+    uint32_t windows = (messages + MQTT_MAX_INFLIGHT - 1) / MQTT_MAX_INFLIGHT;
+    return SessionCost{MQTT_CONNECT_BYTES + messages * MQTT_PUBLISH_OVERHEAD + backlog, 1 + windows};
+}
+
+inline uint32_t sessionMs(const SessionCost &cost) {
+    return RTT_MS + cost.roundTrips * RTT_MS + cost.bytes * RADIO_TX_US_PER_BYTE / 1000;   // the TCP handshake first
+}
+
+constexpr SessionCost TX_SLOTS_COST{1 + 8 + 2 * MESSAGE_HEADER, 1};     // requestTxSlots
+constexpr uint32_t BUSY_MS = 2 * RTT_MS;        // the handshake, and the offer the busy reply answers
+
+enum class Session : uint8_t { Data, Log, Uplink, Slots, Done };
+
+/* The fake main server: admits connections in time order, up to `connections` open at once. It hands out tx slots
+ * from the windows of the day with the fewest devices */
+class FakeServer {
+public:
+    FakeServer(uint16_t connections, uint32_t minutes, uint16_t windowS)
+        : connections(connections), bytesPerMinute(minutes, 0), offeredPerMinute(minutes, 0),
+          acceptedPerMinute(minutes, 0), windowS(std::max<uint16_t>(windowS, 60)),
+          slotLoad(SECONDS_PER_DAY / this->windowS, 0) {}
+
+    void countSlots(const TxSlot slots[2], int32_t devices) {
+        for (uint8_t i = 0; i < 2; i++) {
+            slotLoad[slots[i].startMinute * 60U / windowS % slotLoad.size()] += devices;
+        }
+    }
+
+    // a device's new slots: the least crowded window, and the least crowded one 6 hours or more away from it
+    void assignSlots(TxSlot slots[2]) {
+        countSlots(slots, -1);
+        size_t windows = slotLoad.size();
+        size_t first = std::min_element(slotLoad.begin(), slotLoad.end()) - slotLoad.begin();
+        size_t second = (first + windows / 2) % windows;
+        for (size_t at = 0; at < windows; at++) {
+            size_t apart = std::min((at + windows - first) % windows, (first + windows - at) % windows);
+            if (apart * windowS >= 6 * 3600U && slotLoad[at] < slotLoad[second]) {
+                second = at;
+            }
+        }
+        slots[0].startMinute = static_cast<recordTimeType>(first * windowS / 60);
+        slots[1].startMinute = static_cast<recordTimeType>(second * windowS / 60);
+        countSlots(slots, 1);
+    }
+
+    bool admit(uint64_t atMs, uint32_t durationMs, uint32_t bytes) {
+        while (!open.empty() && open.top() <= atMs) {
+            open.pop();
+        }
+        size_t minute = std::min<uint64_t>(atMs / 60000, bytesPerMinute.size() - 1);
+        offeredPerMinute[minute]++;
+        if (open.size() >= connections) {
+            collisions++;
+            return false;
+        }
+        open.push(atMs + durationMs);
+        sessions++;
+        acceptedPerMinute[minute]++;
+        if (open.size() > peak) {
+            peak = static_cast<uint32_t>(open.size());
+            peakAtMs = atMs;
+        }
+        bytesPerMinute[minute] += bytes;
+        return true;
+    }
+
+    void report(Report &report) const {
+        report.sessions = sessions;
+        report.collisions = collisions;
+        report.peakConcurrent = peak;
+        report.peakAtMs = peakAtMs;
+        for (uint64_t bytes : bytesPerMinute) {
+            report.serverBytes += bytes;
+            report.peakBytesPerMinute = std::max(report.peakBytesPerMinute, bytes);
+        }
+        report.meanBytesPerMinute = static_cast<double>(report.serverBytes) / static_cast<double>(bytesPerMinute.size());
+        report.peakOfferedPerMinute = *std::max_element(offeredPerMinute.begin(), offeredPerMinute.end());
+        report.peakAcceptedPerMinute = *std::max_element(acceptedPerMinute.begin(), acceptedPerMinute.end());
+    }
+
+private:
+    uint16_t connections;
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> open;     // when each one closes
+    std::vector<uint64_t> bytesPerMinute;
+    std::vector<uint32_t> offeredPerMinute;
+    std::vector<uint32_t> acceptedPerMinute;
+    uint16_t windowS;
+    std::vector<int32_t> slotLoad;      // devices per window of the day
+    uint64_t sessions = 0;
+    uint64_t collisions = 0;
+    uint32_t peak = 0;
+    uint64_t peakAtMs = 0;
+};
+
+// A barrier for threads that each have a core: spins (yielding) instead of sleeping, as windows are short
+class SpinBarrier {
+public:
+    explicit SpinBarrier(unsigned count) : count(count) {}
+
+    void wait() {
+        unsigned generation = phase.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+            arrived.store(0, std::memory_order_relaxed);
+            phase.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        while (phase.load(std::memory_order_acquire) == generation) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    unsigned count;
+    std::atomic<unsigned> arrived{0};
+    std::atomic<unsigned> phase{0};
+};
+
+// what a radio wakeup sends: at a tx time everything, at a DataTable retry (TxRetry) the table and the log
+enum class Link : uint8_t { TxTime, TxRetry, UplinkRetry };
+
+struct Request {
+    uint64_t atMs;
+    uint32_t deviceId;
+    uint32_t device;        // in its shard
+    uint32_t durationMs;
+    uint32_t bytes;
+    Session session;
+    TxSlot slots[2];        // a Slots session's: the device's, then the server's
+    bool admitted;
+};
+
+struct Device {
+    Device(uint32_t id, const SchedulerConfig &config, uint32_t readings)
+        : id(id), scheduler(config), bin(id * 2654435761U + 1, readings) {}
+
+    uint32_t id;
+    int32_t clockOffsetMs = 0;          // its clock minus UTC
+    Scheduler scheduler;
+    bench::SyntheticBin bin;
+    RecordDeltas deltas;
+    uint16_t records = 0;
+    uint32_t dataBytes = 1 + DATA_CHECKSUM_SIZE;    // the encoded DataTable: version, records, CRC
+    uint64_t dataDueMs = 0;             // the tx time the oldest unsent readings were first due at, 0: none
+    uint32_t logBytes = 0;
+    uint32_t uplinkBytes = 0;
+    uint32_t backoffS = 0;              // the uplink's
+    TxSlot slots[2];
+    TxSlotState slotState;
+    bool scanned = false;               // an access point is cached
+    uint64_t leaseAtMs = 0;
+    bool hasLease = false;
+    bool linkUp = false;                // a radio wakeup's sessions are running
+    Link link = Link::TxTime;
+    Session session = Session::Done;
+};
+
+class Shard {
+public:
+    enum class Kind : uint8_t { Wake, Connect, TxRetry, UplinkRetry };
+
+    struct Event {
+        uint64_t atMs;
+        uint32_t device;
+        Kind kind;
+        bool operator>(const Event &other) const {
+            return atMs != other.atMs ? atMs > other.atMs : device > other.device;
+        }
+    };
+
+    std::deque<Device> devices;         // not a vector: a Scheduler doesn't move
+    std::vector<Request> requests;      // of the current window
+    const Config *config = nullptr;
+    uint64_t events = 0;
+    uint64_t wifiConnects = 0;
+    uint64_t ntpSyncs = 0;
+    uint64_t uploads = 0;
+    double uploadDelayS = 0;
+    uint64_t retries = 0;
+    uint64_t renegotiations = 0;
+
+    void start() {
+        for (uint32_t i = 0; i < devices.size(); i++) {
+            Device &device = devices[i];
+            device.scheduler.start(MIDNIGHT);
+            wakeAt(i);
+        }
+    }
+
+    uint64_t nextAtMs() const { return heap.empty() ? UINT64_MAX : heap.top().atMs; }
+
+    void runUntil(uint64_t endMs) {
+        requests.clear();
+        while (!heap.empty() && heap.top().atMs < endMs) {
+            Event event = heap.top();
+            heap.pop();
+            events++;
+            Device &device = devices[event.device];
+            switch (event.kind) {
+                case Kind::Wake: wake(event.device, device, event.atMs); break;
+                case Kind::Connect: connect(event.device, device, event.atMs); break;
+                case Kind::TxRetry: startLink(event.device, device, event.atMs, Link::TxRetry); break;
+                case Kind::UplinkRetry: startLink(event.device, device, event.atMs, Link::UplinkRetry); break;
+            }
+        }
+    }
+
+    // the server's answers to this window's requests
+    void answer() {
+        for (const Request &request : requests) {
+            uint64_t doneMs = request.atMs + (request.admitted ? request.durationMs : BUSY_MS);
+            finishSession(request, doneMs);
+        }
+    }
+
+private:
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> heap;
+
+    static uint64_t toMs(uint32_t epochS) { return static_cast<uint64_t>(epochS - MIDNIGHT) * 1000; }
+
+    static uint32_t localS(const Device &device, uint64_t atMs) {
+        return MIDNIGHT + static_cast<uint32_t>((static_cast<int64_t>(atMs) + device.clockOffsetMs) / 1000);
+    }
+
+    void wakeAt(uint32_t index) {
+        const Device &device = devices[index];
+        int64_t atMs = static_cast<int64_t>(toMs(device.scheduler.nextWakeup())) - device.clockOffsetMs;
+        heap.push(Event{static_cast<uint64_t>(std::max<int64_t>(atMs, 0)), index, Kind::Wake});
+    }
+
+    void wake(uint32_t index, Device &device, uint64_t atMs) {
+        uint32_t nowS = localS(device, atMs);
+        Job due[JOB_COUNT];
+        uint8_t count = device.scheduler.runDue(nowS, due);
+        for (uint8_t i = 0; i < count; i++) {
+            switch (due[i]) {
+                case Job::Sense: sense(device, nowS); break;
+                case Job::TxFirst:
+                case Job::TxSecond: {
+                    device.logBytes += LOG_BYTES;
+                    uint8_t slot = due[i] == Job::TxFirst ? 0 : 1;
+                    uint64_t jitterMs = txJitterS(device.id, slot, device.slots[slot].windowS) * 1000ULL;
+                    if (device.records > 0 && device.dataDueMs == 0) {
+                        device.dataDueMs = atMs > jitterMs ? atMs - jitterMs : 1;     // the slot's start
+                    }
+                    startLink(index, device, atMs, Link::TxTime);
+                    break;
+                }
+                case Job::CalibrateClock:
+                    if (!device.linkUp) {
+                        wifiConnect(device, atMs);      // to pool.ntp.org: the main server doesn't see it
+                    }
+                    ntpSyncs++;
+                    break;
+                case Job::CheckDeviceStatus: device.uplinkBytes += STATUS_BYTES; break;
+                default: break;
+            }
+        }
+        wakeAt(index);
+    }
+
+    void sense(Device &device, uint32_t localS) {
+        weightType grams = device.bin.next();
+        if (device.records >= DATA_TABLE_CAPACITY) {
+            return;     // the table is full until the next delivery
+        }
+        uint8_t encoded[MAX_ENCODED_RECORD_SIZE];
+        Record record{static_cast<recordTimeType>((localS % SECONDS_PER_DAY) / 60), grams};
+        device.dataBytes += static_cast<uint32_t>(device.deltas.encode(record, encoded));
+        device.records++;
+    }
+
+    // how long the Wi-Fi connect takes
+    uint32_t wifiConnect(Device &device, uint64_t atMs) {
+        wifiConnects++;
+        uint32_t ms = hal::sim::WIFI_JOIN_MS;
+        if (!device.scanned) {
+            ms += hal::sim::WIFI_CHANNELS * WIFI_SCAN_MS_PER_CHANNEL;
+            device.scanned = true;
+        }
+        if (!device.hasLease || atMs - device.leaseAtMs >= static_cast<uint64_t>(WIFI_LEASE_REUSE_S) * 1000) {
+            ms += hal::sim::WIFI_DHCP_MS;
+            device.hasLease = true;
+            device.leaseAtMs = atMs;
+        }
+        return ms;
+    }
+
+    void startLink(uint32_t index, Device &device, uint64_t atMs, Link link) {
+        if (device.linkUp) {
+            return;     // rare: what's running sends the same, or the next tx time does
+        }
+        device.linkUp = true;
+        device.link = link;
+        device.session = Session::Data;
+        nextSession(index, device, atMs + wifiConnect(device, atMs));
+    }
+
+    // skips the sessions this wakeup doesn't have, or that have nothing to send
+    void nextSession(uint32_t index, Device &device, uint64_t atMs) {
+        while (device.session != Session::Done && !hasToSend(device, device.session)) {
+            device.session = static_cast<Session>(static_cast<uint8_t>(device.session) + 1);
+        }
+        if (device.session == Session::Done) {
+            device.linkUp = false;
+            return;
+        }
+        heap.push(Event{atMs, index, Kind::Connect});
+    }
+
+    bool hasToSend(const Device &device, Session session) const {
+        bool tx = device.link != Link::UplinkRetry;
+        switch (session) {
+            case Session::Data: return tx && device.records > 0;
+            case Session::Log: return tx && device.logBytes > 0;
+            case Session::Uplink: return device.link != Link::TxRetry && device.uplinkBytes > 0;
+            case Session::Slots: return tx && config->renegotiate && device.slotState.shouldRenegotiate();
+            default: return false;
+        }
+    }
+
+    SessionCost cost(const Device &device) const {
+        switch (device.session) {
+            case Session::Data: return chunkedTransferCost(device.dataBytes);
+            case Session::Log: return chunkedTransferCost(device.logBytes);
+            case Session::Uplink: return uplinkFlushCost(device.uplinkBytes);
+            default: return TX_SLOTS_COST;
+        }
+    }
+
+    void connect(uint32_t index, Device &device, uint64_t atMs) {
+        SessionCost session = cost(device);
+        requests.push_back(Request{atMs, device.id, index, sessionMs(session), session.bytes, device.session,
+                                   {device.slots[0], device.slots[1]}, false});
+    }
+
+    void finishSession(const Request &request, uint64_t doneMs) {
+        uint32_t index = request.device;
+        Device &device = devices[index];
+        bool delivered = request.admitted;
+        switch (device.session) {
+            case Session::Data: {
+                uint32_t retryS = device.slotState.onSend(delivered, !delivered, config->retryAfterS, device.id,
+                                                          localS(device, doneMs));
+                if (retryS > 0 && config->backoff) {
+                    retries++;
+                    heap.push(Event{doneMs + retryS * 1000ULL, index, Kind::TxRetry});
+                }
+                if (delivered) {
+                    uploads++;
+                    uploadDelayS += static_cast<double>(doneMs - device.dataDueMs) / 1000;
+                    device.records = 0;
+                    device.dataBytes = 1 + DATA_CHECKSUM_SIZE;
+                    device.deltas = RecordDeltas();
+                    device.dataDueMs = 0;
+                }
+                break;
+            }
+            case Session::Log:
+                if (delivered) {
+                    device.logBytes = 0;
+                }
+                break;
+            case Session::Uplink:
+                if (delivered) {
+                    device.uplinkBytes = 0;
+                    device.backoffS = 0;
+                } else {
+                    device.backoffS = device.backoffS == 0 ? UPLINK_BACKOFF_MIN_S
+                                                           : std::min(device.backoffS * 2, UPLINK_BACKOFF_MAX_S);
+                    heap.push(Event{doneMs + static_cast<uint64_t>(device.backoffS) * 1000, index, Kind::UplinkRetry});
+                }
+                break;
+            case Session::Slots:
+                if (delivered) {    // onChangeTxTimes
+                    renegotiations++;
+                    device.slots[0] = request.slots[0];
+                    device.slots[1] = request.slots[1];
+                    device.slotState.renegotiated();
+                    device.scheduler.setTxTimes(txSecondOfDay(device.slots[0], 0, device.id),
+                                                txSecondOfDay(device.slots[1], 1, device.id), localS(device, doneMs));
+                }
+                break;
+            default: break;
+        }
+        device.session = static_cast<Session>(static_cast<uint8_t>(device.session) + 1);
+        nextSession(index, device, doneMs);
+    }
+};
+
+inline Report run(const Config &config) {
+    Report report;
+    report.devices = config.devices;
+    unsigned threads = config.threads != 0 ? config.threads : std::max(1U, std::thread::hardware_concurrency());
+    threads = std::max(1U, std::min<unsigned>(threads, config.devices));
+    report.threads = threads;
+
+    std::vector<Shard> shards(threads);
+    FakeServer server(config.serverConnections, config.days * MINUTES_PER_DAY, config.txWindowS);
+    bench::Xorshift rng(12345);
+    for (uint32_t id = 0; id < config.devices; id++) {
+        recordTimeType minutes[2] = {DEFAULT_TX_MINUTES[0], DEFAULT_TX_MINUTES[1]};
+        if (config.txMinutes) {
+            config.txMinutes(id, minutes);
+        }
+        TxSlot slots[2] = {{minutes[0], config.txWindowS}, {minutes[1], config.txWindowS}};
+        server.countSlots(slots, 1);
+        SchedulerConfig schedule{60, {txSecondOfDay(slots[0], 0, id), txSecondOfDay(slots[1], 1, id)},
+                                 CALIBRATE_CLOCK_SECOND_OF_DAY, STATUS_CHECK_INTERVAL_S, SCHEDULER_SLACK_S};
+        Shard &shard = shards[id % threads];
+        shard.devices.emplace_back(id, schedule, config.days * MINUTES_PER_DAY);
+        Device &device = shard.devices.back();
+        device.slots[0] = slots[0];
+        device.slots[1] = slots[1];
+        device.clockOffsetMs = static_cast<int32_t>(rng.next() % (2 * CLOCK_SPREAD_MS + 1)) -
+                               static_cast<int32_t>(CLOCK_SPREAD_MS);
+    }
+    for (Shard &shard : shards) {
+        shard.config = &config;
+        shard.start();
+    }
+
+    uint64_t endMs = static_cast<uint64_t>(config.days) * SECONDS_PER_DAY * 1000;
+    std::vector<uint64_t> nextAt(threads);
+    std::vector<Request *> admitting;
+    SpinBarrier barrier(threads);
+
+    auto work = [&](unsigned self) {
+        Shard &shard = shards[self];
+        nextAt[self] = shard.nextAtMs();
+        while (true) {
+            barrier.wait();
+            uint64_t windowMs = *std::min_element(nextAt.begin(), nextAt.end());
+            if (windowMs >= endMs) {
+                break;
+            }
+            shard.runUntil(windowMs + WINDOW_MS);
+            barrier.wait();
+            if (self == 0) {
+                admitting.clear();
+                for (Shard &each : shards) {
+                    for (Request &request : each.requests) {
+                        admitting.push_back(&request);
+                    }
+                }
+                std::sort(admitting.begin(), admitting.end(), [](const Request *a, const Request *b) {
+                    return a->atMs != b->atMs ? a->atMs < b->atMs : a->deviceId < b->deviceId;
+                });
+                for (Request *request : admitting) {
+                    request->admitted = server.admit(request->atMs, request->durationMs, request->bytes);
+                    if (request->admitted && request->session == Session::Slots) {
+                        server.assignSlots(request->slots);
+                    }
+                }
+            }
+            barrier.wait();
+            shard.answer();
+            nextAt[self] = shard.nextAtMs();
+        }
+    };
+
+    bench::Clock::time_point start = bench::Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned self = 1; self < threads; self++) {
+        workers.emplace_back(work, self);
+    }
+    work(0);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    report.wallS = bench::elapsedNs(start, bench::Clock::now()) / 1e9;
+
+    server.report(report);
+    double uploadDelayS = 0;
+    for (const Shard &shard : shards) {
+        report.events += shard.events;
+        report.wifiConnects += shard.wifiConnects;
+        report.ntpSyncs += shard.ntpSyncs;
+        report.uploads += shard.uploads;
+        uploadDelayS += shard.uploadDelayS;
+        report.retries += shard.retries;
+        report.renegotiations += shard.renegotiations;
+        for (const Device &device : shard.devices) {
+            report.undelivered += device.dataDueMs != 0 ? 1 : 0;
+        }
+    }
+    report.meanUploadDelayS = report.uploads > 0 ? uploadDelayS / static_cast<double>(report.uploads) : 0;
+    return report;
+}
+
+}  // namespace fleet
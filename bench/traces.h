@@ -0,0 +1,71 @@
+#pragma once
+
+/**
+ * Minute-level weight traces for the benchmarks.
+ * A trace is either loaded from a CSV file (one "minute,grams" line per reading, as exported by the main server),
+ * or generated: a synthetic bin day with deposits, sensor noise and an emptying, built from a fixed seed
+ * so every run (and every machine) sees the same day.
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "types.h"
+
+namespace bench {
+
+// The synthetic bin one reading at a time, for callers that can't hold a whole trace per bin (fleet.h)
+class SyntheticBin {
+public:
+    SyntheticBin(uint32_t seed, uint32_t readings) : rng(seed) {
+        level = 1500 + static_cast<int32_t>(rng.next() % 1000);        // what was left from yesterday
+        emptyAt = readings / 2 + rng.next() % (readings / 4);
+    }
+
+    weightType next() {
+        uint32_t r = rng.next();
+        if (r % 100 < 4) {
+            level += 150 + static_cast<int32_t>((r >> 8) % 2500);      // someone throws a bag in
+        }
+        if (i++ == emptyAt) {
+            level = 0;                                                  // the bin is emptied
+        }
+        int32_t noise = static_cast<int32_t>((r >> 20) % 5) - 2;        // +-2 g
+        return static_cast<weightType>(level + noise > 0 ? level + noise : 0);
+    }
+
+private:
+    Xorshift rng;
+    int32_t level;
+    uint32_t emptyAt;
+    uint32_t i = 0;
+};
+
+inline std::vector<Record> syntheticBinDay(uint32_t seed, uint16_t readings = 840, recordTimeType startMinute = 360) {
+    SyntheticBin bin(seed, readings);
+    std::vector<Record> trace;
+    trace.reserve(readings);
+    for (uint16_t i = 0; i < readings; i++) {
+        trace.push_back(Record{static_cast<recordTimeType>((startMinute + i) % (24 * 60)), bin.next()});
+    }
+    return trace;
+}
+
+// Empty if the file can't be read
+inline std::vector<Record> loadTraceCsv(const char *path) {
+    std::vector<Record> trace;
+    std::FILE *file = std::fopen(path, "r");
+    if (file == nullptr) {
+        return trace;
+    }
+    unsigned minute = 0;
+    unsigned long grams = 0;
+    while (std::fscanf(file, "%u,%lu", &minute, &grams) == 2) {
+        trace.push_back(Record{static_cast<recordTimeType>(minute), static_cast<weightType>(grams)});
+    }
+    std::fclose(file);
+    return trace;
+}
+
+}  // namespace bench
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ARDUINO
+#include <mbedtls/gcm.h>
+#endif
+
+/**
+ * AES-256-GCM: encryption with a 16 byte tag that authenticates the ciphertext and some associated data (AAD).
+ * A nonce must never be used twice with the same key: the callers draw random 12 byte nonces (hal::randomBytes).
+ *
+ * On the ESP32-C3 it's mbedtls, on the chip's AES accelerator. On the host it's a table-driven software AES (4 KiB of
+ * round tables) and a 4 bit GHASH table per key. Both give the same bytes for the same input.
+ * The key is expanded once by setKey, so sealing or opening a short record costs its blocks only.
+ */
+
+constexpr size_t AES_GCM_KEY_SIZE = 32;
+constexpr size_t AES_GCM_NONCE_SIZE = 12;
+constexpr size_t AES_GCM_TAG_SIZE = 16;
+
+class AesGcm {
+public:
+    AesGcm();
+    ~AesGcm();
+    AesGcm(const AesGcm &) = delete;
+    AesGcm &operator=(const AesGcm &) = delete;
+
+    void setKey(const uint8_t key[AES_GCM_KEY_SIZE]);
+    void seal(const uint8_t nonce[AES_GCM_NONCE_SIZE], const void *aad, size_t aadLength, const void *plain,
+              size_t length, void *cipher, uint8_t tag[AES_GCM_TAG_SIZE]);
+    // false if the tag doesn't match (tampered with, or another key): plain is zeroed then
+    bool open(const uint8_t nonce[AES_GCM_NONCE_SIZE], const void *aad, size_t aadLength, const void *cipher,
+              size_t length, const uint8_t tag[AES_GCM_TAG_SIZE], void *plain);
+
+private:
+#ifdef ARDUINO
+    mbedtls_gcm_context context;
+#else
+    void encryptBlock(const uint8_t in[16], uint8_t out[16]) const;
+    void ghashMultiply(uint8_t x[16]) const;            // x = x * H in GF(2^128)
+    void ghash(const uint8_t *aad, size_t aadLength, const uint8_t *cipher, size_t length, uint8_t out[16]) const;
+    void crypt(const uint8_t nonce[AES_GCM_NONCE_SIZE], const uint8_t *in, size_t length, uint8_t *out) const;
+
+    uint32_t roundKeys[60] = {};    // AES-256: 15 round keys
+    uint64_t tableHigh[16] = {};    // the multiples of H by every nibble
+    uint64_t tableLow[16] = {};
+#endif
+};
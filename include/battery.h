@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "config.h"
+#include "device_status.h"
+#include "energy.h"
+
+/**
+ * Battery monitor: the battery's voltage, how much is left, and how fast it goes.
+ *
+ * The battery reaches the BATTERY_POWER pin through a divider (BATTERY_DIVIDER_RATIO). A sample is BATTERY_OVERSAMPLES
+ * ADC reads averaged, each calibrated by the HAL: on target, analogReadMilliVolts corrects the ADC with the eFuse
+ * calibration burnt in at the factory. The samples go through an IIR filter, a sample weighing 1 / 2^filterShift:
+ *
+ *      filtered += (sample - filtered) / 2^filterShift         (in 1/256 mV, so small steps aren't rounded away)
+ *
+ * Samples are only taken while the radio is off (the energy ledger knows: WifiLink books it from the first hold of the
+ * link to the last release, whichever session holds it): a 285 mA TX burst through the cell's internal resistance sags
+ * it by tens of mV, which would read as a battery much emptier than it is.
+ *
+ * From the filtered voltage:
+ *  - the charge left, through the discharge curve (config.h BATTERY_DISCHARGE_CURVE, mV to % of the rated capacity)
+ *  - the low battery alert, with hysteresis: it goes on below MIN_BATTERY_POWER, and off only once the battery is back
+ *    BATTERY_ALERT_HYSTERESIS_MV above it, so a battery sitting at the threshold doesn't toggle it on every sample
+ *  - the trend, in mV per day: a least squares line through the filtered voltage kept every BATTERY_TREND_POINT_S, over the
+ *    last BATTERY_TREND_POINTS of them
+ *
+ * The load cell task samples it every interval, and onCheckDeviceStatus reports it (reportBattery). The days to empty
+ * (energy.h) use the charge left from the curve once there's a reading.
+ */
+
+struct BatteryConfig {
+    gpio pin;
+    uint8_t oversamples;                // ADC reads a sample averages
+    uint8_t filterShift;                // a sample weighs 1 / 2^filterShift in the filtered voltage
+    uint32_t dividerRatio;              // battery mV per pin mV
+    uint16_t validMinMilliVolts;        // a sample outside is a broken divider or a floating pin, and is dropped
+    uint16_t validMaxMilliVolts;
+    uint16_t lowMilliVolts;             // the alert goes on below
+    uint16_t hysteresisMilliVolts;      // and off at lowMilliVolts + this
+    const DischargePoint *curve;        // by falling mV
+    uint8_t curveLength;
+    uint32_t capacityMah;
+    uint32_t trendPointS;
+};
+
+constexpr BatteryConfig BATTERY_CONFIG = {
+    BATTERY_POWER,
+    BATTERY_OVERSAMPLES,
+    BATTERY_FILTER_SHIFT,
+    BATTERY_DIVIDER_RATIO,
+    BATTERY_VALID_MIN_MV,
+    BATTERY_VALID_MAX_MV,
+    static_cast<uint16_t>(MIN_BATTERY_POWER * 1000 + 0.5f),
+    BATTERY_ALERT_HYSTERESIS_MV,
+    BATTERY_DISCHARGE_CURVE,
+    sizeof(BATTERY_DISCHARGE_CURVE) / sizeof(BATTERY_DISCHARGE_CURVE[0]),
+    BATTERY_CAPACITY_MAH,
+    BATTERY_TREND_POINT_S,
+};
+
+class BatteryMonitor {
+public:
+    explicit BatteryMonitor(const BatteryConfig &config) : config(config) {}
+    bool sample(EnergyLedger &ledger = energyLedger);   // false: the radio is on, or the sample is out of range
+    void reset();                       // no reading, no alert, no trend
+    bool hasReading();                  // thread-safe, like the rest
+    uint16_t milliVolts();              // filtered, 0 until the first sample
+    bool isLow();
+    uint32_t lowAlerts();               // times the alert went on since reset
+    float remainingPercent();           // of the rated capacity, through the discharge curve
+    float remainingMah();
+    bool trend(float &milliVoltsPerDay);    // false until there are BATTERY_TREND_MIN_POINTS points
+
+private:
+    BatteryConfig config;
+    std::mutex mutex;
+    bool has = false;
+    int32_t filtered = 0;               // mV * 256
+    bool low = false;
+    uint32_t alerts = 0;
+    uint64_t pointUs[BATTERY_TREND_POINTS] = {};
+    int32_t points[BATTERY_TREND_POINTS] = {};  // filtered, mV * 256
+    uint8_t pointCount = 0;
+    uint8_t nextPoint = 0;
+};
+
+extern BatteryMonitor batteryMonitor;   // the device's
+
+// % of the rated capacity left at a battery voltage, linear between the curve's points
+float dischargePercent(uint16_t milliVolts, const DischargePoint *curve, uint8_t length);
+
+// Samples the battery, then logs its voltage, the alert if it's on, and the trend once there is one
+void reportBattery(BatteryMonitor &monitor = batteryMonitor);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * CRC-32 (IEEE 802.3, the one zlib and the server use).
+ * Incremental: start from 0 and feed the data in as many pieces as needed, the result is the same as one pass.
+ *
+ *      uint32_t crc = crc32Update(0, header, headerLength);
+ *      crc = crc32Update(crc, body, bodyLength);
+ *
+ * On the ESP32-C3 it's the ROM's crc32_le (no table in flash or RAM), on the host slice-by-8: eight 1 KiB tables,
+ * 8 bytes per step. Both give the same result for the same data, as do the other implementations below.
+ */
+uint32_t crc32Update(uint32_t crc, const void *data, size_t length);
+
+inline uint32_t crc32(const void *data, size_t length) {
+    return crc32Update(0, data, length);
+}
+
+/* A CRC computed piece by piece, e.g. record by record while a table is appended to, so it's ready when it's sent. */
+class Crc32 {
+public:
+    void update(const void *data, size_t length) { crc = crc32Update(crc, data, length); }
+    void update(uint8_t byte) { update(&byte, 1); }
+    uint32_t value() const { return crc; }
+    void reset() { crc = 0; }
+
+private:
+    uint32_t crc = 0;
+};
+
+// The implementations crc32Update picks from, all incremental as above. For the tests and benchmarks
+uint32_t crc32UpdateBitwise(uint32_t crc, const void *data, size_t length);     // no table, 8 shifts a byte
+uint32_t crc32UpdateNibble(uint32_t crc, const void *data, size_t length);      // 64 byte table, 2 lookups a byte
+uint32_t crc32UpdateSliceBy8(uint32_t crc, const void *data, size_t length);    // 8 KiB of tables, 8 bytes a step
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+#include "config.h"
+
+/**
+ * Clock drift: how fast the RTC runs away from NTP time, so the time can be corrected between NTP syncs.
+ *
+ * The RTC on the default oscillator drifts up to 20 s an hour (scheduler.h), mostly at a steady rate for a given
+ * temperature. Each sync (onCalibrateClock) measures the offset, NTP - local, and steps the clock by it. The estimator
+ * keeps the last CLOCK_DRIFT_SAMPLES syncs on the clock's unstepped timeline (the local time minus every step so far):
+ *
+ *      offset(t) = intercept + rate * t            t: unstepped local seconds, offset: ms
+ *
+ * fitted by Theil-Sen: the rate is the median of the slopes between every pair of syncs, the intercept the median of
+ * what's left. A median shrugs off a sync or two that are far off (a bad NTP reply, a few minutes in the sun), where a
+ * least squares line would be pulled along. Between syncs, the line is the correction: correct() turns the local time
+ * into NTP time for the readings' and the log's timestamps (recordTimeType) and for the scheduler's deadlines.
+ *
+ * Once CLOCK_DRIFT_MIN_SAMPLES syncs fit, the syncs stretch: the largest residual, and the spread of the pairwise
+ * slopes (their median absolute deviation) say how far the corrected time may be off after d days, and the next sync
+ * comes after the most days, up to CLOCK_SYNC_MAX_DAYS, that keep it within CLOCK_DRIFT_BUDGET_MS. Each day skipped
+ * is a Wi-Fi session saved. Fewer syncs than that can line up by chance, and a noisy NTP link keeps them daily.
+ *
+ * An offset further than CLOCK_MAX_ERROR_MS from the correction isn't drift: the clock was set anew, or had never been
+ * set, or the NTP answer is bad. With a fit, one such sync is only held as a suspect: the clock isn't stepped, and the
+ * next wakeup syncs again. If that sync is as far off the same way, the fit starts over from it; if it agrees with the
+ * fit, the suspect is dropped. Without a fit, or with a clock that was never set (0) or went back, it starts over at
+ * once.
+ *
+ * The object is only the fit's plain state, so it can live in RTC memory. Its lock is a static outside it, shared by
+ * every ClockDrift (see clock_drift.cpp).
+ */
+
+class ClockDrift {
+public:
+    constexpr ClockDrift() {}       // constant initialised, so the RTC copy isn't overwritten at a wakeup
+
+    // An NTP sync at local time localS measured offsetMs (NTP - local). returns the step, s, to set the clock by now
+    int32_t addSync(uint32_t localS, int64_t offsetMs);
+
+    uint32_t correct(uint32_t localS);      // the NTP time at local time localS, 0 while the clock isn't set
+    int64_t correctionMs(uint32_t localS);  // NTP - local, as the fit predicts it. 0 until there are 2 syncs
+    int32_t ratePpb();                      // positive: the RTC runs slow. 0 until there are 2 syncs
+    uint8_t syncs();                        // in the fit
+    uint8_t syncIntervalDays();             // between NTP syncs, from 1 up to CLOCK_SYNC_MAX_DAYS
+    bool isSyncDue(uint32_t localS);        // the CalibrateClock job's wakeup at localS should sync
+    void reset();
+
+private:
+    struct Sync {
+        uint32_t atS;       // unstepped local time, from originS
+        int32_t offsetMs;   // NTP - unstepped local, from originMs
+    };
+
+    void fit();
+    int64_t predictMs(uint32_t unsteppedS) const;   // NTP - unstepped local
+
+    Sync samples[CLOCK_DRIFT_SAMPLES] = {};     // oldest first
+    uint8_t count = 0;
+    uint32_t originS = 0;
+    int64_t originMs = 0;
+    int32_t stepsS = 0;             // every step since the origin
+    uint32_t lastSyncS = 0;         // local, after its step
+    int32_t rate = 0;               // ppb
+    int32_t interceptMs = 0;        // from originMs, at originS
+    uint32_t rateSpread = 0;        // ppb
+    uint32_t residualSpreadMs = 0;
+    uint8_t intervalDays = 1;
+    bool hasSuspect = false;        // a sync far off the fit, waiting for the next one to confirm it
+    int64_t suspectMs = 0;          // how far off, offset - correction
+};
+
+extern ClockDrift clockDrift;       // the device's, in RTC memory
+
+// hal::epochSeconds(), corrected for the drift: the time every timestamp and deadline uses
+uint32_t epochNow(ClockDrift &drift = clockDrift);
@@ -4,7 +4,136 @@
 
 constexpr uint16_t senseInterval = 60 * 1000;
 
+constexpr uint32_t TASK_STACK_BYTES = 4096;
+constexpr uint32_t CPU_FREQUENCY_MHZ = 160;     // the ESP32-C3's default, see hal::cpuCycles
+
+constexpr uint16_t DATA_TABLE_CAPACITY = 14 * 60;   // 14 hours * 60 readings an hour
+constexpr const char *STORAGE_PARTITION = "storage";   // the DataTable and the LogFile, see flash_log.h and partitions.csv
+constexpr uint16_t LOG_FILE_SIZE = 4096;    // bytes, see logging.h
+
+// scheduler.h
+constexpr recordTimeType DEFAULT_TX_MINUTES[2] = {13 * 60, 20 * 60};  // until the server sends the tx slots (onChangeTxTimes)
+constexpr uint32_t CALIBRATE_CLOCK_SECOND_OF_DAY = 3 * 60 * 60;     // UTC
+constexpr uint32_t STATUS_CHECK_INTERVAL_S = 60 * 60;
+constexpr uint32_t SCHEDULER_SLACK_S = 30;      // jobs due this soon after a wakeup run in it
+
+// tx_slots.h
+constexpr uint16_t DEFAULT_TX_WINDOW_S = 15 * 60;   // of the default tx slots, starting at DEFAULT_TX_MINUTES
+constexpr uint32_t TX_BACKOFF_BASE_S = 20;          // the first retry after a busy reply is 1/2 to 1 of this, then doubling
+constexpr uint32_t TX_BACKOFF_MAX_S = 30 * 60;
+constexpr uint8_t TX_BACKOFF_ATTEMPTS = 5;          // busy replies in a row before the table waits for the next tx time
+constexpr uint8_t TX_HISTORY_LENGTH = 8;            // the last sends of the table, that the failure rate is over
+constexpr uint8_t TX_RENEGOTIATE_FAILURES = 4;      // failed ones among them that ask the server for other tx slots
+
+// clock_drift.h
+constexpr uint8_t CLOCK_DRIFT_SAMPLES = 8;              // NTP syncs the drift is fitted over
+constexpr uint8_t CLOCK_DRIFT_MIN_SAMPLES = 6;          // fitted before the syncs stretch past a day
+constexpr uint32_t CLOCK_DRIFT_BUDGET_MS = 5000;        // the error the corrected time may reach by the next sync
+constexpr uint8_t CLOCK_SYNC_MAX_DAYS = 4;
+constexpr int64_t CLOCK_MAX_ERROR_MS = 15 * 60 * 1000;  // two syncs this far from the correction start the fit over
+constexpr const char *NTP_DEFAULT_SERVER = "pool.ntp.org";  // until onSetup stores one
+constexpr uint32_t NTP_TIMEOUT_MS = 5000;
+
+// sensors.h
+constexpr uint16_t LOAD_CELL_RING_LENGTH = 16;          // samples reduced to one reading
+constexpr uint8_t LOAD_CELL_SETTLE_SAMPLES = 4;         // dropped after power up: the HX711 settles in 400 ms at 10 SPS
+constexpr uint8_t LOAD_CELL_COLD_SETTLE_SAMPLES = 20;   // dropped by a cold start: the legacy 2 s stabilising time
+constexpr int32_t LOAD_CELL_DRIFT_COUNTS = 200;         // ~10 g. a warm reading drifting more starts cold. see sensors.h
+constexpr uint32_t LOAD_CELL_SAMPLE_PERIOD_MS = 100;    // 10 SPS (RATE pin low)
+constexpr SampleFilter LOAD_CELL_FILTER = SampleFilter::TrimmedMean;
+constexpr uint8_t LOAD_CELL_TRIM_PERCENT = 25;          // of the samples, dropped from each end by the trimmed mean
+constexpr int32_t LOAD_CELL_DEFAULT_TARE = 0;           // raw reading of the empty plate, until onCalibrateLoadCell
+constexpr float LOAD_CELL_DEFAULT_COUNTS_PER_GRAM = 21.0f;
+constexpr SenseMode SENSE_MODE = SenseMode::EveryInterval;
+// SenseMode::Adaptive, see sensors.h AdaptiveSampler
+constexpr weightType ADAPTIVE_DEAD_BAND_GRAMS = 10;     // a change this small is noise (the legacy smallDelta)
+constexpr weightType ADAPTIVE_SETTLE_BAND_GRAMS = 50;   // this much between two readings: still moving (the legacy largeDelta)
+constexpr uint16_t ADAPTIVE_HEARTBEAT_MINUTES = 60;     // an unchanged reading is stored at least this often
+constexpr uint32_t ADAPTIVE_IDLE_INTERVAL_S = 2 * 60;   // sensing interval while nothing happens
+constexpr uint8_t ADAPTIVE_QUIET_READINGS = 3;          // quiet readings at senseInterval before going idle
+
+constexpr uint16_t MAIN_SERVER_PORT = 1900;
+constexpr uint32_t MAIN_SERVER_TIMEOUT_MS = 5000;
+constexpr uint8_t MAX_SEND_ATTEMPTS = 3;
+constexpr uint8_t COMM_PROBLEM_AFTER_FAILURES = 2;  // failed sends in a row that raise hasMainServerCommProblem. see device_status.h
+constexpr uint16_t TRANSFER_CHUNK_SIZE = 256;   // what a lost or corrupt chunk costs to resend. see networkings.h
+constexpr uint16_t TRANSFER_MAX_CHUNKS = 32;
+constexpr uint8_t TRANSFER_MAX_ROUNDS = 6;      // offers per connection before reconnecting
+
+// uplink.h
+constexpr uint16_t MQTT_PORT = 1883;
+constexpr uint16_t MQTT_MAX_PACKET_SIZE = 1024;     // PubSubClient's MQTT_MAX_PACKET_SIZE, within the broker's limit
+constexpr uint8_t MQTT_MAX_INFLIGHT = 4;            // PUBLISH frames sent ahead of their PUBACK
+constexpr uint16_t MQTT_KEEP_ALIVE_S = 60;
+constexpr uint32_t MQTT_TIMEOUT_MS = 5000;
+constexpr uint16_t UPLINK_CHUNK_SIZE = 896;         // bytes of a message per backlog record
+constexpr uint32_t UPLINK_BACKOFF_MIN_S = 30;
+constexpr uint32_t UPLINK_BACKOFF_MAX_S = 2 * 60 * 60;
+
+// energy.h. ESP32-C3 datasheet figures at 3.3 V, 160 MHz
+constexpr uint32_t DEEP_SLEEP_MICROAMPS = 5;
+constexpr uint32_t LIGHT_SLEEP_MICROAMPS = 130;
+constexpr uint32_t CPU_ACTIVE_MICROAMPS = 23000;        // radio off (modem sleep)
+constexpr uint32_t RADIO_TX_MICROAMPS = 285000;         // 802.11n at the default power
+constexpr uint32_t RADIO_RX_MICROAMPS = 84000;          // also while listening and associating
+constexpr uint32_t RADIO_TX_US_PER_BYTE = 8;            // ~1 Mbit/s effective at the low rates a far bin links at
+constexpr uint32_t BATTERY_CAPACITY_MAH = 2500;         // rated, from full down to MIN_BATTERY_POWER
+
+// battery.h
+constexpr uint8_t BATTERY_OVERSAMPLES = 16;             // ADC reads averaged into a sample
+constexpr uint8_t BATTERY_FILTER_SHIFT = 3;             // a sample weighs 1/8: at one a minute, ~8 minutes to follow a step
+constexpr uint32_t BATTERY_DIVIDER_RATIO = 2;           // 100k / 100k: 4.2 V reads 2.1 V, within the ADC's 11 dB range
+constexpr uint16_t BATTERY_VALID_MIN_MV = 2500;         // below: the divider is broken or the pin floats
+constexpr uint16_t BATTERY_VALID_MAX_MV = 4500;
+constexpr uint16_t BATTERY_ALERT_HYSTERESIS_MV = 50;    // BatteryLow ends this far above MIN_BATTERY_POWER
+constexpr uint32_t BATTERY_TREND_POINT_S = 60 * 60;     // the filtered voltage is kept for the trend this often
+constexpr uint8_t BATTERY_TREND_POINTS = 72;            // the trend's fit covers the last 3 days
+constexpr uint8_t BATTERY_TREND_MIN_POINTS = 6;
+constexpr DischargePoint BATTERY_DISCHARGE_CURVE[] = {  // single Li-ion cell at a few mA, by falling mV
+    {4180, 100}, {4060, 90}, {3960, 80}, {3880, 70}, {3810, 60}, {3760, 50},
+    {3720, 40}, {3680, 30}, {3620, 20}, {3530, 10}, {3400, 5}, {3020, 0},   // the last: MIN_BATTERY_POWER
+};
+
+// wifi_link.h
+constexpr uint8_t WIFI_MAX_NETWORKS = 4;                // stored by onSetup
+constexpr uint32_t WIFI_SCAN_MS_PER_CHANNEL = 120;
+constexpr uint32_t WIFI_FAST_CONNECT_TIMEOUT_MS = 1500; // a cached access point that hasn't answered by then has moved
+constexpr uint32_t WIFI_CONNECT_TIMEOUT_MS = 10000;
+constexpr uint32_t WIFI_LEASE_REUSE_S = 12 * 60 * 60;   // a cached DHCP lease is reused as a static IP this long
+
+// credential_vault.h
+constexpr uint8_t VAULT_RECORD_SLOTS = WIFI_MAX_NETWORKS + 1;   // one spare, so a password is replaced without a gap
+constexpr uint8_t VAULT_EFUSE_KEY_ID = 4;               // the eFuse key block (HMAC_UP) the device key is derived from
+
+// setup_console.h
+constexpr uint32_t SERIAL_BAUD = 115200;
+constexpr uint8_t CONSOLE_LINE_LENGTH = 128;    // with its terminator: fits `wifi add` with a quoted 32 char SSID and 64 char password
+constexpr uint8_t CONSOLE_MAX_TOKENS = 8;       // a command and its arguments
+constexpr uint32_t CONSOLE_POLL_MS = 20;        // how often it looks for input, sleeping in between: the worst echo delay
+constexpr uint32_t CONSOLE_IDLE_TIMEOUT_MS = 10 * 60 * 1000;  // onSetup gives up after this long without input
+constexpr float PLATE_TOL_MIN = 50.0f;          // g, the weighing plate weights onSetup accepts
+constexpr float PLATE_TOL_MAX = 3000.0f;
+
+// NVS keys (see hal.h)
+constexpr const char *NVS_KEY_SERVER_IP = "serverIp";   // char[16], dotted IPv4, set by onSetup
+constexpr const char *NVS_KEY_NTP_SERVER = "ntpServer"; // char[16], dotted IPv4, set by onSetup. NTP_DEFAULT_SERVER if missing
+constexpr const char *NVS_KEY_DEVICE_ID = "deviceId";   // uint32_t, set by onSetup
+constexpr const char *NVS_KEY_TX_SLOTS = "txSlots";    // TxSlot[2], set by onChangeTxTimes. see tx_slots.h
+constexpr const char *NVS_KEY_STREAM_EPOCHS = "epochs"; // uint16_t[3], see flash_log.h
+constexpr const char *NVS_KEY_STREAM_FLOORS = "floors"; // uint32_t[3]: each stream's sectors up to it are cleared
+constexpr const char *NVS_KEY_WIFI_NETWORKS = "wifiNets"; // WifiNetwork[WIFI_MAX_NETWORKS], legacy plaintext: imported into the vault and erased by its mount
+constexpr const char *NVS_KEY_VAULT_INDEX = "vaultIdx"; // + 0 or 1: the two copies of VaultIndex. see credential_vault.h
+constexpr const char *NVS_KEY_VAULT_RECORD = "vaultRec";    // + slot: VaultRecord, one sealed password
+constexpr const char *NVS_KEY_MQTT_BROKER = "mqttBroker"; // char[16], dotted IPv4. the main server's IP if missing
+constexpr const char *NVS_KEY_UPLINK_SEQUENCE = "upSeq"; // uint32_t[2]: the backlog's first sequence number, and the
+                                                        // flash store sequence the backlog before it was sent through
+constexpr const char *NVS_KEY_PLATE_WEIGHT = "plateWeight";   // float, g, set by onSetup, kept until it's sent to the server
+constexpr const char *NVS_KEY_LOAD_CELL_CAL = "loadCellCal";   // LoadCellCalibration, set by onCalibrateLoadCell. see sensors.h
+
 constexpr uint8_t EVENTS_QUEUE_LENGTH = 10;
+constexpr uint16_t EVENTS_RING_LENGTH = 16;     // must be a power of two. see event_ring.h
+constexpr uint32_t EVENTS_IDLE_WAIT_MS = 1000;  // how long loop() sleeps waiting for an event before listening again
+constexpr uint16_t LED_REQUESTS_RING_LENGTH = 8;    // blinkLed requests waiting for the display task. a power of two
 
 constexpr gpio HX711_DOUT       = 2;
 constexpr gpio HX711_SCK        = 3;
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "aes_gcm.h"
+#include "config.h"
+#include "wifi_link.h"
+
+/**
+ * The credential vault: the Wi-Fi passwords onSetup stores, encrypted in NVS.
+ *
+ * Each password is a record of its own, sealed by AES-256-GCM (aes_gcm.h) under a key unique to the device
+ * (hal::deviceKey, derived from the eFuse key block VAULT_EFUSE_KEY_ID), with a random nonce. The record's slot and its network's SSID are its AAD, so a record
+ * copied to another slot or another SSID doesn't open. A small index, in plaintext (SSIDs are broadcast anyway), maps
+ * each SSID to its record slot: finding one network's password at connect time is one NVS read and one decrypt, however
+ * many networks are stored.
+ *
+ * Power loss: every change is a few NVS writes, each committed before the next, and the index is the commit point.
+ * It's kept twice (NVS_KEY_VAULT_INDEX 0 and 1), each with a generation and a CRC32; mount() takes the valid copy with
+ * the highest generation, and a change writes its new index over the other copy, so the current one is never touched.
+ *  - add: the password is sealed into a slot the index doesn't use, the new index is written, then a record it
+ *    replaced is erased. VAULT_RECORD_SLOTS keeps a spare slot for this.
+ *  - remove: the index without the network is written, then its record is erased.
+ * Cut anywhere, a remount finds the vault as it was before the change or after it. Records no index entry points to
+ * (from a cut before the switch, or before an erase) are erased by mount().
+ *
+ * The stored networks of earlier firmware (NVS_KEY_WIFI_NETWORKS, plaintext) are imported by mount(), then erased.
+ *
+ * No key, no vault: on a chip with no key burnt into that block, mount() fails (setup() logs LogCode::VaultLocked) and
+ * the vault stores and hands out nothing. There's no fallback key: anything else on the chip (the MAC, say) can be read
+ * by whoever holds it, and a key derived from it would let them open every record.
+ */
+
+struct VaultIndex {
+    struct Entry {
+        char ssid[33];      // empty: a free entry
+        uint8_t record;     // its slot, below VAULT_RECORD_SLOTS
+    };
+
+    uint32_t generation;
+    Entry entries[WIFI_MAX_NETWORKS];
+    uint32_t crc;           // CRC32 of everything before it
+};
+
+struct VaultRecord {
+    uint8_t nonce[AES_GCM_NONCE_SIZE];
+    uint8_t password[65];   // sealed whole, with its padding, so the length doesn't show
+    uint8_t tag[AES_GCM_TAG_SIZE];
+};
+
+class CredentialVault {
+public:
+    struct Stats {
+        uint32_t decrypts = 0;
+        uint32_t failures = 0;  // records that didn't open: tampered with, or sealed under another device key
+    };
+
+    // Derives the key, reads the index, imports the legacy networks and erases orphan records. call again after a reboot.
+    // false if there's no device key: then nothing is read or imported, and every other call refuses
+    bool mount();
+    bool isMounted() const { return mounted; }
+
+    // Stores the network's password, replacing the one stored for that SSID. false if WIFI_MAX_NETWORKS other
+    // networks are stored, the SSID is empty or too long, or NVS failed: then the vault is as it was
+    bool add(const char *ssid, const char *password);
+    bool remove(const char *ssid);          // false if it wasn't stored, or NVS failed
+    // The SSID's password, with one record read and one decrypt. false if it isn't stored or doesn't open
+    bool find(const char *ssid, char password[65]);
+    // The stored networks, packed to the front, without their passwords (nothing is decrypted). returns how many
+    uint8_t list(WifiNetwork networks[WIFI_MAX_NETWORKS]);
+    const Stats &stats() const { return counters; }
+
+private:
+    int8_t entryOf(const char *ssid) const;
+    void readIndex();                       // the newest valid NVS copy
+    bool writeIndex(const VaultIndex &next);    // over the older copy, as the next generation
+    bool addLocked(const char *ssid, const char *password);
+    void importLegacy();
+    void eraseOrphans();
+
+    std::mutex mutex;
+    AesGcm gcm;
+    VaultIndex index = {};
+    uint8_t current = 0;    // the NVS copy index was read from
+    bool mounted = false;
+    Stats counters;
+};
+
+extern CredentialVault credentialVault;
+
+// Zeroes a buffer that held a secret, in a way the compiler can't drop as a dead store
+void wipeSecret(void *buffer, size_t length);
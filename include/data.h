@@ -1,30 +1,116 @@
 #pragma once
 
+#include <cstdint>
+#include <mutex>
+
+#include "data_codec.h"
+#include "flash_log.h"
 #include "types.h"
 
 /**
  * should contain functions of:
- *  - Create a data table with specific columns and formats. currently, time (HHmm), weight (unsigned integer, ranges 0-99,999, in grams)
+ *  - Create a data table with specific columns and formats. currently, time (HHmm), weight (unsigned integer, ranges 0-131,070, in grams)
  *  - Updates the table with a new data.
  *  - deletes the existing table.
  */
 
 
-/** Here there's a problem that should be adressed:
- * It's prefered that the data is kept on the flash (4MB) but it's there with other stuff.
- * So after all code is done, should check how much space is left.
- * 
- * if it turns out problematic, maybe a string of number is prefered (3 bytes for hour, 4 bytes for weight)
+/** Flash space:
+ * The table lives in flash, not in RAM, as the DataTable stream of the flash store (see flash_log.h),
+ * and every record is packed into 3 bytes (24 bits), little endian:
+ *
+ *      bits 23..17: minutes since the previous record (1-126)
+ *      bits 16..0 : weight in grams (0-131,070)
+ *
+ * The time of day (11 bits) doesn't fit next to a 17 bit weight in 3 bytes, so it's stored as a delta.
+ * When the delta is out of range (the first record, a gap longer than 126 minutes, two records in the same minute)
+ * a time marker is written first: delta 0, and the minute of day (0-1439) the next delta counts from in the low bits.
+ * The delta stops at 126 so the last byte of a record is never 0xFF, which the flash store needs to find the end.
+ * A record and its time marker are appended together, so they're never split between two flash sectors.
+ *
+ * So a full day (840 records) takes 2523 bytes of flash and no RAM, instead of 3360 bytes for an array of 4 byte records.
  */
+constexpr uint8_t PACKED_RECORD_SIZE = 3;
+constexpr weightType MAX_RECORD_WEIGHT = 0x1FFFE;
+constexpr recordTimeType MINUTES_PER_DAY = 24 * 60;
+
+/* Iterates over the records, decoding them straight from the memory-mapped flash, sector after sector. */
+class RecordIterator {
+public:
+    RecordIterator() = default;     // the end
+    RecordIterator(const FlashLog *store, StreamId stream, uint32_t through);  // the segments up to sequence `through`
+    Record operator*() const { return current; }
+    RecordIterator &operator++();
+    bool operator!=(const RecordIterator &other) const { return position != other.position; }
+
+private:
+    void decode();      // skips time markers and decodes the record at position
+
+    const FlashLog *store = nullptr;
+    StreamId stream = StreamId::DataTable;
+    uint32_t through = 0;
+    FlashSegment segment = {nullptr, 0, 0};
+    const uint8_t *position = nullptr;
+    const uint8_t *end = nullptr;
+    recordTimeType minute = 0;
+    Record current = {0, 0};
+};
+
+/* A read-only view of the records in the table, up to a sequence of the flash store. Nothing is copied. */
+class RecordSpan {
+public:
+    RecordSpan(const FlashLog *store, StreamId stream, uint16_t count, uint32_t through = UINT32_MAX)
+        : store(store), stream(stream), count(count), through(through) {}
+    RecordIterator begin() const { return count > 0 ? RecordIterator(store, stream, through) : RecordIterator(); }
+    RecordIterator end() const { return RecordIterator(); }
+    uint16_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    const FlashLog *store;
+    StreamId stream;
+    uint16_t count;
+    uint32_t through;
+};
+
 class DataTable {
     public:
-        DataTable(uint16_t capacity);   // For now the size should be 14 hours * 60 readings an hour = 840 * struct Record size of space. the table is saved on the flash not RAM
-        void createDataTable();
-        void updateTable(Record record);
-        Record *readTable();               // returns an array with the length of the number of records, each item is a record 
-        void deleteTable();
-    
+        // The records at one point in time, to send while more are added: see snapshot()
+        struct Snapshot {
+            uint16_t records;
+            uint32_t checksum;          // the CRC trailer encodeDataTable gives them
+            uint32_t through;           // the flash store's sequence they end at
+        };
+
+        DataTable(uint16_t capacity, FlashLog &store = flashStore);    // For now the size should be 14 hours * 60 readings an hour = 840 records (DATA_TABLE_CAPACITY)
+        bool createDataTable();         // mounts the flash store if needed. records that are already there (e.g. before a reboot) are kept
+        bool updateTable(Record record);    // false if the table is full or flash can't be written
+        RecordSpan readTable() const;   // the records in the order they were added, read in place from flash
+        void deleteTable();             // O(1), nothing is erased. see flash_log.h
+        // Seals the table: the records so far, which the ones added from now on don't join (they start a new sector)
+        Snapshot snapshot();
+        RecordSpan readTable(const Snapshot &snapshot) const;
+        void deleteThrough(const Snapshot &snapshot);   // the snapshot's records, once sent. the ones added since are kept
+        uint16_t length() const;
+        uint32_t flashBytesUsed() const;
+        uint32_t payloadChecksum() const;   // the CRC trailer encodeDataTable gives these records
+
     private:
-        bool isFull();
+        bool isFull() const;
+        void rescan();                  // the counts and the checksum, from what's in flash. the lock is held
+
+        FlashLog &store;
+        uint16_t capacity;
+        uint16_t recordCount = 0;
+        uint32_t bytesUsed = 0;
+        recordTimeType lastMinute = 0;
+        bool hasLastMinute = false;
+        DataChecksum checksum;          // kept as records are appended, and rebuilt from flash by createDataTable
+        mutable std::mutex mutex;       // the sensor task appends while loop() reads and deletes
 };
 
+extern DataTable dataTable;     // the device's table, DATA_TABLE_CAPACITY records
+
+// Packing helpers, shared with the codecs that read the table
+uint32_t packRecord(recordTimeType minutesSincePrevious, weightType weight);
+uint32_t packTimeMarker(recordTimeType minuteOfDay);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "checksum.h"
+#include "types.h"
+
+class RecordSpan;   // data.h, which keeps a DataChecksum
+
+/**
+ * Wire format of the data table, as sent to the main server by onSendData.
+ * Readings are a minute apart and the weight changes slowly, so deltas are tiny and most records take 2 bytes:
+ *
+ *      byte 0          DATA_FORMAT_VERSION
+ *      first record    varint minute of day, varint weight
+ *      every other     varint minutes since the previous record (mod 1440), zig-zag varint weight change
+ *      last 4 bytes    CRC32 (little endian, see checksum.h) of all the bytes before it
+ *
+ * Varints are LEB128: 7 bits per byte, low bits first, high bit set on all bytes but the last.
+ * The CRC is computed as the records are encoded, and DataTable computes the same one as they're appended
+ * (DataChecksum), so neither needs a pass over the payload.
+ */
+constexpr uint8_t DATA_FORMAT_VERSION = 1;
+constexpr size_t DATA_CHECKSUM_SIZE = 4;
+
+// Worst case bytes for a table of recordCount records (time delta: 2 bytes, weight change: 3 bytes)
+constexpr size_t maxEncodedDataSize(uint16_t recordCount) {
+    return 1 + static_cast<size_t>(recordCount) * 5 + DATA_CHECKSUM_SIZE;
+}
+
+constexpr size_t MAX_ENCODED_RECORD_SIZE = 10;  // two 5 byte varints
+
+/* The encoding state between records: the previous one, which the next is a delta of. */
+class RecordDeltas {
+public:
+    size_t encode(const Record &record, uint8_t out[MAX_ENCODED_RECORD_SIZE]);     // returns its length
+
+private:
+    bool hasPrevious = false;
+    recordTimeType previousMinute = 0;
+    weightType previousWeight = 0;
+};
+
+/* Encodes records one by one into a caller-provided buffer. */
+class DataEncoder {
+public:
+    DataEncoder(uint8_t *buffer, size_t capacity);
+    bool add(const Record &record);     // false if the buffer is full (the record is not added)
+    size_t finish();                    // appends the CRC. returns the payload length, 0 if the CRC doesn't fit
+    uint32_t checksum() const { return crc.value(); }
+
+private:
+    uint8_t *buffer;
+    size_t capacity;
+    size_t length = 0;
+    RecordDeltas deltas;
+    Crc32 crc;
+};
+
+/* The CRC trailer of a table's payload, computed record by record without encoding it into a buffer. */
+class DataChecksum {
+public:
+    DataChecksum() { reset(); }
+    void add(const Record &record);
+    uint32_t value() const { return crc.value(); }
+    void reset();
+
+private:
+    RecordDeltas deltas;
+    Crc32 crc;
+};
+
+// Encodes a whole table. returns the payload length, 0 if it doesn't fit in capacity
+size_t encodeDataTable(const RecordSpan &records, uint8_t *payload, size_t capacity);
+
+// Decodes a payload into records. false if it's corrupt (bad CRC, version or varint) or has more than capacity records
+bool decodeDataTable(const uint8_t *payload, size_t length, Record *records, uint16_t capacity, uint16_t &count);
+
+// The CRC stored in the payload's trailer
+uint32_t dataPayloadChecksum(const uint8_t *payload, size_t length);
@@ -2,16 +2,83 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <atomic>
+
+#include "types.h"
 
 constexpr float MIN_BATTERY_POWER = 3.02; // in volts
 
-// Atomic flag setters
-void setIsActive(bool value); /* in `device_status.cpp`:
- * #include "freertos/atomic.h"
- * static volatile intptr_t isActiveFlag = 0;
- * void setIsActive(bool value) {atomic_store(&isActiveFlag, value ? 1 : 0);}
- * bool getIsActive(void) {return atomic_load(&isActiveFlag) != 0;}
+/**
+ * The device status register: every status flag and counter in one 32-bit word, in RTC memory.
+ *
+ * RTC memory survives deep sleep, so a wakeup finds the status as it was left and doesn't read flash for it. On power-up
+ * it's zeroed: initDeviceStatus (setup()) sees the Valid bit clear and restores what NVS knows (the device ID).
+ *
+ *      bit 0           Valid: initDeviceStatus ran since power-up
+ *      bit 1           isActive
+ *      bit 2           hasMainServerCommProblem
+ *      bit 3           hasDeviceId
+ *      bits 15..8      commFailures: failed sends to the main server in a row, saturating at 255
+ *      bits 26..16     last successful send, minute of day + 1. 0: none since power-up
+ *      others          0
+ *
+ * The word is a std::atomic<uint32_t>: snapshot() reads the whole status with one aligned load, so it's never half of
+ * one update and half of another, and updates go through compare-and-swap, so writers in different tasks don't lose
+ * each other's changes. (The ESP32-C3 has no atomic instructions: its toolchain does the compare-and-swap with the
+ * interrupts masked for a few instructions. Loads and stores are single instructions.)
  */
+
+constexpr recordTimeType NO_TX_MINUTE = 0xFFFF;
+
+struct DeviceStatus {
+    bool isActive;
+    bool hasMainServerCommProblem;
+    bool hasDeviceId;
+    uint8_t commFailures;
+    recordTimeType lastTxMinute;    // of the last successful send, NO_TX_MINUTE if none
+};
+
+uint32_t packDeviceStatus(const DeviceStatus &status);     // Valid set
+DeviceStatus unpackDeviceStatus(uint32_t word);
+
+class StatusRegister {
+public:
+    constexpr StatusRegister() : word(0) {}     // constant initialised, so the RTC copy isn't overwritten at a wakeup
+    DeviceStatus snapshot() const { return unpackDeviceStatus(word.load(std::memory_order_acquire)); }
+    bool isValid() const { return (word.load(std::memory_order_acquire) & 1U) != 0; }
+    void clear() { word.store(0, std::memory_order_release); }     // as at power-up
+
+    // Stores desired if the register still holds expected. Otherwise false, and expected is what it holds now
+    bool compareAndSwap(DeviceStatus &expected, const DeviceStatus &desired);
+
+    // Applies change (void(DeviceStatus &)) to the current status until no other writer came in between. returns the result
+    template <typename Change>
+    DeviceStatus update(Change change) {
+        uint32_t current = word.load(std::memory_order_acquire);
+        DeviceStatus desired;
+        do {
+            desired = unpackDeviceStatus(current);
+            change(desired);
+        } while (!word.compare_exchange_weak(current, packDeviceStatus(desired), std::memory_order_acq_rel,
+                                             std::memory_order_acquire));
+        return desired;
+    }
+
+private:
+    std::atomic<uint32_t> word;
+};
+
+extern StatusRegister deviceStatus;     // the device's, in RTC memory
+
+// After a power-up (the register isn't Valid): restores hasDeviceId from NVS. After a wakeup: nothing
+void initDeviceStatus(StatusRegister &status = deviceStatus);
+
+// A send to the main server delivered (counters reset, the tx minute kept) or failed. COMM_PROBLEM_AFTER_FAILURES
+// failures in a row raise hasMainServerCommProblem, the next delivery clears it
+void recordMainServerSend(bool delivered, recordTimeType minute, StatusRegister &status = deviceStatus);
+
+// Atomic flag setters, on deviceStatus
+void setIsActive(bool value);
 void setHasMainServerCommProblem(bool value);
 void setHasDeviceId(bool value);
 
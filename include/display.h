@@ -4,7 +4,8 @@
 
 void initDisplay(DisplayMode displayMode);
 void displayOnComputer(const char *msg);
-void blinkLed(LEDPattern ledPattern);
+void blinkLed(LEDPattern ledPattern);     // thread-safe: hands the pattern to the display task (see led_patterns.h)
+void stopLed(LEDPattern ledPattern);      // thread-safe: ends a repeating pattern, e.g. RunningSetup
 
 /** Process responsible for displaying outputs to the user
  * Input:
@@ -24,5 +25,7 @@ void blinkLed(LEDPattern ledPattern);
  *  1. You may add more constants, functions, classes, etc. as needed.
  *  2. This process isn't on the main process (aka, void loop) to make sure messages and blinkings will be displayed when needed with no delays.
  *  3. It's prefered that the blinking logic is designed modularly, so blinking patterns are changeable easely in the future (i.e., patterns on future differnet outputs, different leds, changing the pattern, etc)
+ *     The patterns and their player are in led_patterns.h. The task sleeps between the LED edges: their one-shot timer and
+ *     blinkLed wake it.
  */
 void display(const char *msg = "", LEDPattern ledPattern = LEDPattern(LEDPatternType::None));
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "config.h"
+
+/**
+ * Energy ledger: where the battery goes.
+ *
+ * The tasks tell it when they wake up and when they park again, WifiLink when the radio is on (from the first hold of
+ * the link, connect included, to the last release, see wifi_link.h), and the TCP senders the bytes they send.
+ * From that it keeps, on the micros() clock:
+ *  - per task, its wall time awake (between a wakeup and the next park). Tasks awake at the same time each count it
+ *  - per power state, the device's time in it. The states don't overlap, the first that applies wins:
+ *      RadioTx, RadioRx    the radio is on. its time is split by the bytes sent, at ENERGY_PROFILE.radioTxUsPerByte
+ *      CpuActive           some task is awake
+ *      LightSleep          every task is parked: the idle task lets the chip light-sleep
+ *      DeepSleep           stays 0: the firmware doesn't deep-sleep. it's kept for the Status message's layout
+ *
+ * report() turns them into mAh with the average current of each state (ENERGY_PROFILE, from config.h). A task's mAh is
+ * its awake time at the CpuActive current, plus the radio time it held at the radio's. The days to empty project the
+ * average current since start over the battery's remaining capacity.
+ *
+ * onCheckDeviceStatus reports it (reportEnergy): a DaysToEmpty log row, and the report to the server as a Status
+ * message. On the host the clock is simulated, so a day's report can be computed in milliseconds (see test_energy.cpp).
+ */
+
+enum class EnergyTask : uint8_t { LoadCell, Display, Scheduler, Networkings, Events, Count };    // Events: loop()
+enum class PowerState : uint8_t { DeepSleep, LightSleep, CpuActive, RadioTx, RadioRx, Count };
+constexpr uint8_t ENERGY_TASK_COUNT = static_cast<uint8_t>(EnergyTask::Count);
+constexpr uint8_t POWER_STATE_COUNT = static_cast<uint8_t>(PowerState::Count);
+
+struct EnergyProfile {
+    uint32_t microAmps[POWER_STATE_COUNT];      // average current, by PowerState
+    uint32_t radioTxUsPerByte;                  // airtime of a byte sent, headers and retries included
+};
+
+constexpr EnergyProfile ENERGY_PROFILE = {
+    {DEEP_SLEEP_MICROAMPS, LIGHT_SLEEP_MICROAMPS, CPU_ACTIVE_MICROAMPS, RADIO_TX_MICROAMPS, RADIO_RX_MICROAMPS},
+    RADIO_TX_US_PER_BYTE,
+};
+
+struct EnergyReport {
+    uint64_t elapsedUs;                         // since start
+    uint64_t stateUs[POWER_STATE_COUNT];
+    uint64_t taskUs[ENERGY_TASK_COUNT];
+    float stateMah[POWER_STATE_COUNT];
+    float taskMah[ENERGY_TASK_COUNT];
+    float totalMah;                             // of the states
+    float averageMilliAmps;
+};
+
+class EnergyLedger {
+public:
+    explicit EnergyLedger(const EnergyProfile &profile) : profile(profile) {}
+    void start();                               // from now, every task parked and the radio off
+    void taskAwake(EnergyTask task);            // thread-safe, like the rest
+    void taskAsleep(EnergyTask task);
+    void radioOn(EnergyTask holder);
+    void radioSent(uint32_t bytes);             // while it's on
+    void radioOff();                            // splits the radio time into TX and RX by the bytes sent
+    bool radioIsOn();
+    EnergyReport report();                      // up to now
+
+private:
+    void advance(uint64_t nowUs);               // books the time since the last change to the current state
+    float toMah(uint64_t microAmpMicroseconds) const;
+
+    EnergyProfile profile;
+    std::mutex mutex;
+    uint64_t startUs = 0;
+    uint64_t lastUs = 0;
+    uint64_t stateUs[POWER_STATE_COUNT] = {};
+    uint64_t taskUs[ENERGY_TASK_COUNT] = {};
+    uint64_t taskRadioCharge[ENERGY_TASK_COUNT] = {};   // uA * us of the radio time it held
+    uint64_t taskRadioUs[ENERGY_TASK_COUNT] = {};
+    bool awake[ENERGY_TASK_COUNT] = {};
+    uint8_t awakeCount = 0;
+    bool radio = false;
+    EnergyTask radioHolder = EnergyTask::Networkings;
+    uint64_t radioUs = 0;                       // of the current radio span
+    uint32_t radioBytes = 0;                    // sent in it
+};
+
+extern EnergyLedger energyLedger;   // the device's, started by setup()
+
+// Days until the remaining capacity is used at the report's average current. UINT16_MAX if nothing was used yet
+uint16_t daysToEmpty(const EnergyReport &report, float remainingMah);
+
+/* Status message with the report, little endian:
+ *
+ *      byte 0          STATUS_ENERGY
+ *      4 bytes         seconds since start
+ *      per state       [s 4][uAh 4]
+ *      per task        [s awake 4][uAh 4]
+ *      2 bytes         days to empty
+ */
+constexpr uint8_t STATUS_ENERGY = 2;
+constexpr size_t ENERGY_STATUS_SIZE = 1 + 4 + 8 * (POWER_STATE_COUNT + ENERGY_TASK_COUNT) + 2;
+
+size_t encodeEnergyReport(const EnergyReport &report, uint16_t days, uint8_t *out, size_t capacity);
+
+// Logs the days to empty (the charge left from battery.h's discharge curve, or before its first reading the rated
+// capacity less what was used since start) and uplinks the report
+void reportEnergy(EnergyLedger &ledger = energyLedger);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "types.h"
+
+/**
+ * Event dispatch, and how long each handler holds the main loop.
+ *
+ * loop() (main.cpp) runs an event's handler from a constexpr table indexed by EventType, through dispatchEvent,
+ * which times it. Short runs are timed with the CPU cycle counter, which costs a couple of instructions to read;
+ * runs longer than half its wrap (~13 s at 160 MHz, e.g. a SendData that retries its connections) with micros().
+ *
+ * Per event type it keeps the number of runs, the fastest and the slowest, and a histogram with buckets a factor
+ * of 4 apart:
+ *
+ *      bucket 0: under 4 us, bucket b: 4^b to 4^(b+1) us, the last one: 4^13 us (67 s) and longer
+ *
+ * onCheckDeviceStatus reports them (reportEventTimings) and they start over, so each report covers the time since
+ * the previous status check:
+ *  - the log file gets a row per event type that ran: EventTiming, see log_codec.h
+ *  - the server gets all of it in a Status message, see encodeEventTimings
+ */
+
+using EventHandler = void (*)();
+
+constexpr uint8_t EVENT_TIMING_BUCKETS = 14;
+
+struct EventTiming {
+    uint32_t count;
+    uint32_t minUs;     // UINT32_MAX until the first run
+    uint32_t maxUs;
+    uint16_t buckets[EVENT_TIMING_BUCKETS];     // saturate at 65535
+};
+
+class EventTimings {
+public:
+    EventTimings() { reset(); }
+    void record(EventType type, uint32_t us);
+    const EventTiming &of(EventType type) const { return timings[static_cast<uint8_t>(type)]; }
+    void reset();
+
+private:
+    EventTiming timings[EVENT_TYPE_COUNT];
+};
+
+extern EventTimings eventTimings;   // only touched by loop() and the handlers it runs
+
+uint8_t eventTimingBucket(uint32_t us);
+
+// Runs the handler of the event type, and records how long it took
+void dispatchEvent(const EventHandler (&handlers)[EVENT_TYPE_COUNT], EventType type,
+                   EventTimings &timings = eventTimings);
+
+/* Status message with the timings, for every event type that ran, little endian:
+ *
+ *      byte 0          STATUS_EVENT_TIMINGS
+ *      per event type  [type 1][count 4][min us 4][max us 4][bucket counts 2 each]
+ */
+constexpr uint8_t STATUS_EVENT_TIMINGS = 1;
+constexpr size_t EVENT_TIMING_RECORD_SIZE = 1 + 3 * 4 + 2 * EVENT_TIMING_BUCKETS;
+constexpr size_t MAX_EVENT_TIMINGS_SIZE = 1 + EVENT_TYPE_COUNT * EVENT_TIMING_RECORD_SIZE;
+
+// returns the length, 0 if nothing ran
+size_t encodeEventTimings(const EventTimings &timings, uint8_t *out, size_t capacity);
+
+// Logs the timings, enqueues them to the uplink, and resets them
+void reportEventTimings(EventTimings &timings = eventTimings);
+
+// The EventTiming log row's payload: event type (4 bits), runs (8 bits, capped) and the slowest run in ms (20 bits, capped)
+uint32_t packEventTiming(EventType type, const EventTiming &timing);
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#ifdef ARDUINO
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#endif
+
+
+/** EventRing
+ * A bounded multi-producer / single-consumer ring buffer, used to hand items (events) from the tasks
+ * (getLoadCellData, display, scheduler, networkings), or from ISRs, to the main loop.
+ *
+ * - Any number of producers may call tryPush concurrently. It never blocks and never takes a lock;
+ *   it returns false if the ring is full.
+ * - Exactly one consumer (loop()) calls tryPop / waitPop. waitPop parks the consumer until an item arrives
+ *   (or the timeout passes) instead of spinning.
+ *
+ * Every cell carries a sequence number (Vyukov's bounded queue), so a producer that reserved a cell
+ * but didn't finish writing it yet is never read half-written.
+ * The producers' index, the consumer's index and the cells sit on separate cache lines.
+ *
+ * Note: the ESP32-C3 has no atomic instructions, so there the compiler's atomic helpers briefly mask interrupts.
+ * It's still safe from ISRs and never waits on another task.
+ */
+
+constexpr uint16_t CACHE_LINE_SIZE = 64;
+
+/* Binary wake-up signal for a single waiting consumer.
+ * A signal given while nobody waits is kept, so a wake-up is never lost. */
+class RingParker {
+public:
+    RingParker();
+    void signal();
+    bool wait(uint32_t timeoutMs);  // returns false on timeout
+
+private:
+#ifdef ARDUINO
+    StaticSemaphore_t semaphoreBuffer;
+    SemaphoreHandle_t semaphore;
+#else
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool signaled = false;
+#endif
+};
+
+template<typename T, uint16_t CAPACITY>
+class EventRing {
+public:
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "EventRing capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "EventRing items are copied between tasks byte by byte");
+
+    static constexpr uint32_t WAIT_FOREVER = UINT32_MAX;
+
+    EventRing();
+    EventRing(const EventRing &) = delete;
+    EventRing &operator=(const EventRing &) = delete;
+
+    bool tryPush(const T &item);                    // any task or ISR. returns false if full
+    bool tryPop(T &item);                           // consumer only. returns false if empty
+    bool waitPop(T &item, uint32_t timeoutMs);      // consumer only. parks until an item arrives, false on timeout
+    bool isEmpty() const;                           // a snapshot, may be stale by the time it returns
+    static constexpr uint16_t capacity() { return CAPACITY; }
+
+private:
+    static constexpr uint32_t MASK = CAPACITY - 1;
+
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        T item;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> head;    // next position to push, shared by producers
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> tail;    // next position to pop, owned by the consumer
+    std::atomic<bool> consumerParked;
+    alignas(CACHE_LINE_SIZE) Cell cells[CAPACITY];
+    RingParker parker;
+};
+
+template<typename T, uint16_t CAPACITY>
+EventRing<T, CAPACITY>::EventRing() : head(0), tail(0), consumerParked(false) {
+    for (uint32_t i = 0; i < CAPACITY; i++) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<typename T, uint16_t CAPACITY>
+bool EventRing<T, CAPACITY>::tryPush(const T &item) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &cells[position & MASK];
+        uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int32_t diff = static_cast<int32_t>(sequence - position);
+        if (diff == 0) {
+            // the cell is free for this lap. claim it, unless another producer was faster
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;   // the consumer hasn't freed this cell yet: the ring is full
+        } else {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+    cell->item = item;
+    cell->sequence.store(position + 1, std::memory_order_release);
+
+    // the store above and the load below may not swap, nor may waitPop's store and re-check:
+    // then either we see the consumer parked, or it sees the item
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumerParked.load(std::memory_order_seq_cst) && consumerParked.exchange(false, std::memory_order_seq_cst)) {
+        parker.signal();
+    }
+    return true;
+}
+
+template<typename T, uint16_t CAPACITY>
+bool EventRing<T, CAPACITY>::tryPop(T &item) {
+    uint32_t position = tail.load(std::memory_order_relaxed);
+    Cell &cell = cells[position & MASK];
+    uint32_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (static_cast<int32_t>(sequence - (position + 1)) < 0) {
+        return false;   // empty, or the producer that claimed this cell is still writing it
+    }
+    item = cell.item;
+    cell.sequence.store(position + CAPACITY, std::memory_order_release);
+    tail.store(position + 1, std::memory_order_relaxed);
+    return true;
+}
+
+template<typename T, uint16_t CAPACITY>
+bool EventRing<T, CAPACITY>::waitPop(T &item, uint32_t timeoutMs) {
+    while (true) {
+        if (tryPop(item)) {
+            return true;
+        }
+        // announce that we're going to sleep, then look once more so a push that raced with us isn't missed
+        consumerParked.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);   // pairs with tryPush's
+        if (tryPop(item)) {
+            consumerParked.store(false, std::memory_order_relaxed);
+            return true;
+        }
+        if (!parker.wait(timeoutMs)) {
+            consumerParked.store(false, std::memory_order_relaxed);
+            return tryPop(item);
+        }
+    }
+}
+
+template<typename T, uint16_t CAPACITY>
+bool EventRing<T, CAPACITY>::isEmpty() const {
+    uint32_t position = tail.load(std::memory_order_relaxed);
+    return static_cast<int32_t>(cells[position & MASK].sequence.load(std::memory_order_acquire) - (position + 1)) < 0;
+}
+
+#ifdef ARDUINO
+inline RingParker::RingParker() : semaphore(xSemaphoreCreateBinaryStatic(&semaphoreBuffer)) {}
+
+inline void RingParker::signal() {
+    if (xPortInIsrContext()) {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        xSemaphoreGiveFromISR(semaphore, &higherPriorityTaskWoken);
+        portYIELD_FROM_ISR(higherPriorityTaskWoken);
+    } else {
+        xSemaphoreGive(semaphore);
+    }
+}
+
+inline bool RingParker::wait(uint32_t timeoutMs) {
+    TickType_t ticks = timeoutMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+    return xSemaphoreTake(semaphore, ticks) == pdTRUE;
+}
+#else
+inline RingParker::RingParker() = default;
+
+inline void RingParker::signal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        signaled = true;
+    }
+    condition.notify_one();
+}
+
+inline bool RingParker::wait(uint32_t timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto isSignaled = [this] { return signaled; };
+    if (timeoutMs == UINT32_MAX) {
+        condition.wait(lock, isSignaled);
+    } else if (!condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), isSignaled)) {
+        return false;
+    }
+    signaled = false;
+    return true;
+}
+#endif
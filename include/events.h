@@ -13,6 +13,9 @@
 #include "data.h"           // functions to handle the sensor data table
 #include "scheduler.h"      // functions to handle scheduling tasks, like sending data to server
 #include "networkings.h"    // functions to handle networking tasks
+#include "event_ring.h"     // lock-free ring that hands events from the tasks to loop()
+
+extern EventRing<Event, EVENTS_RING_LENGTH> eventsRing;    // written by any task (through enqueueEvent), read only by loop()
 
 /** On the main process - an event listener
  * Input:
@@ -33,6 +36,20 @@
  */
 void listenToEvents();
 
+/** Raises an event from any task (or ISR)
+ * Input:
+ *  - EventType eventType: the event to handle
+ *  - uint8_t priority: smaller is more urgent (1 is the highest used by the handlers)
+ *
+ * Behaviour:
+ *  1. Pushes the event into the lock-free events ring (see event_ring.h). Never blocks.
+ *  2. The main loop moves it into the events queue, which orders it by priority.
+ *
+ * Output:
+ *  - bool: false if the ring is full and the event was dropped
+ */
+bool enqueueEvent(EventType eventType, uint8_t priority);
+
 /** The setup logic
  * This function must be invoked only if the device is connected to a computer via the USB (serial) port.
  * 
@@ -80,6 +97,8 @@ void listenToEvents();
  * Notes:
  *  1. You may add more constants, functions, classes, etc. as needed.
  *  2. Display is always on computer-mode, even when defined otherwise.
+ *  3. Steps 1. - 7. are the command console of setup_console.h: it waits for input without blocking the other tasks,
+ *      and stores what was entered on `done`. It ends after CONSOLE_IDLE_TIMEOUT_MS without input.
 */
 void onSetup();
 
@@ -167,7 +186,8 @@ void onDeactivate();
  * 
  * Behaviour:
  *  1. Check for critical problems:
- *      1.1. obtain battery power. Make sure its above device_status.h::MIN_BATTERY_POWER.
+ *      1.1. obtain battery power. Make sure its above device_status.h::MIN_BATTERY_POWER (battery.h::reportBattery,
+ *           whose low alert has hysteresis around it)
  *      1.2. ping the main server ("connection check ping") and awaits response.
  *      1.3. check all sensors are working (i.e., there're meaningful readings which make sense).
  *      - if any error in either of these, enqueue (led-pattern) LowBattery \ NetworkingProblem \ BatteryPowerReadingProblem \ LoadCellReadingProblem
@@ -175,6 +195,9 @@ void onDeactivate();
  * 2. Check for non-critical 
  *      2.1. ping the NTP server and awaits response. If any errors, enqueue to msg-queue an informing message
  * 3. Finally, log (see logging.h) all results (including specific battery level), both positive checks and negative, with datetime stamp
+ *      - and how long each event's handler held the main loop since the last check (event_dispatch.h::reportEventTimings),
+ *        which also goes to the server as a Status message
+ *      - the projected days to empty, from the energy used since start (energy.h::reportEnergy), also sent as a Status message
  * 4. Only if critical error(s) occured, enqueue in the events queue SendLogFile
  * 
  * Output:
@@ -208,6 +231,7 @@ void onCheckDeviceStatus();
  *  3. Wait for a button press (user approves they're ready for calibration)
  *  4. Calibrate (see logic in the code commented below the function decleration).
  *  5. Save calibration ratio to EEPROM
+ *      - (NVS_KEY_LOAD_CELL_CAL), then sensors.h::invalidateLoadCellWarmState, so the next reading starts cold with it
  * 
  * Output:
  *  - None.
@@ -409,9 +433,12 @@ void loop()
  *  - None. If input is needed, you may add input parametrs.
  * 
  * Behaviour:
- *  1. Device asks server for the tx times (2 in total, each time is of 24 hours format)
- *  2. it stores them in an array in the EEPROM
- *  3. it tells the scheduler to reschedul its events.
+ *  1. Device asks server for the tx slots (2 in total, each a start minute of day and a window, see tx_slots.h),
+ *     with how many of its last sends failed (networkings.h::requestTxSlots)
+ *  2. it stores them in the EEPROM (NVS_KEY_TX_SLOTS), and the failure history starts over
+ *  3. it tells the scheduler to reschedul its events (scheduler.h rescheduleTxTimes): the device sends at its own
+ *     offset into each window, derived from its deviceID.
+ * Also raised by onSendData when too many sends failed (tx_slots.h renegotiation).
  * 
  * Output:
  *  - None.
@@ -420,7 +447,7 @@ void loop()
  *  - None.
  * 
  * Errors:
- *  - communication error
+ *  - communication error, or slots out of range: logged, the current slots are kept
  * 
  * Notes:
  *  1. You may add more constants, functions, classes, etc. as needed.
@@ -434,10 +461,10 @@ void onChangeTxTimes();
  *  - None. If input is needed, you may add input parametrs.
  * 
  * Behaviour:
- *  1. generate a checksum of the log file
- *  2. send the log file to the server.
- *  3. wait for receiving a checksum from the server.
- *  4. if they match send to the server that all is good. if not, log the error and resend the log file
+ *  1. read the binary log file (see log_codec.h)
+ *  2. send the log file to the server, in chunks that each carry their CRC32 (networkings.h::sendChunkedToMainServer)
+ *  3. wait for the server's bitmap of the chunks it received intact.
+ *  4. resend only the missing or corrupt chunks, until the server has them all. after a disconnect it resumes
  *  5. delete the existing logfile
  *  6. create a new logfile
  * 
@@ -462,12 +489,17 @@ void onSendLogFile();
  *  - None. If input is needed, you may add input parametrs.
  * 
  * Behaviour:
- *  1. generate a checksum of the data
- *  2. send the data to the server.
- *  3. wait for receiving a checksum from the server.
- *  4. if they match send to the server that all is good. if not, log the error and resend the data
+ *  1. encode the data
+ *      - the table is encoded with delta + varint compression (see data_codec.h), with a CRC32 trailer over the payload
+ *      - the trailer is checked against the CRC the table kept as records were appended. a mismatch (flash corruption)
+ *        is logged, and the table is sent anyway
+ *  2. send the data to the server, in chunks that each carry their CRC32 (networkings.h::sendChunkedToMainServer)
+ *  3. wait for the server's bitmap of the chunks it received intact.
+ *  4. resend only the missing or corrupt chunks, until the server has them all. after a disconnect it resumes
  *  5. delete the existing data
  *  6. create a new data table
+ * The result is counted in tx_slots.h::txSlotState: a busy server gets the table again after a randomized backoff
+ * (scheduler.h retryTxAt), and too many failures ask the server for other tx slots (EventType::ChangeTxTimes).
  * 
  * Output:
  *  - None.
@@ -484,7 +516,8 @@ void onSendLogFile();
 void onSendData();
 
 /** clock calibration logic
- * Calibration's to be performed after once a 24 hours.
+ * Calibration's to be performed after once a 24 hours. Once the drift is known (clock_drift.h), every
+ * clockDrift.syncIntervalDays(): the CalibrateClock job skips the days in between.
  * 
  * Input:
  *  - None. If input is needed, you may add input parametrs.
@@ -492,8 +525,10 @@ void onSendData();
  * Behaviour:
  *  - ESP32 should have some builtin functions to handle callibrating clock with NTP. it goes something like that:
  *  1. connect to NTP server
- *  2. ask for current time
- *  3. calibrate the inner-clock
+ *  2. ask for current time (networkings.h::requestNtpOffset: how far off the local clock is)
+ *  3. calibrate the inner-clock: step it by the offset, and add the sync to the drift fit, which corrects the
+ *     timestamps and the scheduler's deadlines until the next sync
+ *  4. log the step (LogCode::ClockCalibrated) and the drift rate (LogCode::ClockDrift)
  * 
  * Output:
  *  - None.
@@ -502,7 +537,7 @@ void onSendData();
  *  - None.
  * 
  * Errors:
- *  - connection error, log it
+ *  - connection error, log it (LogCode::NtpUnreachable). the fit keeps correcting the clock
  * 
  * Notes:
  *  1. You may add more constants, functions, classes, etc. as needed.
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "hal.h"
+
+/**
+ * Log-structured, wear-levelled flash storage, shared by the DataTable (data.h), the LogFile (logging.h)
+ * and the uplink backlog (uplink.h).
+ *
+ * All of them are rewritten every day (deleted after every successful send), so erasing their own fixed sectors
+ * would wear those sectors out and add erase latency to every send. Instead:
+ *  - The partition is split into sectors. Every sector belongs to one stream and one epoch of it, written in its header:
+ *      magic (4) | sequence (4) | epoch (2) | stream (1) | 0xFF (1) | CRC32 of the 12 bytes before (4)
+ *  - Data is only ever appended. A stream's content is its sectors of the current epoch, ordered by sequence.
+ *  - Deleting a stream is O(1): its epoch is bumped (in NVS) and its old sectors become garbage. Nothing is erased.
+ *    Deleting what was sent, and keeping what was appended meanwhile, is as cheap: the sender seal()s the stream,
+ *    which returns the sequence of its newest sector, reads up to it, and clearThrough() that sequence once it's
+ *    delivered. The stream's floor (in NVS) goes up to it, and sectors at or below a floor are garbage too.
+ *  - New sectors are taken round-robin from after the newest one, erasing garbage only then,
+ *    so the erases spread evenly over the whole partition.
+ *
+ * One append never spans two sectors. The end of the data in a sector is after its last non-0xFF byte,
+ * so the last byte of an append must never be 0xFF.
+ *
+ * A power cut in the middle of an append leaves part of it at the end of its sector. Only the stream's owner can tell
+ * (the DataTable's records are 3 bytes, the uplink's are framed): it seal()s the stream after mounting, so its next
+ * append starts a new sector, at a record boundary, and the torn bytes stay the last of theirs.
+ *
+ * Threads: the sensor task, loop() and the networkings task all append, clear and read. Every call takes the store's
+ * lock, so two appends never claim the same bytes or the same free sector, and a reader sees an append whole or not
+ * at all. A segment stays valid after the lock is let go: its bytes are never written again, and its sector is only
+ * erased once its stream is cleared, which only the stream's owner does.
+ */
+enum class StreamId : uint8_t { DataTable = 1, LogFile = 2, Uplink = 3 };     // Uplink: the backlog, see uplink.h
+
+/* Part of a stream that's contiguous in the memory-mapped flash */
+struct FlashSegment {
+    const uint8_t *data;
+    uint16_t length;
+    uint32_t sequence;
+};
+
+class FlashLog {
+public:
+    static constexpr uint8_t MAX_SECTORS = 64;
+    static constexpr uint16_t SECTOR_HEADER_SIZE = 16;
+    static constexpr uint16_t MAX_APPEND = hal::FLASH_SECTOR_SIZE - SECTOR_HEADER_SIZE;
+
+    bool mount(const char *label);      // maps the partition and scans the sector headers. call again after a reboot
+    bool isMounted() const;
+    bool append(StreamId stream, const void *data, uint16_t length);    // false if no sector is free
+    void clear(StreamId stream);        // logical delete (epoch bump). no erase
+    // The stream's next append takes a new sector (until the next mount). returns the newest sequence in the stream, 0 if
+    // it's empty: what's there now is the segments up to it, whatever is appended later
+    uint32_t seal(StreamId stream);
+    void clearThrough(StreamId stream, uint32_t sequence);  // logical delete of the segments up to sequence. no erase
+    uint32_t size(StreamId stream) const;   // bytes of the stream's current content
+
+    // The stream's first segment, and the one after a given segment. false when there's no more
+    bool firstSegment(StreamId stream, FlashSegment &segment) const;
+    bool nextSegment(StreamId stream, const FlashSegment &after, FlashSegment &segment) const;
+
+private:
+    struct Sector {
+        uint32_t sequence;
+        uint16_t epoch;
+        uint16_t used;      // bytes after the header
+        uint8_t stream;     // 0: no valid header (erased, or garbage from a torn write)
+        bool erased;        // every byte is 0xFF, can be taken without an erase
+        bool sealed;        // appended to no more: see seal()
+    };
+
+    bool isLive(const Sector &sector, StreamId stream) const;
+    bool findSegment(StreamId stream, uint32_t afterSequence, FlashSegment &segment) const;
+    int16_t writableSector(StreamId stream, uint16_t length) const;
+    int16_t allocateSector(StreamId stream);
+    uint16_t &epochOf(StreamId stream) { return epochs[static_cast<uint8_t>(stream) - 1]; }
+    uint16_t epochOf(StreamId stream) const { return epochs[static_cast<uint8_t>(stream) - 1]; }
+    uint32_t floorOf(StreamId stream) const { return floors[static_cast<uint8_t>(stream) - 1]; }
+
+    mutable std::mutex mutex;       // held by every public call. the private ones run under it
+    hal::FlashPartition partition;
+    Sector sectors[MAX_SECTORS];
+    uint8_t sectorCount = 0;
+    uint32_t lastSequence = 0;
+    int16_t newestSector = -1;
+    uint16_t epochs[3] = {0, 0, 0};
+    uint32_t floors[3] = {0, 0, 0};
+};
+
+extern FlashLog flashStore;     // on the STORAGE_PARTITION (see config.h), mounted in setup()
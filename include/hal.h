@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "types.h"
+
+#ifdef ARDUINO
+#include <esp_attr.h>
+#define HAL_ISR IRAM_ATTR   // interrupt handlers must live in IRAM, they may run while the flash cache is off
+// kept in RTC memory across deep sleep, zeroed on power-up. plain data only: no lock, no heap pointer
+#define HAL_RTC_DATA RTC_DATA_ATTR
+#else
+#define HAL_ISR
+#define HAL_RTC_DATA
+#endif
+
+/**
+ * Hardware abstraction layer.
+ * All the firmware logic talks to the hardware (and to the Arduino / FreeRTOS / ESP-IDF APIs) only through these functions,
+ * so the same logic builds for the ESP32-C3 and for the host:
+ *  - src/hal_esp32.cpp: the real backend (ARDUINO is defined)
+ *  - src/hal_native.cpp: simulated backends for the `native` environment. They're driven by the functions in hal_sim.h.
+ *
+ * On the host the clock is simulated: sleeping advances it instantly, so a simulated day runs in milliseconds.
+ *
+ * Keep this layer thin - no logic here, only the smallest primitives the logic needs.
+ */
+namespace hal {
+
+/* ---- clock ---- */
+uint32_t millis();                      // since boot
+uint64_t micros();                      // since boot
+uint32_t cpuCycles();                   // free-running, a couple of instructions to read. wraps every ~27 s at 160 MHz
+void sleepMs(uint32_t ms);              // yields to other tasks (on the host, advances the simulated clock)
+uint32_t epochSeconds();                // wall clock, UTC+0. 0 if it was never set
+void setEpochSeconds(uint32_t seconds);
+
+/* ---- one-shot timers ----
+ * The handler runs in the timer task (on the host: inside the sleep that reaches the expiry), so keep it short:
+ * typically it signals the task that does the work. */
+using TimerHandler = void (*)(void *arg);
+int timerCreate(TimerHandler handler, void *arg);      // -1 if there's no timer left
+void timerStartOnce(int timer, uint64_t delayUs);      // (re)arms it, replacing an expiry not reached yet
+void timerStop(int timer);
+
+/* ---- tasks ---- */
+using TaskFunction = void (*)(void *arg);
+bool startTask(TaskFunction function, const char *name, uint32_t stackBytes, uint8_t priority, void *arg = nullptr);   // function must never return
+
+/* ---- GPIO ---- */
+using InterruptHandler = void (*)();
+void pinModeOutput(gpio pin);
+void pinModeInput(gpio pin, bool pullUp);
+void digitalWrite(gpio pin, bool high);
+bool digitalRead(gpio pin);
+void attachFallingEdgeInterrupt(gpio pin, InterruptHandler handler);   // mark the handler HAL_ISR. the pin wakes the CPU from light sleep
+void detachInterrupt(gpio pin);
+
+/* ---- ADC ---- */
+uint32_t analogReadMilliVolts(gpio pin);   // calibrated reading of the pin voltage (before any external divider)
+
+/* ---- HX711 load-cell ADC (pins from config.h: HX711_DOUT, HX711_SCK) ---- */
+void loadCellBegin();
+bool loadCellIsReady();                 // DOUT is low: a conversion is waiting to be read. ISR-safe
+int32_t loadCellReadRaw();              // one signed 24 bit conversion, channel A gain 128. call only when ready. ISR-safe
+void loadCellPowerDown();
+void loadCellPowerUp();
+
+/* ---- NVS (non-volatile key-value storage, the ESP32's EEPROM) ---- */
+bool nvsGet(const char *key, void *value, size_t length);          // false if the key is missing or has another length
+bool nvsSet(const char *key, const void *value, size_t length);
+bool nvsErase(const char *key);
+bool nvsCommit();                                                   // makes the previous sets durable across power loss
+
+/* ---- flash partitions (see partitions.csv) ----
+ * Memory-mapped for reading, so data can be read in place without copying it to RAM.
+ * NOR flash semantics: erasing sets a whole sector to 0xFF, and writing can only clear bits (1 -> 0). */
+constexpr uint32_t FLASH_SECTOR_SIZE = 4096;
+
+class FlashPartition {
+public:
+    bool open(const char *label);       // finds and maps the partition. false if there's no such partition
+    bool isOpen() const { return mapped != nullptr; }
+    uint32_t size() const { return length; }
+    const uint8_t *data() const { return mapped; }
+    bool write(uint32_t offset, const void *data, uint32_t count);
+    bool eraseSector(uint32_t sector);
+
+private:
+    const uint8_t *mapped = nullptr;
+    uint32_t length = 0;
+    const void *handle = nullptr;       // the backend's partition handle
+};
+
+/* ---- Wi-Fi station ---- */
+struct WifiAccessPoint {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+};
+
+struct WifiLease {          // IPv4 addresses, as the driver stores them
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t netmask;
+    uint32_t dns;
+};
+
+uint8_t wifiScan(WifiAccessPoint *found, uint8_t capacity);    // all channels. the strongest first
+// Without an access point the driver scans for the SSID first; without a lease it asks DHCP for one
+bool wifiConnect(const char *ssid, const char *password, const WifiAccessPoint *accessPoint, const WifiLease *lease,
+                 uint32_t timeoutMs);
+bool wifiLease(WifiLease &lease);       // the connection's addresses. false if not connected
+void wifiDisconnect();                  // and turns the radio off
+
+/* ---- TCP sockets ---- */
+constexpr int INVALID_SOCKET = -1;
+int socketConnect(const char *host, uint16_t port, uint32_t timeoutMs);    // INVALID_SOCKET on failure
+int32_t socketSend(int socket, const void *data, size_t length);            // bytes sent, -1 on error
+int32_t socketReceive(int socket, void *buffer, size_t length, uint32_t timeoutMs);    // bytes received, 0 on timeout, -1 on error
+void socketClose(int socket);
+
+/* ---- NTP ---- */
+// One SNTP exchange with the server: its time minus the local clock (epochSeconds), ms, halfway through the round trip
+bool ntpOffsetMs(const char *server, uint32_t timeoutMs, int64_t &offsetMs);
+
+/* ---- device secrets ---- */
+// 32 bytes unique to the device and secret. On the ESP32: the HMAC of a label under an eFuse key block software can't
+// read (VAULT_EFUSE_KEY_ID). false while no key is burnt into it: nothing else on the chip is both unique and secret
+bool deviceKey(uint8_t key[32]);
+void randomBytes(void *buffer, size_t length);     // from the hardware RNG
+
+/* ---- serial (the USB port, onSetup's console) ---- */
+void serialBegin(uint32_t baud);
+size_t serialRead(char *buffer, size_t capacity);  // what has arrived, up to capacity. never waits: 0 if nothing has
+void serialWrite(const char *text, size_t length);
+
+}  // namespace hal
@@ -0,0 +1,119 @@
+#pragma once
+
+#ifndef ARDUINO
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+/**
+ * Controls for the simulated hardware behind hal.h on the host (`native` environment only).
+ * Tests and benchmarks use these to set what the "hardware" sees, and to inspect what the firmware did.
+ */
+namespace hal {
+namespace sim {
+
+// Puts every simulated peripheral back to power-on state (clock at 0, empty NVS, no peer, ...)
+void reset();
+
+/* ---- clock ---- */
+void advanceMs(uint32_t ms);
+void advanceUs(uint64_t us);
+void setClockDriftPpm(int32_t ppm);     // how much faster than the simulated time the local clock runs (slower if < 0)
+
+/* ---- NTP ----
+ * The NTP server tells the simulated time, from ntpEpochSeconds at the moment it's set, with a round trip of
+ * NTP_ROUND_TRIP_MS. 0: no server answers. Like the sockets, it needs a Wi-Fi connection (hal::wifiConnect) */
+constexpr uint32_t NTP_ROUND_TRIP_MS = 40;
+void setNtpTime(uint32_t epochSeconds);
+uint32_t ntpQueryCount();
+
+/* ---- serial ----
+ * A terminal on the other end of the port: what's typed arrives after a delay, and what the firmware writes is kept
+ * (up to SERIAL_OUTPUT_CAPACITY bytes, the rest is dropped) until it's read */
+constexpr size_t SERIAL_OUTPUT_CAPACITY = 8192;
+void serialType(const char *text, uint32_t afterMs = 0);   // arrives whole, afterMs from now
+std::string serialOutput();             // written since the last call
+uint32_t serialLastWriteMs();           // when the firmware last wrote, ms since boot
+
+/* ---- one-shot timers ---- */
+uint32_t timerFireCount();              // expiries so far: each one is a CPU wakeup
+
+/* ---- GPIO ---- */
+void setPinLevel(gpio pin, bool high);  // an input driven from outside. a high-to-low change fires an attached interrupt
+bool pinLevel(gpio pin);                // the level the firmware wrote to an output
+uint32_t pinWriteCount(gpio pin);       // how many times the firmware wrote the pin
+
+/* ---- ADC ---- */
+using AnalogSource = uint32_t (*)(gpio pin, uint32_t nowMs);
+void setAnalogMilliVolts(gpio pin, uint32_t milliVolts);   // every read of the pin returns this value
+void setAnalogSource(AnalogSource source);              // or every read of any pin asks this function, e.g. for noise
+
+/* ---- HX711 ----
+ * A bit-bang model of the chip: while powered it converts every sample period and pulls DOUT low, firing the DOUT
+ * interrupt, and each SCK rising edge shifts the next bit out on DOUT. Only the conversions pull DOUT low: on the ESP32 the
+ * data bits fire the interrupt too, and find DOUT high after the read. */
+constexpr uint32_t LOAD_CELL_SAMPLE_PERIOD_MS = 100;    // HX711 at 10 samples per second (RATE pin low)
+using LoadCellSource = int32_t (*)(uint32_t nowMs);
+void setLoadCellRaw(int32_t raw);                       // every conversion returns this value
+void setLoadCellSource(LoadCellSource source);          // or asks this function for the value at the current time
+void setLoadCellConnected(bool connected);              // false: DOUT floats high, no conversion ever comes
+uint32_t loadCellReads();                               // complete reads (25 SCK pulses)
+bool loadCellPoweredDown();
+
+/* ---- NVS ---- */
+void powerCycle();                      // drops everything set since the last nvsCommit, like a power cut would
+uint32_t nvsCommitCount();
+// The next `writes` NVS sets, erases and commits go through, then the power is gone: the later ones fail and change
+// nothing, until powerCycle()
+void cutPowerAfterNvsWrites(uint32_t writes);
+bool isPowerCut();
+
+/* ---- device secrets ---- */
+void setDeviceKey(const uint8_t key[32]);   // nullptr: none, as with no eFuse key burnt. reset() puts back the host's
+
+/* ---- flash ---- */
+void setFlashPartition(const char *label, uint32_t size);  // (re)creates the partition, fully erased
+uint32_t flashEraseCount(const char *label, uint32_t sector);
+uint32_t flashBytesWritten(const char *label);
+
+/* ---- Wi-Fi ----
+ * The access points in range, and a timing model of the driver: a scan takes WIFI_SCAN_MS_PER_CHANNEL on each channel,
+ * joining an access point WIFI_JOIN_MS and asking DHCP for a lease WIFI_DHCP_MS. A connect without an access point
+ * scans first. A connect to an access point that isn't there (moved to another channel, gone) takes its whole timeout. */
+constexpr uint8_t WIFI_CHANNELS = 13;
+constexpr uint32_t WIFI_JOIN_MS = 160;      // authentication, association and the WPA2 4-way handshake
+constexpr uint32_t WIFI_DHCP_MS = 1200;     // DISCOVER to ACK, and the ARP probe of the address
+struct AccessPoint {
+    const char *ssid;
+    const char *password;
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+};
+void addAccessPoint(const AccessPoint &accessPoint);
+void removeAccessPoints();
+uint32_t wifiScanCount();               // scans, the firmware's and the driver's own
+uint32_t wifiDhcpCount();
+
+/* ---- sockets ---- */
+/* The remote side of every simulated connection (the main server, an NTP server, ...), reached only while Wi-Fi is
+ * connected (hal::wifiConnect).
+ * Whatever is appended to `reply` is what the firmware will receive next. */
+class SocketPeer {
+public:
+    virtual ~SocketPeer() = default;
+    virtual bool onConnect(const char *host, uint16_t port) = 0;     // false refuses the connection
+    virtual void onReceive(int socket, const uint8_t *data, size_t length, std::vector<uint8_t> &reply) = 0;
+    virtual void onClose(int socket) { (void) socket; }
+};
+void setSocketPeer(SocketPeer *peer);
+void dropSocket(int socket);            // the link breaks: the next send / receive on it fails
+
+}  // namespace sim
+}  // namespace hal
+
+#endif
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "types.h"
+
+/**
+ * LED patterns (see types.h LEDPatternType), compiled at build time into tables of (level, duration) steps,
+ * and the engine that plays them back from a one-shot timer.
+ *
+ * Patterns are written in Morse: '.' is a dot, '-' a dash, ' ' the gap between letters. morse() turns the string into
+ * steps: the LED is on for a dot (LED_DOT_MS) or a dash (3 dots), off for a dot between symbols and for 3 dots between
+ * letters, and the pattern ends with its last symbol. Consecutive steps never have the same level, so every step
+ * boundary is an edge.
+ *
+ * LedEngine drives several LEDs from one timer: it's armed for the next edge of any of them, so the display task
+ * sleeps between edges and never blocks in a delay. Each LED plays one pattern at a time:
+ *  - a request at least as urgent (priority not larger) preempts the playing pattern. a preempted repeating pattern
+ *    (e.g. RunningSetup) waits, and resumes when the urgent one ends
+ *  - a less urgent request waits until the playing pattern ends (or forever, behind a repeating one)
+ * Only one pattern waits per LED: the most urgent, the newest among equals.
+ * The engine isn't synchronized: it belongs to the display task (see display.h).
+ */
+
+constexpr uint16_t LED_DOT_MS = 200;
+
+struct LedStep {
+    bool on;
+    uint16_t durationMs;
+};
+
+struct LedPatternSpec {
+    const LedStep *steps;
+    uint8_t count;
+    bool repeat;            // starts over at the end, until another pattern takes the LED
+    uint8_t priority;       // smaller is more urgent, like Queue
+};
+
+// How many steps morse(code) makes: an on step per symbol, and the gaps between them
+template<size_t N>
+constexpr size_t morseStepCount(const char (&code)[N]) {
+    size_t symbols = 0;
+    for (size_t i = 0; i + 1 < N; i++) {
+        symbols += code[i] == '.' || code[i] == '-' ? 1 : 0;
+    }
+    return symbols > 0 ? symbols * 2 - 1 : 0;
+}
+
+template<size_t STEPS, size_t N>
+constexpr std::array<LedStep, STEPS> morse(const char (&code)[N]) {
+    std::array<LedStep, STEPS> steps{};
+    size_t count = 0;
+    uint16_t gapMs = LED_DOT_MS;
+    for (size_t i = 0; i + 1 < N; i++) {
+        if (code[i] == ' ') {
+            gapMs = 3 * LED_DOT_MS;
+        } else if (code[i] == '.' || code[i] == '-') {
+            if (count > 0) {
+                steps[count++] = LedStep{false, gapMs};
+            }
+            steps[count++] = LedStep{true, static_cast<uint16_t>(code[i] == '.' ? LED_DOT_MS : 3 * LED_DOT_MS)};
+            gapMs = LED_DOT_MS;
+        }
+    }
+    return steps;
+}
+
+const LedPatternSpec &ledPattern(LEDPatternType type);
+
+class LedEngine {
+public:
+    static constexpr uint8_t MAX_LEDS = 4;
+
+    LedEngine(const gpio *pins, uint8_t count);
+    bool begin(void (*onTimer)(void *arg), void *arg);  // the timer's handler must get onTimer() called, e.g. by the display task
+    void play(uint8_t led, LEDPatternType type);        // None turns the LED off and drops what's waiting
+    void stop(uint8_t led, LEDPatternType type);        // ends it if it's playing (or waiting), e.g. RunningSetup when setup is done
+    void onTimer();                                     // plays the edges that are due, and re-arms the timer
+    LEDPatternType playing(uint8_t led) const { return led < count ? leds[led].playing : LEDPatternType::None; }
+
+private:
+    struct Led {
+        gpio pin;
+        LEDPatternType playing = LEDPatternType::None;
+        LEDPatternType waiting = LEDPatternType::None;
+        uint8_t step = 0;
+        uint64_t stepEndsUs = 0;
+        bool on = false;
+    };
+
+    void write(Led &led, bool on);
+    void start(Led &led, LEDPatternType type, uint64_t nowUs);
+    void wait(Led &led, LEDPatternType type);
+    void finish(Led &led, uint64_t nowUs);
+    void arm(uint64_t nowUs);
+
+    Led leds[MAX_LEDS];
+    uint8_t count;
+    int timer = -1;
+};
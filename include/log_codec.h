@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "types.h"
+
+/**
+ * Binary format of the log file (see logging.h). Every entry is an event code, the HHmm it happened at,
+ * and an optional number (a battery level, a byte count...), in 2 to 7 bytes:
+ *
+ *      byte 0          bits 5..0: LogCode, bits 7..6: payload size (0: none, 1: 1 byte, 2: 2 bytes, 3: 4 bytes)
+ *      payload         0, 1, 2 or 4 bytes, little endian
+ *      last 2 bytes    minute of day (0-1439), little endian
+ *
+ * The minute comes last because its high byte is at most 5: an entry never ends with 0xFF, as the flash store needs.
+ * The text of the codes lives in the decoder only, which renders the file as the server shows it:
+ *
+ *      deviceID: 42
+ *
+ *      date: 17/10/2026
+ *      1234 battery 3912 mV
+ */
+
+/* Everything that's logged. Values are on flash and on the server: append new codes, never renumber. At most 64. */
+enum class LogCode : uint8_t {
+    DeviceId,                   // payload: deviceID. the first entry of every file
+    Date,                       // payload: days since 1970-01-01 (UTC)
+    LogFileFull,                // the last entry of a full file
+    SetupStarted,
+    SetupDone,
+    Activated,
+    Deactivated,
+    StatusCheck,
+    BatteryMilliVolts,          // payload: mV
+    BatteryLow,                 // payload: mV
+    MainServerUnreachable,
+    NtpUnreachable,
+    LoadCellNotResponding,
+    LoadCellCalibrated,         // payload: plate weight, g
+    LoadCellCalibrationFailed,
+    TxTimesChanged,             // payload: the two tx minutes of day, first << 16 | second
+    SendingData,                // payload: bytes
+    SendingLogFile,             // payload: bytes
+    SendOk,
+    ChecksumMismatch,
+    CommError,
+    ClockCalibrated,            // payload: correction, s (signed)
+    ClockCalibrationFailed,
+    Reboot,                     // payload: reset reason
+    EventTiming,                // payload: EventType << 28 | runs << 20 | slowest run, ms. see event_dispatch.h
+    DaysToEmpty,                // payload: days, at the average current since start. see energy.h
+    BatteryTrend,               // payload: mV per day (signed). see battery.h
+    MainServerBusy,             // payload: the backoff before the retry, s. see tx_slots.h
+    ClockDrift,                 // payload: the RTC's drift, ppm (signed), positive if it runs slow. see clock_drift.h
+    VaultLocked,                // no device key: the stored Wi-Fi networks can't be read. see credential_vault.h
+    Count                       // not a code
+};
+
+struct LogEntry {
+    LogCode code;
+    recordTimeType minute;      // of day, UTC
+    bool hasPayload;
+    uint32_t payload;
+};
+
+constexpr size_t MIN_LOG_ENTRY_SIZE = 3;
+constexpr size_t MAX_LOG_ENTRY_SIZE = 7;
+
+// Encodes an entry into out (at least MAX_LOG_ENTRY_SIZE bytes). The payload takes as few bytes as its value needs.
+size_t encodeLogEntry(const LogEntry &entry, uint8_t *out);
+
+// Decodes the entry at the start of bytes. returns its length, 0 if it's truncated or not a valid entry
+size_t decodeLogEntry(const uint8_t *bytes, size_t length, LogEntry &entry);
+
+#ifndef ARDUINO
+// The host-side decoder: renders a whole binary log file as text, '\0' terminated.
+// returns the text's length, or 0 if the log is corrupt or the text doesn't fit in capacity
+size_t renderLogFile(const uint8_t *log, size_t length, char *text, size_t capacity);
+#endif
@@ -1,5 +1,10 @@
 # pragma once
 
+#include <cstddef>
+#include <mutex>
+
+#include "flash_log.h"
+#include "log_codec.h"
 #include "types.h"
 
 /**
@@ -20,29 +25,52 @@
  * <here all data should be listed, see onCheckDeviceStatus for more info>
  */
 
-/** Here there's a problem that should be adressed:
- * It's prefered that the data is kept on the flash (4MB) but it's there with other stuff.
- * So after all code is done, should check how much space is left.
+/** Flash space:
+ * The log file is the LogFile stream of the flash store (see flash_log.h), next to the DataTable,
+ * so both share the wear levelling and deleting it is O(1). It takes up to `size` bytes of it (LOG_FILE_SIZE).
+ *
+ * It's binary: every row is a LogCode, its HHmm and an optional number, 3 to 7 bytes (see log_codec.h),
+ * where the same row as text takes 20-40 bytes. The text is rendered on the host, by renderLogFile.
+ * The deviceID and the dates are rows too. Dates are UTC seconds since 1970 (see dateType).
  */
-
 class LogFile {
     public:
-        LogFile(uint16_t size);     // size of the file
-        void createLogFile();
-        void addLogRow(const char *msg);
-        void addDate(dateType date);
-        const char *readLogFile();
-        void deleteLogFile();
+        LogFile(uint16_t size, FlashLog &store = flashStore);  // size of the file
+        bool createLogFile();           // mounts the flash store if needed. a log that's already there (e.g. before a reboot) is kept
+        bool addLogRow(LogCode code);   // at the current HHmm. adds the date first when the day changed. false if full
+        bool addLogRow(LogCode code, uint32_t payload);
+        bool addDate(dateType date);
+        // copies the binary file out of flash, up to a sequence seal() returned. returns its length
+        size_t readLogFile(uint8_t *buffer, size_t capacity, uint32_t through = UINT32_MAX) const;
+        void deleteLogFile();           // and creates a new, clean one
+        // The file so far, to send while more is logged: rows from now on start a file of their own, with its
+        // deviceID and date rows. returns the flash store's sequence it ends at
+        uint32_t seal();
+        void deleteThrough(uint32_t through);   // the sealed file, once sent. what's been logged since is kept
+        uint32_t length() const;
 
     private:
-        bool isFull();  // should alert right before it's full and log message: "logfile is full, yet more info is tried to be logged"
+        bool create();
+        bool appendDate(dateType date);
+        bool beginRow(uint32_t now);    // the rows a new file or a new day needs first
+        bool isFull(size_t entryLength) const;  // keeps room for the LogFileFull row, which is logged once, right before it's full
+        bool appendEntry(const LogEntry &entry);
+
+        FlashLog &store;
+        uint16_t size;
+        uint32_t bytesUsed = 0;
+        uint32_t lastDay = UINT32_MAX;  // of the last date row. unknown after a reboot
+        bool fullLogged = false;
+        bool headerDue = false;         // sealed: the next row starts a new file
+        mutable std::mutex mutex;       // every task logs. held by the public calls
 };
 
+extern LogFile logFile;     // the device's log file, LOG_FILE_SIZE bytes
+
 /** what should be logged:
  * any event with HHmm timestamp, any error - critical or not - with HHmm timestamp
  * including when transmitting data \ log file to server (log the transmission before transmitting - allows follow up if communication fails) 
  * 
- * to shorten the file, codes may be used instead of strings.
- * list all the possible log info in an enum class but be sure you know what each value is mapping to.
- * This will be later decoded in the server.
+ * to shorten the file, codes are used instead of strings: LogCode (log_codec.h) lists all the possible log info,
+ * and renderLogFile maps them back to text. The server decodes the file the same way.
  */
\ No newline at end of file
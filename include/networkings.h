@@ -1,5 +1,10 @@
 # pragma once
 
+#include <cstddef>
+#include <cstdint>
+
+#include "types.h"
+
 /** 
  * should handle all networkings ins and outs with all connected parties:
  *  - connect to wifi network
@@ -15,4 +20,57 @@
  * Also note, that esp32 has fairly good api for this, so when implementing functions, there's no need to "reinvent the wheel".
  */
 
-void networkings();
\ No newline at end of file
+void networkings();     // runs the MQTT uplink (uplink.h) over wifi_link.h: drains its backlog when asked, and retries with backoff
+
+/* Messages to the main server: [MessageType, 1 byte][payload length, 4 bytes little endian][payload] */
+enum class MessageType : uint8_t {
+    DataTable = 1, LogFile = 2, ChecksumOk = 3, ChecksumMismatch = 4, Status = 5,
+    TransferOffer = 6, TransferChunk = 7,   // see sendChunkedToMainServer
+    TxSlots = 8,                            // see requestTxSlots
+};
+// A Status payload's first byte says what it holds: STATUS_EVENT_TIMINGS (event_dispatch.h), STATUS_ENERGY (energy.h)
+
+struct TransferStats {
+    uint32_t bytesSent = 0;         // message headers included
+    uint32_t bytesReceived = 0;
+    uint16_t roundTrips = 0;
+    uint16_t chunksSent = 0;
+    uint8_t connects = 0;
+    bool busy = false;              // the server replied it's busy
+    uint16_t retryAfterS = 0;       // and when to come back, at the soonest
+};
+
+/** Sends a payload to the main server in chunks, resending only what didn't arrive intact
+ * The payload is split into TRANSFER_CHUNK_SIZE chunks (the last one shorter), sent as messages of their own:
+ *  - TransferOffer: [transfer id, 4][type, 1][payload length, 4][chunk size, 2][chunk count, 2]
+ *    the server replies with the chunks it has: [transfer id, 4][chunk count, 2][bitmap, 1 bit per chunk, LSB first]
+ *    or, while it's taking too many devices at once, that it's busy: [transfer id, 4][0, 2][retry after, s, 2]
+ *  - TransferChunk: [transfer id, 4][sequence, 2][CRC32 of the chunk, 4][chunk]
+ *    the server keeps a chunk only if its CRC matches, and replies nothing
+ * Each round offers the transfer and streams every chunk the bitmap misses, until it's full: 2 round trips on a good link.
+ * The transfer id is the CRC32 of the type, length and payload, so a transfer cut by a disconnect (or a reboot) resumes
+ * from the chunks the server kept as long as the payload is the same. Numbers are little endian.
+ *
+ * Input:
+ *  - MessageType type, const uint8_t *payload, size_t length: up to TRANSFER_MAX_CHUNKS chunks
+ *  - TransferStats *stats: added to, if given
+ *
+ * Output:
+ *  - bool: true once the server has every chunk. false if it can't be reached, it's busy (stats->busy), or it's still
+ *    missing chunks after MAX_SEND_ATTEMPTS connections of TRANSFER_MAX_ROUNDS rounds each
+ */
+bool sendChunkedToMainServer(MessageType type, const uint8_t *payload, size_t length, TransferStats *stats = nullptr);
+
+/** Asks the main server for this device's tx slots (tx_slots.h)
+ * Request: TxSlots [failed sends among the last TX_HISTORY_LENGTH, 1]. The server can move a device that fails often.
+ * Reply: 2 * [start minute of day, 2][window, s, 2], little endian.
+ * Output:
+ *  - bool: false on a communication error. slots is set only on true
+ */
+bool requestTxSlots(uint8_t failures, TxSlot slots[2]);
+
+/** Asks the NTP server (NVS_KEY_NTP_SERVER, NTP_DEFAULT_SERVER if there's none) how far off the local clock is
+ * Output:
+ *  - bool: false if it doesn't answer in NTP_TIMEOUT_MS. offsetMs, NTP - local, is set only on true
+ */
+bool requestNtpOffset(int64_t &offsetMs);
@@ -1,22 +1,146 @@
 #pragma once
 
+#include <cstdint>
+#include <new>
+#include <utility>
 
-/** Queue 
- * implement the Queue class
- * 
- * Note that since it'll be used for several different tasks (messages, events, etc.) T will be replaced with the corresponding type
- * Also note, that in order to prevent dynamic allocation, the queue is set to a maximal size - capacity. 
+
+/** Queue
+ * A fixed-capacity priority queue, implemented as a binary min-heap.
+ *
+ * Note that since it'll be used for several different tasks (messages, events, etc.) T will be replaced with the corresponding type.
+ * T must have a `priority` member (smaller priority is more urgent).
+ * Items with the same priority are dequeued in the order they were enqueued (FIFO).
+ *
+ * Also note, that in order to prevent dynamic allocation, the queue is set to a maximal size - CAPACITY -
+ * which is a template parameter, so the storage is a plain array inside the object (no heap allocation).
+ *
+ * Complexity: enqueue / dequeue are O(log n), peek / size / isEmpty are O(1).
+ * The queue itself is not synchronized. Items coming from other tasks should arrive through an EventRing (see event_ring.h).
 */
-template<typename T>
+template<typename T, uint16_t CAPACITY>
 class Queue {
 public:
-    Queue(uint8_t capacity);
-    void enqueue(const T &item);
-    T dequeue();
-    bool isEmpty();
+    static_assert(CAPACITY > 0, "Queue capacity must be positive");
+
+    Queue() = default;
+    ~Queue();
+    Queue(const Queue &) = delete;
+    Queue &operator=(const Queue &) = delete;
+
+    bool tryEnqueue(const T &item);     // never blocks. returns false (and drops the item) if the queue is full
+    void enqueue(const T &item);        // same as tryEnqueue, for callers that don't care about an overflow
+    T dequeue();                        // the queue must not be empty
+    bool tryDequeue(T &item);           // returns false if the queue is empty
+    const T &peek() const;              // the most urgent item, without removing it. the queue must not be empty
+    uint16_t size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    static constexpr uint16_t capacity() { return CAPACITY; }
 
 private:
-    bool isFull();
-    void sortByPriority();
+    struct Slot {
+        T item;
+        uint32_t order;     // enqueue sequence number, breaks ties between equal priorities
+    };
+
+    bool isFull() const { return count == CAPACITY; }
+    static bool isBefore(const Slot &a, const Slot &b);
+    Slot &slot(uint16_t index) { return *std::launder(reinterpret_cast<Slot *>(storage) + index); }
+    const Slot &slot(uint16_t index) const { return *std::launder(reinterpret_cast<const Slot *>(storage) + index); }
+    void siftUp(uint16_t index);
+    void siftDown(uint16_t index);
+
+    // raw storage, so T doesn't have to be default-constructible (e.g. LEDPattern)
+    alignas(Slot) unsigned char storage[CAPACITY * sizeof(Slot)];
+    uint16_t count = 0;
+    uint32_t nextOrder = 0;
 };
 
+template<typename T, uint16_t CAPACITY>
+Queue<T, CAPACITY>::~Queue() {
+    for (uint16_t i = 0; i < count; i++) {
+        slot(i).~Slot();
+    }
+}
+
+template<typename T, uint16_t CAPACITY>
+bool Queue<T, CAPACITY>::isBefore(const Slot &a, const Slot &b) {
+    if (a.item.priority != b.item.priority) {
+        return a.item.priority < b.item.priority;
+    }
+    // signed difference keeps the FIFO order correct when nextOrder wraps around
+    return static_cast<int32_t>(a.order - b.order) < 0;
+}
+
+template<typename T, uint16_t CAPACITY>
+bool Queue<T, CAPACITY>::tryEnqueue(const T &item) {
+    if (isFull()) {
+        return false;
+    }
+    new (&slot(count)) Slot{item, nextOrder++};
+    count++;
+    siftUp(count - 1);
+    return true;
+}
+
+template<typename T, uint16_t CAPACITY>
+void Queue<T, CAPACITY>::enqueue(const T &item) {
+    (void) tryEnqueue(item);
+}
+
+template<typename T, uint16_t CAPACITY>
+T Queue<T, CAPACITY>::dequeue() {
+    T item = std::move(slot(0).item);
+    count--;
+    if (count > 0) {
+        slot(0) = std::move(slot(count));
+        siftDown(0);
+    }
+    slot(count).~Slot();
+    return item;
+}
+
+template<typename T, uint16_t CAPACITY>
+bool Queue<T, CAPACITY>::tryDequeue(T &item) {
+    if (isEmpty()) {
+        return false;
+    }
+    item = dequeue();
+    return true;
+}
+
+template<typename T, uint16_t CAPACITY>
+const T &Queue<T, CAPACITY>::peek() const {
+    return slot(0).item;
+}
+
+template<typename T, uint16_t CAPACITY>
+void Queue<T, CAPACITY>::siftUp(uint16_t index) {
+    while (index > 0) {
+        uint16_t parent = (index - 1) / 2;
+        if (!isBefore(slot(index), slot(parent))) {
+            break;
+        }
+        std::swap(slot(index), slot(parent));
+        index = parent;
+    }
+}
+
+template<typename T, uint16_t CAPACITY>
+void Queue<T, CAPACITY>::siftDown(uint16_t index) {
+    while (true) {
+        uint32_t left = 2 * static_cast<uint32_t>(index) + 1;
+        if (left >= count) {
+            break;
+        }
+        uint16_t child = static_cast<uint16_t>(left);
+        if (left + 1 < count && isBefore(slot(left + 1), slot(left))) {
+            child = static_cast<uint16_t>(left + 1);
+        }
+        if (!isBefore(slot(child), slot(index))) {
+            break;
+        }
+        std::swap(slot(index), slot(child));
+        index = child;
+    }
+}
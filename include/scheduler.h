@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstdint>
+
+#include "event_ring.h"
+#include "queue.h"
+#include "types.h"
+
 /**
  * This handles shceduling
  * Note that esp32, in order to track time, cannot be in deepsleep, but timers are active in deepsleep.
@@ -9,4 +15,73 @@
  * (https://docs.espressif.com/projects/esp-idf/en/stable/esp32c3/api-reference/system/system_time.html)
  */
 
-void scheduler();
\ No newline at end of file
+/** Scheduler
+ * Every periodic job has one timer in a min-heap (the Queue, keyed by the deadline), so the next wakeup is the heap's top
+ * and the device sleeps until then. Deadlines are UTC epoch seconds, of the drift-corrected clock (clock_drift.h epochNow):
+ *  - Sense: every senseInterval, on the interval's boundaries (so readings fall on whole minutes).
+ *    SenseMode::Adaptive changes the interval between readings (setSenseInterval)
+ *  - TxFirst, TxSecond: daily, at the two tx times set by onChangeTxTimes
+ *  - CalibrateClock: daily, at CALIBRATE_CLOCK_SECOND_OF_DAY. The scheduler task raises the event only every
+ *    clockDrift.syncIntervalDays()
+ *  - CheckDeviceStatus: every STATUS_CHECK_INTERVAL_S, counted from start
+ *  - TxRetry: once, when a busy main server's backoff ends (setTxRetry, tx_slots.h). start() doesn't schedule it
+ *
+ * Timer coalescing: a wakeup runs every job due within `slack` seconds after it, early, instead of waking up again
+ * for each of them. A job that ran early keeps its grid: its next deadline counts from the nominal one, not from now.
+ * When the device was asleep (or the clock jumped) past several deadlines, a job runs once and skips the missed ones.
+ */
+enum class Job : uint8_t { Sense, TxFirst, TxSecond, CalibrateClock, CheckDeviceStatus, TxRetry, Count };
+constexpr uint8_t JOB_COUNT = static_cast<uint8_t>(Job::Count);
+
+struct SchedulerConfig {
+    uint32_t senseIntervalS;
+    uint32_t txSecondsOfDay[2];         // UTC
+    uint32_t calibrateClockSecondOfDay;
+    uint32_t statusCheckIntervalS;
+    uint32_t slackS;                    // 0: no coalescing
+};
+
+class Scheduler {
+public:
+    explicit Scheduler(const SchedulerConfig &config) : config(config) {}
+    void start(uint32_t nowS);          // (re)schedules every enabled job from now
+    void setTxTimes(uint32_t firstSecondOfDay, uint32_t secondSecondOfDay, uint32_t nowS);
+    void setEnabled(Job job, bool enabled, uint32_t nowS);  // e.g. no sensing while the device isn't active
+    void setSenseInterval(uint32_t intervalS);  // the next reading is the first new boundary after the last one that ran
+    void setTxRetry(uint32_t atS);      // one TxRetry at atS, instead of any pending one
+    bool hasJobs() const { return !timers.isEmpty(); }
+    uint32_t nextWakeup() const { return timers.peek().priority; }     // there must be jobs
+    uint8_t runDue(uint32_t nowS, Job *due);    // takes the jobs due by now + slack (JOB_COUNT at most) and reschedules them
+
+private:
+    struct Timer {
+        Job job;
+        uint32_t priority;  // the deadline, epoch seconds. sooner is more urgent
+    };
+
+    uint32_t firstDeadline(Job job, uint32_t nowS) const;
+    uint32_t nextDeadline(Job job, uint32_t deadline, uint32_t nowS) const;
+    void schedule(Job job, uint32_t nowS);
+    void unschedule(Job job);
+
+    SchedulerConfig config;
+    Queue<Timer, JOB_COUNT> timers;
+    bool disabled[JOB_COUNT] = {};
+    uint32_t lastSenseS = 0;            // the deadline of the last Sense that ran, 0 before the first one
+};
+
+/* The scheduler task: sleeps until the next wakeup, then runs the due jobs.
+ * Sense wakes getLoadCellData (sensors.h) through senseDue, the others raise their event (events.h).
+ * The tx jobs also wake the networkings task to flush the uplink backlog (uplink.h). */
+void scheduler();
+
+extern RingParker senseDue;
+
+// Thread-safe. Called by onChangeTxTimes once the new tx slots are in NVS, wakes the scheduler task to reschedule
+void rescheduleTxTimes();
+
+// Thread-safe. Called by onSendData when the main server is busy: SendData is raised again at atS (epoch seconds)
+void retryTxAt(uint32_t atS);
+
+// Thread-safe. Called by getLoadCellData when SenseMode::Adaptive changes the interval, wakes the scheduler task to reschedule
+void changeSenseInterval(uint32_t intervalS);
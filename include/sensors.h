@@ -1,14 +1,28 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+
+#include "config.h"
+#include "types.h"
+
 /** Process responsible for obtaining and logging load-cell readings
  * Input:
- *  - bool isActive: collect data only when device is active
+ *  - none: collect data only when device is active. device_status.h getIsActive is read at every interval, since
+ *    the device is activated (and deactivated) while the task runs
  * 
  * Behaviour:
  *  1. read (digital) data from the input pins. see config.h constants about HX711 for more info.
  *      - validate input is not corrupted
  *  2. log to the sensor-table with HHmm (24 hours format, no ":") timestamp. see data.h for more info.
- *  3. sleep until the next interval (config.h senseInterval)
+ *  3. sleep until the next interval (config.h senseInterval): wait on scheduler.h senseDue, which the scheduler signals then
+ *
+ * Sampling (see sampleLoadCell below): at each interval the HX711 is powered up for a burst of conversions. Its DOUT falling
+ * edge interrupt reads each one into a fixed ring, and the task sleeps through the burst, so nothing polls the chip and the
+ * CPU sleeps between samples. Then the ring is reduced to one reading with config.h LOAD_CELL_FILTER.
+ *
+ * config.h SENSE_MODE picks which readings are stored: every one (EveryInterval), or only the changes (Adaptive, see
+ * AdaptiveSampler below), which also senses less often while the weight doesn't move.
  * 
  * Output:
  *  - void: No output
@@ -17,7 +31,132 @@
  *  1. You may add more constants, functions, classes, etc. as needed.
  *  2. This process isn't on the main process (aka, void loop) to make sure no gaps, that may result from other processes, will appear in the data.
  */
-void getLoadCellData(bool isActive);
+void getLoadCellData();
+
+/** SampleRing
+ * The samples of one burst, written by the DOUT interrupt handler. When full, a new sample overwrites the oldest one.
+ * Single producer (the ISR), single consumer, which reads only after the HX711 is powered down and the ISR can't run.
+ */
+template<uint16_t CAPACITY>
+class SampleRing {
+public:
+    void push(int32_t sample) {
+        uint32_t position = written.load(std::memory_order_relaxed);
+        samples[position % CAPACITY] = sample;
+        written.store(position + 1, std::memory_order_release);
+    }
+    uint16_t count() const {
+        uint32_t total = written.load(std::memory_order_acquire);
+        return static_cast<uint16_t>(total < CAPACITY ? total : CAPACITY);
+    }
+    uint16_t copyTo(int32_t *out) const {      // oldest first, returns the count
+        uint32_t total = written.load(std::memory_order_acquire);
+        uint16_t length = count();
+        for (uint16_t i = 0; i < length; i++) {
+            out[i] = samples[(total - length + i) % CAPACITY];
+        }
+        return length;
+    }
+    void clear() { written.store(0, std::memory_order_relaxed); }
+
+private:
+    int32_t samples[CAPACITY] = {};
+    std::atomic<uint32_t> written{0};
+};
+
+/** Reduces `count` (> 0) raw samples to one value. Reorders `samples`.
+ *  - Mean: cheapest, but a single spike (something brushing the plate) moves it
+ *  - Median: ignores up to half the samples being off, but keeps only one sample's worth of noise filtering
+ *  - TrimmedMean: drops config.h LOAD_CELL_TRIM_PERCENT of the samples from each end, then averages the rest
+ */
+int32_t reduceSamples(int32_t *samples, uint16_t count, SampleFilter filter);
+
+/** One burst: powers the HX711 up, sleeps while the interrupt collects the samples, powers it down and reduces them.
+ * Blocks for (settleSamples + LOAD_CELL_RING_LENGTH + 1) sample periods.
+ * driftCounts, if given, gets how far the mean of the burst's second half is from its first half's.
+ * False if fewer than half the samples came in (the HX711 isn't responding). */
+bool sampleLoadCell(SampleFilter filter, int32_t &raw, uint8_t settleSamples = LOAD_CELL_SETTLE_SAMPLES,
+                    int32_t *driftCounts = nullptr);
+
+/** AdaptiveSampler
+ * Decides, reading by reading, which ones SenseMode::Adaptive stores and how long until the next one.
+ * Like the legacy handleNewWeightData:
+ *  - a reading within deadBandGrams of the last stored one is no real change (smallDelta)
+ *  - a reading settleBandGrams or more away from the previous one means the weight is still moving (largeDelta):
+ *    someone is throwing something in. it's stored once it settles
+ * A settled change is stored, and so are the first reading and, heartbeatMinutes after the last stored record, an
+ * unchanged one: the server tells a quiet bin from a silent device by it, and holds the last value in between.
+ * Readings come every activeIntervalS from a movement until quietReadings of them in a row were quiet,
+ * then every idleIntervalS until the next movement.
+ */
+struct AdaptiveConfig {
+    weightType deadBandGrams;
+    weightType settleBandGrams;
+    uint16_t heartbeatMinutes;
+    uint32_t activeIntervalS;
+    uint32_t idleIntervalS;
+    uint8_t quietReadings;
+};
+
+class AdaptiveSampler {
+public:
+    explicit AdaptiveSampler(const AdaptiveConfig &config) : config(config) {}
+    bool onReading(const Record &reading);      // true: store it
+    uint32_t intervalS() const { return quiet < config.quietReadings ? config.activeIntervalS : config.idleIntervalS; }
+
+private:
+    AdaptiveConfig config;
+    bool hasStored = false;
+    Record lastStored = {0, 0};
+    weightType previous = 0;    // the last reading, stored or not
+    uint8_t quiet = 0;          // quiet readings in a row, up to config.quietReadings
+};
+
+struct LoadCellCalibration {    // stored in NVS under NVS_KEY_LOAD_CELL_CAL
+    int32_t tareRaw;            // the empty plate
+    float countsPerGram;
+};
+LoadCellCalibration loadCellCalibration();  // from NVS, or the config.h defaults
+weightType rawToGrams(int32_t raw, const LoadCellCalibration &calibration);    // rounded, clamped to 0..MAX_RECORD_WEIGHT
+
+/** Cold and warm starts of the load cell
+ * The legacy setupLoadcell() started the HX711 with LoadCell.start(2000, true): 2 s of stabilisation and a tare, at every
+ * start. A reading here doesn't tare (the tare comes with the calibration, see onCalibrateLoadCell), and starts one of
+ * two ways:
+ *  - Cold, after a power-up or a failed drift check: the calibration is read from NVS, and the burst drops
+ *    LOAD_CELL_COLD_SETTLE_SAMPLES conversions first, the legacy stabilisation time, while the bridge and the HX711
+ *    warm up from unpowered
+ *  - Warm, after a wakeup from deep sleep: the calibration is the copy a cold start left in RTC memory, and the burst
+ *    drops only LOAD_CELL_SETTLE_SAMPLES, the HX711's settling time after its power down (400 ms at 10 SPS)
+ * A warm reading is checked for drift. If its burst's halves are more than LOAD_CELL_DRIFT_COUNTS apart (not settled),
+ * or it reads more than that below the tare (the offset moved), it's dropped and a cold start follows at once.
+ *
+ * Awake time per reading, with the timing model of the simulated HX711 (see bench_sensors.cpp):
+ *
+ *      legacy start(2000, true)    2000 ms + a 16 sample tare + the burst     5300 ms
+ *      cold                        (20 + 16 + 1) sample periods               3700 ms
+ *      warm                        (4 + 16 + 1) sample periods                2100 ms
+ */
+enum class LoadCellStart : uint8_t { Cold, Warm };
+
+struct LoadCellWarmState {      // in RTC memory: kept across deep sleep, zeroed on power-up
+    uint32_t magic;             // LOAD_CELL_WARM_MAGIC once a cold start filled it
+    LoadCellCalibration calibration;
+};
+extern LoadCellWarmState loadCellWarmState;
+constexpr uint32_t LOAD_CELL_WARM_MAGIC = 0x4C435752;  // "LCWR"
+
+struct LoadCellReading {
+    int32_t raw;
+    weightType grams;
+    LoadCellStart start;        // how the reading that counted started
+    bool driftFallback;         // a warm start failed its drift check first
+};
+
+// A reading, warm if the state allows it. False if the HX711 isn't responding
+bool readLoadCell(SampleFilter filter, LoadCellReading &reading, LoadCellWarmState &state = loadCellWarmState);
+// The next reading starts cold, e.g. after a new calibration was stored
+void invalidateLoadCellWarmState(LoadCellWarmState &state = loadCellWarmState);
 
 /** Invoked by other functions, responsible for obtaining battery power (in Volts)
  * Input:
@@ -26,9 +165,10 @@ void getLoadCellData(bool isActive);
  * Behaviour:
  *  1. read (analog) data from the input pin. see config.h constants about battery power for more info.
  *      - validate input is not corrupted
+ *  The reading is battery.h's batteryMonitor: oversampled, filtered, and skipped while the radio is on
  * 
  * Output:
- *  - float: power in volts
+ *  - float: power in volts, filtered. 0 until the first valid reading
  * 
  * Notes:
  *  1. You may add more constants, functions, classes, etc. as needed.
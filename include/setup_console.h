@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config.h"
+#include "wifi_link.h"
+
+/**
+ * The serial console of onSetup.
+ *
+ * All its memory is in the object, allocated once (setupConsole): the line being typed, the tokens, as pointers into
+ * it, and the settings being edited. Nothing is allocated on the heap, so no session fragments it. poll() never waits:
+ * it takes what has arrived on the serial port, edits the line (backspace, Ctrl-U, arrow keys ignored), echoes it, and
+ * runs the line once it's complete. run() polls, sleeping CONSOLE_POLL_MS in between, so the other tasks keep running
+ * while the user types.
+ *
+ * A line is a command and its arguments, split on spaces. Double quotes keep the spaces of an argument (an SSID).
+ * The commands edit a copy of the stored settings. NVS is only written by `save` and `done`:
+ *      help                        the commands
+ *      show                        the settings (the SSIDs, not the passwords)
+ *      wifi add <ssid> <password>  up to WIFI_MAX_NETWORKS. "" for an open network
+ *      wifi del <ssid> [<ssid>...]
+ *      server <ip>                 the main server, dotted IPv4
+ *      ntp <ip>                    the NTP server. NTP_DEFAULT_SERVER until it's set
+ *      plate <grams>               the weighing plate's weight, within [PLATE_TOL_MIN, PLATE_TOL_MAX]
+ *      save                        writes the settings
+ *      done                        saves, and ends the session. needs a network, the server and the plate
+ * An invalid line is reported and changes nothing.
+ *
+ * The passwords go to the credential vault (credential_vault.h). The console loads only the stored SSIDs, and a
+ * password typed in is held in RAM until it's saved: then it's sealed into the vault and wiped.
+ */
+
+constexpr size_t IP_TEXT_LENGTH = 16;       // "255.255.255.255" and its terminator, as NVS keeps the IPs
+
+class SetupConsole {
+public:
+    struct Settings {
+        WifiNetwork networks[WIFI_MAX_NETWORKS];    // an empty SSID is a free slot
+        uint8_t sealed;                             // bit i: networks[i] is in the vault, its password isn't here
+        char serverIp[IP_TEXT_LENGTH];              // empty: not set
+        char ntpServer[IP_TEXT_LENGTH];
+        float plateGrams;                           // 0: not set
+    };
+
+    enum class Reply : uint8_t {
+        Ok,
+        Error,      // reported to the user, nothing changed
+        Done,       // the session ends
+    };
+
+    void begin();                           // mounts the vault, loads the stored settings, prints the banner and the prompt
+    bool poll();                            // handles what has arrived, never waits. false once `done` ended the session
+    bool run(uint32_t idleTimeoutMs);       // polls until `done` (true), or until nothing arrived for idleTimeoutMs (false)
+    Reply execute(char *text);              // runs a line (split in place), as if it was typed
+    const Settings &settings() const { return edited; }
+
+private:
+    void handle(char c);
+    void endLine();
+
+    char line[CONSOLE_LINE_LENGTH] = {};
+    uint8_t length = 0;
+    bool overflowed = false;    // the line outgrew the buffer: it's dropped at its end
+    bool afterCr = false;       // a LF right after a CR ends no second line
+    uint8_t escape = 0;         // into an escape sequence (an arrow key): 1 after ESC, 2 after ESC [
+    bool finished = false;
+    uint32_t lastInputMs = 0;
+    Settings edited = {};
+};
+
+extern SetupConsole setupConsole;
+
+/** The console's validators and tokenizer, for the commands and their tests */
+
+// "a.b.c.d", each 0-255, decimal digits only and no leading zeros (an octal 010 would mean 8 to some parsers)
+bool parseIpv4(const char *text, uint8_t octets[4]);
+
+// a weight in grams, "250" or "250.5": digits and at most one point, within [PLATE_TOL_MIN, PLATE_TOL_MAX]
+bool parsePlateWeight(const char *text, float &grams);
+
+// Splits text in place, on spaces: tokens point into it. A double-quoted token may hold spaces (the quotes are
+// dropped), "" is an empty token. Returns the count, or -1 if there are more than capacity or a quote isn't closed
+int8_t tokenize(char *text, char *tokens[], uint8_t capacity);
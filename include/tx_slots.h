@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include "config.h"
+#include "types.h"
+
+/**
+ * Tx slots: when in the day a device sends its data to the main server, and what it does when the server is too busy.
+ *
+ * The server hands out two tx slots (onChangeTxTimes), each a start minute and a window. A device sends at its own
+ * offset into the window, a hash of its deviceID, so the devices sharing a slot spread evenly over the window instead of
+ * all connecting in the same second, and each keeps its offset from day to day (the server knows when to expect it).
+ * Until the server sends slots, DEFAULT_TX_SLOTS are windows of DEFAULT_TX_WINDOW_S from DEFAULT_TX_MINUTES.
+ *
+ * Busy: the server answers an offer with a busy reply (networkings.h) while it's taking too many devices at once.
+ * Retrying at a fixed delay would send back together every device it turned away together. Instead, the n-th busy
+ * reply in a row waits the server's retry-after hint, then a random [1/2, 1] of TX_BACKOFF_BASE_S * 2^(n-1) (at most
+ * TX_BACKOFF_MAX_S): the more often a device collides, the wider it spreads its retry. After TX_BACKOFF_ATTEMPTS busy
+ * replies in a row, the table waits for the next tx time.
+ *
+ * Renegotiation: the results of the last TX_HISTORY_LENGTH sends are kept. TX_RENEGOTIATE_FAILURES failures among
+ * them mean the slot is crowded: onChangeTxTimes asks the server for other slots, with the failure count as a hint.
+ */
+
+constexpr TxSlot DEFAULT_TX_SLOTS[2] = {{DEFAULT_TX_MINUTES[0], DEFAULT_TX_WINDOW_S},
+                                        {DEFAULT_TX_MINUTES[1], DEFAULT_TX_WINDOW_S}};
+
+// The device's offset into a slot's window, s: the same every day, and uniform over the window across deviceIDs
+uint32_t txJitterS(uint32_t deviceId, uint8_t slot, uint16_t windowS);
+
+// When the device sends in its slot (0 or 1), second of day (UTC)
+uint32_t txSecondOfDay(const TxSlot &slot, uint8_t index, uint32_t deviceId);
+
+bool isValidTxSlot(const TxSlot &slot);     // starts within the day, and its window is shorter than a day
+void loadTxSlots(TxSlot slots[2]);          // from NVS, DEFAULT_TX_SLOTS until the server sent valid ones
+bool storeTxSlots(const TxSlot slots[2]);   // false if either isn't valid, and nothing is stored
+
+class TxSlotState {
+public:
+    constexpr TxSlotState() {}      // constant initialised, so the RTC copy isn't overwritten at a wakeup
+
+    // The result of a send of the table, at a tx time or a retry. busy: the server replied so, with its retry-after
+    // hint. returns the seconds to wait before retrying, 0 for no retry (delivered, failed otherwise, or out of attempts)
+    uint32_t onSend(bool delivered, bool busy, uint16_t retryAfterS, uint32_t deviceId, uint32_t nowS);
+
+    uint8_t busyInARow() const { return busy; }
+    uint8_t failures() const;       // among the last TX_HISTORY_LENGTH sends
+    bool shouldRenegotiate() const { return failures() >= TX_RENEGOTIATE_FAILURES; }
+    void renegotiated();            // the server sent new slots: their history starts over
+    void reset();
+
+private:
+    uint8_t history = 0;    // bit i: the i-th send back failed
+    uint8_t sends = 0;      // in the history, up to TX_HISTORY_LENGTH
+    uint8_t busy = 0;
+};
+
+extern TxSlotState txSlotState;     // the device's, in RTC memory
@@ -3,10 +3,13 @@
 
 using gpio = uint8_t;               // GPIO pin number. GPIO stands for General-Purpose Input/Output
 using recordTimeType = uint16_t;    // time in minutes. ranges from 0 (= 00:00) to 1439 (= 23:59). see data.h
-using weightType = uint16_t;        // weight in integer grams. ranges from 0 to 65,535 (= 65.535 kg). see data.h
-using dateType = uint32_t;
+using weightType = uint32_t;        // weight in integer grams. ranges from 0 to 131,070 (= 131.07 kg, 17 bits on flash). see data.h
+using dateType = uint32_t;          // UTC seconds since 1970-01-01. see logging.h
 
 enum class EventType : uint8_t { Setup, Activate, Deactivate, CheckDeviceStatus, CalibrateLoadCell, ChangeTxTimes, SendLogFile, SendData, CalibrateClock};
+constexpr uint8_t EVENT_TYPE_COUNT = static_cast<uint8_t>(EventType::CalibrateClock) + 1;
+enum class SenseMode : uint8_t { EveryInterval, Adaptive };         // which readings are stored. see sensors.h
+enum class SampleFilter : uint8_t { Mean, Median, TrimmedMean };   // how a burst of HX711 samples becomes one reading. see sensors.h
 enum class DisplayMode : uint8_t { ComputerOnly, LEDOnly, Both };
 enum class LEDPatternType : uint8_t {
     None,                   // No light. Used when not called or when nothing to display
@@ -39,6 +42,16 @@ struct LEDPattern {
     LEDPattern(LEDPatternType ledPatternType) : ledPatternType(ledPatternType) {}
 };
 
+struct DischargePoint { // for battery.h
+    uint16_t milliVolts;    // battery voltage at rest
+    uint8_t percent;        // of the rated capacity left
+};
+
+struct TxSlot { // for tx_slots.h
+    recordTimeType startMinute;     // of day, UTC
+    uint16_t windowS;               // devices spread their sends over this long from the start. 0: all at the start
+};
+
 struct Record { // for data.h
     recordTimeType recordTime;
     weightType weight;
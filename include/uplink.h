@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config.h"
+#include "event_ring.h"
+#include "flash_log.h"
+#include "networkings.h"
+
+/**
+ * The MQTT uplink: batched, pipelined publishing to the broker, with an on-flash backlog.
+ *
+ * Every radio wakeup pays the Wi-Fi connect and the broker's CONNECT round trip, so messages aren't sent when
+ * they're made. enqueue() appends them to the backlog, the Uplink stream of the FlashLog, and flush() sends the
+ * whole backlog in one connection:
+ *  - Records are coalesced into as few PUBLISH frames as MQTT_MAX_PACKET_SIZE allows. Each frame's payload is a
+ *    batch of records: [type, 1][sequence, varint][flags, 1][length, varint][bytes]
+ *  - Frames are QoS 1 and pipelined: a window of up to MQTT_MAX_INFLIGHT is sent before waiting for its PUBACKs,
+ *    so the round trips per flush are the CONNACK and one per window of frames.
+ *  - The session is persistent (clean session off), so the broker keeps the device's subscriptions and queued
+ *    messages for it between connections.
+ *  - The backlog is only cleared once every frame was acknowledged. After a failure (no Wi-Fi, no broker, a broken
+ *    link) it stays on flash, across reboots, and the next flush is after an exponential backoff:
+ *    UPLINK_BACKOFF_MIN_S, doubling up to UPLINK_BACKOFF_MAX_S.
+ *  - A flush seals the backlog when it starts, and sends and clears only what was enqueued before that.
+ *
+ * Delivery is at least once: a flush that broke after some PUBACKs sends those records again. Every record has a
+ * sequence number that keeps counting across flushes (its base is in NVS), so the server drops the duplicates.
+ *
+ * The payload of a message longer than UPLINK_CHUNK_SIZE is split into records; flags bit 0 marks its last one.
+ * enqueue may run while another task flushes, since the FlashLog is locked. flush runs on one task only.
+ *
+ * Only the status messages go this way. The data table and the log file are sent at the device's tx slots with
+ * the chunked, checksummed transfers of networkings.h: those slots spread the fleet over the server, with busy
+ * replies and backoff (see tx_slots.h), and the broker wouldn't keep to them.
+ */
+
+class Uplink {
+public:
+    enum class Result : uint8_t {
+        Sent,       // the backlog was published and cleared
+        Empty,      // nothing to send
+        Waiting,    // backing off after a failure, until retryAtS()
+        Failed,     // kept for later, backing off
+    };
+
+    struct Stats {
+        uint32_t connects = 0;
+        uint32_t publishes = 0;     // PUBLISH frames
+        uint32_t records = 0;       // records acknowledged
+        uint32_t bytesSent = 0;     // MQTT bytes, headers included
+        uint32_t bytesReceived = 0;
+        uint32_t roundTrips = 0;    // waits for the broker: the CONNACK, and every wait for a PUBACK
+    };
+
+    explicit Uplink(FlashLog &store) : store(store) {}
+
+    bool load();        // reads the sequence base from NVS, seals a torn backlog. call after the store is mounted
+    bool enqueue(MessageType type, const uint8_t *payload, size_t length);  // false if the backlog is full
+    Result flush(uint32_t nowS);    // sends the backlog if it's not backing off
+    uint32_t retryAtS() const { return retryAt; }   // 0 when not backing off
+    uint32_t backlogBytes() const { return store.size(StreamId::Uplink); }
+    uint32_t nextSequence() const { return sequenceBase; }  // of the backlog's first record
+    const Stats &stats() const { return counters; }
+
+private:
+    bool publishBacklog(int socket, uint32_t through, uint32_t &records);
+    bool publish(int socket, const uint8_t *batch, uint16_t length);
+    bool awaitInflight(int socket);     // every PUBACK of the window, in order
+    void backOff(uint32_t nowS);
+
+    FlashLog &store;
+    uint32_t sequenceBase = 0;
+    uint32_t retryAt = 0;
+    uint32_t backoffS = 0;          // 0: the last flush went through
+    uint16_t nextPacketId = 1;
+    uint16_t inflight[MQTT_MAX_INFLIGHT];    // packet ids waiting for their PUBACK, oldest first
+    uint8_t inflightCount = 0;
+    Stats counters;
+};
+
+extern Uplink uplink;   // on flashStore, flushed by the networkings task
+extern RingParker uplinkDue;    // wakes the networkings task to flush the backlog, e.g. at the tx times
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "config.h"
+#include "energy.h"
+#include "hal.h"
+
+/**
+ * The Wi-Fi connection manager of the networkings task.
+ *
+ * A full connect scans every channel (~1.6 s) and asks DHCP for a lease (~1 s) before the first byte can be sent,
+ * at each of the daily transmissions. WifiLink remembers, per stored network, the access point it last joined (BSSID
+ * and channel) and the lease DHCP gave it, in RTC memory, so it survives deep sleep. connect() then:
+ *  1. Fast path: joins the last good network's cached access point directly, without a scan, giving up after
+ *     WIFI_FAST_CONNECT_TIMEOUT_MS. While the cached lease is younger than WIFI_LEASE_REUSE_S it's reused as a static IP,
+ *     skipping DHCP too; an older one is renewed through DHCP.
+ *  2. On a miss (the access point moved to another channel, or is gone) its cache entry is dropped, and it falls back to
+ *     a scan: it joins the strongest access point of any stored network, by BSSID and channel, and caches it.
+ * Power-up zeroes RTC memory, and the cache is only trusted with its magic word, so a cold boot takes the slow path.
+ *
+ * With a credential vault (credential_vault.h), the networks come without their passwords: each join decrypts the one
+ * password it needs, right before hal::wifiConnect, and wipes it after.
+ *
+ * Sharing: the loop() task (the main server, NTP) and the networkings task (the MQTT uplink) each need the link for a
+ * session, at times the same one (a tx time raises SendData and wakes the uplink together). A session holds the link
+ * (WifiHold): the first holder connects, the others wait for that connect and share it, and the last one to let go
+ * disconnects. No session can switch the radio off under another.
+ *
+ * With an energy ledger (energy.h), the radio is on in it from the first hold's connect to the last release, held by
+ * the first holder's task, so the whole of it is booked, whichever session uses it.
+ */
+
+class CredentialVault;
+
+struct WifiNetwork {        // as stored by onSetup. an empty SSID is a free slot
+    char ssid[33];
+    char password[65];
+};
+
+struct WifiCacheEntry {
+    uint32_t ssidHash;      // CRC32 of the SSID, so a network deleted or replaced by onSetup isn't taken for another
+    hal::WifiAccessPoint accessPoint;
+    hal::WifiLease lease;
+    uint32_t leaseAtS;      // when DHCP gave it, epoch seconds. 0: no lease
+};
+
+struct WifiCache {
+    uint32_t magic;
+    uint8_t lastGood;       // the network the fast path tries
+    WifiCacheEntry entries[WIFI_MAX_NETWORKS];  // by the network's place in the stored list
+};
+
+class WifiLink {
+public:
+    enum class Path : uint8_t {
+        None,       // not connected
+        Cached,     // the fast path
+        Scanned,    // the slow path
+    };
+
+    struct Stats {
+        uint32_t fastHits = 0;
+        uint32_t fastMisses = 0;
+        uint32_t scans = 0;
+        uint32_t failures = 0;  // no stored network could be joined
+    };
+
+    // vault: where the passwords are. nullptr: in the networks given to connect. ledger: told when the radio is on
+    explicit WifiLink(WifiCache &cache, CredentialVault *vault = nullptr, EnergyLedger *ledger = nullptr)
+        : cache(cache), vault(vault), ledger(ledger) {}
+    bool connect(const WifiNetwork *networks, uint8_t count, uint32_t nowS);
+    void disconnect();
+    // connect() for the first holder, shared by the ones after it. false (not held) if no network could be joined
+    bool acquire(const WifiNetwork *networks, uint8_t count, uint32_t nowS, EnergyTask holder);
+    void release();                 // disconnect() once the last holder lets go
+    uint8_t holders() const { return holding; }
+    Path lastPath() const { return path; }
+    const Stats &stats() const { return counters; }
+
+private:
+    bool connectCached(const WifiNetwork *networks, uint8_t count, uint32_t nowS);
+    bool connectScanned(const WifiNetwork *networks, uint8_t count, uint32_t nowS);
+    bool join(const WifiNetwork &network, const hal::WifiAccessPoint *accessPoint, const hal::WifiLease *lease,
+              uint32_t timeoutMs);
+    void remember(uint8_t index, const WifiNetwork &network, const hal::WifiAccessPoint &accessPoint, uint32_t nowS);
+
+    WifiCache &cache;
+    CredentialVault *vault;
+    EnergyLedger *ledger;
+    std::mutex mutex;               // for acquire and release: held through a connect, so a second session waits for it
+    uint8_t holding = 0;
+    Path path = Path::None;
+    Stats counters;
+};
+
+extern WifiCache wifiCache;     // in RTC memory
+extern WifiLink wifiLink;
+
+// The device's link (wifiLink), to the stored networks, held for the scope of one session with the main server, the
+// MQTT broker or NTP, by the task it runs on. isUp(): false if no stored network could be joined
+class WifiHold {
+public:
+    explicit WifiHold(EnergyTask holder);
+    ~WifiHold();
+    WifiHold(const WifiHold &) = delete;
+    WifiHold &operator=(const WifiHold &) = delete;
+    bool isUp() const { return held; }
+
+private:
+    bool held;
+};
+
+// The stored networks, packed to the front, from the credential vault: their SSIDs only. returns how many
+uint8_t loadWifiNetworks(WifiNetwork networks[WIFI_MAX_NETWORKS]);
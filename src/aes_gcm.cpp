@@ -0,0 +1,298 @@
+#include "aes_gcm.h"
+
+#include <cstring>
+
+#ifdef ARDUINO
+
+AesGcm::AesGcm() {
+    mbedtls_gcm_init(&context);
+}
+
+AesGcm::~AesGcm() {
+    mbedtls_gcm_free(&context);
+}
+
+void AesGcm::setKey(const uint8_t key[AES_GCM_KEY_SIZE]) {
+    mbedtls_gcm_setkey(&context, MBEDTLS_CIPHER_ID_AES, key, AES_GCM_KEY_SIZE * 8);
+}
+
+void AesGcm::seal(const uint8_t nonce[AES_GCM_NONCE_SIZE], const void *aad, size_t aadLength, const void *plain,
+                  size_t length, void *cipher, uint8_t tag[AES_GCM_TAG_SIZE]) {
+    mbedtls_gcm_crypt_and_tag(&context, MBEDTLS_GCM_ENCRYPT, length, nonce, AES_GCM_NONCE_SIZE,
+                              static_cast<const unsigned char *>(aad), aadLength, static_cast<const unsigned char *>(plain),
+                              static_cast<unsigned char *>(cipher), AES_GCM_TAG_SIZE, tag);
+}
+
+bool AesGcm::open(const uint8_t nonce[AES_GCM_NONCE_SIZE], const void *aad, size_t aadLength, const void *cipher,
+                  size_t length, const uint8_t tag[AES_GCM_TAG_SIZE], void *plain) {
+    if (mbedtls_gcm_auth_decrypt(&context, length, nonce, AES_GCM_NONCE_SIZE, static_cast<const unsigned char *>(aad),
+                                 aadLength, tag, AES_GCM_TAG_SIZE, static_cast<const unsigned char *>(cipher),
+                                 static_cast<unsigned char *>(plain)) != 0) {
+        std::memset(plain, 0, length);
+        return false;
+    }
+    return true;
+}
+
+#else
+
+namespace {
+
+constexpr uint8_t BLOCK = 16;
+constexpr uint8_t ROUNDS = 14;      // AES-256
+
+constexpr uint8_t rotl8(uint8_t x, int shift) {
+    return static_cast<uint8_t>(x << shift | x >> (8 - shift));
+}
+
+constexpr uint8_t xtime(uint8_t x) {    // x * 2 in GF(2^8)
+    return static_cast<uint8_t>(x << 1 ^ ((x & 0x80) != 0 ? 0x1B : 0));
+}
+
+constexpr uint32_t rotr32(uint32_t x, int shift) {
+    return shift == 0 ? x : x >> shift | x << (32 - shift);
+}
+
+// the S-box, and the round tables: tables[k][x] is the MixColumns column of S(x), rotated by k bytes, so a round is
+// 16 lookups and XORs
+struct AesTables {
+    uint8_t sbox[256];
+    uint32_t rounds[4][256];
+};
+
+constexpr AesTables makeAesTables() {
+    AesTables tables{};
+    uint8_t p = 1;
+    uint8_t q = 1;
+    do {    // p runs through every non-zero element (powers of 3), q through their inverses
+        p = static_cast<uint8_t>(p ^ xtime(p));
+        q = static_cast<uint8_t>(q ^ q << 1);
+        q = static_cast<uint8_t>(q ^ q << 2);
+        q = static_cast<uint8_t>(q ^ q << 4);
+        if ((q & 0x80) != 0) {
+            q ^= 0x09;
+        }
+        tables.sbox[p] = static_cast<uint8_t>(q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63);
+    } while (p != 1);
+    tables.sbox[0] = 0x63;
+    for (uint32_t x = 0; x < 256; x++) {
+        uint8_t s = tables.sbox[x];
+        uint32_t column = static_cast<uint32_t>(xtime(s)) << 24 | static_cast<uint32_t>(s) << 16 |
+                          static_cast<uint32_t>(s) << 8 | static_cast<uint8_t>(xtime(s) ^ s);
+        for (int k = 0; k < 4; k++) {
+            tables.rounds[k][x] = rotr32(column, 8 * k);
+        }
+    }
+    return tables;
+}
+
+constexpr AesTables AES = makeAesTables();
+static_assert(AES.sbox[0x00] == 0x63 && AES.sbox[0x01] == 0x7C && AES.sbox[0x53] == 0xED && AES.sbox[0xFF] == 0x16,
+              "wrong AES S-box");
+
+// x * P^4 mod the GHASH polynomial, for the nibble shifted out: the reduction of a 4 bit step
+constexpr uint16_t GHASH_REDUCE[16] = {
+    0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+    0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0,
+};
+
+uint32_t load32(const uint8_t *bytes) {
+    return static_cast<uint32_t>(bytes[0]) << 24 | static_cast<uint32_t>(bytes[1]) << 16 |
+           static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+}
+
+void store32(uint8_t *bytes, uint32_t value) {
+    bytes[0] = static_cast<uint8_t>(value >> 24);
+    bytes[1] = static_cast<uint8_t>(value >> 16);
+    bytes[2] = static_cast<uint8_t>(value >> 8);
+    bytes[3] = static_cast<uint8_t>(value);
+}
+
+uint64_t load64(const uint8_t *bytes) {
+    return static_cast<uint64_t>(load32(bytes)) << 32 | load32(bytes + 4);
+}
+
+void store64(uint8_t *bytes, uint64_t value) {
+    store32(bytes, static_cast<uint32_t>(value >> 32));
+    store32(bytes + 4, static_cast<uint32_t>(value));
+}
+
+uint32_t subWord(uint32_t word) {
+    return static_cast<uint32_t>(AES.sbox[word >> 24]) << 24 | static_cast<uint32_t>(AES.sbox[word >> 16 & 0xFF]) << 16 |
+           static_cast<uint32_t>(AES.sbox[word >> 8 & 0xFF]) << 8 | AES.sbox[word & 0xFF];
+}
+
+void xorBlock(uint8_t *into, const uint8_t *from, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        into[i] ^= from[i];
+    }
+}
+
+// nonce || counter, the 12 byte nonce's counter blocks
+void counterBlock(const uint8_t nonce[AES_GCM_NONCE_SIZE], uint32_t counter, uint8_t block[BLOCK]) {
+    std::memcpy(block, nonce, AES_GCM_NONCE_SIZE);
+    store32(block + AES_GCM_NONCE_SIZE, counter);
+}
+
+}  // namespace
+
+AesGcm::AesGcm() = default;
+
+AesGcm::~AesGcm() {
+    volatile uint32_t *keys = roundKeys;    // volatile: wiped even though nothing reads them after
+    for (size_t i = 0; i < sizeof(roundKeys) / sizeof(roundKeys[0]); i++) {
+        keys[i] = 0;
+    }
+}
+
+void AesGcm::setKey(const uint8_t key[AES_GCM_KEY_SIZE]) {
+    constexpr uint8_t KEY_WORDS = AES_GCM_KEY_SIZE / 4;
+    for (uint8_t i = 0; i < KEY_WORDS; i++) {
+        roundKeys[i] = load32(key + 4 * i);
+    }
+    uint8_t rcon = 0x01;
+    for (uint8_t i = KEY_WORDS; i < 4 * (ROUNDS + 1); i++) {
+        uint32_t word = roundKeys[i - 1];
+        if (i % KEY_WORDS == 0) {
+            word = subWord(word << 8 | word >> 24) ^ static_cast<uint32_t>(rcon) << 24;
+            rcon = xtime(rcon);
+        } else if (i % KEY_WORDS == 4) {
+            word = subWord(word);
+        }
+        roundKeys[i] = roundKeys[i - KEY_WORDS] ^ word;
+    }
+
+    // H = E(0), and its multiples by every nibble: the 4 bit GHASH table
+    uint8_t h[BLOCK] = {};
+    encryptBlock(h, h);
+    uint64_t high = load64(h);
+    uint64_t low = load64(h + 8);
+    tableHigh[0] = 0;
+    tableLow[0] = 0;
+    tableHigh[8] = high;
+    tableLow[8] = low;
+    for (uint8_t i = 4; i > 0; i >>= 1) {
+        uint64_t carry = (low & 1) != 0 ? 0xE1000000ULL << 32 : 0;
+        low = high << 63 | low >> 1;
+        high = high >> 1 ^ carry;
+        tableHigh[i] = high;
+        tableLow[i] = low;
+    }
+    for (uint8_t i = 2; i <= 8; i *= 2) {
+        for (uint8_t j = 1; j < i; j++) {
+            tableHigh[i + j] = tableHigh[i] ^ tableHigh[j];
+            tableLow[i + j] = tableLow[i] ^ tableLow[j];
+        }
+    }
+}
+
+void AesGcm::seal(const uint8_t nonce[AES_GCM_NONCE_SIZE], const void *aad, size_t aadLength, const void *plain,
+                  size_t length, void *cipher, uint8_t tag[AES_GCM_TAG_SIZE]) {
+    crypt(nonce, static_cast<const uint8_t *>(plain), length, static_cast<uint8_t *>(cipher));
+    uint8_t hash[BLOCK];
+    ghash(static_cast<const uint8_t *>(aad), aadLength, static_cast<const uint8_t *>(cipher), length, hash);
+    uint8_t block[BLOCK];
+    counterBlock(nonce, 1, block);
+    encryptBlock(block, tag);
+    xorBlock(tag, hash, AES_GCM_TAG_SIZE);
+}
+
+bool AesGcm::open(const uint8_t nonce[AES_GCM_NONCE_SIZE], const void *aad, size_t aadLength, const void *cipher,
+                  size_t length, const uint8_t tag[AES_GCM_TAG_SIZE], void *plain) {
+    uint8_t expected[BLOCK];
+    ghash(static_cast<const uint8_t *>(aad), aadLength, static_cast<const uint8_t *>(cipher), length, expected);
+    uint8_t block[BLOCK];
+    counterBlock(nonce, 1, block);
+    encryptBlock(block, block);
+    uint8_t difference = 0;     // every byte compared, so the time doesn't tell how much of the tag was right
+    for (uint8_t i = 0; i < AES_GCM_TAG_SIZE; i++) {
+        difference |= static_cast<uint8_t>(expected[i] ^ block[i] ^ tag[i]);
+    }
+    if (difference != 0) {
+        std::memset(plain, 0, length);
+        return false;
+    }
+    crypt(nonce, static_cast<const uint8_t *>(cipher), length, static_cast<uint8_t *>(plain));
+    return true;
+}
+
+void AesGcm::encryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+    const uint32_t *key = roundKeys;
+    uint32_t s0 = load32(in) ^ key[0];
+    uint32_t s1 = load32(in + 4) ^ key[1];
+    uint32_t s2 = load32(in + 8) ^ key[2];
+    uint32_t s3 = load32(in + 12) ^ key[3];
+    const auto &t = AES.rounds;
+    for (uint8_t round = 1; round < ROUNDS; round++) {
+        key += 4;
+        uint32_t t0 = t[0][s0 >> 24] ^ t[1][s1 >> 16 & 0xFF] ^ t[2][s2 >> 8 & 0xFF] ^ t[3][s3 & 0xFF] ^ key[0];
+        uint32_t t1 = t[0][s1 >> 24] ^ t[1][s2 >> 16 & 0xFF] ^ t[2][s3 >> 8 & 0xFF] ^ t[3][s0 & 0xFF] ^ key[1];
+        uint32_t t2 = t[0][s2 >> 24] ^ t[1][s3 >> 16 & 0xFF] ^ t[2][s0 >> 8 & 0xFF] ^ t[3][s1 & 0xFF] ^ key[2];
+        uint32_t t3 = t[0][s3 >> 24] ^ t[1][s0 >> 16 & 0xFF] ^ t[2][s1 >> 8 & 0xFF] ^ t[3][s2 & 0xFF] ^ key[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+    key += 4;   // the last round: no MixColumns
+    const uint8_t *s = AES.sbox;
+    store32(out, (static_cast<uint32_t>(s[s0 >> 24]) << 24 | static_cast<uint32_t>(s[s1 >> 16 & 0xFF]) << 16 |
+                  static_cast<uint32_t>(s[s2 >> 8 & 0xFF]) << 8 | s[s3 & 0xFF]) ^ key[0]);
+    store32(out + 4, (static_cast<uint32_t>(s[s1 >> 24]) << 24 | static_cast<uint32_t>(s[s2 >> 16 & 0xFF]) << 16 |
+                      static_cast<uint32_t>(s[s3 >> 8 & 0xFF]) << 8 | s[s0 & 0xFF]) ^ key[1]);
+    store32(out + 8, (static_cast<uint32_t>(s[s2 >> 24]) << 24 | static_cast<uint32_t>(s[s3 >> 16 & 0xFF]) << 16 |
+                      static_cast<uint32_t>(s[s0 >> 8 & 0xFF]) << 8 | s[s1 & 0xFF]) ^ key[2]);
+    store32(out + 12, (static_cast<uint32_t>(s[s3 >> 24]) << 24 | static_cast<uint32_t>(s[s0 >> 16 & 0xFF]) << 16 |
+                       static_cast<uint32_t>(s[s1 >> 8 & 0xFF]) << 8 | s[s2 & 0xFF]) ^ key[3]);
+}
+
+void AesGcm::ghashMultiply(uint8_t x[16]) const {
+    uint8_t nibble = x[15] & 0x0F;
+    uint64_t high = tableHigh[nibble];
+    uint64_t low = tableLow[nibble];
+    for (int i = 15; i >= 0; i--) {
+        for (int half = i == 15 ? 1 : 0; half < 2; half++) {    // the low nibble, then the high one
+            nibble = half == 0 ? x[i] & 0x0F : x[i] >> 4;
+            uint8_t shiftedOut = low & 0x0F;
+            low = high << 60 | low >> 4;
+            high = high >> 4 ^ static_cast<uint64_t>(GHASH_REDUCE[shiftedOut]) << 48;
+            high ^= tableHigh[nibble];
+            low ^= tableLow[nibble];
+        }
+    }
+    store64(x, high);
+    store64(x + 8, low);
+}
+
+void AesGcm::ghash(const uint8_t *aad, size_t aadLength, const uint8_t *cipher, size_t length, uint8_t out[16]) const {
+    std::memset(out, 0, BLOCK);
+    for (size_t at = 0; at < aadLength; at += BLOCK) {
+        xorBlock(out, aad + at, aadLength - at < BLOCK ? aadLength - at : BLOCK);
+        ghashMultiply(out);
+    }
+    for (size_t at = 0; at < length; at += BLOCK) {
+        xorBlock(out, cipher + at, length - at < BLOCK ? length - at : BLOCK);
+        ghashMultiply(out);
+    }
+    uint8_t lengths[BLOCK];
+    store64(lengths, static_cast<uint64_t>(aadLength) * 8);
+    store64(lengths + 8, static_cast<uint64_t>(length) * 8);
+    xorBlock(out, lengths, BLOCK);
+    ghashMultiply(out);
+}
+
+void AesGcm::crypt(const uint8_t nonce[AES_GCM_NONCE_SIZE], const uint8_t *in, size_t length, uint8_t *out) const {
+    uint8_t counter[BLOCK];
+    uint8_t keyStream[BLOCK];
+    uint32_t block = 2;     // 1 is the tag's
+    for (size_t at = 0; at < length; at += BLOCK, block++) {
+        counterBlock(nonce, block, counter);
+        encryptBlock(counter, keyStream);
+        size_t count = length - at < BLOCK ? length - at : BLOCK;
+        for (size_t i = 0; i < count; i++) {
+            out[at + i] = in[at + i] ^ keyStream[i];
+        }
+    }
+}
+
+#endif
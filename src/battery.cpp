@@ -0,0 +1,187 @@
+#include "battery.h"
+
+#include <cmath>
+
+#include "hal.h"
+#include "logging.h"
+#include "sensors.h"
+
+namespace {
+
+constexpr float US_PER_DAY = 86400e6f;
+
+constexpr bool curveFalls(const DischargePoint *curve, size_t length) {
+    for (size_t i = 1; i < length; i++) {
+        if (curve[i].milliVolts >= curve[i - 1].milliVolts || curve[i].percent > curve[i - 1].percent) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr size_t CURVE_LENGTH = sizeof(BATTERY_DISCHARGE_CURVE) / sizeof(BATTERY_DISCHARGE_CURVE[0]);
+static_assert(CURVE_LENGTH >= 2 && curveFalls(BATTERY_DISCHARGE_CURVE, CURVE_LENGTH),
+              "the discharge curve goes by falling mV and %");
+static_assert(BATTERY_DISCHARGE_CURVE[CURVE_LENGTH - 1].percent == 0 &&
+              BATTERY_DISCHARGE_CURVE[CURVE_LENGTH - 1].milliVolts == BATTERY_CONFIG.lowMilliVolts,
+              "the rated capacity ends at MIN_BATTERY_POWER");
+static_assert(BATTERY_TREND_MIN_POINTS >= 2 && BATTERY_TREND_MIN_POINTS <= BATTERY_TREND_POINTS, "a line needs 2 points");
+static_assert(BATTERY_FILTER_SHIFT < 8, "the filter keeps 8 fraction bits");
+
+int32_t toFixed(uint32_t milliVolts) {
+    return static_cast<int32_t>(milliVolts << 8);
+}
+
+uint16_t fromFixed(int32_t fixed) {
+    return static_cast<uint16_t>((fixed + 128) >> 8);
+}
+
+}  // namespace
+
+BatteryMonitor batteryMonitor(BATTERY_CONFIG);
+
+float dischargePercent(uint16_t milliVolts, const DischargePoint *curve, uint8_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    if (milliVolts >= curve[0].milliVolts) {
+        return curve[0].percent;
+    }
+    for (uint8_t i = 1; i < length; i++) {
+        if (milliVolts >= curve[i].milliVolts) {
+            const DischargePoint &above = curve[i - 1];
+            const DischargePoint &below = curve[i];
+            float share = static_cast<float>(milliVolts - below.milliVolts) / static_cast<float>(above.milliVolts - below.milliVolts);
+            return below.percent + share * static_cast<float>(above.percent - below.percent);
+        }
+    }
+    return curve[length - 1].percent;
+}
+
+bool BatteryMonitor::sample(EnergyLedger &ledger) {
+    if (ledger.radioIsOn() || config.oversamples == 0) {
+        return false;
+    }
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < config.oversamples; i++) {
+        sum += hal::analogReadMilliVolts(config.pin);
+    }
+    uint32_t milliVolts = (sum * config.dividerRatio + config.oversamples / 2) / config.oversamples;
+    if (milliVolts < config.validMinMilliVolts || milliVolts > config.validMaxMilliVolts) {
+        return false;
+    }
+    uint64_t nowUs = hal::micros();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!has) {
+        filtered = toFixed(milliVolts);
+        has = true;
+    } else {
+        filtered += (toFixed(milliVolts) - filtered) >> config.filterShift;
+    }
+    uint16_t now = fromFixed(filtered);
+    if (!low && now < config.lowMilliVolts) {
+        low = true;
+        alerts++;
+    } else if (low && now >= config.lowMilliVolts + config.hysteresisMilliVolts) {
+        low = false;
+    }
+
+    uint8_t last = static_cast<uint8_t>((nextPoint + BATTERY_TREND_POINTS - 1) % BATTERY_TREND_POINTS);
+    if (pointCount == 0 || nowUs - pointUs[last] >= static_cast<uint64_t>(config.trendPointS) * 1000000) {
+        pointUs[nextPoint] = nowUs;
+        points[nextPoint] = filtered;
+        nextPoint = static_cast<uint8_t>((nextPoint + 1) % BATTERY_TREND_POINTS);
+        pointCount = pointCount < BATTERY_TREND_POINTS ? static_cast<uint8_t>(pointCount + 1) : pointCount;
+    }
+    return true;
+}
+
+void BatteryMonitor::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    has = false;
+    filtered = 0;
+    low = false;
+    alerts = 0;
+    pointCount = 0;
+    nextPoint = 0;
+}
+
+bool BatteryMonitor::hasReading() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return has;
+}
+
+uint16_t BatteryMonitor::milliVolts() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return has ? fromFixed(filtered) : 0;
+}
+
+bool BatteryMonitor::isLow() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return low;
+}
+
+uint32_t BatteryMonitor::lowAlerts() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return alerts;
+}
+
+float BatteryMonitor::remainingPercent() {
+    return dischargePercent(milliVolts(), config.curve, config.curveLength);
+}
+
+float BatteryMonitor::remainingMah() {
+    return remainingPercent() * static_cast<float>(config.capacityMah) / 100;
+}
+
+bool BatteryMonitor::trend(float &milliVoltsPerDay) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pointCount < BATTERY_TREND_MIN_POINTS) {
+        return false;
+    }
+    // least squares slope, around the means. time in days from the oldest point, voltage in mV
+    uint8_t oldest = static_cast<uint8_t>((nextPoint + BATTERY_TREND_POINTS - pointCount) % BATTERY_TREND_POINTS);
+    double sumT = 0, sumV = 0;
+    for (uint8_t i = 0; i < pointCount; i++) {
+        uint8_t at = static_cast<uint8_t>((oldest + i) % BATTERY_TREND_POINTS);
+        sumT += static_cast<double>(pointUs[at] - pointUs[oldest]) / US_PER_DAY;
+        sumV += points[at] / 256.0;
+    }
+    double meanT = sumT / pointCount, meanV = sumV / pointCount;
+    double covariance = 0, variance = 0;
+    for (uint8_t i = 0; i < pointCount; i++) {
+        uint8_t at = static_cast<uint8_t>((oldest + i) % BATTERY_TREND_POINTS);
+        double t = static_cast<double>(pointUs[at] - pointUs[oldest]) / US_PER_DAY - meanT;
+        covariance += t * (points[at] / 256.0 - meanV);
+        variance += t * t;
+    }
+    if (!(variance > 0)) {
+        return false;
+    }
+    milliVoltsPerDay = static_cast<float>(covariance / variance);
+    return true;
+}
+
+float getBatteryPower(bool isActive) {
+    if (isActive) {
+        batteryMonitor.sample();
+    }
+    return batteryMonitor.milliVolts() / 1000.0f;
+}
+
+void reportBattery(BatteryMonitor &monitor) {
+    monitor.sample();
+    if (!monitor.hasReading()) {
+        return;
+    }
+    uint16_t milliVolts = monitor.milliVolts();
+    logFile.addLogRow(LogCode::BatteryMilliVolts, milliVolts);
+    if (monitor.isLow()) {
+        logFile.addLogRow(LogCode::BatteryLow, milliVolts);
+    }
+    float milliVoltsPerDay;
+    if (monitor.trend(milliVoltsPerDay)) {
+        logFile.addLogRow(LogCode::BatteryTrend, static_cast<uint32_t>(static_cast<int32_t>(std::lround(milliVoltsPerDay))));
+    }
+}
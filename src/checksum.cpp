@@ -0,0 +1,96 @@
+#include "checksum.h"
+
+#ifdef ARDUINO
+#include <esp_rom_crc.h>
+#endif
+
+namespace {
+
+constexpr uint32_t POLYNOMIAL = 0xEDB88320;     // 0x04C11DB7 reflected
+
+// one entry per nibble: 64 bytes of table
+constexpr uint32_t NIBBLE_TABLE[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+// tables[0] is the classic byte table. tables[k][byte] is the CRC of byte followed by k zero bytes,
+// so 8 bytes can be folded in at once: one lookup per byte, and no dependency between the lookups
+struct SliceTables {
+    uint32_t tables[8][256];
+};
+
+constexpr SliceTables makeSliceTables() {
+    SliceTables slices{};
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (POLYNOMIAL & (0U - (crc & 1)));
+        }
+        slices.tables[0][byte] = crc;
+    }
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t previous = slices.tables[k - 1][byte];
+            slices.tables[k][byte] = (previous >> 8) ^ slices.tables[0][previous & 0xFF];
+        }
+    }
+    return slices;
+}
+
+constexpr SliceTables SLICES = makeSliceTables();
+static_assert(SLICES.tables[0][1] == 0x77073096 && SLICES.tables[0][255] == 0x2D02EF8D, "wrong CRC32 table");
+
+uint32_t load32(const uint8_t *bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+}  // namespace
+
+uint32_t crc32Update(uint32_t crc, const void *data, size_t length) {
+#ifdef ARDUINO
+    return esp_rom_crc32_le(crc, static_cast<const uint8_t *>(data), static_cast<uint32_t>(length));
+#else
+    return crc32UpdateSliceBy8(crc, data, length);
+#endif
+}
+
+uint32_t crc32UpdateBitwise(uint32_t crc, const void *data, size_t length) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (POLYNOMIAL & (0U - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+uint32_t crc32UpdateNibble(uint32_t crc, const void *data, size_t length) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ NIBBLE_TABLE[crc & 0x0F];
+        crc = (crc >> 4) ^ NIBBLE_TABLE[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+uint32_t crc32UpdateSliceBy8(uint32_t crc, const void *data, size_t length) {
+    const uint32_t (&t)[8][256] = SLICES.tables;
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    for (; length >= 8; length -= 8, bytes += 8) {
+        uint32_t low = load32(bytes) ^ crc;     // byte loads: the data needn't be aligned, and any endianness works
+        uint32_t high = load32(bytes + 4);
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    }
+    for (; length > 0; length--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *bytes++) & 0xFF];
+    }
+    return ~crc;
+}
@@ -0,0 +1,193 @@
+#include "clock_drift.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+
+#include "hal.h"
+
+namespace {
+
+constexpr uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+constexpr int64_t PPB_PER_MS_PER_S = 1000000;   // 1 ms a second is 1000 ppm
+constexpr uint32_t SPREAD_MARGIN = 3;           // median absolute deviations of the rate the predicted error allows for
+constexpr uint8_t MAX_PAIRS = CLOCK_DRIFT_SAMPLES * (CLOCK_DRIFT_SAMPLES - 1) / 2;
+static_assert(CLOCK_DRIFT_MIN_SAMPLES >= 3 && CLOCK_DRIFT_MIN_SAMPLES <= CLOCK_DRIFT_SAMPLES,
+              "stretching the syncs needs a spread, so more than 2 syncs");
+static_assert(CLOCK_SYNC_MAX_DAYS >= 1, "the syncs are at least daily");
+
+// the median of values (reordered), the mean of the two middle ones for an even count
+int32_t median(int32_t *values, uint8_t count) {
+    std::sort(values, values + count);
+    if (count % 2 == 1) {
+        return values[count / 2];
+    }
+    return static_cast<int32_t>((static_cast<int64_t>(values[count / 2 - 1]) + values[count / 2]) / 2);
+}
+
+int32_t clampToInt32(int64_t value) {
+    return static_cast<int32_t>(std::min<int64_t>(std::max<int64_t>(value, INT32_MIN), INT32_MAX));
+}
+
+// to the nearest whole second, halves away from 0
+int64_t roundToSeconds(int64_t ms) {
+    return (ms + (ms >= 0 ? 500 : -500)) / 1000;
+}
+
+// not in the RTC object: a pthread mutex's semaphore is on the heap, which a deep-sleep wakeup doesn't keep
+std::mutex driftMutex;
+
+}  // namespace
+
+HAL_RTC_DATA ClockDrift clockDrift;
+
+int32_t ClockDrift::addSync(uint32_t localS, int64_t offsetMs) {
+    std::lock_guard<std::mutex> lock(driftMutex);
+    uint32_t unsteppedS = static_cast<uint32_t>(static_cast<int64_t>(localS) - stepsS);
+    bool restart = count == 0 || localS == 0 || localS < lastSyncS || unsteppedS < originS;
+    int64_t offFit = restart ? 0 : offsetMs - (predictMs(unsteppedS) - stepsS * 1000LL);
+    if (std::llabs(offFit) > CLOCK_MAX_ERROR_MS) {
+        if (!hasSuspect || std::llabs(offFit - suspectMs) > CLOCK_MAX_ERROR_MS) {
+            hasSuspect = true;      // one sync could be a bad NTP answer: keep the clock, and ask again
+            suspectMs = offFit;
+            return 0;
+        }
+        restart = true;             // two agree: the clock was set anew
+    }
+    hasSuspect = false;
+    if (restart) {
+        count = 0;
+        stepsS = 0;
+        originS = localS;
+        originMs = offsetMs;
+        unsteppedS = localS;
+    }
+    if (count == CLOCK_DRIFT_SAMPLES) {     // the oldest goes, the next one becomes the origin
+        Sync next = samples[1];
+        originS += next.atS;
+        originMs += next.offsetMs;
+        for (uint8_t i = 1; i < count; i++) {
+            samples[i - 1] = Sync{samples[i].atS - next.atS, samples[i].offsetMs - next.offsetMs};
+        }
+        count--;
+    }
+    samples[count++] = Sync{unsteppedS - originS, clampToInt32(offsetMs + stepsS * 1000LL - originMs)};
+
+    int32_t stepS = static_cast<int32_t>(roundToSeconds(offsetMs));
+    stepsS += stepS;
+    lastSyncS = static_cast<uint32_t>(static_cast<int64_t>(localS) + stepS);
+    fit();
+    return stepS;
+}
+
+uint32_t ClockDrift::correct(uint32_t localS) {
+    if (localS == 0) {
+        return 0;
+    }
+    return static_cast<uint32_t>(static_cast<int64_t>(localS) + roundToSeconds(correctionMs(localS)));
+}
+
+int64_t ClockDrift::correctionMs(uint32_t localS) {
+    std::lock_guard<std::mutex> lock(driftMutex);
+    if (count < 2) {
+        return 0;   // the sync's step was the whole correction
+    }
+    return predictMs(static_cast<uint32_t>(static_cast<int64_t>(localS) - stepsS)) - stepsS * 1000LL;
+}
+
+int32_t ClockDrift::ratePpb() {
+    std::lock_guard<std::mutex> lock(driftMutex);
+    return rate;
+}
+
+uint8_t ClockDrift::syncs() {
+    std::lock_guard<std::mutex> lock(driftMutex);
+    return count;
+}
+
+uint8_t ClockDrift::syncIntervalDays() {
+    std::lock_guard<std::mutex> lock(driftMutex);
+    return intervalDays;
+}
+
+bool ClockDrift::isSyncDue(uint32_t localS) {
+    std::lock_guard<std::mutex> lock(driftMutex);
+    // half a day early still counts: the job wakes up daily, at about the same time as the last sync
+    return count == 0 || hasSuspect || localS + SECONDS_PER_DAY / 2 >= lastSyncS + intervalDays * SECONDS_PER_DAY;
+}
+
+void ClockDrift::reset() {
+    std::lock_guard<std::mutex> lock(driftMutex);
+    count = 0;
+    originS = 0;
+    originMs = 0;
+    stepsS = 0;
+    lastSyncS = 0;
+    rate = 0;
+    interceptMs = 0;
+    rateSpread = 0;
+    residualSpreadMs = 0;
+    intervalDays = 1;
+    hasSuspect = false;
+    suspectMs = 0;
+}
+
+// Theil-Sen, and the spreads that stretch the sync interval. the lock is held
+void ClockDrift::fit() {
+    int32_t values[MAX_PAIRS];
+    uint8_t pairs = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        for (uint8_t j = i + 1; j < count; j++) {
+            if (samples[j].atS > samples[i].atS) {
+                int64_t rise = static_cast<int64_t>(samples[j].offsetMs) - samples[i].offsetMs;
+                values[pairs++] = clampToInt32(rise * PPB_PER_MS_PER_S / (samples[j].atS - samples[i].atS));
+            }
+        }
+    }
+    if (pairs == 0) {
+        rate = 0;
+        interceptMs = samples[0].offsetMs;
+        rateSpread = 0;
+        residualSpreadMs = 0;
+        intervalDays = 1;
+        return;
+    }
+    int32_t slopes[MAX_PAIRS];
+    std::copy(values, values + pairs, slopes);
+    rate = median(values, pairs);
+    for (uint8_t i = 0; i < pairs; i++) {
+        values[i] = clampToInt32(std::abs(static_cast<int64_t>(slopes[i]) - rate));
+    }
+    rateSpread = static_cast<uint32_t>(median(values, pairs));
+
+    for (uint8_t i = 0; i < count; i++) {
+        values[i] = clampToInt32(samples[i].offsetMs - static_cast<int64_t>(rate) * samples[i].atS / PPB_PER_MS_PER_S);
+    }
+    interceptMs = median(values, count);
+    residualSpreadMs = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        residualSpreadMs = std::max<uint32_t>(residualSpreadMs, static_cast<uint32_t>(std::abs(values[i] - interceptMs)));
+    }
+
+    intervalDays = 1;
+    if (count < CLOCK_DRIFT_MIN_SAMPLES) {
+        return;
+    }
+    for (uint8_t days = CLOCK_SYNC_MAX_DAYS; days > 1; days--) {
+        uint64_t errorMs = residualSpreadMs + SPREAD_MARGIN * static_cast<uint64_t>(rateSpread) * days * SECONDS_PER_DAY /
+                                                  PPB_PER_MS_PER_S;
+        if (errorMs <= CLOCK_DRIFT_BUDGET_MS) {
+            intervalDays = days;
+            return;
+        }
+    }
+}
+
+int64_t ClockDrift::predictMs(uint32_t unsteppedS) const {
+    int64_t sinceOrigin = static_cast<int64_t>(unsteppedS) - originS;
+    return originMs + interceptMs + static_cast<int64_t>(rate) * sinceOrigin / PPB_PER_MS_PER_S;
+}
+
+uint32_t epochNow(ClockDrift &drift) {
+    return drift.correct(hal::epochSeconds());
+}
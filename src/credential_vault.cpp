@@ -0,0 +1,280 @@
+#include "credential_vault.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "checksum.h"
+#include "hal.h"
+
+namespace {
+
+constexpr size_t SSID_CAPACITY = sizeof(VaultIndex::Entry::ssid);
+constexpr size_t PASSWORD_CAPACITY = sizeof(VaultRecord::password);
+constexpr size_t NVS_KEY_CAPACITY = 16;     // NVS keys are 15 characters at most
+static_assert(PASSWORD_CAPACITY == sizeof(WifiNetwork::password), "a record holds a stored network's password");
+static_assert(VAULT_RECORD_SLOTS > WIFI_MAX_NETWORKS, "an add needs a slot the index doesn't use");
+static_assert(VAULT_RECORD_SLOTS <= 10, "the slot is one digit of its NVS key");
+
+struct NvsKey {
+    char name[NVS_KEY_CAPACITY];
+    NvsKey(const char *prefix, uint8_t number) { std::snprintf(name, sizeof(name), "%s%u", prefix, number); }
+};
+
+uint32_t indexCrc(const VaultIndex &index) {
+    return crc32(&index, offsetof(VaultIndex, crc));
+}
+
+// The record's AAD: its slot, then its network's SSID. returns the length
+size_t recordAad(uint8_t slot, const char *ssid, uint8_t aad[1 + SSID_CAPACITY]) {
+    size_t length = std::strlen(ssid);
+    aad[0] = slot;
+    std::memcpy(aad + 1, ssid, length);
+    return 1 + length;
+}
+
+// Drops the entries that can't be right even under a valid CRC: a slot out of range, a slot or an SSID used twice
+void sanitize(VaultIndex &index) {
+    for (uint8_t i = 0; i < WIFI_MAX_NETWORKS; i++) {
+        VaultIndex::Entry &entry = index.entries[i];
+        entry.ssid[SSID_CAPACITY - 1] = '\0';
+        bool valid = entry.ssid[0] != '\0' && entry.record < VAULT_RECORD_SLOTS;
+        for (uint8_t j = 0; valid && j < i; j++) {
+            const VaultIndex::Entry &earlier = index.entries[j];
+            valid = earlier.ssid[0] == '\0' ||
+                    (earlier.record != entry.record && std::strcmp(earlier.ssid, entry.ssid) != 0);
+        }
+        if (!valid) {
+            std::memset(&entry, 0, sizeof(entry));
+        }
+    }
+}
+
+}  // namespace
+
+CredentialVault credentialVault;
+
+void wipeSecret(void *buffer, size_t length) {
+    volatile uint8_t *bytes = static_cast<volatile uint8_t *>(buffer);
+    for (size_t i = 0; i < length; i++) {
+        bytes[i] = 0;
+    }
+}
+
+bool CredentialVault::mount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    mounted = false;
+    uint8_t key[AES_GCM_KEY_SIZE];
+    if (!hal::deviceKey(key)) {
+        return false;
+    }
+    gcm.setKey(key);
+    wipeSecret(key, sizeof(key));
+    readIndex();
+    mounted = true;
+    importLegacy();
+    eraseOrphans();
+    return true;
+}
+
+bool CredentialVault::add(const char *ssid, const char *password) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return mounted && addLocked(ssid, password);
+}
+
+bool CredentialVault::remove(const char *ssid) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int8_t at = mounted ? entryOf(ssid) : -1;
+    if (at < 0) {
+        return false;
+    }
+    VaultIndex next = index;
+    uint8_t slot = next.entries[at].record;
+    std::memset(&next.entries[at], 0, sizeof(next.entries[at]));
+    if (!writeIndex(next)) {
+        return false;
+    }
+    // a cut before this leaves an orphan record, which the next mount erases
+    NvsKey record(NVS_KEY_VAULT_RECORD, slot);
+    hal::nvsErase(record.name);
+    hal::nvsCommit();
+    return true;
+}
+
+bool CredentialVault::find(const char *ssid, char password[65]) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int8_t at = mounted ? entryOf(ssid) : -1;
+    if (at < 0) {
+        return false;
+    }
+    uint8_t slot = index.entries[at].record;
+    VaultRecord record;
+    NvsKey key(NVS_KEY_VAULT_RECORD, slot);
+    if (!hal::nvsGet(key.name, &record, sizeof(record))) {
+        counters.failures++;
+        return false;
+    }
+    uint8_t aad[1 + SSID_CAPACITY];
+    size_t aadLength = recordAad(slot, index.entries[at].ssid, aad);
+    counters.decrypts++;
+    if (!gcm.open(record.nonce, aad, aadLength, record.password, PASSWORD_CAPACITY, record.tag, password)) {
+        counters.failures++;
+        return false;
+    }
+    password[PASSWORD_CAPACITY - 1] = '\0';
+    return true;
+}
+
+uint8_t CredentialVault::list(WifiNetwork networks[WIFI_MAX_NETWORKS]) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint8_t count = 0;
+    for (const VaultIndex::Entry &entry : index.entries) {
+        if (mounted && entry.ssid[0] != '\0') {
+            WifiNetwork &network = networks[count++];
+            std::memset(&network, 0, sizeof(network));
+            std::memcpy(network.ssid, entry.ssid, sizeof(network.ssid));
+        }
+    }
+    return count;
+}
+
+int8_t CredentialVault::entryOf(const char *ssid) const {
+    if (ssid[0] == '\0') {
+        return -1;
+    }
+    for (uint8_t i = 0; i < WIFI_MAX_NETWORKS; i++) {
+        if (std::strcmp(index.entries[i].ssid, ssid) == 0) {
+            return static_cast<int8_t>(i);
+        }
+    }
+    return -1;
+}
+
+void CredentialVault::readIndex() {
+    index = {};
+    current = 0;
+    bool found = false;
+    for (uint8_t copy = 0; copy < 2; copy++) {
+        VaultIndex stored;
+        NvsKey key(NVS_KEY_VAULT_INDEX, copy);
+        if (!hal::nvsGet(key.name, &stored, sizeof(stored)) || stored.crc != indexCrc(stored)) {
+            continue;
+        }
+        if (!found || stored.generation > index.generation) {
+            index = stored;
+            current = copy;
+            found = true;
+        }
+    }
+    sanitize(index);
+}
+
+bool CredentialVault::writeIndex(const VaultIndex &next) {
+    VaultIndex written = next;
+    written.generation = index.generation + 1;
+    written.crc = indexCrc(written);
+    uint8_t older = current ^ 1;
+    NvsKey key(NVS_KEY_VAULT_INDEX, older);
+    if (!hal::nvsSet(key.name, &written, sizeof(written)) || !hal::nvsCommit()) {
+        readIndex();    // the write may have made it or not: NVS says which
+        return false;
+    }
+    index = written;
+    current = older;
+    return true;
+}
+
+bool CredentialVault::addLocked(const char *ssid, const char *password) {
+    size_t ssidLength = std::strlen(ssid);
+    size_t passwordLength = std::strlen(password);
+    if (ssidLength == 0 || ssidLength >= SSID_CAPACITY || passwordLength >= PASSWORD_CAPACITY) {
+        return false;
+    }
+    int8_t at = entryOf(ssid);
+    bool replacing = at >= 0;
+    bool used[VAULT_RECORD_SLOTS] = {};
+    for (uint8_t i = 0; i < WIFI_MAX_NETWORKS; i++) {
+        const VaultIndex::Entry &entry = index.entries[i];
+        if (entry.ssid[0] != '\0') {
+            used[entry.record] = true;
+        } else if (at < 0) {
+            at = static_cast<int8_t>(i);
+        }
+    }
+    if (at < 0) {
+        return false;   // full
+    }
+    uint8_t slot = 0;
+    while (used[slot]) {
+        slot++;
+    }
+
+    VaultRecord record;
+    hal::randomBytes(record.nonce, sizeof(record.nonce));
+    char plain[PASSWORD_CAPACITY] = {};
+    std::memcpy(plain, password, passwordLength);
+    uint8_t aad[1 + SSID_CAPACITY];
+    size_t aadLength = recordAad(slot, ssid, aad);
+    gcm.seal(record.nonce, aad, aadLength, plain, sizeof(plain), record.password, record.tag);
+    wipeSecret(plain, sizeof(plain));
+    NvsKey key(NVS_KEY_VAULT_RECORD, slot);
+    if (!hal::nvsSet(key.name, &record, sizeof(record)) || !hal::nvsCommit()) {
+        return false;   // an orphan at worst
+    }
+
+    VaultIndex next = index;
+    VaultIndex::Entry &entry = next.entries[at];
+    uint8_t replaced = entry.record;
+    std::memset(&entry, 0, sizeof(entry));
+    std::memcpy(entry.ssid, ssid, ssidLength);
+    entry.record = slot;
+    if (!writeIndex(next)) {
+        return false;
+    }
+    if (replacing) {
+        NvsKey old(NVS_KEY_VAULT_RECORD, replaced);
+        hal::nvsErase(old.name);
+        hal::nvsCommit();
+    }
+    return true;
+}
+
+void CredentialVault::importLegacy() {
+    WifiNetwork legacy[WIFI_MAX_NETWORKS];
+    if (!hal::nvsGet(NVS_KEY_WIFI_NETWORKS, legacy, sizeof(legacy))) {
+        return;
+    }
+    // a cut halfway leaves the blob, and the next mount imports it again: add replaces what's there
+    bool imported = true;
+    for (WifiNetwork &network : legacy) {
+        network.ssid[sizeof(network.ssid) - 1] = '\0';
+        network.password[sizeof(network.password) - 1] = '\0';
+        if (network.ssid[0] != '\0' && !addLocked(network.ssid, network.password)) {
+            imported = false;
+        }
+    }
+    wipeSecret(legacy, sizeof(legacy));
+    if (imported) {
+        hal::nvsErase(NVS_KEY_WIFI_NETWORKS);
+        hal::nvsCommit();
+    }
+}
+
+void CredentialVault::eraseOrphans() {
+    bool used[VAULT_RECORD_SLOTS] = {};
+    for (const VaultIndex::Entry &entry : index.entries) {
+        if (entry.ssid[0] != '\0') {
+            used[entry.record] = true;
+        }
+    }
+    bool erased = false;
+    for (uint8_t slot = 0; slot < VAULT_RECORD_SLOTS; slot++) {
+        VaultRecord record;
+        NvsKey key(NVS_KEY_VAULT_RECORD, slot);
+        if (!used[slot] && hal::nvsGet(key.name, &record, sizeof(record))) {
+            erased = hal::nvsErase(key.name) || erased;
+        }
+    }
+    if (erased) {
+        hal::nvsCommit();
+    }
+}
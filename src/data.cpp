@@ -0,0 +1,204 @@
+#include "data.h"
+
+#include "config.h"
+
+namespace {
+
+constexpr uint8_t WEIGHT_BITS = 17;
+constexpr uint32_t WEIGHT_MASK = (1UL << WEIGHT_BITS) - 1;
+constexpr recordTimeType MAX_DELTA = 126;
+
+void storePacked(uint8_t *bytes, uint32_t packed) {
+    bytes[0] = static_cast<uint8_t>(packed);
+    bytes[1] = static_cast<uint8_t>(packed >> 8);
+    bytes[2] = static_cast<uint8_t>(packed >> 16);
+}
+
+uint32_t loadPacked(const uint8_t *bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16);
+}
+
+recordTimeType deltaOf(uint32_t packed) {
+    return static_cast<recordTimeType>(packed >> WEIGHT_BITS);
+}
+
+}  // namespace
+
+uint32_t packRecord(recordTimeType minutesSincePrevious, weightType weight) {
+    if (weight > MAX_RECORD_WEIGHT) {
+        weight = MAX_RECORD_WEIGHT;
+    }
+    return (static_cast<uint32_t>(minutesSincePrevious) << WEIGHT_BITS) | weight;
+}
+
+uint32_t packTimeMarker(recordTimeType minuteOfDay) {
+    return minuteOfDay % MINUTES_PER_DAY;
+}
+
+/* ---- RecordIterator ---- */
+RecordIterator::RecordIterator(const FlashLog *store, StreamId stream, uint32_t through)
+    : store(store), stream(stream), through(through) {
+    if (store->firstSegment(stream, segment) && segment.sequence <= through) {
+        position = segment.data;
+        end = segment.data + segment.length;
+    }
+    decode();
+}
+
+RecordIterator &RecordIterator::operator++() {
+    position += PACKED_RECORD_SIZE;
+    decode();
+    return *this;
+}
+
+void RecordIterator::decode() {
+    while (position != nullptr) {
+        if (position + PACKED_RECORD_SIZE > end) {
+            FlashSegment next;
+            if (!store->nextSegment(stream, segment, next) || next.sequence > through) {
+                position = nullptr;     // the end
+                return;
+            }
+            segment = next;
+            position = segment.data;
+            end = segment.data + segment.length;
+            continue;
+        }
+        uint32_t packed = loadPacked(position);
+        recordTimeType delta = deltaOf(packed);
+        if (delta != 0) {
+            minute = static_cast<recordTimeType>((minute + delta) % MINUTES_PER_DAY);
+            current = Record{minute, packed & WEIGHT_MASK};
+            return;
+        }
+        minute = static_cast<recordTimeType>(packed & WEIGHT_MASK);
+        position += PACKED_RECORD_SIZE;
+    }
+}
+
+/* ---- DataTable ---- */
+DataTable dataTable(DATA_TABLE_CAPACITY);
+
+DataTable::DataTable(uint16_t capacity, FlashLog &store) : store(store), capacity(capacity) {}
+
+bool DataTable::createDataTable() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!store.isMounted() && !store.mount(STORAGE_PARTITION)) {
+        return false;
+    }
+    // pick up where we left off
+    rescan();
+    return true;
+}
+
+bool DataTable::updateTable(Record record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!store.isMounted() || isFull()) {
+        return false;
+    }
+    uint8_t bytes[2 * PACKED_RECORD_SIZE];
+    uint8_t length = 0;
+    recordTimeType minute = static_cast<recordTimeType>(record.recordTime % MINUTES_PER_DAY);
+    recordTimeType delta = static_cast<recordTimeType>((minute + MINUTES_PER_DAY - lastMinute) % MINUTES_PER_DAY);
+    if (!hasLastMinute || delta == 0 || delta > MAX_DELTA) {
+        // count the next record from the minute before it
+        storePacked(bytes, packTimeMarker(static_cast<recordTimeType>(minute + MINUTES_PER_DAY - 1)));
+        length += PACKED_RECORD_SIZE;
+        delta = 1;
+    }
+    uint32_t packed = packRecord(delta, record.weight);
+    storePacked(bytes + length, packed);
+    length += PACKED_RECORD_SIZE;
+    if (!store.append(StreamId::DataTable, bytes, length)) {
+        return false;
+    }
+    checksum.add(Record{minute, packed & WEIGHT_MASK});     // as it's stored: the weight may have been clamped
+    bytesUsed += length;
+    lastMinute = minute;
+    hasLastMinute = true;
+    recordCount++;
+    return true;
+}
+
+RecordSpan DataTable::readTable() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return RecordSpan(&store, StreamId::DataTable, recordCount);
+}
+
+DataTable::Snapshot DataTable::snapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Snapshot snapshot{recordCount, checksum.value(), store.seal(StreamId::DataTable)};
+    hasLastMinute = false;      // the next record starts its sector with a time marker: it may be all that's left
+    return snapshot;
+}
+
+RecordSpan DataTable::readTable(const Snapshot &snapshot) const {
+    return RecordSpan(&store, StreamId::DataTable, snapshot.records, snapshot.through);
+}
+
+void DataTable::deleteThrough(const Snapshot &snapshot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (store.isMounted()) {
+        store.clearThrough(StreamId::DataTable, snapshot.through);
+    }
+    rescan();   // what's left starts with a time marker (see snapshot), so it reads on its own
+}
+
+void DataTable::deleteTable() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (store.isMounted()) {
+        store.clear(StreamId::DataTable);
+    }
+    recordCount = 0;
+    bytesUsed = 0;
+    hasLastMinute = false;
+    checksum.reset();
+}
+
+uint16_t DataTable::length() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return recordCount;
+}
+
+uint32_t DataTable::flashBytesUsed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesUsed;
+}
+
+uint32_t DataTable::payloadChecksum() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return checksum.value();
+}
+
+bool DataTable::isFull() const {
+    return recordCount >= capacity;
+}
+
+void DataTable::rescan() {
+    recordCount = 0;
+    bytesUsed = 0;
+    hasLastMinute = false;
+    checksum.reset();
+    FlashSegment segment;
+    for (bool found = store.firstSegment(StreamId::DataTable, segment); found;
+         found = store.nextSegment(StreamId::DataTable, segment, segment)) {
+        for (uint16_t offset = 0; offset + PACKED_RECORD_SIZE <= segment.length; offset += PACKED_RECORD_SIZE) {
+            uint32_t packed = loadPacked(segment.data + offset);
+            recordTimeType delta = deltaOf(packed);
+            if (delta == 0) {
+                lastMinute = static_cast<recordTimeType>(packed & WEIGHT_MASK);
+            } else {
+                lastMinute = static_cast<recordTimeType>((lastMinute + delta) % MINUTES_PER_DAY);
+                checksum.add(Record{lastMinute, packed & WEIGHT_MASK});
+                recordCount++;
+            }
+            hasLastMinute = true;
+        }
+        bytesUsed += segment.length;
+        if (segment.length % PACKED_RECORD_SIZE != 0) {
+            // an append torn by a power cut: the next one starts a new sector, on a record boundary
+            store.seal(StreamId::DataTable);
+        }
+    }
+}
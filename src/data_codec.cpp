@@ -0,0 +1,155 @@
+#include "data_codec.h"
+
+#include <cstring>
+
+#include "data.h"
+
+namespace {
+
+constexpr uint8_t VARINT_MORE = 0x80;
+constexpr uint8_t VARINT_BITS = 7;
+constexpr uint8_t MAX_VARINT_BYTES = 5;
+
+uint32_t zigZag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+int32_t unZigZag(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+size_t putVarint(uint8_t *out, uint32_t value) {
+    size_t length = 0;
+    do {
+        uint8_t byte = value & ~VARINT_MORE;
+        value >>= VARINT_BITS;
+        out[length++] = value != 0 ? (byte | VARINT_MORE) : byte;
+    } while (value != 0);
+    return length;
+}
+
+bool getVarint(const uint8_t *&position, const uint8_t *end, uint32_t &value) {
+    value = 0;
+    for (uint8_t i = 0; i < MAX_VARINT_BYTES && position < end; i++) {
+        uint8_t byte = *position++;
+        value |= static_cast<uint32_t>(byte & ~VARINT_MORE) << (VARINT_BITS * i);
+        if ((byte & VARINT_MORE) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+/* ---- RecordDeltas ---- */
+size_t RecordDeltas::encode(const Record &record, uint8_t out[MAX_ENCODED_RECORD_SIZE]) {
+    size_t length;
+    if (!hasPrevious) {
+        length = putVarint(out, record.recordTime);
+        length += putVarint(out + length, record.weight);
+    } else {
+        uint32_t minutes = (record.recordTime + MINUTES_PER_DAY - previousMinute) % MINUTES_PER_DAY;
+        int32_t change = static_cast<int32_t>(record.weight) - static_cast<int32_t>(previousWeight);
+        length = putVarint(out, minutes);
+        length += putVarint(out + length, zigZag(change));
+    }
+    hasPrevious = true;
+    previousMinute = record.recordTime;
+    previousWeight = record.weight;
+    return length;
+}
+
+/* ---- DataEncoder ---- */
+DataEncoder::DataEncoder(uint8_t *buffer, size_t capacity) : buffer(buffer), capacity(capacity) {
+    if (capacity > 0) {
+        buffer[length++] = DATA_FORMAT_VERSION;
+        crc.update(DATA_FORMAT_VERSION);
+    }
+}
+
+bool DataEncoder::add(const Record &record) {
+    uint8_t bytes[MAX_ENCODED_RECORD_SIZE];
+    RecordDeltas next = deltas;
+    size_t recordLength = next.encode(record, bytes);
+    if (length + recordLength > capacity) {
+        return false;
+    }
+    std::memcpy(buffer + length, bytes, recordLength);
+    length += recordLength;
+    crc.update(bytes, recordLength);
+    deltas = next;
+    return true;
+}
+
+size_t DataEncoder::finish() {
+    if (capacity == 0 || length + DATA_CHECKSUM_SIZE > capacity) {
+        return 0;
+    }
+    for (size_t i = 0; i < DATA_CHECKSUM_SIZE; i++) {
+        buffer[length++] = static_cast<uint8_t>(crc.value() >> (8 * i));
+    }
+    return length;
+}
+
+/* ---- DataChecksum ---- */
+void DataChecksum::add(const Record &record) {
+    uint8_t bytes[MAX_ENCODED_RECORD_SIZE];
+    crc.update(bytes, deltas.encode(record, bytes));
+}
+
+void DataChecksum::reset() {
+    deltas = RecordDeltas();
+    crc.reset();
+    crc.update(DATA_FORMAT_VERSION);
+}
+
+/* ---- whole tables ---- */
+size_t encodeDataTable(const RecordSpan &records, uint8_t *payload, size_t capacity) {
+    DataEncoder encoder(payload, capacity);
+    for (Record record : records) {
+        if (!encoder.add(record)) {
+            return 0;
+        }
+    }
+    return encoder.finish();
+}
+
+uint32_t dataPayloadChecksum(const uint8_t *payload, size_t length) {
+    if (length < DATA_CHECKSUM_SIZE) {
+        return 0;
+    }
+    const uint8_t *trailer = payload + length - DATA_CHECKSUM_SIZE;
+    return static_cast<uint32_t>(trailer[0]) | (static_cast<uint32_t>(trailer[1]) << 8) |
+           (static_cast<uint32_t>(trailer[2]) << 16) | (static_cast<uint32_t>(trailer[3]) << 24);
+}
+
+bool decodeDataTable(const uint8_t *payload, size_t length, Record *records, uint16_t capacity, uint16_t &count) {
+    count = 0;
+    if (length < 1 + DATA_CHECKSUM_SIZE || payload[0] != DATA_FORMAT_VERSION) {
+        return false;
+    }
+    const uint8_t *end = payload + length - DATA_CHECKSUM_SIZE;
+    if (crc32(payload, length - DATA_CHECKSUM_SIZE) != dataPayloadChecksum(payload, length)) {
+        return false;
+    }
+    const uint8_t *position = payload + 1;
+    uint32_t minute = 0;
+    uint32_t weight = 0;
+    while (position < end) {
+        uint32_t first;
+        uint32_t second;
+        if (count >= capacity || !getVarint(position, end, first) || !getVarint(position, end, second)) {
+            return false;
+        }
+        if (count == 0) {
+            minute = first;
+            weight = second;
+        } else {
+            minute = (minute + first) % MINUTES_PER_DAY;
+            weight = static_cast<uint32_t>(static_cast<int32_t>(weight) + unZigZag(second));
+        }
+        records[count++] = Record{static_cast<recordTimeType>(minute), weight};
+    }
+    return true;
+}
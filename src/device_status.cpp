@@ -0,0 +1,97 @@
+#include "device_status.h"
+
+#include "config.h"
+#include "data.h"
+#include "hal.h"
+
+namespace {
+
+constexpr uint32_t VALID = 1U << 0;
+constexpr uint32_t IS_ACTIVE = 1U << 1;
+constexpr uint32_t HAS_MAIN_SERVER_COMM_PROBLEM = 1U << 2;
+constexpr uint32_t HAS_DEVICE_ID = 1U << 3;
+constexpr uint8_t COMM_FAILURES_SHIFT = 8;
+constexpr uint8_t TX_MINUTE_SHIFT = 16;
+constexpr uint32_t TX_MINUTE_MASK = 0x7FF;
+static_assert(MINUTES_PER_DAY < TX_MINUTE_MASK, "the tx minute + 1 fits in 11 bits");
+
+}  // namespace
+
+HAL_RTC_DATA StatusRegister deviceStatus;
+
+uint32_t packDeviceStatus(const DeviceStatus &status) {
+    uint32_t word = VALID;
+    word |= status.isActive ? IS_ACTIVE : 0;
+    word |= status.hasMainServerCommProblem ? HAS_MAIN_SERVER_COMM_PROBLEM : 0;
+    word |= status.hasDeviceId ? HAS_DEVICE_ID : 0;
+    word |= static_cast<uint32_t>(status.commFailures) << COMM_FAILURES_SHIFT;
+    uint32_t txMinute = status.lastTxMinute < MINUTES_PER_DAY ? status.lastTxMinute + 1U : 0;
+    return word | txMinute << TX_MINUTE_SHIFT;
+}
+
+DeviceStatus unpackDeviceStatus(uint32_t word) {
+    uint32_t txMinute = (word >> TX_MINUTE_SHIFT) & TX_MINUTE_MASK;
+    return DeviceStatus{
+        (word & IS_ACTIVE) != 0,
+        (word & HAS_MAIN_SERVER_COMM_PROBLEM) != 0,
+        (word & HAS_DEVICE_ID) != 0,
+        static_cast<uint8_t>(word >> COMM_FAILURES_SHIFT),
+        txMinute != 0 && txMinute <= MINUTES_PER_DAY ? static_cast<recordTimeType>(txMinute - 1) : NO_TX_MINUTE,
+    };
+}
+
+bool StatusRegister::compareAndSwap(DeviceStatus &expected, const DeviceStatus &desired) {
+    uint32_t current = packDeviceStatus(expected);
+    if (word.compare_exchange_strong(current, packDeviceStatus(desired), std::memory_order_acq_rel,
+                                     std::memory_order_acquire)) {
+        return true;
+    }
+    expected = unpackDeviceStatus(current);
+    return false;
+}
+
+void initDeviceStatus(StatusRegister &status) {
+    if (status.isValid()) {
+        return;     // a wakeup from deep sleep: the register is as it was left
+    }
+    uint32_t deviceId;
+    bool hasDeviceId = hal::nvsGet(NVS_KEY_DEVICE_ID, &deviceId, sizeof(deviceId));
+    status.update([hasDeviceId](DeviceStatus &now) { now.hasDeviceId = hasDeviceId; });
+}
+
+void recordMainServerSend(bool delivered, recordTimeType minute, StatusRegister &status) {
+    status.update([delivered, minute](DeviceStatus &now) {
+        if (delivered) {
+            now.commFailures = 0;
+            now.hasMainServerCommProblem = false;
+            now.lastTxMinute = minute;
+            return;
+        }
+        now.commFailures = now.commFailures < UINT8_MAX ? static_cast<uint8_t>(now.commFailures + 1) : UINT8_MAX;
+        now.hasMainServerCommProblem = now.hasMainServerCommProblem || now.commFailures >= COMM_PROBLEM_AFTER_FAILURES;
+    });
+}
+
+void setIsActive(bool value) {
+    deviceStatus.update([value](DeviceStatus &now) { now.isActive = value; });
+}
+
+void setHasMainServerCommProblem(bool value) {
+    deviceStatus.update([value](DeviceStatus &now) { now.hasMainServerCommProblem = value; });
+}
+
+void setHasDeviceId(bool value) {
+    deviceStatus.update([value](DeviceStatus &now) { now.hasDeviceId = value; });
+}
+
+bool getIsActive(void) {
+    return deviceStatus.snapshot().isActive;
+}
+
+bool getHasMainServerCommProblem(void) {
+    return deviceStatus.snapshot().hasMainServerCommProblem;
+}
+
+bool getHasDeviceId(void) {
+    return deviceStatus.snapshot().hasDeviceId;
+}
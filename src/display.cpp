@@ -0,0 +1,54 @@
+#include "display.h"
+
+#include "config.h"
+#include "energy.h"
+#include "event_ring.h"
+#include "hal.h"
+#include "led_patterns.h"
+
+namespace {
+
+constexpr gpio LED_PINS[] = {LED};
+
+struct LedRequest {
+    LEDPatternType type;
+    bool stop;
+};
+
+EventRing<LedRequest, LED_REQUESTS_RING_LENGTH> ledRequests;
+RingParker displayWake;
+
+}  // namespace
+
+void blinkLed(LEDPattern ledPattern) {
+    if (ledRequests.tryPush(LedRequest{ledPattern.ledPatternType, false})) {
+        displayWake.signal();
+    }
+}
+
+void stopLed(LEDPattern ledPattern) {
+    if (ledRequests.tryPush(LedRequest{ledPattern.ledPatternType, true})) {
+        displayWake.signal();
+    }
+}
+
+void display(const char *msg, LEDPattern ledPattern) {
+    (void) msg;     // the computer display (displayOnComputer) comes with initDisplay
+    static LedEngine leds(LED_PINS, sizeof(LED_PINS) / sizeof(LED_PINS[0]));
+    leds.begin([](void *) { displayWake.signal(); }, nullptr);
+    leds.play(0, ledPattern.ledPatternType);
+    while (true) {
+        LedRequest request;
+        while (ledRequests.tryPop(request)) {
+            if (request.stop) {
+                leds.stop(0, request.type);
+            } else {
+                leds.play(0, request.type);
+            }
+        }
+        leds.onTimer();
+        energyLedger.taskAsleep(EnergyTask::Display);
+        displayWake.wait(UINT32_MAX);   // until the next edge, or the next request
+        energyLedger.taskAwake(EnergyTask::Display);
+    }
+}
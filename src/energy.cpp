@@ -0,0 +1,207 @@
+#include "energy.h"
+
+#include "battery.h"
+#include "hal.h"
+#include "logging.h"
+#include "uplink.h"
+
+namespace {
+
+constexpr float MICROAMP_MICROSECONDS_PER_MAH = 3.6e12f;
+constexpr float US_PER_DAY = 86400e6f;
+
+void put32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t seconds(uint64_t us) {
+    return static_cast<uint32_t>(us / 1000000);
+}
+
+uint32_t microAmpHours(float mAh) {
+    return static_cast<uint32_t>(mAh * 1000 + 0.5f);
+}
+
+}  // namespace
+
+EnergyLedger energyLedger(ENERGY_PROFILE);
+
+void EnergyLedger::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    startUs = lastUs = hal::micros();
+    for (uint8_t state = 0; state < POWER_STATE_COUNT; state++) {
+        stateUs[state] = 0;
+    }
+    for (uint8_t task = 0; task < ENERGY_TASK_COUNT; task++) {
+        taskUs[task] = taskRadioCharge[task] = taskRadioUs[task] = 0;
+        awake[task] = false;
+    }
+    awakeCount = 0;
+    radio = false;
+    radioUs = 0;
+    radioBytes = 0;
+}
+
+void EnergyLedger::taskAwake(EnergyTask task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint8_t index = static_cast<uint8_t>(task);
+    if (index >= ENERGY_TASK_COUNT || awake[index]) {
+        return;
+    }
+    advance(hal::micros());
+    awake[index] = true;
+    awakeCount++;
+}
+
+void EnergyLedger::taskAsleep(EnergyTask task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint8_t index = static_cast<uint8_t>(task);
+    if (index >= ENERGY_TASK_COUNT || !awake[index]) {
+        return;
+    }
+    advance(hal::micros());
+    awake[index] = false;
+    awakeCount--;
+}
+
+void EnergyLedger::radioOn(EnergyTask holder) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (radio || static_cast<uint8_t>(holder) >= ENERGY_TASK_COUNT) {
+        return;
+    }
+    advance(hal::micros());
+    radio = true;
+    radioHolder = holder;
+    radioUs = 0;
+    radioBytes = 0;
+}
+
+void EnergyLedger::radioSent(uint32_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (radio) {
+        radioBytes += bytes;
+    }
+}
+
+void EnergyLedger::radioOff() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!radio) {
+        return;
+    }
+    advance(hal::micros());
+    uint64_t txUs = static_cast<uint64_t>(radioBytes) * profile.radioTxUsPerByte;
+    txUs = txUs < radioUs ? txUs : radioUs;
+    uint64_t rxUs = radioUs - txUs;
+    stateUs[static_cast<uint8_t>(PowerState::RadioTx)] += txUs;
+    stateUs[static_cast<uint8_t>(PowerState::RadioRx)] += rxUs;
+    uint8_t holder = static_cast<uint8_t>(radioHolder);
+    taskRadioUs[holder] += radioUs;
+    taskRadioCharge[holder] += txUs * profile.microAmps[static_cast<uint8_t>(PowerState::RadioTx)] +
+                               rxUs * profile.microAmps[static_cast<uint8_t>(PowerState::RadioRx)];
+    radio = false;
+    radioUs = 0;
+    radioBytes = 0;
+}
+
+bool EnergyLedger::radioIsOn() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return radio;
+}
+
+EnergyReport EnergyLedger::report() {
+    std::lock_guard<std::mutex> lock(mutex);
+    advance(hal::micros());
+    EnergyReport report{};
+    report.elapsedUs = lastUs - startUs;
+    for (uint8_t state = 0; state < POWER_STATE_COUNT; state++) {
+        report.stateUs[state] = stateUs[state];
+    }
+    // a radio span still going is RX so far
+    report.stateUs[static_cast<uint8_t>(PowerState::RadioRx)] += radioUs;
+    for (uint8_t state = 0; state < POWER_STATE_COUNT; state++) {
+        report.stateMah[state] = toMah(report.stateUs[state] * profile.microAmps[state]);
+        report.totalMah += report.stateMah[state];
+    }
+    const uint32_t cpuMicroAmps = profile.microAmps[static_cast<uint8_t>(PowerState::CpuActive)];
+    for (uint8_t task = 0; task < ENERGY_TASK_COUNT; task++) {
+        uint64_t radioHeld = taskRadioUs[task];
+        uint64_t charge = taskRadioCharge[task];
+        if (radio && task == static_cast<uint8_t>(radioHolder)) {
+            radioHeld += radioUs;
+            charge += radioUs * profile.microAmps[static_cast<uint8_t>(PowerState::RadioRx)];
+        }
+        report.taskUs[task] = taskUs[task];
+        uint64_t cpuUs = taskUs[task] > radioHeld ? taskUs[task] - radioHeld : 0;
+        report.taskMah[task] = toMah(cpuUs * cpuMicroAmps + charge);
+    }
+    report.averageMilliAmps =
+        report.elapsedUs > 0 ? report.totalMah * 3600e6f / static_cast<float>(report.elapsedUs) : 0;
+    return report;
+}
+
+void EnergyLedger::advance(uint64_t nowUs) {
+    uint64_t us = nowUs > lastUs ? nowUs - lastUs : 0;
+    lastUs = nowUs > lastUs ? nowUs : lastUs;
+    for (uint8_t task = 0; task < ENERGY_TASK_COUNT; task++) {
+        taskUs[task] += awake[task] ? us : 0;
+    }
+    if (radio) {
+        radioUs += us;      // split into TX and RX by radioOff
+    } else if (awakeCount > 0) {
+        stateUs[static_cast<uint8_t>(PowerState::CpuActive)] += us;
+    } else {
+        stateUs[static_cast<uint8_t>(PowerState::LightSleep)] += us;
+    }
+}
+
+float EnergyLedger::toMah(uint64_t microAmpMicroseconds) const {
+    return static_cast<float>(microAmpMicroseconds) / MICROAMP_MICROSECONDS_PER_MAH;
+}
+
+uint16_t daysToEmpty(const EnergyReport &report, float remainingMah) {
+    if (report.totalMah <= 0 || report.elapsedUs == 0) {
+        return UINT16_MAX;
+    }
+    if (remainingMah <= 0) {
+        return 0;
+    }
+    float mahPerDay = report.totalMah * US_PER_DAY / static_cast<float>(report.elapsedUs);
+    float days = remainingMah / mahPerDay;
+    return days < UINT16_MAX ? static_cast<uint16_t>(days) : UINT16_MAX;
+}
+
+size_t encodeEnergyReport(const EnergyReport &report, uint16_t days, uint8_t *out, size_t capacity) {
+    if (capacity < ENERGY_STATUS_SIZE) {
+        return 0;
+    }
+    size_t length = 0;
+    out[length++] = STATUS_ENERGY;
+    put32(out + length, seconds(report.elapsedUs));
+    length += 4;
+    for (uint8_t state = 0; state < POWER_STATE_COUNT; state++) {
+        put32(out + length, seconds(report.stateUs[state]));
+        put32(out + length + 4, microAmpHours(report.stateMah[state]));
+        length += 8;
+    }
+    for (uint8_t task = 0; task < ENERGY_TASK_COUNT; task++) {
+        put32(out + length, seconds(report.taskUs[task]));
+        put32(out + length + 4, microAmpHours(report.taskMah[task]));
+        length += 8;
+    }
+    out[length++] = static_cast<uint8_t>(days);
+    out[length++] = static_cast<uint8_t>(days >> 8);
+    return length;
+}
+
+void reportEnergy(EnergyLedger &ledger) {
+    EnergyReport report = ledger.report();
+    float remainingMah = batteryMonitor.hasReading() ? batteryMonitor.remainingMah()
+                                                     : static_cast<float>(BATTERY_CAPACITY_MAH) - report.totalMah;
+    uint16_t days = daysToEmpty(report, remainingMah);
+    logFile.addLogRow(LogCode::DaysToEmpty, days);
+    uint8_t payload[ENERGY_STATUS_SIZE];
+    size_t length = encodeEnergyReport(report, days, payload, sizeof(payload));
+    uplink.enqueue(MessageType::Status, payload, length);
+}
@@ -0,0 +1,114 @@
+#include "event_dispatch.h"
+
+#include "config.h"
+#include "hal.h"
+#include "logging.h"
+#include "uplink.h"
+
+namespace {
+
+constexpr uint32_t CYCLE_TIMED_MAX_US = (1ULL << 31) / CPU_FREQUENCY_MHZ;   // half the cycle counter's wrap
+constexpr uint32_t MAX_RUNS_LOGGED = 0xFF;
+constexpr uint32_t MAX_MS_LOGGED = 0xFFFFF;
+
+void put32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+}  // namespace
+
+EventTimings eventTimings;
+
+uint8_t eventTimingBucket(uint32_t us) {
+    uint8_t bucket = 0;
+    while (us >= 4 && bucket < EVENT_TIMING_BUCKETS - 1) {
+        us >>= 2;
+        bucket++;
+    }
+    return bucket;
+}
+
+void EventTimings::record(EventType type, uint32_t us) {
+    uint8_t index = static_cast<uint8_t>(type);
+    if (index >= EVENT_TYPE_COUNT) {
+        return;
+    }
+    EventTiming &timing = timings[index];
+    timing.count++;
+    timing.minUs = us < timing.minUs ? us : timing.minUs;
+    timing.maxUs = us > timing.maxUs ? us : timing.maxUs;
+    uint16_t &bucket = timing.buckets[eventTimingBucket(us)];
+    if (bucket < UINT16_MAX) {
+        bucket++;
+    }
+}
+
+void EventTimings::reset() {
+    for (EventTiming &timing : timings) {
+        timing = EventTiming{0, UINT32_MAX, 0, {}};
+    }
+}
+
+void dispatchEvent(const EventHandler (&handlers)[EVENT_TYPE_COUNT], EventType type, EventTimings &timings) {
+    uint8_t index = static_cast<uint8_t>(type);
+    if (index >= EVENT_TYPE_COUNT || handlers[index] == nullptr) {
+        return;
+    }
+    uint64_t startUs = hal::micros();
+    uint32_t startCycles = hal::cpuCycles();
+    handlers[index]();
+    uint32_t cycles = hal::cpuCycles() - startCycles;
+    uint64_t us = hal::micros() - startUs;
+    if (us < CYCLE_TIMED_MAX_US) {
+        us = cycles / CPU_FREQUENCY_MHZ;
+    }
+    timings.record(type, us < UINT32_MAX ? static_cast<uint32_t>(us) : UINT32_MAX);
+}
+
+size_t encodeEventTimings(const EventTimings &timings, uint8_t *out, size_t capacity) {
+    if (capacity < 1) {
+        return 0;
+    }
+    size_t length = 0;
+    out[length++] = STATUS_EVENT_TIMINGS;
+    for (uint8_t index = 0; index < EVENT_TYPE_COUNT; index++) {
+        const EventTiming &timing = timings.of(static_cast<EventType>(index));
+        if (timing.count == 0 || length + EVENT_TIMING_RECORD_SIZE > capacity) {
+            continue;
+        }
+        out[length++] = index;
+        put32(out + length, timing.count);
+        put32(out + length + 4, timing.minUs);
+        put32(out + length + 8, timing.maxUs);
+        length += 12;
+        for (uint16_t bucket : timing.buckets) {
+            out[length++] = static_cast<uint8_t>(bucket);
+            out[length++] = static_cast<uint8_t>(bucket >> 8);
+        }
+    }
+    return length > 1 ? length : 0;
+}
+
+uint32_t packEventTiming(EventType type, const EventTiming &timing) {
+    uint32_t runs = timing.count < MAX_RUNS_LOGGED ? timing.count : MAX_RUNS_LOGGED;
+    uint32_t slowestMs = (timing.maxUs + 999) / 1000;
+    slowestMs = slowestMs < MAX_MS_LOGGED ? slowestMs : MAX_MS_LOGGED;
+    return (static_cast<uint32_t>(type) << 28) | (runs << 20) | slowestMs;
+}
+
+void reportEventTimings(EventTimings &timings) {
+    for (uint8_t index = 0; index < EVENT_TYPE_COUNT; index++) {
+        EventType type = static_cast<EventType>(index);
+        if (timings.of(type).count > 0) {
+            logFile.addLogRow(LogCode::EventTiming, packEventTiming(type, timings.of(type)));
+        }
+    }
+    uint8_t payload[MAX_EVENT_TIMINGS_SIZE];
+    size_t length = encodeEventTimings(timings, payload, sizeof(payload));
+    if (length > 0) {
+        uplink.enqueue(MessageType::Status, payload, length);
+    }
+    timings.reset();
+}
@@ -0,0 +1,141 @@
+#include "events.h"
+
+#include "battery.h"
+#include "clock_drift.h"
+#include "data_codec.h"
+#include "device_status.h"
+#include "energy.h"
+#include "event_dispatch.h"
+#include "hal.h"
+#include "logging.h"
+#include "setup_console.h"
+#include "tx_slots.h"
+
+static_assert(maxEncodedDataSize(DATA_TABLE_CAPACITY) <= static_cast<size_t>(TRANSFER_MAX_CHUNKS) * TRANSFER_CHUNK_SIZE,
+              "a full data table must fit in one chunked transfer");
+static_assert(LOG_FILE_SIZE <= static_cast<size_t>(TRANSFER_MAX_CHUNKS) * TRANSFER_CHUNK_SIZE,
+              "the log file must fit in one chunked transfer");
+
+EventRing<Event, EVENTS_RING_LENGTH> eventsRing;
+
+namespace {
+
+// sends to the main server, and counts the result in the device status
+bool sendAndRecord(MessageType type, const uint8_t *payload, size_t length, TransferStats *stats = nullptr) {
+    bool delivered = sendChunkedToMainServer(type, payload, length, stats);
+    recordMainServerSend(delivered, static_cast<recordTimeType>(epochNow() % (24 * 60 * 60) / 60));
+    return delivered;
+}
+
+// counts a send of the table in the tx slot state: a busy server gets it again after the backoff, a crowded slot
+// is renegotiated
+void recordTxSend(bool delivered, const TransferStats &stats) {
+    uint32_t deviceId = 0;
+    hal::nvsGet(NVS_KEY_DEVICE_ID, &deviceId, sizeof(deviceId));
+    uint32_t now = epochNow();
+    uint32_t retryS = txSlotState.onSend(delivered, stats.busy, stats.retryAfterS, deviceId, now);
+    if (retryS > 0) {
+        logFile.addLogRow(LogCode::MainServerBusy, retryS);
+        retryTxAt(now + retryS);
+    }
+    if (txSlotState.shouldRenegotiate()) {
+        enqueueEvent(EventType::ChangeTxTimes, 3);
+    }
+}
+
+}  // namespace
+
+bool enqueueEvent(EventType eventType, uint8_t priority) {
+    return eventsRing.tryPush(Event{eventType, priority});
+}
+
+void onSetup() {
+    // 1. - 7. the dialogue: networks, servers and the plate weight, stored by the console's `done`
+    setupConsole.begin();
+    if (!setupConsole.run(CONSOLE_IDLE_TIMEOUT_MS)) {
+        constexpr char TIMED_OUT[] = "\r\nno input for a while, setup ends. what wasn't saved is lost\r\n";
+        hal::serialWrite(TIMED_OUT, sizeof(TIMED_OUT) - 1);
+        return;
+    }
+    // 8. + 9. the networkings task connects with the new settings, and the clock syncs
+    enqueueEvent(EventType::CalibrateClock, 1);
+}
+
+void onCheckDeviceStatus() {
+    logFile.addLogRow(LogCode::StatusCheck);
+    // 1.1. battery power. 3. log the results
+    reportBattery();
+    reportEventTimings();
+    reportEnergy();
+}
+
+void onSendData() {
+    enqueueEvent(EventType::SendLogFile, 1);
+
+    // 1. encode the table. records the sensing task adds meanwhile go after the snapshot and stay for the next send
+    static uint8_t payload[maxEncodedDataSize(DATA_TABLE_CAPACITY)];
+    DataTable::Snapshot sent = dataTable.snapshot();
+    size_t length = encodeDataTable(dataTable.readTable(sent), payload, sizeof(payload));
+    if (length > 0 && dataPayloadChecksum(payload, length) != sent.checksum) {
+        logFile.addLogRow(LogCode::ChecksumMismatch);   // flash gave back other records than were appended
+    }
+
+    // 2. - 4. send it in checksummed chunks, resending only the ones that didn't arrive intact
+    TransferStats stats;
+    bool delivered = sendAndRecord(MessageType::DataTable, payload, length, &stats);
+    recordTxSend(delivered, stats);
+    if (!delivered) {
+        return;     // communication error: keep the table for the retry or the next tx time, the server keeps the chunks it has
+    }
+    // 5. + 6. drop the records that were sent
+    dataTable.deleteThrough(sent);
+}
+
+void onSendLogFile() {
+    static uint8_t file[LOG_FILE_SIZE];
+    uint32_t through = logFile.seal();
+    size_t length = logFile.readLogFile(file, sizeof(file), through);
+    if (length == 0) {
+        return;
+    }
+    if (!sendAndRecord(MessageType::LogFile, file, length)) {
+        return;     // keep the log for the next try
+    }
+    logFile.deleteThrough(through);     // rows logged during the send stay
+}
+
+void onChangeTxTimes() {
+    // 1. ask the server, telling it how crowded the current slots are
+    TxSlot slots[2];
+    if (!requestTxSlots(txSlotState.failures(), slots)) {
+        logFile.addLogRow(LogCode::MainServerUnreachable);
+        return;
+    }
+    // 2. store them
+    if (!storeTxSlots(slots)) {
+        logFile.addLogRow(LogCode::CommError);
+        return;
+    }
+    txSlotState.renegotiated();
+    logFile.addLogRow(LogCode::TxTimesChanged, static_cast<uint32_t>(slots[0].startMinute) << 16 | slots[1].startMinute);
+    // 3. and send at the device's offsets into them from now on
+    rescheduleTxTimes();
+}
+
+void onCalibrateClock() {
+    // 1. + 2. how far off the local clock is
+    int64_t offsetMs = 0;
+    if (!requestNtpOffset(offsetMs)) {
+        logFile.addLogRow(LogCode::NtpUnreachable);
+        return;
+    }
+    // 3. step the clock, and fit the drift that corrects it until the next sync
+    uint32_t local = hal::epochSeconds();
+    int32_t stepS = clockDrift.addSync(local, offsetMs);
+    hal::setEpochSeconds(static_cast<uint32_t>(static_cast<int64_t>(local) + stepS));
+    // 4. log both
+    logFile.addLogRow(LogCode::ClockCalibrated, static_cast<uint32_t>(stepS));
+    if (clockDrift.syncs() >= 2) {
+        logFile.addLogRow(LogCode::ClockDrift, static_cast<uint32_t>(clockDrift.ratePpb() / 1000));
+    }
+}
@@ -0,0 +1,227 @@
+#include "flash_log.h"
+
+#include <algorithm>
+
+#include "checksum.h"
+#include "config.h"
+
+namespace {
+
+constexpr uint32_t SECTOR_MAGIC = 0x314C4644;   // "DFL1"
+constexpr uint8_t HEADER_CRC_OFFSET = 12;
+constexpr uint8_t STREAM_COUNT = 3;
+
+uint32_t load32(const uint8_t *bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+void store32(uint8_t *bytes, uint32_t value) {
+    for (uint8_t i = 0; i < 4; i++) {
+        bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+bool isErased(const uint8_t *bytes, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        if (bytes[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+FlashLog flashStore;
+
+bool FlashLog::mount(const char *label) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!partition.isOpen() && !partition.open(label)) {
+        return false;
+    }
+    uint32_t count = partition.size() / hal::FLASH_SECTOR_SIZE;
+    sectorCount = static_cast<uint8_t>(count < MAX_SECTORS ? count : MAX_SECTORS);
+    if (!hal::nvsGet(NVS_KEY_STREAM_EPOCHS, epochs, sizeof(epochs))) {
+        epochs[2] = 0;
+        if (!hal::nvsGet(NVS_KEY_STREAM_EPOCHS, epochs, 2 * sizeof(epochs[0]))) {     // stored before the Uplink stream
+            epochs[0] = epochs[1] = 0;
+        }
+    }
+    if (!hal::nvsGet(NVS_KEY_STREAM_FLOORS, floors, sizeof(floors))) {
+        floors[0] = floors[1] = floors[2] = 0;
+    }
+
+    lastSequence = 0;
+    newestSector = -1;
+    for (uint8_t i = 0; i < sectorCount; i++) {
+        const uint8_t *bytes = partition.data() + i * hal::FLASH_SECTOR_SIZE;
+        Sector &sector = sectors[i];
+        sector = Sector{0, 0, 0, 0, false, false};
+        if (isErased(bytes, hal::FLASH_SECTOR_SIZE)) {
+            sector.erased = true;
+            continue;
+        }
+        uint8_t stream = bytes[10];
+        if (load32(bytes) != SECTOR_MAGIC || stream == 0 || stream > STREAM_COUNT ||
+            load32(bytes + HEADER_CRC_OFFSET) != crc32(bytes, HEADER_CRC_OFFSET)) {
+            continue;   // torn header or foreign data: garbage, erased when it's reused
+        }
+        sector.sequence = load32(bytes + 4);
+        sector.epoch = static_cast<uint16_t>(bytes[8] | (bytes[9] << 8));
+        sector.stream = stream;
+        uint16_t used = MAX_APPEND;
+        while (used > 0 && bytes[SECTOR_HEADER_SIZE + used - 1] == 0xFF) {
+            used--;
+        }
+        sector.used = used;
+        if (newestSector < 0 || sector.sequence > lastSequence) {
+            lastSequence = sector.sequence;
+            newestSector = i;
+        }
+    }
+    for (uint32_t floor : floors) {
+        lastSequence = std::max(lastSequence, floor);   // new sectors stay above the floors, even on a wiped partition
+    }
+    return true;
+}
+
+bool FlashLog::isMounted() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sectorCount > 0;
+}
+
+bool FlashLog::append(StreamId stream, const void *data, uint16_t length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (sectorCount == 0 || length == 0 || length > MAX_APPEND) {
+        return false;
+    }
+    int16_t index = writableSector(stream, length);
+    if (index < 0) {
+        index = allocateSector(stream);
+        if (index < 0) {
+            return false;
+        }
+    }
+    Sector &sector = sectors[index];
+    uint32_t offset = index * hal::FLASH_SECTOR_SIZE + SECTOR_HEADER_SIZE + sector.used;
+    if (!partition.write(offset, data, length)) {
+        return false;
+    }
+    sector.used += length;
+    return true;
+}
+
+void FlashLog::clear(StreamId stream) {
+    std::lock_guard<std::mutex> lock(mutex);
+    epochOf(stream)++;
+    hal::nvsSet(NVS_KEY_STREAM_EPOCHS, epochs, sizeof(epochs));
+    hal::nvsCommit();
+}
+
+uint32_t FlashLog::seal(StreamId stream) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t newest = 0;
+    for (uint8_t i = 0; i < sectorCount; i++) {
+        if (isLive(sectors[i], stream)) {
+            sectors[i].sealed = true;
+            newest = std::max(newest, sectors[i].sequence);
+        }
+    }
+    return newest;
+}
+
+void FlashLog::clearThrough(StreamId stream, uint32_t sequence) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t &floor = floors[static_cast<uint8_t>(stream) - 1];
+    if (sequence <= floor) {
+        return;
+    }
+    floor = sequence;
+    hal::nvsSet(NVS_KEY_STREAM_FLOORS, floors, sizeof(floors));
+    hal::nvsCommit();
+}
+
+uint32_t FlashLog::size(StreamId stream) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < sectorCount; i++) {
+        if (isLive(sectors[i], stream)) {
+            total += sectors[i].used;
+        }
+    }
+    return total;
+}
+
+bool FlashLog::firstSegment(StreamId stream, FlashSegment &segment) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return findSegment(stream, 0, segment);
+}
+
+bool FlashLog::nextSegment(StreamId stream, const FlashSegment &after, FlashSegment &segment) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return findSegment(stream, after.sequence, segment);
+}
+
+bool FlashLog::isLive(const Sector &sector, StreamId stream) const {
+    return sector.stream == static_cast<uint8_t>(stream) && sector.epoch == epochOf(stream) &&
+           sector.sequence > floorOf(stream);
+}
+
+bool FlashLog::findSegment(StreamId stream, uint32_t afterSequence, FlashSegment &segment) const {
+    int16_t found = -1;
+    for (uint8_t i = 0; i < sectorCount; i++) {
+        const Sector &sector = sectors[i];
+        if (isLive(sector, stream) && sector.used > 0 && sector.sequence > afterSequence &&
+            (found < 0 || sector.sequence < sectors[found].sequence)) {
+            found = i;
+        }
+    }
+    if (found < 0) {
+        return false;
+    }
+    segment = FlashSegment{partition.data() + found * hal::FLASH_SECTOR_SIZE + SECTOR_HEADER_SIZE, sectors[found].used,
+                           sectors[found].sequence};
+    return true;
+}
+
+int16_t FlashLog::writableSector(StreamId stream, uint16_t length) const {
+    // only the stream's newest sector is appended to, so the order of the data is the order of the sectors
+    int16_t newest = -1;
+    for (uint8_t i = 0; i < sectorCount; i++) {
+        if (isLive(sectors[i], stream) && (newest < 0 || sectors[i].sequence > sectors[newest].sequence)) {
+            newest = i;
+        }
+    }
+    return newest >= 0 && !sectors[newest].sealed && sectors[newest].used + length <= MAX_APPEND ? newest : -1;
+}
+
+int16_t FlashLog::allocateSector(StreamId stream) {
+    for (uint8_t step = 1; step <= sectorCount; step++) {
+        uint8_t index = static_cast<uint8_t>((newestSector + step) % sectorCount);
+        Sector &sector = sectors[index];
+        if (sector.stream != 0 && isLive(sector, static_cast<StreamId>(sector.stream))) {
+            continue;
+        }
+        if (!sector.erased && !partition.eraseSector(index)) {
+            continue;
+        }
+        uint8_t header[SECTOR_HEADER_SIZE];
+        store32(header, SECTOR_MAGIC);
+        store32(header + 4, lastSequence + 1);
+        header[8] = static_cast<uint8_t>(epochOf(stream));
+        header[9] = static_cast<uint8_t>(epochOf(stream) >> 8);
+        header[10] = static_cast<uint8_t>(stream);
+        header[11] = 0xFF;
+        store32(header + HEADER_CRC_OFFSET, crc32(header, HEADER_CRC_OFFSET));
+        sector = Sector{lastSequence + 1, epochOf(stream), 0, static_cast<uint8_t>(stream), false, false};
+        if (!partition.write(index * hal::FLASH_SECTOR_SIZE, header, SECTOR_HEADER_SIZE)) {
+            sector.stream = 0;  // half a header is garbage
+            continue;
+        }
+        lastSequence++;
+        newestSector = index;
+        return index;
+    }
+    return -1;
+}
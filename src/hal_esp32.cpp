@@ -0,0 +1,402 @@
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <cstring>
+#include <sys/time.h>
+
+#include "config.h"
+#include "driver/gpio.h"
+#include "esp_hmac.h"
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hal.h"
+
+namespace {
+
+constexpr const char *NVS_NAMESPACE = "daphi";
+constexpr int MAX_SOCKETS = 4;
+constexpr int MAX_TIMERS = 4;
+constexpr uint8_t HX711_BITS = 24;
+constexpr uint32_t HX711_POWER_DOWN_US = 70;    // SCK high for more than 60us powers the HX711 down
+constexpr uint16_t NTP_PORT = 123;
+constexpr size_t NTP_PACKET_SIZE = 48;
+constexpr uint32_t NTP_UNIX_OFFSET_S = 2208988800UL;    // 1900-01-01 to 1970-01-01
+
+Preferences preferences;
+bool preferencesOpen = false;
+
+WiFiClient clients[MAX_SOCKETS];
+esp_timer_handle_t timers[MAX_TIMERS] = {};
+portMUX_TYPE loadCellMux = portMUX_INITIALIZER_UNLOCKED;
+
+Preferences &nvs() {
+    if (!preferencesOpen) {
+        preferencesOpen = preferences.begin(NVS_NAMESPACE, false);
+    }
+    return preferences;
+}
+
+WiFiClient *clientAt(int socket) {
+    return socket >= 0 && socket < MAX_SOCKETS ? &clients[socket] : nullptr;
+}
+
+int64_t localEpochMs() {
+    timeval now;
+    gettimeofday(&now, nullptr);
+    return static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+}
+
+// an NTP timestamp (seconds since 1900, 32.32 fixed point, big endian) at bytes, ms since 1970
+int64_t fromNtpTimestamp(const uint8_t *bytes) {
+    uint32_t seconds = static_cast<uint32_t>(bytes[0]) << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
+    uint32_t fraction = static_cast<uint32_t>(bytes[4]) << 24 | bytes[5] << 16 | bytes[6] << 8 | bytes[7];
+    return (static_cast<int64_t>(seconds) - NTP_UNIX_OFFSET_S) * 1000 + ((static_cast<uint64_t>(fraction) * 1000) >> 32);
+}
+
+}  // namespace
+
+namespace hal {
+
+/* ---- clock ---- */
+uint32_t millis() {
+    return ::millis();
+}
+
+uint64_t micros() {
+    return static_cast<uint64_t>(esp_timer_get_time());
+}
+
+uint32_t cpuCycles() {
+    return ESP.getCycleCount();
+}
+
+void sleepMs(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+uint32_t epochSeconds() {
+    time_t now = time(nullptr);
+    return now > 0 ? static_cast<uint32_t>(now) : 0;
+}
+
+void setEpochSeconds(uint32_t seconds) {
+    timeval now = {static_cast<time_t>(seconds), 0};
+    settimeofday(&now, nullptr);
+}
+
+/* ---- one-shot timers ---- */
+int timerCreate(TimerHandler handler, void *arg) {
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        if (timers[i] == nullptr) {
+            esp_timer_create_args_t args = {};
+            args.callback = handler;
+            args.arg = arg;
+            args.dispatch_method = ESP_TIMER_TASK;
+            args.name = "hal";
+            return esp_timer_create(&args, &timers[i]) == ESP_OK ? i : -1;
+        }
+    }
+    return -1;
+}
+
+void timerStartOnce(int timer, uint64_t delayUs) {
+    if (timer < 0 || timer >= MAX_TIMERS || timers[timer] == nullptr) {
+        return;
+    }
+    esp_timer_stop(timers[timer]);      // fails harmlessly when it isn't armed
+    esp_timer_start_once(timers[timer], delayUs);
+}
+
+void timerStop(int timer) {
+    if (timer >= 0 && timer < MAX_TIMERS && timers[timer] != nullptr) {
+        esp_timer_stop(timers[timer]);
+    }
+}
+
+/* ---- tasks ---- */
+bool startTask(TaskFunction function, const char *name, uint32_t stackBytes, uint8_t priority, void *arg) {
+    return xTaskCreate(function, name, stackBytes, arg, priority, nullptr) == pdPASS;
+}
+
+/* ---- GPIO ---- */
+void pinModeOutput(gpio pin) {
+    ::pinMode(pin, OUTPUT);
+}
+
+void pinModeInput(gpio pin, bool pullUp) {
+    ::pinMode(pin, pullUp ? INPUT_PULLUP : INPUT);
+}
+
+void digitalWrite(gpio pin, bool high) {
+    ::digitalWrite(pin, high ? HIGH : LOW);
+}
+
+bool digitalRead(gpio pin) {
+    return ::digitalRead(pin) == HIGH;
+}
+
+void attachFallingEdgeInterrupt(gpio pin, InterruptHandler handler) {
+    ::attachInterrupt(digitalPinToInterrupt(pin), handler, FALLING);
+    // light sleep only wakes on a level: low is what a falling edge leaves behind
+    gpio_wakeup_enable(static_cast<gpio_num_t>(pin), GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+}
+
+void detachInterrupt(gpio pin) {
+    gpio_wakeup_disable(static_cast<gpio_num_t>(pin));
+    ::detachInterrupt(digitalPinToInterrupt(pin));
+}
+
+/* ---- ADC ---- */
+uint32_t analogReadMilliVolts(gpio pin) {
+    return ::analogReadMilliVolts(pin);     // applies the eFuse calibration
+}
+
+/* ---- HX711 ---- */
+void loadCellBegin() {
+    ::pinMode(HX711_SCK, OUTPUT);
+    ::pinMode(HX711_DOUT, INPUT);
+    ::digitalWrite(HX711_SCK, LOW);
+}
+
+bool IRAM_ATTR loadCellIsReady() {
+    return ::digitalRead(HX711_DOUT) == LOW;
+}
+
+int32_t IRAM_ATTR loadCellReadRaw() {
+    uint32_t value = 0;
+    // the clock pulses must stay short (SCK high < 50us), so nothing may preempt us while shifting.
+    // the _SAFE variants, since the DOUT interrupt handler reads from the ISR
+    portENTER_CRITICAL_SAFE(&loadCellMux);
+    for (uint8_t bit = 0; bit < HX711_BITS; bit++) {
+        ::digitalWrite(HX711_SCK, HIGH);
+        delayMicroseconds(1);
+        value = (value << 1) | (::digitalRead(HX711_DOUT) == HIGH ? 1 : 0);
+        ::digitalWrite(HX711_SCK, LOW);
+        delayMicroseconds(1);
+    }
+    // one more pulse selects channel A, gain 128 for the next conversion
+    ::digitalWrite(HX711_SCK, HIGH);
+    delayMicroseconds(1);
+    ::digitalWrite(HX711_SCK, LOW);
+    portEXIT_CRITICAL_SAFE(&loadCellMux);
+
+    if (value & 0x800000) {
+        value |= 0xFF000000;    // sign-extend the 24 bit two's complement value
+    }
+    return static_cast<int32_t>(value);
+}
+
+void loadCellPowerDown() {
+    ::digitalWrite(HX711_SCK, LOW);
+    ::digitalWrite(HX711_SCK, HIGH);
+    delayMicroseconds(HX711_POWER_DOWN_US);
+}
+
+void loadCellPowerUp() {
+    ::digitalWrite(HX711_SCK, LOW);
+}
+
+/* ---- NVS ---- */
+bool nvsGet(const char *key, void *value, size_t length) {
+    if (!nvs().isKey(key) || nvs().getBytesLength(key) != length) {
+        return false;
+    }
+    return nvs().getBytes(key, value, length) == length;
+}
+
+bool nvsSet(const char *key, const void *value, size_t length) {
+    return nvs().putBytes(key, value, length) == length;
+}
+
+bool nvsErase(const char *key) {
+    return !nvs().isKey(key) || nvs().remove(key);
+}
+
+bool nvsCommit() {
+    return true;    // Preferences commits every put / remove before returning
+}
+
+/* ---- flash partitions ---- */
+bool FlashPartition::open(const char *label) {
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == nullptr) {
+        return false;
+    }
+    const void *pointer = nullptr;
+    spi_flash_mmap_handle_t mmapHandle;
+    if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &pointer, &mmapHandle) != ESP_OK) {
+        return false;
+    }
+    handle = partition;
+    mapped = static_cast<const uint8_t *>(pointer);
+    length = partition->size;
+    return true;
+}
+
+bool FlashPartition::write(uint32_t offset, const void *data, uint32_t count) {
+    // esp_partition_write invalidates the cache, so the mapped view sees the new bytes right away
+    return handle != nullptr &&
+           esp_partition_write(static_cast<const esp_partition_t *>(handle), offset, data, count) == ESP_OK;
+}
+
+bool FlashPartition::eraseSector(uint32_t sector) {
+    return handle != nullptr && esp_partition_erase_range(static_cast<const esp_partition_t *>(handle),
+                                                          sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE) == ESP_OK;
+}
+
+/* ---- Wi-Fi station ---- */
+uint8_t wifiScan(WifiAccessPoint *found, uint8_t capacity) {
+    WiFi.mode(WIFI_STA);
+    int16_t count = WiFi.scanNetworks(false, false, false, WIFI_SCAN_MS_PER_CHANNEL);
+    uint8_t kept = 0;
+    for (int16_t i = 0; i < count && kept < capacity; i++) {    // the driver sorts by RSSI
+        WifiAccessPoint &accessPoint = found[kept++];
+        strlcpy(accessPoint.ssid, WiFi.SSID(i).c_str(), sizeof(accessPoint.ssid));
+        memcpy(accessPoint.bssid, WiFi.BSSID(i), sizeof(accessPoint.bssid));
+        accessPoint.channel = static_cast<uint8_t>(WiFi.channel(i));
+        accessPoint.rssi = static_cast<int8_t>(WiFi.RSSI(i));
+    }
+    WiFi.scanDelete();
+    return kept;
+}
+
+bool wifiConnect(const char *ssid, const char *password, const WifiAccessPoint *accessPoint, const WifiLease *lease,
+                 uint32_t timeoutMs) {
+    WiFi.mode(WIFI_STA);
+    if (lease != nullptr) {
+        WiFi.config(IPAddress(lease->ip), IPAddress(lease->gateway), IPAddress(lease->netmask), IPAddress(lease->dns));
+    } else {
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);     // DHCP
+    }
+    WiFi.begin(ssid, password, accessPoint != nullptr ? accessPoint->channel : 0,
+               accessPoint != nullptr ? accessPoint->bssid : nullptr, true);
+    if (WiFi.waitForConnectResult(timeoutMs) != WL_CONNECTED) {
+        WiFi.disconnect();
+        return false;
+    }
+    return true;
+}
+
+bool wifiLease(WifiLease &lease) {
+    if (WiFi.status() != WL_CONNECTED) {
+        return false;
+    }
+    lease = WifiLease{static_cast<uint32_t>(WiFi.localIP()), static_cast<uint32_t>(WiFi.gatewayIP()),
+                      static_cast<uint32_t>(WiFi.subnetMask()), static_cast<uint32_t>(WiFi.dnsIP())};
+    return true;
+}
+
+void wifiDisconnect() {
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+}
+
+/* ---- TCP sockets ---- */
+int socketConnect(const char *host, uint16_t port, uint32_t timeoutMs) {
+    for (int i = 0; i < MAX_SOCKETS; i++) {
+        if (!clients[i].connected()) {
+            return clients[i].connect(host, port, static_cast<int32_t>(timeoutMs)) ? i : INVALID_SOCKET;
+        }
+    }
+    return INVALID_SOCKET;
+}
+
+int32_t socketSend(int socket, const void *data, size_t length) {
+    WiFiClient *client = clientAt(socket);
+    if (client == nullptr || !client->connected()) {
+        return -1;
+    }
+    return static_cast<int32_t>(client->write(static_cast<const uint8_t *>(data), length));
+}
+
+int32_t socketReceive(int socket, void *buffer, size_t length, uint32_t timeoutMs) {
+    WiFiClient *client = clientAt(socket);
+    if (client == nullptr) {
+        return -1;
+    }
+    uint32_t start = ::millis();
+    while (client->available() == 0) {
+        if (!client->connected()) {
+            return -1;
+        }
+        if (::millis() - start >= timeoutMs) {
+            return 0;
+        }
+        vTaskDelay(1);
+    }
+    return client->read(static_cast<uint8_t *>(buffer), length);
+}
+
+void socketClose(int socket) {
+    if (WiFiClient *client = clientAt(socket)) {
+        client->stop();
+    }
+}
+
+/* ---- NTP ---- */
+bool ntpOffsetMs(const char *server, uint32_t timeoutMs, int64_t &offsetMs) {
+    WiFiUDP udp;
+    if (!udp.begin(0)) {
+        return false;
+    }
+    uint8_t packet[NTP_PACKET_SIZE] = {0x23};    // LI 0, version 4, mode 3 (client)
+    int64_t sentMs = localEpochMs();
+    bool sent = udp.beginPacket(server, NTP_PORT) && udp.write(packet, sizeof(packet)) == sizeof(packet) && udp.endPacket();
+    uint32_t start = ::millis();
+    bool received = false;
+    while (sent && !received && ::millis() - start < timeoutMs) {
+        received = udp.parsePacket() >= static_cast<int>(NTP_PACKET_SIZE) &&
+                   udp.read(packet, sizeof(packet)) == static_cast<int>(NTP_PACKET_SIZE);
+        if (!received) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    int64_t receivedMs = localEpochMs();
+    udp.stop();
+    if (!received || packet[1] == 0) {    // stratum 0: a kiss-o'-death, no time
+        return false;
+    }
+    // ((server receive - sent) + (server transmit - received)) / 2
+    offsetMs = (fromNtpTimestamp(packet + 32) - sentMs + fromNtpTimestamp(packet + 40) - receivedMs) / 2;
+    return true;
+}
+
+/* ---- device secrets ---- */
+bool deviceKey(uint8_t key[32]) {
+    static const char LABEL[] = "daphi credential vault";
+    // fails while no key is burnt: espefuse.py burn_key BLOCK_KEY<id> <key file> HMAC_UP
+    return esp_hmac_calculate(static_cast<hmac_key_id_t>(VAULT_EFUSE_KEY_ID), LABEL, sizeof(LABEL) - 1, key) == ESP_OK;
+}
+
+void randomBytes(void *buffer, size_t length) {
+    esp_fill_random(buffer, length);
+}
+
+/* ---- serial ---- */
+void serialBegin(uint32_t baud) {
+    Serial.begin(baud);
+}
+
+size_t serialRead(char *buffer, size_t capacity) {
+    size_t count = 0;
+    while (count < capacity && Serial.available() > 0) {
+        buffer[count++] = static_cast<char>(Serial.read());
+    }
+    return count;
+}
+
+void serialWrite(const char *text, size_t length) {
+    Serial.write(reinterpret_cast<const uint8_t *>(text), length);
+}
+
+}  // namespace hal
+
+#endif
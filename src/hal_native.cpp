@@ -0,0 +1,1023 @@
+#ifndef ARDUINO
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "config.h"
+#include "hal.h"
+#include "hal_sim.h"
+
+namespace {
+
+constexpr uint16_t PIN_COUNT = 32;
+constexpr int MAX_SOCKETS = 8;
+constexpr int MAX_TIMERS = 8;
+
+struct Pin {
+    bool output = false;
+    bool level = true;      // inputs idle high (HX711 DOUT is high while converting, the button is pulled up)
+    uint32_t writes = 0;
+    hal::InterruptHandler handler = nullptr;
+};
+
+struct Socket {
+    bool open = false;
+    bool broken = false;
+    std::vector<uint8_t> inbound;
+};
+
+struct AccessPointSim {
+    std::string ssid;
+    std::string password;
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+};
+
+struct TimerSim {
+    hal::TimerHandler handler = nullptr;
+    void *arg = nullptr;
+    bool armed = false;
+    uint64_t dueUs = 0;
+};
+
+struct SerialChunk {
+    uint64_t atUs;          // when it arrives
+    std::string text;
+    size_t read = 0;
+};
+
+struct FlashSim {
+    std::vector<uint8_t> bytes;
+    std::vector<uint32_t> erases;   // per sector
+    uint32_t bytesWritten = 0;
+};
+
+// mirrors partitions.csv
+struct DefaultPartition {
+    const char *label;
+    uint32_t size;
+};
+constexpr DefaultPartition DEFAULT_PARTITIONS[] = {
+    {"storage", 0x20000},
+};
+
+struct SimState {
+    std::recursive_mutex mutex;
+
+    uint64_t nowUs = 0;
+    uint32_t epochAtBoot = 0;
+    uint64_t epochSetAtUs = 0;
+    int64_t epochSetMs = 0;                 // the local clock then
+    int32_t clockDriftPpm = 0;
+    uint32_t ntpEpoch = 0;
+    uint64_t ntpSetAtUs = 0;
+    uint32_t ntpQueries = 0;
+
+    std::vector<SerialChunk> serialInput;   // by arrival
+    char serialOutput[hal::sim::SERIAL_OUTPUT_CAPACITY];   // fixed, so writing never allocates
+    size_t serialOutputLength = 0;
+    uint64_t serialLastWriteUs = 0;
+
+    TimerSim timers[MAX_TIMERS];
+    uint32_t timerFires = 0;
+
+    Pin pins[PIN_COUNT];
+    uint32_t milliVolts[PIN_COUNT] = {};
+    hal::sim::AnalogSource analogSource = nullptr;
+
+    // the HX711: converts on its own clock while powered, and shifts a conversion out on DOUT, one bit per SCK pulse
+    int32_t loadCellRaw = 0;
+    hal::sim::LoadCellSource loadCellSource = nullptr;
+    bool loadCellConnected = true;
+    bool loadCellDown = true;               // until loadCellBegin
+    bool loadCellReady = false;             // a conversion is latched, DOUT went low
+    uint64_t loadCellNextConversionUs = 0;
+    uint32_t loadCellShift = 0;             // the latched conversion, 24 bits
+    uint8_t loadCellPulses = 0;             // SCK pulses into the current read
+    uint32_t loadCellReads = 0;
+
+    std::map<std::string, std::vector<uint8_t>> nvsCommitted;
+    std::map<std::string, std::vector<uint8_t>> nvsPending;
+    std::map<std::string, bool> nvsPendingErase;
+    uint32_t nvsCommits = 0;
+    int64_t nvsWritesLeft = -1;             // before the power cut. -1: no cut coming
+    bool powerCut = false;
+
+    uint8_t deviceKey[32];
+    bool hasDeviceKey = true;
+    uint32_t randomState = 1;
+
+    std::map<std::string, FlashSim> flash;
+
+    std::vector<AccessPointSim> accessPoints;
+    bool wifiConnected = false;
+    hal::WifiLease wifiLease{};
+    uint32_t wifiScans = 0;
+    uint32_t wifiDhcps = 0;
+
+    hal::sim::SocketPeer *peer = nullptr;
+    Socket sockets[MAX_SOCKETS];
+};
+
+SimState &state() {
+    static SimState simState;
+    return simState;
+}
+
+// the host's device key: fixed, so what a test or a benchmark encrypts reads back in the next run
+constexpr uint8_t HOST_DEVICE_KEY[32] = {
+    'd', 'a', 'p', 'h', 'i', ' ', 'h', 'o', 's', 't', ' ', 'd', 'e', 'v', 'i', 'c',
+    'e', ' ', 'k', 'e', 'y', ',', ' ', 'n', 'o', 't', ' ', 's', 'e', 'c', 'r', 't',
+};
+
+// counts an NVS write against the coming power cut. false: the power is gone, the write doesn't happen
+bool nvsWriteGoesThrough(SimState &s) {
+    if (s.nvsWritesLeft == 0) {
+        s.powerCut = true;
+    }
+    if (s.powerCut) {
+        return false;
+    }
+    if (s.nvsWritesLeft > 0) {
+        s.nvsWritesLeft--;
+    }
+    return true;
+}
+
+Pin *pinAt(gpio pin) {
+    return pin < PIN_COUNT ? &state().pins[pin] : nullptr;
+}
+
+constexpr uint8_t HX711_BITS = 24;
+constexpr uint64_t LOAD_CELL_SAMPLE_PERIOD_US = hal::sim::LOAD_CELL_SAMPLE_PERIOD_MS * 1000ULL;
+
+// a value as the HX711 outputs it: 24 bit two's complement, saturated
+uint32_t toLoadCellBits(int32_t value) {
+    value = std::min(std::max(value, -0x800000), 0x7FFFFF);
+    return static_cast<uint32_t>(value) & 0xFFFFFF;
+}
+
+// a rising SCK edge: the HX711 shifts the next bit out on DOUT, MSB first. the 25th pulse ends the read, DOUT goes back
+// high and channel A, gain 128 is selected for the next conversion
+void clockLoadCell(SimState &s) {
+    if (s.loadCellDown || !s.loadCellReady) {
+        return;
+    }
+    s.loadCellPulses++;
+    Pin &dout = s.pins[HX711_DOUT];
+    if (s.loadCellPulses <= HX711_BITS) {
+        dout.level = ((s.loadCellShift >> (HX711_BITS - s.loadCellPulses)) & 1) != 0;
+    } else {
+        dout.level = true;
+        s.loadCellReady = false;
+        s.loadCellPulses = 0;
+        s.loadCellReads++;
+    }
+}
+
+// the strongest access point of the SSID, or the one given by BSSID and channel. nullptr if it isn't there
+const AccessPointSim *findAccessPoint(const char *ssid, const hal::WifiAccessPoint *target) {
+    const AccessPointSim *best = nullptr;
+    for (const AccessPointSim &accessPoint : state().accessPoints) {
+        if (accessPoint.ssid != ssid || (best != nullptr && accessPoint.rssi <= best->rssi)) {
+            continue;
+        }
+        if (target == nullptr || (std::memcmp(accessPoint.bssid, target->bssid, sizeof(accessPoint.bssid)) == 0 &&
+                                  accessPoint.channel == target->channel)) {
+            best = &accessPoint;
+        }
+    }
+    return best;
+}
+
+void scanAllChannels() {
+    state().wifiScans++;
+    hal::sim::advanceMs(hal::sim::WIFI_CHANNELS * WIFI_SCAN_MS_PER_CHANNEL);
+}
+
+// the local clock, ms since 1970: epochSetMs at epochSetAtUs, running clockDriftPpm fast since
+int64_t localEpochMs(const SimState &s) {
+    int64_t elapsedUs = static_cast<int64_t>(s.nowUs - s.epochSetAtUs);
+    return s.epochSetMs + (elapsedUs + elapsedUs * s.clockDriftPpm / 1000000) / 1000;
+}
+
+Socket *socketAt(int socket) {
+    return socket >= 0 && socket < MAX_SOCKETS && state().sockets[socket].open ? &state().sockets[socket] : nullptr;
+}
+
+}  // namespace
+
+namespace hal {
+
+/* ---- clock ---- */
+uint32_t millis() {
+    return static_cast<uint32_t>(micros() / 1000);
+}
+
+uint64_t micros() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return state().nowUs;
+}
+
+uint32_t cpuCycles() {
+    return static_cast<uint32_t>(micros() * CPU_FREQUENCY_MHZ);
+}
+
+void sleepMs(uint32_t ms) {
+    sim::advanceMs(ms);
+}
+
+uint32_t epochSeconds() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (state().epochAtBoot == 0) {
+        return 0;
+    }
+    return static_cast<uint32_t>(localEpochMs(state()) / 1000);
+}
+
+void setEpochSeconds(uint32_t seconds) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().epochAtBoot = seconds;
+    state().epochSetAtUs = state().nowUs;
+    state().epochSetMs = static_cast<int64_t>(seconds) * 1000;
+}
+
+/* ---- one-shot timers ---- */
+int timerCreate(TimerHandler handler, void *arg) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        TimerSim &timer = state().timers[i];
+        if (timer.handler == nullptr) {
+            timer = TimerSim{handler, arg, false, 0};
+            return i;
+        }
+    }
+    return -1;
+}
+
+void timerStartOnce(int timer, uint64_t delayUs) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (timer >= 0 && timer < MAX_TIMERS && state().timers[timer].handler != nullptr) {
+        state().timers[timer].armed = true;
+        state().timers[timer].dueUs = state().nowUs + delayUs;
+    }
+}
+
+void timerStop(int timer) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (timer >= 0 && timer < MAX_TIMERS) {
+        state().timers[timer].armed = false;
+    }
+}
+
+/* ---- tasks ---- */
+bool startTask(TaskFunction function, const char *name, uint32_t stackBytes, uint8_t priority, void *arg) {
+    (void) name;
+    (void) stackBytes;
+    (void) priority;
+    std::thread(function, arg).detach();
+    return true;
+}
+
+/* ---- GPIO ---- */
+void pinModeOutput(gpio pin) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (Pin *p = pinAt(pin)) {
+        p->output = true;
+        p->level = false;
+    }
+}
+
+void pinModeInput(gpio pin, bool pullUp) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (Pin *p = pinAt(pin)) {
+        p->output = false;
+        p->level = pullUp || p->level;
+    }
+}
+
+void digitalWrite(gpio pin, bool high) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (Pin *p = pinAt(pin)) {
+        bool rising = high && !p->level;
+        p->level = high;
+        p->writes++;
+        if (pin == HX711_SCK && rising) {
+            clockLoadCell(state());
+        }
+    }
+}
+
+bool digitalRead(gpio pin) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    Pin *p = pinAt(pin);
+    return p != nullptr && p->level;
+}
+
+void attachFallingEdgeInterrupt(gpio pin, InterruptHandler handler) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (Pin *p = pinAt(pin)) {
+        p->handler = handler;
+    }
+}
+
+void detachInterrupt(gpio pin) {
+    attachFallingEdgeInterrupt(pin, nullptr);
+}
+
+/* ---- ADC ---- */
+uint32_t analogReadMilliVolts(gpio pin) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (state().analogSource != nullptr) {
+        return state().analogSource(pin, static_cast<uint32_t>(state().nowUs / 1000));
+    }
+    return pin < PIN_COUNT ? state().milliVolts[pin] : 0;
+}
+
+/* ---- HX711 ---- */
+void loadCellBegin() {
+    pinModeOutput(HX711_SCK);
+    pinModeInput(HX711_DOUT, false);
+    loadCellPowerUp();
+}
+
+bool loadCellIsReady() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return !state().loadCellDown && !state().pins[HX711_DOUT].level;
+}
+
+int32_t loadCellReadRaw() {
+    // the same bit-bang as on the ESP32, against the simulated chip
+    uint32_t value = 0;
+    for (uint8_t bit = 0; bit < HX711_BITS; bit++) {
+        digitalWrite(HX711_SCK, true);
+        sim::advanceUs(1);
+        value = (value << 1) | (digitalRead(HX711_DOUT) ? 1 : 0);
+        digitalWrite(HX711_SCK, false);
+        sim::advanceUs(1);
+    }
+    digitalWrite(HX711_SCK, true);
+    sim::advanceUs(1);
+    digitalWrite(HX711_SCK, false);
+
+    if (value & 0x800000) {
+        value |= 0xFF000000;
+    }
+    return static_cast<int32_t>(value);
+}
+
+void loadCellPowerDown() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    s.pins[HX711_SCK].level = true;     // held high: the chip powers down, without clocking a bit out
+    s.pins[HX711_SCK].writes++;
+    s.pins[HX711_DOUT].level = true;
+    s.loadCellDown = true;
+    s.loadCellReady = false;
+    s.loadCellPulses = 0;
+}
+
+void loadCellPowerUp() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    s.pins[HX711_SCK].level = false;
+    s.pins[HX711_SCK].writes++;
+    if (s.loadCellDown) {
+        s.loadCellDown = false;
+        s.loadCellNextConversionUs = s.nowUs + LOAD_CELL_SAMPLE_PERIOD_US;  // the first conversion takes a full period
+    }
+}
+
+/* ---- NVS ---- */
+bool nvsGet(const char *key, void *value, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    if (s.nvsPendingErase.count(key) != 0) {
+        return false;
+    }
+    auto pending = s.nvsPending.find(key);
+    const std::vector<uint8_t> *stored = nullptr;
+    if (pending != s.nvsPending.end()) {
+        stored = &pending->second;
+    } else {
+        auto committed = s.nvsCommitted.find(key);
+        if (committed == s.nvsCommitted.end()) {
+            return false;
+        }
+        stored = &committed->second;
+    }
+    if (stored->size() != length) {
+        return false;
+    }
+    std::memcpy(value, stored->data(), length);
+    return true;
+}
+
+bool nvsSet(const char *key, const void *value, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (!nvsWriteGoesThrough(state())) {
+        return false;
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(value);
+    state().nvsPendingErase.erase(key);
+    state().nvsPending[key] = std::vector<uint8_t>(bytes, bytes + length);
+    return true;
+}
+
+bool nvsErase(const char *key) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (!nvsWriteGoesThrough(state())) {
+        return false;
+    }
+    state().nvsPending.erase(key);
+    state().nvsPendingErase[key] = true;
+    return true;
+}
+
+bool nvsCommit() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    if (!nvsWriteGoesThrough(s)) {
+        return false;
+    }
+    for (auto &entry : s.nvsPendingErase) {
+        s.nvsCommitted.erase(entry.first);
+    }
+    for (auto &entry : s.nvsPending) {
+        s.nvsCommitted[entry.first] = entry.second;
+    }
+    s.nvsPending.clear();
+    s.nvsPendingErase.clear();
+    s.nvsCommits++;
+    return true;
+}
+
+/* ---- flash partitions ---- */
+bool FlashPartition::open(const char *label) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    auto found = state().flash.find(label);
+    if (found == state().flash.end()) {
+        return false;
+    }
+    handle = &found->second;
+    mapped = found->second.bytes.data();
+    length = static_cast<uint32_t>(found->second.bytes.size());
+    return true;
+}
+
+bool FlashPartition::write(uint32_t offset, const void *data, uint32_t count) {
+    {
+        std::lock_guard<std::recursive_mutex> lock(state().mutex);
+        if (handle == nullptr || offset + count > length || offset + count < offset) {
+            return false;
+        }
+        FlashSim *flash = static_cast<FlashSim *>(const_cast<void *>(handle));
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (uint32_t i = 0; i < count; i++) {
+            flash->bytes[offset + i] &= bytes[i];     // NOR flash can only clear bits
+        }
+        flash->bytesWritten += count;
+    }
+    std::this_thread::yield();      // a write blocks the task for a while on the chip: the others run meanwhile
+    return true;
+}
+
+bool FlashPartition::eraseSector(uint32_t sector) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (handle == nullptr || (sector + 1) * FLASH_SECTOR_SIZE > length) {
+        return false;
+    }
+    FlashSim *flash = static_cast<FlashSim *>(const_cast<void *>(handle));
+    std::fill_n(flash->bytes.begin() + sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE, 0xFF);
+    flash->erases[sector]++;
+    return true;
+}
+
+/* ---- Wi-Fi station ---- */
+uint8_t wifiScan(WifiAccessPoint *found, uint8_t capacity) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    scanAllChannels();
+    std::vector<AccessPointSim> sorted = state().accessPoints;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const AccessPointSim &a, const AccessPointSim &b) { return a.rssi > b.rssi; });
+    uint8_t count = 0;
+    for (const AccessPointSim &accessPoint : sorted) {
+        if (count == capacity) {
+            break;
+        }
+        WifiAccessPoint &out = found[count++];
+        std::snprintf(out.ssid, sizeof(out.ssid), "%s", accessPoint.ssid.c_str());
+        std::memcpy(out.bssid, accessPoint.bssid, sizeof(out.bssid));
+        out.channel = accessPoint.channel;
+        out.rssi = accessPoint.rssi;
+    }
+    return count;
+}
+
+bool wifiConnect(const char *ssid, const char *password, const WifiAccessPoint *accessPoint, const WifiLease *lease,
+                 uint32_t timeoutMs) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    s.wifiConnected = false;
+    uint64_t startUs = s.nowUs;
+    if (accessPoint == nullptr) {
+        scanAllChannels();
+    }
+    const AccessPointSim *found = findAccessPoint(ssid, accessPoint);
+    if (found == nullptr || found->password != password) {
+        uint64_t spentUs = s.nowUs - startUs;
+        sim::advanceUs(spentUs < timeoutMs * 1000ULL ? timeoutMs * 1000ULL - spentUs : 0);
+        return false;
+    }
+    sim::advanceMs(sim::WIFI_JOIN_MS);
+    if (lease != nullptr) {
+        s.wifiLease = *lease;
+    } else {
+        s.wifiDhcps++;
+        sim::advanceMs(sim::WIFI_DHCP_MS);
+        uint32_t host = 50 + static_cast<uint32_t>(found - s.accessPoints.data());
+        s.wifiLease = WifiLease{0x0000A8C0U | (host << 24), 0x0100A8C0U, 0x00FFFFFFU, 0x0100A8C0U};    // 192.168.0.x/24
+    }
+    s.wifiConnected = true;
+    return true;
+}
+
+bool wifiLease(WifiLease &lease) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (!state().wifiConnected) {
+        return false;
+    }
+    lease = state().wifiLease;
+    return true;
+}
+
+void wifiDisconnect() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().wifiConnected = false;
+}
+
+/* ---- sockets ---- */
+int socketConnect(const char *host, uint16_t port, uint32_t timeoutMs) {
+    (void) timeoutMs;
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    if (!s.wifiConnected || s.peer == nullptr || !s.peer->onConnect(host, port)) {     // no route without Wi-Fi
+        return INVALID_SOCKET;
+    }
+    for (int i = 0; i < MAX_SOCKETS; i++) {
+        if (!s.sockets[i].open) {
+            s.sockets[i] = Socket{true, false, {}};
+            return i;
+        }
+    }
+    return INVALID_SOCKET;
+}
+
+int32_t socketSend(int socket, const void *data, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    Socket *s = socketAt(socket);
+    if (s == nullptr || s->broken || state().peer == nullptr) {
+        return -1;
+    }
+    state().peer->onReceive(socket, static_cast<const uint8_t *>(data), length, s->inbound);
+    return static_cast<int32_t>(length);
+}
+
+int32_t socketReceive(int socket, void *buffer, size_t length, uint32_t timeoutMs) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    Socket *s = socketAt(socket);
+    if (s == nullptr || s->broken) {
+        return -1;
+    }
+    if (s->inbound.empty()) {
+        sim::advanceMs(timeoutMs);  // nothing will arrive: the wait times out
+        return 0;
+    }
+    size_t count = std::min(length, s->inbound.size());
+    std::memcpy(buffer, s->inbound.data(), count);
+    s->inbound.erase(s->inbound.begin(), s->inbound.begin() + static_cast<std::ptrdiff_t>(count));
+    return static_cast<int32_t>(count);
+}
+
+void socketClose(int socket) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    Socket *s = socketAt(socket);
+    if (s == nullptr) {
+        return;
+    }
+    s->open = false;
+    if (state().peer != nullptr) {
+        state().peer->onClose(socket);
+    }
+}
+
+/* ---- NTP ---- */
+bool ntpOffsetMs(const char *server, uint32_t timeoutMs, int64_t &offsetMs) {
+    (void) server;
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    if (!s.wifiConnected) {
+        return false;   // no route: fails at once
+    }
+    s.ntpQueries++;
+    if (s.ntpEpoch == 0) {
+        sim::advanceMs(timeoutMs);
+        return false;
+    }
+    sim::advanceMs(sim::NTP_ROUND_TRIP_MS / 2);
+    int64_t serverMs = static_cast<int64_t>(s.ntpEpoch) * 1000 + static_cast<int64_t>(s.nowUs - s.ntpSetAtUs) / 1000;
+    offsetMs = serverMs - (s.epochAtBoot == 0 ? 0 : localEpochMs(s));
+    sim::advanceMs(sim::NTP_ROUND_TRIP_MS / 2);
+    return true;
+}
+
+/* ---- device secrets ---- */
+bool deviceKey(uint8_t key[32]) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    std::memcpy(key, state().deviceKey, sizeof(state().deviceKey));
+    return state().hasDeviceKey;
+}
+
+void randomBytes(void *buffer, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    uint32_t &x = state().randomState;      // xorshift32: deterministic, so the simulation runs the same every time
+    uint8_t *bytes = static_cast<uint8_t *>(buffer);
+    for (size_t i = 0; i < length; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        bytes[i] = static_cast<uint8_t>(x >> 24);
+    }
+}
+
+/* ---- serial ---- */
+void serialBegin(uint32_t baud) {
+    (void) baud;
+}
+
+size_t serialRead(char *buffer, size_t capacity) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    size_t count = 0;
+    while (count < capacity && !s.serialInput.empty() && s.serialInput.front().atUs <= s.nowUs) {
+        SerialChunk &chunk = s.serialInput.front();
+        size_t take = std::min(capacity - count, chunk.text.size() - chunk.read);
+        std::memcpy(buffer + count, chunk.text.data() + chunk.read, take);
+        count += take;
+        chunk.read += take;
+        if (chunk.read == chunk.text.size()) {
+            s.serialInput.erase(s.serialInput.begin());
+        }
+    }
+    return count;
+}
+
+void serialWrite(const char *text, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    size_t take = std::min(length, sim::SERIAL_OUTPUT_CAPACITY - s.serialOutputLength);
+    std::memcpy(s.serialOutput + s.serialOutputLength, text, take);
+    s.serialOutputLength += take;
+    s.serialLastWriteUs = s.nowUs;
+}
+
+/* ---- simulation controls ---- */
+namespace sim {
+
+void reset() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    s.nowUs = 0;
+    s.epochAtBoot = 0;
+    s.epochSetAtUs = 0;
+    s.epochSetMs = 0;
+    s.clockDriftPpm = 0;
+    s.ntpEpoch = 0;
+    s.ntpSetAtUs = 0;
+    s.ntpQueries = 0;
+    s.serialInput.clear();
+    s.serialOutputLength = 0;
+    s.serialLastWriteUs = 0;
+    for (Pin &pin : s.pins) {
+        pin = Pin{};
+    }
+    for (TimerSim &timer : s.timers) {
+        timer = TimerSim{};
+    }
+    s.timerFires = 0;
+    std::fill(std::begin(s.milliVolts), std::end(s.milliVolts), 0);
+    s.loadCellRaw = 0;
+    s.loadCellSource = nullptr;
+    s.analogSource = nullptr;
+    s.loadCellConnected = true;
+    s.loadCellDown = true;
+    s.loadCellReady = false;
+    s.loadCellNextConversionUs = 0;
+    s.loadCellShift = 0;
+    s.loadCellPulses = 0;
+    s.loadCellReads = 0;
+    s.nvsCommitted.clear();
+    s.nvsPending.clear();
+    s.nvsPendingErase.clear();
+    s.nvsCommits = 0;
+    s.nvsWritesLeft = -1;
+    s.powerCut = false;
+    std::memcpy(s.deviceKey, HOST_DEVICE_KEY, sizeof(s.deviceKey));
+    s.hasDeviceKey = true;
+    s.randomState = 0x2545F491;
+    // erase in place rather than dropping the partitions, so FlashPartition objects that outlive a reset stay valid
+    for (auto &entry : s.flash) {
+        setFlashPartition(entry.first.c_str(), static_cast<uint32_t>(entry.second.bytes.size()));
+    }
+    for (const DefaultPartition &partition : DEFAULT_PARTITIONS) {
+        setFlashPartition(partition.label, partition.size);
+    }
+    s.accessPoints.clear();
+    s.wifiConnected = false;
+    s.wifiLease = WifiLease{};
+    s.wifiScans = 0;
+    s.wifiDhcps = 0;
+    s.peer = nullptr;
+    for (Socket &socket : s.sockets) {
+        socket = Socket{};
+    }
+}
+
+void advanceMs(uint32_t ms) {
+    advanceUs(static_cast<uint64_t>(ms) * 1000);
+}
+
+void setClockDriftPpm(int32_t ppm) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    s.epochSetMs = localEpochMs(s);     // the drift so far stays in the clock
+    s.epochSetAtUs = s.nowUs;
+    s.clockDriftPpm = ppm;
+}
+
+void setNtpTime(uint32_t epochSeconds) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().ntpEpoch = epochSeconds;
+    state().ntpSetAtUs = state().nowUs;
+}
+
+uint32_t ntpQueryCount() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return state().ntpQueries;
+}
+
+void serialType(const char *text, uint32_t afterMs) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    uint64_t atUs = s.nowUs + static_cast<uint64_t>(afterMs) * 1000;
+    if (!s.serialInput.empty()) {
+        atUs = std::max(atUs, s.serialInput.back().atUs);     // a terminal sends in order
+    }
+    s.serialInput.push_back(SerialChunk{atUs, text});
+}
+
+std::string serialOutput() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    SimState &s = state();
+    std::string written(s.serialOutput, s.serialOutputLength);
+    s.serialOutputLength = 0;
+    return written;
+}
+
+uint32_t serialLastWriteMs() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return static_cast<uint32_t>(state().serialLastWriteUs / 1000);
+}
+
+void advanceUs(uint64_t us) {
+    uint64_t until;
+    {
+        std::lock_guard<std::recursive_mutex> lock(state().mutex);
+        until = state().nowUs + us;
+    }
+    // meanwhile, in time order: the timers expire, and the HX711 converts on its own clock. each conversion pulls DOUT
+    // low, which may fire its interrupt
+    while (true) {
+        InterruptHandler handler = nullptr;
+        TimerHandler timerHandler = nullptr;
+        void *timerArg = nullptr;
+        {
+            std::lock_guard<std::recursive_mutex> lock(state().mutex);
+            SimState &s = state();
+            TimerSim *timer = nullptr;
+            for (TimerSim &candidate : s.timers) {
+                if (candidate.armed && candidate.dueUs <= until && (timer == nullptr || candidate.dueUs < timer->dueUs)) {
+                    timer = &candidate;
+                }
+            }
+            bool converting = !s.loadCellDown && s.loadCellConnected && s.loadCellNextConversionUs <= until;
+            if (timer != nullptr && (!converting || timer->dueUs <= s.loadCellNextConversionUs)) {
+                s.nowUs = std::max(s.nowUs, timer->dueUs);
+                timer->armed = false;
+                timerHandler = timer->handler;
+                timerArg = timer->arg;
+                s.timerFires++;
+            } else if (!converting) {
+                break;
+            }
+        }
+        if (timerHandler != nullptr) {
+            timerHandler(timerArg);
+            continue;
+        }
+        {
+            std::lock_guard<std::recursive_mutex> lock(state().mutex);
+            SimState &s = state();
+            s.nowUs = std::max(s.nowUs, s.loadCellNextConversionUs);
+            s.loadCellNextConversionUs += LOAD_CELL_SAMPLE_PERIOD_US;
+            if (s.loadCellPulses > 0) {
+                continue;   // finished in the middle of a read: dropped
+            }
+            s.loadCellShift = toLoadCellBits(s.loadCellSource != nullptr ? s.loadCellSource(static_cast<uint32_t>(s.nowUs / 1000))
+                                                                         : s.loadCellRaw);
+            s.loadCellReady = true;
+            Pin &dout = s.pins[HX711_DOUT];
+            if (dout.level) {
+                handler = dout.handler;     // an unread conversion is overwritten with DOUT still low: no new edge
+            }
+            dout.level = false;
+        }
+        if (handler != nullptr) {
+            handler();
+        }
+    }
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().nowUs = std::max(state().nowUs, until);
+}
+
+void setPinLevel(gpio pin, bool high) {
+    InterruptHandler handler = nullptr;
+    {
+        std::lock_guard<std::recursive_mutex> lock(state().mutex);
+        Pin *p = pinAt(pin);
+        if (p == nullptr) {
+            return;
+        }
+        if (p->level && !high) {
+            handler = p->handler;
+        }
+        p->level = high;
+    }
+    if (handler != nullptr) {
+        handler();
+    }
+}
+
+bool pinLevel(gpio pin) {
+    return digitalRead(pin);
+}
+
+uint32_t pinWriteCount(gpio pin) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    Pin *p = pinAt(pin);
+    return p != nullptr ? p->writes : 0;
+}
+
+uint32_t timerFireCount() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return state().timerFires;
+}
+
+void setAnalogMilliVolts(gpio pin, uint32_t milliVolts) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (pin < PIN_COUNT) {
+        state().milliVolts[pin] = milliVolts;
+    }
+    state().analogSource = nullptr;
+}
+
+void setAnalogSource(AnalogSource source) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().analogSource = source;
+}
+
+void setLoadCellRaw(int32_t raw) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().loadCellRaw = raw;
+    state().loadCellSource = nullptr;
+}
+
+void setLoadCellSource(LoadCellSource source) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().loadCellSource = source;
+}
+
+void setLoadCellConnected(bool connected) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().loadCellConnected = connected;
+}
+
+uint32_t loadCellReads() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return state().loadCellReads;
+}
+
+bool loadCellPoweredDown() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return state().loadCellDown;
+}
+
+void powerCycle() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().nvsPending.clear();
+    state().nvsPendingErase.clear();
+    state().nvsWritesLeft = -1;
+    state().powerCut = false;
+}
+
+void cutPowerAfterNvsWrites(uint32_t writes) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().nvsWritesLeft = writes;
+}
+
+bool isPowerCut() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return state().powerCut;
+}
+
+void setDeviceKey(const uint8_t key[32]) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().hasDeviceKey = key != nullptr;
+    if (key != nullptr) {
+        std::memcpy(state().deviceKey, key, sizeof(state().deviceKey));
+    }
+}
+
+uint32_t nvsCommitCount() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return state().nvsCommits;
+}
+
+void setFlashPartition(const char *label, uint32_t size) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    FlashSim &flash = state().flash[label];
+    flash.bytes.assign(size, 0xFF);
+    flash.erases.assign(size / FLASH_SECTOR_SIZE, 0);
+    flash.bytesWritten = 0;
+}
+
+uint32_t flashEraseCount(const char *label, uint32_t sector) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    auto found = state().flash.find(label);
+    if (found == state().flash.end() || sector >= found->second.erases.size()) {
+        return 0;
+    }
+    return found->second.erases[sector];
+}
+
+uint32_t flashBytesWritten(const char *label) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    auto found = state().flash.find(label);
+    return found == state().flash.end() ? 0 : found->second.bytesWritten;
+}
+
+void setSocketPeer(SocketPeer *peer) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().peer = peer;
+}
+
+void addAccessPoint(const AccessPoint &accessPoint) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    AccessPointSim added{accessPoint.ssid, accessPoint.password, {}, accessPoint.channel, accessPoint.rssi};
+    std::memcpy(added.bssid, accessPoint.bssid, sizeof(added.bssid));
+    state().accessPoints.push_back(added);
+}
+
+void removeAccessPoints() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    state().accessPoints.clear();
+    state().wifiConnected = false;
+}
+
+uint32_t wifiScanCount() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return state().wifiScans;
+}
+
+uint32_t wifiDhcpCount() {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    return state().wifiDhcps;
+}
+
+void dropSocket(int socket) {
+    std::lock_guard<std::recursive_mutex> lock(state().mutex);
+    if (Socket *s = socketAt(socket)) {
+        s->broken = true;
+    }
+}
+
+}  // namespace sim
+}  // namespace hal
+
+#endif
@@ -0,0 +1,167 @@
+#include "led_patterns.h"
+
+#include "hal.h"
+
+namespace {
+
+constexpr char ACTIVATION_CODE[] = ".- .- .-";
+constexpr char STATUS_CODE[] = "-";
+constexpr char CALIBRATION_CODE[] = "-.-";
+constexpr char BUTTON_CODE[] = "..";
+constexpr char OUT_CODE[] = "---";
+constexpr char GOOD_CODE[] = ". . .";
+
+constexpr auto ACTIVATION_STEPS = morse<morseStepCount(ACTIVATION_CODE)>(ACTIVATION_CODE);
+constexpr auto STATUS_STEPS = morse<morseStepCount(STATUS_CODE)>(STATUS_CODE);
+constexpr auto CALIBRATION_STEPS = morse<morseStepCount(CALIBRATION_CODE)>(CALIBRATION_CODE);
+constexpr auto BUTTON_STEPS = morse<morseStepCount(BUTTON_CODE)>(BUTTON_CODE);
+constexpr auto OUT_STEPS = morse<morseStepCount(OUT_CODE)>(OUT_CODE);
+constexpr auto GOOD_STEPS = morse<morseStepCount(GOOD_CODE)>(GOOD_CODE);
+constexpr LedStep SETUP_STEPS[] = {{false, 2500}, {true, 500}};
+constexpr LedStep ERROR_STEPS[] = {{true, 3000}};
+
+static_assert(CALIBRATION_STEPS.size() == 5 && CALIBRATION_STEPS[1].durationMs == LED_DOT_MS, "- . - is on, off, on, off, on");
+static_assert(ACTIVATION_STEPS[3].durationMs == 3 * LED_DOT_MS && !ACTIVATION_STEPS[3].on, "3 dots between letters");
+
+// indexed by LEDPatternType
+constexpr LedPatternSpec PATTERNS[] = {
+    {nullptr, 0, false, UINT8_MAX},                                                         // None
+    {SETUP_STEPS, 2, true, 3},                                                              // RunningSetup
+    {ACTIVATION_STEPS.data(), static_cast<uint8_t>(ACTIVATION_STEPS.size()), false, 2},     // RunningActivation
+    {STATUS_STEPS.data(), static_cast<uint8_t>(STATUS_STEPS.size()), false, 2},             // CheckingDeviceStatus
+    {CALIBRATION_STEPS.data(), static_cast<uint8_t>(CALIBRATION_STEPS.size()), false, 2},   // RunningCalibration
+    {BUTTON_STEPS.data(), static_cast<uint8_t>(BUTTON_STEPS.size()), false, 1},             // ButtonPressed
+    {OUT_STEPS.data(), static_cast<uint8_t>(OUT_STEPS.size()), false, 1},                   // ProcessOut
+    {GOOD_STEPS.data(), static_cast<uint8_t>(GOOD_STEPS.size()), false, 1},                 // Good
+    {ERROR_STEPS, 1, false, 0},                                                             // MajorError
+};
+static_assert(sizeof(PATTERNS) / sizeof(PATTERNS[0]) == static_cast<size_t>(LEDPatternType::MajorError) + 1,
+              "a pattern for every LEDPatternType");
+
+}  // namespace
+
+const LedPatternSpec &ledPattern(LEDPatternType type) {
+    return PATTERNS[static_cast<uint8_t>(type)];
+}
+
+/* ---- LedEngine ---- */
+LedEngine::LedEngine(const gpio *pins, uint8_t count) : count(count < MAX_LEDS ? count : MAX_LEDS) {
+    for (uint8_t i = 0; i < this->count; i++) {
+        leds[i].pin = pins[i];
+    }
+}
+
+bool LedEngine::begin(void (*onTimer)(void *arg), void *arg) {
+    for (uint8_t i = 0; i < count; i++) {
+        hal::pinModeOutput(leds[i].pin);
+        leds[i].on = false;
+    }
+    timer = hal::timerCreate(onTimer, arg);
+    return timer >= 0;
+}
+
+void LedEngine::play(uint8_t led, LEDPatternType type) {
+    if (led >= count) {
+        return;
+    }
+    Led &target = leds[led];
+    uint64_t now = hal::micros();
+    if (type == LEDPatternType::None) {
+        target.waiting = LEDPatternType::None;
+        target.playing = LEDPatternType::None;
+        write(target, false);
+    } else if (target.playing == LEDPatternType::None) {
+        start(target, type, now);
+    } else if (ledPattern(type).priority <= ledPattern(target.playing).priority) {
+        if (ledPattern(target.playing).repeat) {
+            wait(target, target.playing);
+        }
+        start(target, type, now);
+    } else {
+        wait(target, type);
+    }
+    arm(now);
+}
+
+void LedEngine::stop(uint8_t led, LEDPatternType type) {
+    if (led >= count || type == LEDPatternType::None) {
+        return;
+    }
+    Led &target = leds[led];
+    uint64_t now = hal::micros();
+    if (target.waiting == type) {
+        target.waiting = LEDPatternType::None;
+    }
+    if (target.playing == type) {
+        finish(target, now);
+    }
+    arm(now);
+}
+
+void LedEngine::onTimer() {
+    uint64_t now = hal::micros();
+    for (uint8_t i = 0; i < count; i++) {
+        Led &led = leds[i];
+        // steps are timed from where the previous one should have ended, so a late wakeup doesn't shift the rest
+        while (led.playing != LEDPatternType::None && led.stepEndsUs <= now) {
+            const LedPatternSpec &pattern = ledPattern(led.playing);
+            if (++led.step >= pattern.count) {
+                if (!pattern.repeat) {
+                    finish(led, led.stepEndsUs);
+                    continue;
+                }
+                led.step = 0;
+            }
+            write(led, pattern.steps[led.step].on);
+            led.stepEndsUs += pattern.steps[led.step].durationMs * 1000ULL;
+        }
+    }
+    arm(now);
+}
+
+void LedEngine::write(Led &led, bool on) {
+    if (led.on != on) {
+        hal::digitalWrite(led.pin, on);
+        led.on = on;
+    }
+}
+
+void LedEngine::start(Led &led, LEDPatternType type, uint64_t nowUs) {
+    const LedPatternSpec &pattern = ledPattern(type);
+    led.playing = type;
+    led.step = 0;
+    write(led, pattern.steps[0].on);
+    led.stepEndsUs = nowUs + pattern.steps[0].durationMs * 1000ULL;
+}
+
+void LedEngine::wait(Led &led, LEDPatternType type) {
+    if (led.waiting == LEDPatternType::None || ledPattern(type).priority <= ledPattern(led.waiting).priority) {
+        led.waiting = type;
+    }
+}
+
+void LedEngine::finish(Led &led, uint64_t nowUs) {
+    led.playing = LEDPatternType::None;
+    write(led, false);
+    if (led.waiting != LEDPatternType::None) {
+        LEDPatternType next = led.waiting;
+        led.waiting = LEDPatternType::None;
+        start(led, next, nowUs);
+    }
+}
+
+void LedEngine::arm(uint64_t nowUs) {
+    bool playing = false;
+    uint64_t next = UINT64_MAX;
+    for (uint8_t i = 0; i < count; i++) {
+        if (leds[i].playing != LEDPatternType::None) {
+            playing = true;
+            next = leds[i].stepEndsUs < next ? leds[i].stepEndsUs : next;
+        }
+    }
+    if (!playing) {
+        hal::timerStop(timer);
+        return;
+    }
+    hal::timerStartOnce(timer, next > nowUs ? next - nowUs : 0);
+}
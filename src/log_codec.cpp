@@ -0,0 +1,181 @@
+#include "log_codec.h"
+
+#ifndef ARDUINO
+#include <cstdio>
+#endif
+
+namespace {
+
+constexpr uint8_t CODE_MASK = 0x3F;
+constexpr uint8_t SIZE_SHIFT = 6;
+constexpr uint8_t PAYLOAD_SIZES[] = {0, 1, 2, 4};
+constexpr recordTimeType MINUTES_PER_DAY = 24 * 60;
+
+uint8_t sizeClassOf(const LogEntry &entry) {
+    if (!entry.hasPayload) {
+        return 0;
+    }
+    return entry.payload <= 0xFF ? 1 : entry.payload <= 0xFFFF ? 2 : 3;
+}
+
+}  // namespace
+
+size_t encodeLogEntry(const LogEntry &entry, uint8_t *out) {
+    uint8_t sizeClass = sizeClassOf(entry);
+    size_t length = 0;
+    out[length++] = static_cast<uint8_t>((static_cast<uint8_t>(entry.code) & CODE_MASK) | (sizeClass << SIZE_SHIFT));
+    for (uint8_t i = 0; i < PAYLOAD_SIZES[sizeClass]; i++) {
+        out[length++] = static_cast<uint8_t>(entry.payload >> (8 * i));
+    }
+    recordTimeType minute = static_cast<recordTimeType>(entry.minute % MINUTES_PER_DAY);
+    out[length++] = static_cast<uint8_t>(minute);
+    out[length++] = static_cast<uint8_t>(minute >> 8);
+    return length;
+}
+
+size_t decodeLogEntry(const uint8_t *bytes, size_t length, LogEntry &entry) {
+    if (length < MIN_LOG_ENTRY_SIZE) {
+        return 0;
+    }
+    uint8_t code = bytes[0] & CODE_MASK;
+    uint8_t payloadSize = PAYLOAD_SIZES[bytes[0] >> SIZE_SHIFT];
+    size_t entryLength = 1 + payloadSize + 2;
+    if (code >= static_cast<uint8_t>(LogCode::Count) || length < entryLength) {
+        return 0;
+    }
+    uint32_t payload = 0;
+    for (uint8_t i = 0; i < payloadSize; i++) {
+        payload |= static_cast<uint32_t>(bytes[1 + i]) << (8 * i);
+    }
+    recordTimeType minute = static_cast<recordTimeType>(bytes[1 + payloadSize] | (bytes[2 + payloadSize] << 8));
+    if (minute >= MINUTES_PER_DAY) {
+        return 0;
+    }
+    entry = LogEntry{static_cast<LogCode>(code), minute, payloadSize > 0, payload};
+    return entryLength;
+}
+
+#ifndef ARDUINO
+namespace {
+
+struct CodeText {
+    const char *text;
+    const char *unit;   // after the payload, if any
+    bool isSigned;
+};
+
+constexpr CodeText CODE_TEXTS[] = {
+    {"deviceID:", "", false},                   // DeviceId
+    {"date:", "", false},                       // Date
+    {"logfile is full, yet more info is tried to be logged", "", false},
+    {"setup started", "", false},
+    {"setup done", "", false},
+    {"activated", "", false},
+    {"deactivated", "", false},
+    {"device status check", "", false},
+    {"battery", " mV", false},
+    {"battery low", " mV", false},
+    {"main server unreachable", "", false},
+    {"NTP server unreachable", "", false},
+    {"load cell not responding", "", false},
+    {"load cell calibrated, plate", " g", false},
+    {"load cell calibration failed", "", false},
+    {"tx times changed", "", false},
+    {"sending data", " B", false},
+    {"sending log file", " B", false},
+    {"sent, checksums match", "", false},
+    {"checksum mismatch", "", false},
+    {"communication error", "", false},
+    {"clock calibrated, corrected by", " s", true},
+    {"clock calibration failed", "", false},
+    {"reboot, reason", "", false},
+    {"event", "", false},                       // EventTiming
+    {"battery empty in", " days", false},
+    {"battery trend", " mV/day", true},
+    {"main server busy, retrying in", " s", false},
+    {"clock drift", " ppm", true},
+    {"no device key, Wi-Fi passwords locked", "", false},
+};
+static_assert(sizeof(CODE_TEXTS) / sizeof(CODE_TEXTS[0]) == static_cast<size_t>(LogCode::Count),
+              "every LogCode needs its text");
+
+constexpr const char *EVENT_NAMES[] = {
+    "Setup", "Activate", "Deactivate", "CheckDeviceStatus", "CalibrateLoadCell", "ChangeTxTimes", "SendLogFile",
+    "SendData", "CalibrateClock",
+};
+static_assert(sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) == EVENT_TYPE_COUNT, "every EventType needs its name");
+
+// days since 1970-01-01 to a Gregorian date (H. Hinnant's civil_from_days)
+void civilFromDays(uint32_t days, unsigned &year, unsigned &month, unsigned &day) {
+    uint32_t z = days + 719468;
+    uint32_t era = z / 146097;
+    uint32_t dayOfEra = z - era * 146097;
+    uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    uint32_t mp = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+}
+
+int renderEntry(const LogEntry &entry, char *text, size_t capacity) {
+    const CodeText &codeText = CODE_TEXTS[static_cast<uint8_t>(entry.code)];
+    switch (entry.code) {
+        case LogCode::DeviceId:
+            return std::snprintf(text, capacity, "deviceID: %lu\n", static_cast<unsigned long>(entry.payload));
+        case LogCode::Date: {
+            unsigned year, month, day;
+            civilFromDays(entry.payload, year, month, day);
+            return std::snprintf(text, capacity, "\ndate: %02u/%02u/%04u\n", day, month, year);
+        }
+        case LogCode::TxTimesChanged:
+            return std::snprintf(text, capacity, "%02u%02u %s %04u %04u\n", entry.minute / 60, entry.minute % 60,
+                                 codeText.text, (entry.payload >> 16) / 60 * 100 + (entry.payload >> 16) % 60,
+                                 (entry.payload & 0xFFFF) / 60 * 100 + (entry.payload & 0xFFFF) % 60);
+        case LogCode::EventTiming: {
+            uint32_t type = entry.payload >> 28;
+            return std::snprintf(text, capacity, "%02u%02u %s %s: %lu runs, slowest %lu ms\n", entry.minute / 60,
+                                 entry.minute % 60, codeText.text, type < EVENT_TYPE_COUNT ? EVENT_NAMES[type] : "?",
+                                 static_cast<unsigned long>((entry.payload >> 20) & 0xFF),
+                                 static_cast<unsigned long>(entry.payload & 0xFFFFF));
+        }
+        default:
+            break;
+    }
+    if (!entry.hasPayload) {
+        return std::snprintf(text, capacity, "%02u%02u %s\n", entry.minute / 60, entry.minute % 60, codeText.text);
+    }
+    if (codeText.isSigned) {
+        return std::snprintf(text, capacity, "%02u%02u %s %ld%s\n", entry.minute / 60, entry.minute % 60, codeText.text,
+                             static_cast<long>(static_cast<int32_t>(entry.payload)), codeText.unit);
+    }
+    return std::snprintf(text, capacity, "%02u%02u %s %lu%s\n", entry.minute / 60, entry.minute % 60, codeText.text,
+                         static_cast<unsigned long>(entry.payload), codeText.unit);
+}
+
+}  // namespace
+
+size_t renderLogFile(const uint8_t *log, size_t length, char *text, size_t capacity) {
+    if (capacity == 0) {
+        return 0;
+    }
+    size_t offset = 0;
+    size_t textLength = 0;
+    text[0] = '\0';
+    while (offset < length) {
+        LogEntry entry;
+        size_t entryLength = decodeLogEntry(log + offset, length - offset, entry);
+        if (entryLength == 0) {
+            return 0;
+        }
+        int written = renderEntry(entry, text + textLength, capacity - textLength);
+        if (written < 0 || static_cast<size_t>(written) >= capacity - textLength) {
+            text[textLength] = '\0';
+            return 0;
+        }
+        textLength += static_cast<size_t>(written);
+        offset += entryLength;
+    }
+    return textLength;
+}
+#endif
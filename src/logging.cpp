@@ -0,0 +1,156 @@
+#include "logging.h"
+
+#include <cstring>
+
+#include "clock_drift.h"
+#include "config.h"
+#include "hal.h"
+
+namespace {
+
+constexpr uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+constexpr size_t FULL_ENTRY_LENGTH = MIN_LOG_ENTRY_SIZE;    // LogFileFull has no payload
+
+recordTimeType minuteNow() {
+    return static_cast<recordTimeType>(epochNow() % SECONDS_PER_DAY / 60);
+}
+
+}  // namespace
+
+LogFile logFile(LOG_FILE_SIZE);
+
+LogFile::LogFile(uint16_t size, FlashLog &store) : store(store), size(size) {}
+
+bool LogFile::createLogFile() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return create();
+}
+
+bool LogFile::create() {
+    if (!store.isMounted() && !store.mount(STORAGE_PARTITION)) {
+        return false;
+    }
+    bytesUsed = store.size(StreamId::LogFile);
+    fullLogged = bytesUsed + FULL_ENTRY_LENGTH > size;     // it was full before a reboot
+    lastDay = UINT32_MAX;
+    headerDue = false;
+    if (bytesUsed > 0) {
+        return true;
+    }
+    uint32_t deviceId = 0;
+    hal::nvsGet(NVS_KEY_DEVICE_ID, &deviceId, sizeof(deviceId));    // 0 until the main server assigns one
+    return appendEntry(LogEntry{LogCode::DeviceId, minuteNow(), true, deviceId}) && appendDate(epochNow());
+}
+
+bool LogFile::addLogRow(LogCode code) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!beginRow(epochNow())) {
+        return false;
+    }
+    return appendEntry(LogEntry{code, minuteNow(), false, 0});
+}
+
+bool LogFile::addLogRow(LogCode code, uint32_t payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!beginRow(epochNow())) {
+        return false;
+    }
+    return appendEntry(LogEntry{code, minuteNow(), true, payload});
+}
+
+bool LogFile::addDate(dateType date) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return appendDate(date);
+}
+
+bool LogFile::appendDate(dateType date) {
+    if (!appendEntry(LogEntry{LogCode::Date, static_cast<recordTimeType>(date % SECONDS_PER_DAY / 60), true,
+                              date / SECONDS_PER_DAY})) {
+        return false;
+    }
+    lastDay = date / SECONDS_PER_DAY;
+    return true;
+}
+
+bool LogFile::beginRow(uint32_t now) {
+    if (headerDue) {
+        uint32_t deviceId = 0;
+        hal::nvsGet(NVS_KEY_DEVICE_ID, &deviceId, sizeof(deviceId));
+        if (!appendEntry(LogEntry{LogCode::DeviceId, minuteNow(), true, deviceId})) {
+            return false;
+        }
+        headerDue = false;
+    }
+    return now / SECONDS_PER_DAY == lastDay || appendDate(now);
+}
+
+size_t LogFile::readLogFile(uint8_t *buffer, size_t capacity, uint32_t through) const {
+    size_t length = 0;
+    FlashSegment segment;
+    for (bool found = store.firstSegment(StreamId::LogFile, segment); found && segment.sequence <= through &&
+                                                                       length < capacity;
+         found = store.nextSegment(StreamId::LogFile, segment, segment)) {
+        size_t count = segment.length < capacity - length ? segment.length : capacity - length;
+        std::memcpy(buffer + length, segment.data, count);
+        length += count;
+    }
+    return length;
+}
+
+void LogFile::deleteLogFile() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (store.isMounted()) {
+        store.clear(StreamId::LogFile);
+    }
+    create();
+}
+
+uint32_t LogFile::seal() {
+    std::lock_guard<std::mutex> lock(mutex);
+    headerDue = true;
+    lastDay = UINT32_MAX;
+    return store.seal(StreamId::LogFile);
+}
+
+void LogFile::deleteThrough(uint32_t through) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (store.isMounted()) {
+        store.clearThrough(StreamId::LogFile, through);
+    }
+    if (store.size(StreamId::LogFile) == 0) {
+        create();   // nothing was logged since: a new, clean file
+        return;
+    }
+    bytesUsed = store.size(StreamId::LogFile);
+    fullLogged = bytesUsed + FULL_ENTRY_LENGTH > size;
+}
+
+uint32_t LogFile::length() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesUsed;
+}
+
+bool LogFile::isFull(size_t entryLength) const {
+    return bytesUsed + entryLength + FULL_ENTRY_LENGTH > size;
+}
+
+bool LogFile::appendEntry(const LogEntry &entry) {
+    if (fullLogged) {
+        return false;
+    }
+    uint8_t bytes[MAX_LOG_ENTRY_SIZE];
+    size_t length = encodeLogEntry(entry, bytes);
+    if (isFull(length)) {
+        length = encodeLogEntry(LogEntry{LogCode::LogFileFull, minuteNow(), false, 0}, bytes);
+        if (store.append(StreamId::LogFile, bytes, static_cast<uint16_t>(length))) {
+            bytesUsed += length;
+        }
+        fullLogged = true;
+        return false;
+    }
+    if (!store.append(StreamId::LogFile, bytes, static_cast<uint16_t>(length))) {
+        return false;
+    }
+    bytesUsed += length;
+    return true;
+}
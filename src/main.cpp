@@ -15,47 +15,85 @@
 #include "device_status.h"  // flags about device status and their function
 #include "display.h"        // handles the display task
 #include "events.h"         // handles events
+#include "event_dispatch.h" // runs and times the event handlers
+#include "energy.h"         // where the battery goes
 #include "sensors.h"        // handles data from the event
 #include "types.h"          // project-specific types and structs
 #include "queue.h"          // queue class
 #include "data.h"           // functions to handle the sensor data table
+#include "flash_log.h"      // wear-levelled flash storage under the data table and the log file
+#include "logging.h"        // the log file
+#include "credential_vault.h" // the Wi-Fi passwords, encrypted in NVS
 #include "scheduler.h"      // functions to handle scheduling tasks, like sending data to server
 #include "networkings.h"    // functions to handle networking tasks
+#include "hal.h"            // hardware abstraction layer: pins, tasks, clock, storage, sockets
 
-#include "freertos/FreeRTOS.h"  // esp32 built-in: multitasking header
-#include "freertos/task.h"      // esp32 built-in: multitasking header
+// The tests bring their own setup() / loop() (see test/test_main.cpp)
+#ifndef PIO_UNIT_TESTING
 
 
-Queue<Event> eventsQueue(EVENTS_QUEUE_LENGTH);
+Queue<Event, EVENTS_QUEUE_LENGTH> eventsQueue;    // only touched by loop(), orders the events by priority
 /* Create messages queue and led-patterns queue */
 
+// indexed by EventType
+constexpr EventHandler EVENT_HANDLERS[EVENT_TYPE_COUNT] = {
+    onSetup,                // - If already activated, device should be de activated for setup, and then (re)activeted. so events queue should be (first to dequeued: ) ... deactivte, setup, activate, ... (last)
+    onActivate,
+    onDeactivate,
+    onCheckDeviceStatus,
+    onCalibrateLoadCell,
+    onChangeTxTimes,
+    onSendLogFile,          // if no device status is logged, or if a device status is logged with errors, then first call onCheckDeviceStatus, then call onSendLogFile
+    onSendData,             // should immidietly enqueue EventType::SendLogFile with priority 1 (highest)
+    onCalibrateClock,
+};
+static_assert(EVENT_HANDLERS[static_cast<uint8_t>(EventType::SendData)] == onSendData &&
+              EVENT_HANDLERS[static_cast<uint8_t>(EventType::CalibrateClock)] == onCalibrateClock,
+              "EVENT_HANDLERS must follow the order of EventType");
+
 void setup() {
-    /* Initiate pinMode() here */
+    hal::serialBegin(SERIAL_BAUD);
+    hal::pinModeOutput(LED);
+    hal::pinModeInput(BUTTON, true);
+    hal::loadCellBegin();
+    initDeviceStatus();     // after a wakeup from deep sleep, already there in RTC memory
+    energyLedger.start();
+    flashStore.mount(STORAGE_PARTITION);
+    bool vaultMounted = credentialVault.mount();
+    dataTable.createDataTable();
+    logFile.createLogFile();
+    if (!vaultMounted) {
+        logFile.addLogRow(LogCode::VaultLocked);
+    }
 
-    xTaskCreate(getLoadCellData); // on "sensors.h"
-    xTaskCreate(display);         // on "display.h"
-    xTaskCreate(scheduler);       // on "scheduler.h"
-    xTaskCreate(networkings);     // on "networkings.h"
+    hal::startTask([](void *) { getLoadCellData(); }, "getLoadCellData", TASK_STACK_BYTES, 2);              // on "sensors.h"
+    hal::startTask([](void *) { display(); }, "display", TASK_STACK_BYTES, 1);                              // on "display.h"
+    hal::startTask([](void *) { scheduler(); }, "scheduler", TASK_STACK_BYTES, 1);                          // on "scheduler.h"
+    hal::startTask([](void *) { networkings(); }, "networkings", TASK_STACK_BYTES, 1);                      // on "networkings.h"
 }
 
 void loop() {
     listenToEvents();
+    Event incoming;
+    // sleep until some task raises an event, instead of spinning on an empty queue
+    energyLedger.taskAsleep(EnergyTask::Events);
+    bool woken = eventsRing.waitPop(incoming, EVENTS_IDLE_WAIT_MS);
+    energyLedger.taskAwake(EnergyTask::Events);
+    if (woken) {
+        eventsQueue.enqueue(incoming);
+    }
+    // whatever doesn't fit waits in the ring for the next round
+    while (eventsQueue.size() < eventsQueue.capacity() && eventsRing.tryPop(incoming)) {
+        eventsQueue.enqueue(incoming);
+    }
     while (!eventsQueue.isEmpty()) {
         Event event = eventsQueue.dequeue();
-        switch (event.eventType) {
-            case EventType::Setup: onSetup(); break;    // - If already activated, device should be de activated for setup, and then (re)activeted. so events queue should be (first to dequeued: ) ... deactivte, setup, activate, ... (last)
-            case EventType::Activate: onActivate(); break;
-            case EventType::Deactivate: onDeactivate(); break;
-            case EventType::CheckDeviceStatus: onCheckDeviceStatus(); break;
-            case EventType::CalibrateLoadCell: onCalibrateLoadCell(); break;
-            case EventType::ChangeTxTimes: onChangeTxTimes(); break;
-            case EventType::SendLogFile: onSendLogFile(); break;    // if no device status is logged, or if a device status is logged with errors, then first call onCheckDeviceStatus, then call onSendLogFile
-            case EventType::SendData: onSendData(); break; // should immidietly enqueue EventType::SendLogFile with priority 1 (highest)
-            case EventType::CalibrateClock: onCalibrateClock(); break;
-        }
+        dispatchEvent(EVENT_HANDLERS, event.eventType);
     }
 }
 
+#endif  // PIO_UNIT_TESTING
+
 /* Old Code to take snippets from
  
 #include <HX711_ADC.h>
@@ -0,0 +1,246 @@
+#include "networkings.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "checksum.h"
+#include "config.h"
+#include "energy.h"
+#include "hal.h"
+#include "uplink.h"
+#include "wifi_link.h"
+
+namespace {
+
+constexpr size_t IP_LENGTH = 16;
+constexpr size_t HEADER_SIZE = 5;
+
+int connectToMainServer() {
+    char serverIp[IP_LENGTH] = {};
+    if (!hal::nvsGet(NVS_KEY_SERVER_IP, serverIp, sizeof(serverIp))) {
+        return hal::INVALID_SOCKET;
+    }
+    serverIp[IP_LENGTH - 1] = '\0';
+    return hal::socketConnect(serverIp, MAIN_SERVER_PORT, MAIN_SERVER_TIMEOUT_MS);
+}
+
+bool sendMessage(int socket, MessageType type, const uint8_t *payload, size_t length) {
+    uint8_t header[HEADER_SIZE] = {static_cast<uint8_t>(type), static_cast<uint8_t>(length),
+                                   static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length >> 16),
+                                   static_cast<uint8_t>(length >> 24)};
+    if (hal::socketSend(socket, header, sizeof(header)) != static_cast<int32_t>(sizeof(header))) {
+        return false;
+    }
+    if (length > 0 && hal::socketSend(socket, payload, length) != static_cast<int32_t>(length)) {
+        return false;
+    }
+    energyLedger.radioSent(static_cast<uint32_t>(HEADER_SIZE + length));
+    return true;
+}
+
+bool receiveExactly(int socket, uint8_t *buffer, size_t length) {
+    size_t received = 0;
+    while (received < length) {
+        int32_t count = hal::socketReceive(socket, buffer + received, length - received, MAIN_SERVER_TIMEOUT_MS);
+        if (count <= 0) {
+            return false;
+        }
+        received += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+/* ---- chunked transfers ---- */
+constexpr size_t OFFER_SIZE = 13;
+constexpr size_t REPLY_HEADER_SIZE = 6;
+constexpr size_t CHUNK_HEADER_SIZE = 10;
+constexpr size_t BITMAP_SIZE = (TRANSFER_MAX_CHUNKS + 7) / 8;
+
+struct Transfer {
+    uint32_t id;
+    MessageType type;
+    const uint8_t *payload;
+    size_t length;
+    uint16_t chunkCount;
+    uint8_t received[BITMAP_SIZE];  // the server's bitmap
+    bool busy = false;              // the server's reply to the last offer
+    uint16_t retryAfterS = 0;
+};
+
+void store16(uint8_t *out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void store32(uint8_t *out, uint32_t value) {
+    store16(out, static_cast<uint16_t>(value));
+    store16(out + 2, static_cast<uint16_t>(value >> 16));
+}
+
+uint32_t load32(const uint8_t *bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+bool hasChunk(const Transfer &transfer, uint16_t sequence) {
+    return (transfer.received[sequence / 8] >> (sequence % 8)) & 1;
+}
+
+bool sendCounted(int socket, MessageType type, const uint8_t *payload, size_t length, TransferStats &stats) {
+    if (!sendMessage(socket, type, payload, length)) {
+        return false;
+    }
+    stats.bytesSent += static_cast<uint32_t>(HEADER_SIZE + length);
+    return true;
+}
+
+// one round trip: offers the transfer, and gets the bitmap of the chunks the server has
+bool offer(int socket, Transfer &transfer, TransferStats &stats) {
+    uint8_t message[OFFER_SIZE];
+    store32(message, transfer.id);
+    message[4] = static_cast<uint8_t>(transfer.type);
+    store32(message + 5, static_cast<uint32_t>(transfer.length));
+    store16(message + 9, TRANSFER_CHUNK_SIZE);
+    store16(message + 11, transfer.chunkCount);
+    stats.roundTrips++;
+    uint8_t reply[REPLY_HEADER_SIZE];
+    size_t bitmapSize = (transfer.chunkCount + 7U) / 8U;
+    if (!sendCounted(socket, MessageType::TransferOffer, message, sizeof(message), stats) ||
+        !receiveExactly(socket, reply, sizeof(reply)) || load32(reply) != transfer.id) {
+        return false;
+    }
+    uint16_t chunkCount = static_cast<uint16_t>(reply[4] | (reply[5] << 8));
+    if (chunkCount == 0) {      // busy: a transfer has a chunk at least
+        uint8_t retryAfter[2];
+        transfer.busy = receiveExactly(socket, retryAfter, sizeof(retryAfter));
+        transfer.retryAfterS = static_cast<uint16_t>(retryAfter[0] | (retryAfter[1] << 8));
+        stats.bytesReceived += static_cast<uint32_t>(sizeof(reply) + sizeof(retryAfter));
+        return false;
+    }
+    if (chunkCount != transfer.chunkCount || !receiveExactly(socket, transfer.received, bitmapSize)) {
+        return false;
+    }
+    stats.bytesReceived += static_cast<uint32_t>(sizeof(reply) + bitmapSize);
+    return true;
+}
+
+// streams every chunk the server doesn't have, without waiting for anything
+bool sendMissing(int socket, const Transfer &transfer, TransferStats &stats) {
+    static uint8_t frame[CHUNK_HEADER_SIZE + TRANSFER_CHUNK_SIZE];
+    for (uint16_t sequence = 0; sequence < transfer.chunkCount; sequence++) {
+        if (hasChunk(transfer, sequence)) {
+            continue;
+        }
+        size_t offset = static_cast<size_t>(sequence) * TRANSFER_CHUNK_SIZE;
+        size_t length = std::min<size_t>(TRANSFER_CHUNK_SIZE, transfer.length - offset);
+        store32(frame, transfer.id);
+        store16(frame + 4, sequence);
+        store32(frame + 6, crc32(transfer.payload + offset, length));
+        if (length > 0) {
+            std::memcpy(frame + CHUNK_HEADER_SIZE, transfer.payload + offset, length);
+        }
+        if (!sendCounted(socket, MessageType::TransferChunk, frame, CHUNK_HEADER_SIZE + length, stats)) {
+            return false;
+        }
+        stats.chunksSent++;
+    }
+    return true;
+}
+
+bool isComplete(const Transfer &transfer) {
+    for (uint16_t sequence = 0; sequence < transfer.chunkCount; sequence++) {
+        if (!hasChunk(transfer, sequence)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+bool sendChunkedToMainServer(MessageType type, const uint8_t *payload, size_t length, TransferStats *stats) {
+    if (length > static_cast<size_t>(TRANSFER_MAX_CHUNKS) * TRANSFER_CHUNK_SIZE) {
+        return false;
+    }
+    TransferStats ignored;
+    TransferStats &counters = stats != nullptr ? *stats : ignored;
+    Transfer transfer{0, type, payload, length, 0, {}};
+    transfer.chunkCount = static_cast<uint16_t>(length == 0 ? 1 : (length + TRANSFER_CHUNK_SIZE - 1) / TRANSFER_CHUNK_SIZE);
+    uint8_t identity[5] = {static_cast<uint8_t>(type)};
+    store32(identity + 1, static_cast<uint32_t>(length));
+    transfer.id = crc32Update(crc32(identity, sizeof(identity)), payload, length);
+
+    WifiHold link(EnergyTask::Events);      // through every attempt: the networkings task may be done with it meanwhile
+
+    for (uint8_t attempt = 0; attempt < MAX_SEND_ATTEMPTS; attempt++) {
+        int socket = connectToMainServer();
+        if (socket == hal::INVALID_SOCKET) {
+            return false;   // unreachable: the caller keeps the payload for the next tx time
+        }
+        counters.connects++;
+        bool complete = false;
+        for (uint8_t round = 0; round < TRANSFER_MAX_ROUNDS && !complete; round++) {
+            if (!offer(socket, transfer, counters)) {
+                break;      // the link broke: reconnect, and resume from what the server has
+            }
+            complete = isComplete(transfer);
+            if (!complete && !sendMissing(socket, transfer, counters)) {
+                break;
+            }
+        }
+        hal::socketClose(socket);
+        if (complete) {
+            return true;
+        }
+        if (transfer.busy) {
+            counters.busy = true;   // another connection now would only add to the crowd: the caller backs off
+            counters.retryAfterS = transfer.retryAfterS;
+            return false;
+        }
+    }
+    return false;
+}
+
+bool requestTxSlots(uint8_t failures, TxSlot slots[2]) {
+    WifiHold link(EnergyTask::Events);
+    int socket = connectToMainServer();
+    if (socket == hal::INVALID_SOCKET) {
+        return false;
+    }
+    uint8_t reply[8];
+    bool ok = sendMessage(socket, MessageType::TxSlots, &failures, sizeof(failures)) &&
+              receiveExactly(socket, reply, sizeof(reply));
+    hal::socketClose(socket);
+    if (ok) {
+        for (uint8_t i = 0; i < 2; i++) {
+            slots[i].startMinute = static_cast<recordTimeType>(reply[4 * i] | (reply[4 * i + 1] << 8));
+            slots[i].windowS = static_cast<uint16_t>(reply[4 * i + 2] | (reply[4 * i + 3] << 8));
+        }
+    }
+    return ok;
+}
+
+bool requestNtpOffset(int64_t &offsetMs) {
+    WifiHold link(EnergyTask::Events);
+    char server[IP_LENGTH] = {};
+    if (!hal::nvsGet(NVS_KEY_NTP_SERVER, server, sizeof(server))) {
+        return hal::ntpOffsetMs(NTP_DEFAULT_SERVER, NTP_TIMEOUT_MS, offsetMs);
+    }
+    server[IP_LENGTH - 1] = '\0';
+    return hal::ntpOffsetMs(server, NTP_TIMEOUT_MS, offsetMs);
+}
+
+void networkings() {
+    uplink.load();
+    while (true) {
+        uint32_t now = hal::epochSeconds();
+        if (uplink.backlogBytes() > 0 && uplink.retryAtS() <= now) {
+            uplink.flush(now);      // holds the link for its session. without a connection it fails, and backs off
+        }
+        uint32_t retryAt = uplink.retryAtS();
+        // parked until asked, or until the backoff ends
+        energyLedger.taskAsleep(EnergyTask::Networkings);
+        uplinkDue.wait(retryAt > now ? (retryAt - now) * 1000U : UINT32_MAX);
+        energyLedger.taskAwake(EnergyTask::Networkings);
+    }
+}
@@ -0,0 +1,229 @@
+#include "scheduler.h"
+
+#include <atomic>
+#include <initializer_list>
+
+#include "clock_drift.h"
+#include "config.h"
+#include "energy.h"
+#include "events.h"
+#include "hal.h"
+#include "tx_slots.h"
+#include "uplink.h"
+
+namespace {
+
+constexpr uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+static_assert(SCHEDULER_SLACK_S < senseInterval / 1000U, "a longer slack would skip readings, see scheduler.h");
+
+// the first time at secondOfDay that's at or after nowS
+uint32_t dailyAt(uint32_t secondOfDay, uint32_t nowS) {
+    uint32_t today = nowS - nowS % SECONDS_PER_DAY + secondOfDay % SECONDS_PER_DAY;
+    return today >= nowS ? today : today + SECONDS_PER_DAY;
+}
+
+// the first deadline on the grid (origin + k * interval) that's after nowS
+uint32_t periodicAfter(uint32_t origin, uint32_t interval, uint32_t nowS) {
+    if (nowS < origin) {
+        return origin;
+    }
+    return origin + ((nowS - origin) / interval + 1) * interval;
+}
+
+RingParker schedulerWake;
+std::atomic<bool> txTimesChanged{false};
+std::atomic<uint32_t> requestedSenseIntervalS{0};   // 0: no change
+std::atomic<uint32_t> requestedTxRetryS{0};         // 0: none asked for
+
+}  // namespace
+
+/* ---- Scheduler ---- */
+void Scheduler::start(uint32_t nowS) {
+    while (!timers.isEmpty()) {
+        timers.dequeue();
+    }
+    for (uint8_t job = 0; job < JOB_COUNT; job++) {
+        if (!disabled[job] && static_cast<Job>(job) != Job::TxRetry) {
+            schedule(static_cast<Job>(job), nowS);
+        }
+    }
+}
+
+void Scheduler::setTxTimes(uint32_t firstSecondOfDay, uint32_t secondSecondOfDay, uint32_t nowS) {
+    config.txSecondsOfDay[0] = firstSecondOfDay;
+    config.txSecondsOfDay[1] = secondSecondOfDay;
+    for (Job job : {Job::TxFirst, Job::TxSecond}) {
+        unschedule(job);
+        if (!disabled[static_cast<uint8_t>(job)]) {
+            schedule(job, nowS);
+        }
+    }
+}
+
+void Scheduler::setEnabled(Job job, bool enabled, uint32_t nowS) {
+    bool wasEnabled = !disabled[static_cast<uint8_t>(job)];
+    disabled[static_cast<uint8_t>(job)] = !enabled;
+    if (enabled && !wasEnabled) {
+        schedule(job, nowS);
+    } else if (!enabled && wasEnabled) {
+        unschedule(job);
+    }
+}
+
+void Scheduler::setSenseInterval(uint32_t intervalS) {
+    config.senseIntervalS = intervalS;
+    if (disabled[static_cast<uint8_t>(Job::Sense)] || lastSenseS == 0) {
+        return;     // the first reading keeps its deadline, the interval applies from it on
+    }
+    unschedule(Job::Sense);
+    timers.enqueue(Timer{Job::Sense, periodicAfter(0, intervalS, lastSenseS)});
+}
+
+void Scheduler::setTxRetry(uint32_t atS) {
+    unschedule(Job::TxRetry);
+    timers.enqueue(Timer{Job::TxRetry, atS});
+}
+
+uint8_t Scheduler::runDue(uint32_t nowS, Job *due) {
+    uint8_t count = 0;
+    uint32_t horizon = nowS + config.slackS;
+    Timer ran[JOB_COUNT];
+    while (!timers.isEmpty() && timers.peek().priority <= horizon) {
+        ran[count] = timers.dequeue();
+        due[count] = ran[count].job;
+        if (ran[count].job == Job::Sense) {
+            lastSenseS = ran[count].priority;
+        }
+        count++;
+    }
+    // rescheduled only now, so a job with an interval shorter than the slack runs once per wakeup
+    for (uint8_t i = 0; i < count; i++) {
+        if (ran[i].job != Job::TxRetry) {   // once only
+            timers.enqueue(Timer{ran[i].job, nextDeadline(ran[i].job, ran[i].priority, horizon)});
+        }
+    }
+    return count;
+}
+
+uint32_t Scheduler::firstDeadline(Job job, uint32_t nowS) const {
+    switch (job) {
+        case Job::Sense: return nowS % config.senseIntervalS == 0 ? nowS : periodicAfter(0, config.senseIntervalS, nowS);
+        case Job::TxFirst: return dailyAt(config.txSecondsOfDay[0], nowS);
+        case Job::TxSecond: return dailyAt(config.txSecondsOfDay[1], nowS);
+        case Job::CalibrateClock: return dailyAt(config.calibrateClockSecondOfDay, nowS);
+        case Job::CheckDeviceStatus: return nowS;   // right after start, then periodically
+        default: return nowS;
+    }
+}
+
+uint32_t Scheduler::nextDeadline(Job job, uint32_t deadline, uint32_t nowS) const {
+    switch (job) {
+        case Job::Sense: return periodicAfter(deadline, config.senseIntervalS, nowS);
+        case Job::CheckDeviceStatus: return periodicAfter(deadline, config.statusCheckIntervalS, nowS);
+        default: return periodicAfter(deadline, SECONDS_PER_DAY, nowS);
+    }
+}
+
+void Scheduler::schedule(Job job, uint32_t nowS) {
+    timers.enqueue(Timer{job, firstDeadline(job, nowS)});
+}
+
+void Scheduler::unschedule(Job job) {
+    Timer kept[JOB_COUNT];
+    uint8_t count = 0;
+    while (!timers.isEmpty()) {
+        Timer timer = timers.dequeue();
+        if (timer.job != job) {
+            kept[count++] = timer;
+        }
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        timers.enqueue(kept[i]);
+    }
+}
+
+/* ---- the scheduler task ---- */
+RingParker senseDue;
+
+void rescheduleTxTimes() {
+    txTimesChanged.store(true);
+    schedulerWake.signal();
+}
+
+void changeSenseInterval(uint32_t intervalS) {
+    requestedSenseIntervalS.store(intervalS);
+    schedulerWake.signal();
+}
+
+void retryTxAt(uint32_t atS) {
+    requestedTxRetryS.store(atS);
+    schedulerWake.signal();
+}
+
+namespace {
+
+// the device's send times in its tx slots
+void loadTxTimes(uint32_t secondsOfDay[2]) {
+    TxSlot slots[2];
+    loadTxSlots(slots);
+    uint32_t deviceId = 0;
+    hal::nvsGet(NVS_KEY_DEVICE_ID, &deviceId, sizeof(deviceId));
+    secondsOfDay[0] = txSecondOfDay(slots[0], 0, deviceId);
+    secondsOfDay[1] = txSecondOfDay(slots[1], 1, deviceId);
+}
+
+void runJob(Job job) {
+    switch (job) {
+        case Job::Sense: senseDue.signal(); break;
+        case Job::TxFirst:
+        case Job::TxSecond:
+            enqueueEvent(EventType::SendData, 2);
+            uplinkDue.signal();     // the uplink backlog goes out in the same radio wakeup
+            break;
+        case Job::TxRetry: enqueueEvent(EventType::SendData, 2); break;     // the uplink has a backoff of its own
+        case Job::CalibrateClock:
+            if (clockDrift.isSyncDue(hal::epochSeconds())) {    // not on the days the drift fit bridges
+                enqueueEvent(EventType::CalibrateClock, 3);
+            }
+            break;
+        case Job::CheckDeviceStatus: enqueueEvent(EventType::CheckDeviceStatus, 3); break;
+        default: break;
+    }
+}
+
+}  // namespace
+
+void scheduler() {
+    SchedulerConfig config{senseInterval / 1000U, {0, 0}, CALIBRATE_CLOCK_SECOND_OF_DAY, STATUS_CHECK_INTERVAL_S,
+                           SCHEDULER_SLACK_S};
+    loadTxTimes(config.txSecondsOfDay);
+    static Scheduler jobs(config);
+    jobs.start(epochNow());
+    while (true) {
+        uint32_t now = epochNow();      // the deadlines are NTP time
+        if (txTimesChanged.exchange(false)) {
+            uint32_t secondsOfDay[2];
+            loadTxTimes(secondsOfDay);
+            jobs.setTxTimes(secondsOfDay[0], secondsOfDay[1], now);
+        }
+        if (uint32_t intervalS = requestedSenseIntervalS.exchange(0)) {
+            jobs.setSenseInterval(intervalS);
+        }
+        if (uint32_t retryAtS = requestedTxRetryS.exchange(0)) {
+            jobs.setTxRetry(retryAtS);
+        }
+        uint32_t wakeup = jobs.nextWakeup();
+        if (wakeup > now) {
+            // parked, not polling: with nothing else to do, the idle task lets the chip sleep until then
+            energyLedger.taskAsleep(EnergyTask::Scheduler);
+            schedulerWake.wait((wakeup - now) * 1000U);
+            energyLedger.taskAwake(EnergyTask::Scheduler);
+            continue;
+        }
+        Job due[JOB_COUNT];
+        uint8_t count = jobs.runDue(now, due);
+        for (uint8_t i = 0; i < count; i++) {
+            runJob(due[i]);
+        }
+    }
+}
@@ -0,0 +1,221 @@
+#include "sensors.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "battery.h"
+#include "clock_drift.h"
+#include "config.h"
+#include "data.h"
+#include "device_status.h"
+#include "energy.h"
+#include "hal.h"
+#include "logging.h"
+#include "scheduler.h"
+
+namespace {
+
+constexpr uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+static_assert((LOAD_CELL_COLD_SETTLE_SAMPLES + LOAD_CELL_RING_LENGTH + 1) * LOAD_CELL_SAMPLE_PERIOD_MS < senseInterval,
+              "a cold burst must end before the next interval");
+static_assert(LOAD_CELL_COLD_SETTLE_SAMPLES >= LOAD_CELL_SETTLE_SAMPLES, "a cold start settles at least as long as a warm one");
+static_assert(ADAPTIVE_IDLE_INTERVAL_S % (senseInterval / 1000U) == 0, "idle readings stay on the minute grid");
+static_assert(SCHEDULER_SLACK_S <= 30, "getLoadCellData rounds the reading's time to the nearest minute");
+
+SampleRing<LOAD_CELL_RING_LENGTH> samples;
+std::atomic<uint8_t> settling{0};   // conversions still to drop after power up
+
+// DOUT went low: a conversion is ready. reading it in the ISR takes ~50us, and frees the task from polling the chip
+void HAL_ISR onLoadCellReady() {
+    if (!hal::loadCellIsReady()) {
+        return;     // fired again by the data bits of a read
+    }
+    int32_t raw = hal::loadCellReadRaw();
+    uint8_t left = settling.load(std::memory_order_relaxed);
+    if (left > 0) {
+        settling.store(left - 1, std::memory_order_relaxed);
+        return;
+    }
+    samples.push(raw);
+}
+
+weightType distance(weightType a, weightType b) {
+    return a > b ? a - b : b - a;
+}
+
+// sum / count, rounded to the nearest
+int32_t roundedDivide(int64_t sum, uint16_t count) {
+    int64_t half = count / 2;
+    return static_cast<int32_t>(sum >= 0 ? (sum + half) / count : (sum - half) / count);
+}
+
+int32_t mean(const int32_t *samples, uint16_t count) {
+    int64_t sum = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    return roundedDivide(sum, count);
+}
+
+// a warm reading that's still settling, or has lost its offset
+bool drifted(int32_t raw, int32_t driftCounts, const LoadCellCalibration &calibration) {
+    return driftCounts > LOAD_CELL_DRIFT_COUNTS || raw < calibration.tareRaw - LOAD_CELL_DRIFT_COUNTS;
+}
+
+}  // namespace
+
+HAL_RTC_DATA LoadCellWarmState loadCellWarmState;
+
+int32_t reduceSamples(int32_t *samples, uint16_t count, SampleFilter filter) {
+    switch (filter) {
+        case SampleFilter::Median: {
+            int32_t *middle = samples + count / 2;
+            std::nth_element(samples, middle, samples + count);
+            if (count % 2 == 1) {
+                return *middle;
+            }
+            int32_t below = *std::max_element(samples, middle);    // nth_element left the lower half before middle
+            return roundedDivide(static_cast<int64_t>(below) + *middle, 2);
+        }
+        case SampleFilter::TrimmedMean: {
+            uint16_t trim = static_cast<uint16_t>(count * LOAD_CELL_TRIM_PERCENT / 100);
+            if (trim == 0) {
+                return mean(samples, count);
+            }
+            std::sort(samples, samples + count);
+            return mean(samples + trim, static_cast<uint16_t>(count - 2 * trim));
+        }
+        case SampleFilter::Mean:
+        default: return mean(samples, count);
+    }
+}
+
+bool AdaptiveSampler::onReading(const Record &reading) {
+    bool moving = hasStored && distance(reading.weight, previous) >= config.settleBandGrams;
+    bool changed = !hasStored || distance(reading.weight, lastStored.weight) > config.deadBandGrams;
+    previous = reading.weight;
+    if (moving || changed) {
+        quiet = 0;
+    } else if (quiet < config.quietReadings) {
+        quiet++;
+    }
+    if (moving) {
+        return false;   // not settled yet
+    }
+    uint16_t sinceStored = static_cast<uint16_t>((reading.recordTime + MINUTES_PER_DAY - lastStored.recordTime) % MINUTES_PER_DAY);
+    if (!changed && sinceStored < config.heartbeatMinutes) {
+        return false;
+    }
+    hasStored = true;
+    lastStored = reading;
+    return true;
+}
+
+bool sampleLoadCell(SampleFilter filter, int32_t &raw, uint8_t settleSamples, int32_t *driftCounts) {
+    samples.clear();
+    settling.store(settleSamples, std::memory_order_relaxed);
+    hal::attachFallingEdgeInterrupt(HX711_DOUT, onLoadCellReady);
+    hal::loadCellPowerUp();
+    // the samples come in by interrupt. one more period covers an HX711 oscillator running a bit slow.
+    // the task is parked meanwhile, so the chip light-sleeps between the interrupts
+    energyLedger.taskAsleep(EnergyTask::LoadCell);
+    hal::sleepMs((settleSamples + LOAD_CELL_RING_LENGTH + 1) * LOAD_CELL_SAMPLE_PERIOD_MS);
+    energyLedger.taskAwake(EnergyTask::LoadCell);
+    hal::loadCellPowerDown();
+    hal::detachInterrupt(HX711_DOUT);
+
+    int32_t burst[LOAD_CELL_RING_LENGTH];
+    uint16_t count = samples.copyTo(burst);
+    if (count < LOAD_CELL_RING_LENGTH / 2) {
+        return false;
+    }
+    if (driftCounts != nullptr) {
+        int32_t first = mean(burst, count / 2);
+        int32_t second = mean(burst + count / 2, static_cast<uint16_t>(count - count / 2));
+        *driftCounts = second > first ? second - first : first - second;
+    }
+    raw = reduceSamples(burst, count, filter);
+    return true;
+}
+
+bool readLoadCell(SampleFilter filter, LoadCellReading &reading, LoadCellWarmState &state) {
+    reading.driftFallback = false;
+    if (state.magic == LOAD_CELL_WARM_MAGIC) {
+        int32_t driftCounts = 0;
+        if (!sampleLoadCell(filter, reading.raw, LOAD_CELL_SETTLE_SAMPLES, &driftCounts)) {
+            return false;
+        }
+        if (!drifted(reading.raw, driftCounts, state.calibration)) {
+            reading.start = LoadCellStart::Warm;
+            reading.grams = rawToGrams(reading.raw, state.calibration);
+            return true;
+        }
+        reading.driftFallback = true;
+    }
+    state.calibration = loadCellCalibration();
+    if (!sampleLoadCell(filter, reading.raw, LOAD_CELL_COLD_SETTLE_SAMPLES)) {
+        state.magic = 0;
+        return false;
+    }
+    state.magic = LOAD_CELL_WARM_MAGIC;
+    reading.start = LoadCellStart::Cold;
+    reading.grams = rawToGrams(reading.raw, state.calibration);
+    return true;
+}
+
+void invalidateLoadCellWarmState(LoadCellWarmState &state) {
+    state.magic = 0;
+}
+
+LoadCellCalibration loadCellCalibration() {
+    LoadCellCalibration calibration{LOAD_CELL_DEFAULT_TARE, LOAD_CELL_DEFAULT_COUNTS_PER_GRAM};
+    if (!hal::nvsGet(NVS_KEY_LOAD_CELL_CAL, &calibration, sizeof(calibration)) || !(calibration.countsPerGram > 0)) {
+        calibration = LoadCellCalibration{LOAD_CELL_DEFAULT_TARE, LOAD_CELL_DEFAULT_COUNTS_PER_GRAM};
+    }
+    return calibration;
+}
+
+weightType rawToGrams(int32_t raw, const LoadCellCalibration &calibration) {
+    float grams = std::round((static_cast<float>(raw) - static_cast<float>(calibration.tareRaw)) / calibration.countsPerGram);
+    if (!(grams > 0)) {
+        return 0;
+    }
+    return grams >= static_cast<float>(MAX_RECORD_WEIGHT) ? MAX_RECORD_WEIGHT : static_cast<weightType>(grams);
+}
+
+void getLoadCellData() {
+    static AdaptiveSampler adaptive(AdaptiveConfig{ADAPTIVE_DEAD_BAND_GRAMS, ADAPTIVE_SETTLE_BAND_GRAMS,
+                                                   ADAPTIVE_HEARTBEAT_MINUTES, senseInterval / 1000U,
+                                                   ADAPTIVE_IDLE_INTERVAL_S, ADAPTIVE_QUIET_READINGS});
+    hal::loadCellBegin();
+    hal::loadCellPowerDown();   // powered only for the bursts
+    while (true) {
+        energyLedger.taskAsleep(EnergyTask::LoadCell);
+        senseDue.wait(UINT32_MAX);
+        energyLedger.taskAwake(EnergyTask::LoadCell);
+        bool isActive = getIsActive();
+        if (!isActive) {
+            continue;
+        }
+        // the nearest whole minute: with timer coalescing, senseDue may come up to SCHEDULER_SLACK_S early
+        recordTimeType minute = static_cast<recordTimeType>((epochNow() + 30) % SECONDS_PER_DAY / 60);
+        getBatteryPower(isActive);     // awake anyway: feeds the battery monitor's filter every interval
+        LoadCellReading reading;
+        if (!readLoadCell(LOAD_CELL_FILTER, reading)) {
+            logFile.addLogRow(LogCode::LoadCellNotResponding);
+            continue;
+        }
+        Record record{minute, reading.grams};
+        if (SENSE_MODE == SenseMode::EveryInterval) {
+            dataTable.updateTable(record);
+            continue;
+        }
+        uint32_t intervalS = adaptive.intervalS();
+        if (adaptive.onReading(record)) {
+            dataTable.updateTable(record);
+        }
+        if (adaptive.intervalS() != intervalS) {
+            changeSenseInterval(adaptive.intervalS());
+        }
+    }
+}
@@ -0,0 +1,516 @@
+#include "setup_console.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "credential_vault.h"
+#include "hal.h"
+
+namespace {
+
+using Settings = SetupConsole::Settings;
+using Reply = SetupConsole::Reply;
+using Handler = Reply (*)(Settings &settings, char **args, uint8_t count);
+
+constexpr char BACKSPACE = '\b';
+constexpr char DELETE = 0x7F;       // what most terminals send for backspace
+constexpr char CTRL_U = 0x15;       // erases the line
+constexpr char ESCAPE = 0x1B;
+constexpr char PROMPT[] = "> ";
+constexpr size_t MAX_SSID_LENGTH = sizeof(WifiNetwork::ssid) - 1;
+constexpr size_t MIN_PASSWORD_LENGTH = 8;   // WPA2. 0 is an open network
+constexpr size_t MAX_PASSWORD_LENGTH = sizeof(WifiNetwork::password) - 1;
+constexpr uint32_t MAX_WHOLE_GRAMS = 100000;    // well above PLATE_TOL_MAX, and far from overflowing
+
+char output[2 * CONSOLE_LINE_LENGTH];   // say()'s, only touched by the task running onSetup
+
+void write(const char *text) {
+    hal::serialWrite(text, std::strlen(text));
+}
+
+void say(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(output, sizeof(output), format, args);
+    va_end(args);
+    if (length > 0) {
+        hal::serialWrite(output, std::min(static_cast<size_t>(length), sizeof(output) - 1));
+    }
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// tenths of a gram, for printing without printf's floats
+long toTenths(float grams) {
+    return std::lround(grams * 10);
+}
+
+int8_t findNetwork(const Settings &settings, const char *ssid) {
+    for (uint8_t i = 0; i < WIFI_MAX_NETWORKS; i++) {
+        if (settings.networks[i].ssid[0] != '\0' && std::strcmp(settings.networks[i].ssid, ssid) == 0) {
+            return static_cast<int8_t>(i);
+        }
+    }
+    return -1;
+}
+
+// Into the vault: removes the networks deleted since, and seals the ones added since (wiping their passwords here)
+bool saveNetworks(Settings &settings) {
+    bool saved = true;
+    WifiNetwork stored[WIFI_MAX_NETWORKS];
+    uint8_t count = credentialVault.list(stored);
+    for (uint8_t i = 0; i < count; i++) {   // first, to make room
+        if (findNetwork(settings, stored[i].ssid) < 0) {
+            saved = credentialVault.remove(stored[i].ssid) && saved;
+        }
+    }
+    for (uint8_t i = 0; i < WIFI_MAX_NETWORKS; i++) {
+        WifiNetwork &network = settings.networks[i];
+        uint8_t bit = static_cast<uint8_t>(1U << i);
+        if (network.ssid[0] == '\0' || (settings.sealed & bit) != 0) {
+            continue;
+        }
+        if (credentialVault.add(network.ssid, network.password)) {
+            settings.sealed |= bit;
+            wipeSecret(network.password, sizeof(network.password));
+        } else {
+            saved = false;
+        }
+    }
+    return saved;
+}
+
+bool saveSettings(Settings &settings) {
+    bool saved = saveNetworks(settings);
+    if (settings.serverIp[0] != '\0') {
+        saved = hal::nvsSet(NVS_KEY_SERVER_IP, settings.serverIp, sizeof(settings.serverIp)) && saved;
+    }
+    if (settings.ntpServer[0] != '\0') {
+        saved = hal::nvsSet(NVS_KEY_NTP_SERVER, settings.ntpServer, sizeof(settings.ntpServer)) && saved;
+    }
+    if (settings.plateGrams > 0) {
+        saved = hal::nvsSet(NVS_KEY_PLATE_WEIGHT, &settings.plateGrams, sizeof(settings.plateGrams)) && saved;
+    }
+    return hal::nvsCommit() && saved;
+}
+
+// an IPv4 argument into text, normalised
+Reply setIp(const char *what, const char *arg, char (&ip)[IP_TEXT_LENGTH]) {
+    uint8_t octets[4];
+    if (!parseIpv4(arg, octets)) {
+        say("invalid IP \"%s\", please re-enter it as 4 numbers 0-255: 192.168.0.10\r\n", arg);
+        return Reply::Error;
+    }
+    std::snprintf(ip, sizeof(ip), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+    say("%s: %s\r\n", what, ip);
+    return Reply::Ok;
+}
+
+Reply help(Settings &, char **, uint8_t);
+
+Reply show(Settings &settings, char **, uint8_t) {
+    write("wifi:");
+    bool any = false;
+    for (const WifiNetwork &network : settings.networks) {
+        if (network.ssid[0] != '\0') {
+            say(" \"%s\"", network.ssid);
+            any = true;
+        }
+    }
+    write(any ? "\r\n" : " (none)\r\n");
+    say("server: %s\r\n", settings.serverIp[0] != '\0' ? settings.serverIp : "(not set)");
+    if (settings.ntpServer[0] != '\0') {
+        say("ntp: %s\r\n", settings.ntpServer);
+    } else {
+        say("ntp: %s (default)\r\n", NTP_DEFAULT_SERVER);
+    }
+    if (settings.plateGrams > 0) {
+        long tenths = toTenths(settings.plateGrams);
+        say("plate: %ld.%ld g\r\n", tenths / 10, tenths % 10);
+    } else {
+        write("plate: (not set)\r\n");
+    }
+    return Reply::Ok;
+}
+
+Reply wifiAdd(Settings &settings, char **args, uint8_t) {
+    const char *ssid = args[0];
+    const char *password = args[1];
+    size_t ssidLength = std::strlen(ssid);
+    size_t passwordLength = std::strlen(password);
+    if (ssidLength == 0 || ssidLength > MAX_SSID_LENGTH) {
+        say("invalid SSID, it has 1 to %u characters\r\n", static_cast<unsigned>(MAX_SSID_LENGTH));
+        return Reply::Error;
+    }
+    if (passwordLength != 0 && (passwordLength < MIN_PASSWORD_LENGTH || passwordLength > MAX_PASSWORD_LENGTH)) {
+        say("invalid password, it has %u to %u characters (\"\" for an open network)\r\n",
+            static_cast<unsigned>(MIN_PASSWORD_LENGTH), static_cast<unsigned>(MAX_PASSWORD_LENGTH));
+        return Reply::Error;
+    }
+    if (findNetwork(settings, ssid) >= 0) {
+        say("\"%s\" is already stored. to change its password, delete it and add it again\r\n", ssid);
+        return Reply::Error;
+    }
+    for (WifiNetwork &network : settings.networks) {
+        if (network.ssid[0] == '\0') {
+            std::memcpy(network.ssid, ssid, ssidLength + 1);
+            std::memcpy(network.password, password, passwordLength + 1);
+            settings.sealed &= static_cast<uint8_t>(~(1U << (&network - settings.networks)));
+            say("added \"%s\"\r\n", ssid);
+            return Reply::Ok;
+        }
+    }
+    say("no room, %u networks are stored. delete one first\r\n", static_cast<unsigned>(WIFI_MAX_NETWORKS));
+    return Reply::Error;
+}
+
+Reply wifiDelete(Settings &settings, char **args, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {   // all or nothing
+        if (findNetwork(settings, args[i]) < 0) {
+            say("no network \"%s\", nothing deleted\r\n", args[i]);
+            return Reply::Error;
+        }
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        int8_t index = findNetwork(settings, args[i]);
+        if (index >= 0) {   // unless it was named twice
+            settings.networks[index] = WifiNetwork{};
+            settings.sealed &= static_cast<uint8_t>(~(1U << index));
+            say("deleted \"%s\"\r\n", args[i]);
+        }
+    }
+    return Reply::Ok;
+}
+
+Reply server(Settings &settings, char **args, uint8_t) {
+    return setIp("server", args[0], settings.serverIp);
+}
+
+Reply ntp(Settings &settings, char **args, uint8_t) {
+    return setIp("ntp", args[0], settings.ntpServer);
+}
+
+Reply plate(Settings &settings, char **args, uint8_t) {
+    float grams;
+    if (!parsePlateWeight(args[0], grams)) {
+        say("invalid weight \"%s\", please re-enter it: %ld to %ld g\r\n", args[0], toTenths(PLATE_TOL_MIN) / 10,
+            toTenths(PLATE_TOL_MAX) / 10);
+        return Reply::Error;
+    }
+    settings.plateGrams = grams;
+    long tenths = toTenths(grams);
+    say("plate: %ld.%ld g\r\n", tenths / 10, tenths % 10);
+    return Reply::Ok;
+}
+
+Reply save(Settings &settings, char **, uint8_t) {
+    if (!saveSettings(settings)) {
+        write("could not save the settings, please try again\r\n");
+        return Reply::Error;
+    }
+    write("saved\r\n");
+    return Reply::Ok;
+}
+
+Reply done(Settings &settings, char **args, uint8_t count) {
+    bool network = false;
+    for (const WifiNetwork &stored : settings.networks) {
+        network = network || stored.ssid[0] != '\0';
+    }
+    if (!network || settings.serverIp[0] == '\0' || settings.plateGrams <= 0) {
+        say("missing:%s%s%s\r\n", network ? "" : " a wifi network", settings.serverIp[0] != '\0' ? "" : " the server IP",
+            settings.plateGrams > 0 ? "" : " the plate weight");
+        return Reply::Error;
+    }
+    if (save(settings, args, count) != Reply::Ok) {
+        return Reply::Error;
+    }
+    write("setup done\r\n");
+    return Reply::Done;
+}
+
+struct Command {
+    const char *name;
+    const char *sub;        // a second word, or nullptr
+    uint8_t minArgs;
+    uint8_t maxArgs;
+    Handler handler;
+    const char *usage;
+    const char *help;
+};
+
+constexpr Command COMMANDS[] = {
+    {"help", nullptr, 0, 0, help, "help", "this list"},
+    {"show", nullptr, 0, 0, show, "show", "the settings"},
+    {"wifi", "add", 2, 2, wifiAdd, "wifi add <ssid> <password>", "quote an SSID with spaces. \"\": open network"},
+    {"wifi", "del", 1, CONSOLE_MAX_TOKENS - 2, wifiDelete, "wifi del <ssid> [<ssid>...]", "deletes networks"},
+    {"server", nullptr, 1, 1, server, "server <ip>", "the main server"},
+    {"ntp", nullptr, 1, 1, ntp, "ntp <ip>", "the NTP server"},
+    {"plate", nullptr, 1, 1, plate, "plate <grams>", "the weighing plate's weight"},
+    {"save", nullptr, 0, 0, save, "save", "writes the settings"},
+    {"done", nullptr, 0, 0, done, "done", "saves them and ends the setup"},
+};
+
+Reply help(Settings &, char **, uint8_t) {
+    for (const Command &command : COMMANDS) {
+        say("  %-28s %s\r\n", command.usage, command.help);
+    }
+    return Reply::Ok;
+}
+
+}  // namespace
+
+SetupConsole setupConsole;
+
+void SetupConsole::begin() {
+    edited = Settings{};
+    credentialVault.mount();
+    uint8_t stored = credentialVault.list(edited.networks);
+    edited.sealed = static_cast<uint8_t>((1U << stored) - 1);
+    if (hal::nvsGet(NVS_KEY_SERVER_IP, edited.serverIp, sizeof(edited.serverIp))) {
+        edited.serverIp[sizeof(edited.serverIp) - 1] = '\0';
+    }
+    if (hal::nvsGet(NVS_KEY_NTP_SERVER, edited.ntpServer, sizeof(edited.ntpServer))) {
+        edited.ntpServer[sizeof(edited.ntpServer) - 1] = '\0';
+    }
+    if (!hal::nvsGet(NVS_KEY_PLATE_WEIGHT, &edited.plateGrams, sizeof(edited.plateGrams)) ||
+        !(edited.plateGrams > 0)) {
+        edited.plateGrams = 0;
+    }
+    length = 0;
+    overflowed = false;
+    afterCr = false;
+    escape = 0;
+    finished = false;
+    lastInputMs = hal::millis();
+    write("\r\n*** setup *** type help for the commands\r\n");
+    show(edited, nullptr, 0);
+    write(PROMPT);
+}
+
+bool SetupConsole::poll() {
+    char received[32];
+    size_t count;
+    while (!finished && (count = hal::serialRead(received, sizeof(received))) > 0) {
+        lastInputMs = hal::millis();
+        for (size_t i = 0; i < count && !finished; i++) {
+            handle(received[i]);
+        }
+    }
+    return !finished;
+}
+
+bool SetupConsole::run(uint32_t idleTimeoutMs) {
+    lastInputMs = hal::millis();
+    while (poll()) {
+        if (hal::millis() - lastInputMs >= idleTimeoutMs) {
+            return false;
+        }
+        hal::sleepMs(CONSOLE_POLL_MS);     // the other tasks run meanwhile
+    }
+    return true;
+}
+
+SetupConsole::Reply SetupConsole::execute(char *text) {
+    char *tokens[CONSOLE_MAX_TOKENS];
+    int8_t count = tokenize(text, tokens, CONSOLE_MAX_TOKENS);
+    if (count < 0) {
+        write("too many arguments, or a quote isn't closed\r\n");
+        return Reply::Error;
+    }
+    if (count == 0) {
+        return Reply::Ok;
+    }
+    bool known = false;
+    for (const Command &command : COMMANDS) {
+        if (std::strcmp(tokens[0], command.name) != 0) {
+            continue;
+        }
+        known = true;
+        uint8_t words = 1;
+        if (command.sub != nullptr) {
+            if (count < 2 || std::strcmp(tokens[1], command.sub) != 0) {
+                continue;
+            }
+            words = 2;
+        }
+        uint8_t args = static_cast<uint8_t>(count - words);
+        if (args < command.minArgs || args > command.maxArgs) {
+            say("usage: %s\r\n", command.usage);
+            return Reply::Error;
+        }
+        return command.handler(edited, tokens + words, args);
+    }
+    if (!known) {
+        say("unknown command \"%s\", type help for the commands\r\n", tokens[0]);
+        return Reply::Error;
+    }
+    for (const Command &command : COMMANDS) {   // the name without a known second word
+        if (std::strcmp(tokens[0], command.name) == 0) {
+            say("usage: %s\r\n", command.usage);
+        }
+    }
+    return Reply::Error;
+}
+
+void SetupConsole::handle(char c) {
+    if (escape == 1) {
+        escape = c == '[' ? 2 : 0;
+        return;
+    }
+    if (escape == 2) {
+        if (c >= 0x40 && c <= 0x7E) {   // the sequence's final byte
+            escape = 0;
+        }
+        return;
+    }
+    bool wasCr = afterCr;
+    afterCr = c == '\r';
+    switch (c) {
+    case '\n':
+        if (!wasCr) {
+            endLine();
+        }
+        return;
+    case '\r':
+        endLine();
+        return;
+    case ESCAPE:
+        escape = 1;
+        return;
+    case BACKSPACE:
+    case DELETE:
+        if (length > 0) {
+            length--;
+            write("\b \b");
+        }
+        return;
+    case CTRL_U:
+        length = 0;
+        overflowed = false;
+        write("^U\r\n");
+        write(PROMPT);
+        return;
+    default:
+        break;
+    }
+    if (c < ' ' || c > '~') {
+        return;     // other control characters, and anything beyond ASCII
+    }
+    if (length + 1 >= CONSOLE_LINE_LENGTH) {
+        overflowed = true;
+        write("\a");
+        return;
+    }
+    line[length++] = c;
+    hal::serialWrite(&c, 1);
+}
+
+void SetupConsole::endLine() {
+    write("\r\n");
+    if (overflowed) {
+        say("line too long, at most %u characters\r\n", static_cast<unsigned>(CONSOLE_LINE_LENGTH - 1));
+    } else {
+        line[length] = '\0';
+        finished = execute(line) == Reply::Done;
+    }
+    length = 0;
+    overflowed = false;
+    if (!finished) {
+        write(PROMPT);
+    }
+}
+
+bool parseIpv4(const char *text, uint8_t octets[4]) {
+    const char *c = text;
+    for (uint8_t i = 0; i < 4; i++) {
+        if (!isDigit(*c) || (*c == '0' && isDigit(c[1]))) {
+            return false;
+        }
+        uint16_t value = 0;
+        for (uint8_t digits = 0; isDigit(*c); digits++, c++) {
+            if (digits == 3) {
+                return false;
+            }
+            value = static_cast<uint16_t>(value * 10 + (*c - '0'));
+        }
+        if (value > 255) {
+            return false;
+        }
+        octets[i] = static_cast<uint8_t>(value);
+        if (i < 3 && *c++ != '.') {
+            return false;
+        }
+    }
+    return *c == '\0';
+}
+
+bool parsePlateWeight(const char *text, float &grams) {
+    uint32_t whole = 0;
+    uint32_t fraction = 0;
+    uint32_t scale = 1;
+    bool digits = false;
+    bool point = false;
+    for (const char *c = text; *c != '\0'; c++) {
+        if (isDigit(*c)) {
+            digits = true;
+            if (!point) {
+                whole = whole * 10 + static_cast<uint32_t>(*c - '0');
+                if (whole > MAX_WHOLE_GRAMS) {
+                    return false;
+                }
+            } else if (scale < 1000000) {   // finer than a microgram is dropped
+                fraction = fraction * 10 + static_cast<uint32_t>(*c - '0');
+                scale *= 10;
+            }
+        } else if (*c == '.' && !point) {
+            point = true;
+        } else {
+            return false;
+        }
+    }
+    float value = static_cast<float>(whole) + static_cast<float>(fraction) / static_cast<float>(scale);
+    if (!digits || value < PLATE_TOL_MIN || value > PLATE_TOL_MAX) {
+        return false;
+    }
+    grams = value;
+    return true;
+}
+
+int8_t tokenize(char *text, char *tokens[], uint8_t capacity) {
+    uint8_t count = 0;
+    char *c = text;
+    while (true) {
+        while (*c == ' ') {
+            c++;
+        }
+        if (*c == '\0') {
+            return static_cast<int8_t>(count);
+        }
+        if (count == capacity) {
+            return -1;
+        }
+        if (*c == '"') {
+            char *close = std::strchr(c + 1, '"');
+            if (close == nullptr || (close[1] != ' ' && close[1] != '\0')) {
+                return -1;  // not closed, or closed in the middle of a token
+            }
+            tokens[count++] = c + 1;
+            *close = '\0';
+            c = close + 1;
+            continue;
+        }
+        tokens[count++] = c;
+        while (*c != ' ' && *c != '\0') {
+            c++;
+        }
+        if (*c == ' ') {
+            *c++ = '\0';
+        }
+    }
+}
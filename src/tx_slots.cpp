@@ -0,0 +1,95 @@
+#include "tx_slots.h"
+
+#include <algorithm>
+
+#include "hal.h"
+
+namespace {
+
+constexpr uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+static_assert(TX_HISTORY_LENGTH >= 1 && TX_HISTORY_LENGTH <= 8, "the history is one byte");
+static_assert(TX_RENEGOTIATE_FAILURES <= TX_HISTORY_LENGTH, "renegotiation must be reachable");
+static_assert(TX_BACKOFF_BASE_S > 0 && TX_BACKOFF_BASE_S <= TX_BACKOFF_MAX_S, "the backoff grows from the base");
+
+// murmur3's finalizer: every input bit flips about half the output bits, so neighbouring deviceIDs land far apart
+uint32_t mix32(uint32_t value) {
+    value ^= value >> 16;
+    value *= 0x85EBCA6BU;
+    value ^= value >> 13;
+    value *= 0xC2B2AE35U;
+    value ^= value >> 16;
+    return value;
+}
+
+}  // namespace
+
+HAL_RTC_DATA TxSlotState txSlotState;
+
+uint32_t txJitterS(uint32_t deviceId, uint8_t slot, uint16_t windowS) {
+    if (windowS == 0) {
+        return 0;
+    }
+    return mix32(deviceId * 2U + slot + 0x9E3779B9U) % windowS;
+}
+
+uint32_t txSecondOfDay(const TxSlot &slot, uint8_t index, uint32_t deviceId) {
+    return (slot.startMinute * 60U + txJitterS(deviceId, index, slot.windowS)) % SECONDS_PER_DAY;
+}
+
+bool isValidTxSlot(const TxSlot &slot) {
+    return slot.startMinute < 24 * 60 && slot.windowS < SECONDS_PER_DAY;
+}
+
+void loadTxSlots(TxSlot slots[2]) {
+    TxSlot stored[2];
+    if (hal::nvsGet(NVS_KEY_TX_SLOTS, stored, sizeof(stored)) && isValidTxSlot(stored[0]) && isValidTxSlot(stored[1])) {
+        slots[0] = stored[0];
+        slots[1] = stored[1];
+        return;
+    }
+    slots[0] = DEFAULT_TX_SLOTS[0];
+    slots[1] = DEFAULT_TX_SLOTS[1];
+}
+
+bool storeTxSlots(const TxSlot slots[2]) {
+    if (!isValidTxSlot(slots[0]) || !isValidTxSlot(slots[1])) {
+        return false;
+    }
+    return hal::nvsSet(NVS_KEY_TX_SLOTS, slots, 2 * sizeof(TxSlot)) && hal::nvsCommit();
+}
+
+uint32_t TxSlotState::onSend(bool delivered, bool busyReply, uint16_t retryAfterS, uint32_t deviceId, uint32_t nowS) {
+    history = static_cast<uint8_t>(history << 1 | (delivered ? 0 : 1));
+    sends = static_cast<uint8_t>(std::min<uint32_t>(sends + 1U, TX_HISTORY_LENGTH));
+    if (delivered || !busyReply) {
+        busy = 0;
+        return 0;
+    }
+    if (++busy > TX_BACKOFF_ATTEMPTS) {
+        busy = 0;
+        return 0;   // the next tx time
+    }
+    uint32_t window = std::min<uint32_t>(TX_BACKOFF_BASE_S << (busy - 1), TX_BACKOFF_MAX_S);
+    uint32_t draw = mix32(deviceId ^ mix32(nowS + busy));
+    return retryAfterS + window / 2 + draw % (window - window / 2 + 1);
+}
+
+uint8_t TxSlotState::failures() const {
+    uint8_t kept = static_cast<uint8_t>(history & ((1U << sends) - 1U));
+    uint8_t count = 0;
+    for (; kept != 0; kept &= static_cast<uint8_t>(kept - 1)) {
+        count++;
+    }
+    return count;
+}
+
+void TxSlotState::renegotiated() {
+    history = 0;
+    sends = 0;
+}
+
+void TxSlotState::reset() {
+    history = 0;
+    sends = 0;
+    busy = 0;
+}
@@ -0,0 +1,319 @@
+#include "uplink.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "energy.h"
+#include "hal.h"
+#include "wifi_link.h"
+
+namespace {
+
+constexpr size_t IP_LENGTH = 16;
+constexpr size_t ID_LENGTH = 24;        // "daphi/" + a uint32 + "/up", and the client id
+
+// MQTT 3.1.1 control packets
+constexpr uint8_t CONNECT = 0x10;
+constexpr uint8_t CONNACK = 0x20;
+constexpr uint8_t PUBLISH_QOS1 = 0x32;
+constexpr uint8_t PUBACK = 0x40;
+constexpr uint8_t DISCONNECT = 0xE0;
+constexpr uint8_t PROTOCOL_LEVEL = 4;
+
+// backlog record: [type, 1][flags, 1][length, 2 little endian][payload][0x00]
+// the terminator keeps the last byte of an append from being 0xFF (see flash_log.h)
+constexpr uint16_t RECORD_HEADER_SIZE = 4;
+constexpr uint8_t LAST_CHUNK = 0x01;
+
+// a PUBLISH frame: fixed header (1 + up to 2 length bytes) | topic (2 + length) | packet id (2) | batch
+constexpr uint16_t PUBLISH_OVERHEAD = 3 + 2 + ID_LENGTH + 2;
+constexpr uint16_t BATCH_CAPACITY = MQTT_MAX_PACKET_SIZE - PUBLISH_OVERHEAD;
+constexpr uint16_t MAX_BATCHED_RECORD = 1 + 5 + 1 + 2 + UPLINK_CHUNK_SIZE;
+static_assert(MAX_BATCHED_RECORD <= BATCH_CAPACITY, "a chunk must fit in one PUBLISH frame");
+static_assert(RECORD_HEADER_SIZE + UPLINK_CHUNK_SIZE + 1 <= FlashLog::MAX_APPEND, "a chunk must fit in one append");
+static_assert(UPLINK_CHUNK_SIZE < 0x4000, "a chunk's length is at most a 2 byte varint");
+
+uint8_t batch[BATCH_CAPACITY];
+
+uint8_t putVarint(uint8_t *out, uint32_t value) {
+    uint8_t count = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[count++] = static_cast<uint8_t>(byte | (value > 0 ? 0x80 : 0));
+    } while (value > 0);
+    return count;
+}
+
+uint8_t varintSize(uint32_t value) {
+    uint8_t count = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        count++;
+    }
+    return count;
+}
+
+uint8_t putString(uint8_t *out, const char *text) {
+    size_t length = std::strlen(text);
+    out[0] = static_cast<uint8_t>(length >> 8);
+    out[1] = static_cast<uint8_t>(length);
+    std::memcpy(out + 2, text, length);
+    return static_cast<uint8_t>(2 + length);
+}
+
+uint16_t payloadLength(const uint8_t *record) {
+    return static_cast<uint16_t>(record[2] | (record[3] << 8));
+}
+
+// false where a power cut tore an append: the rest of the sector is garbage
+bool isWholeRecord(const FlashSegment &segment, uint16_t position) {
+    const uint8_t *record = segment.data + position;
+    uint16_t length = payloadLength(record);
+    return length <= UPLINK_CHUNK_SIZE && position + RECORD_HEADER_SIZE + length < segment.length &&
+           record[RECORD_HEADER_SIZE + length] == 0x00;
+}
+
+uint32_t deviceId() {
+    uint32_t id = 0;
+    hal::nvsGet(NVS_KEY_DEVICE_ID, &id, sizeof(id));
+    return id;
+}
+
+bool sendAll(int socket, const uint8_t *data, size_t length, uint32_t &bytesSent) {
+    if (hal::socketSend(socket, data, length) != static_cast<int32_t>(length)) {
+        return false;
+    }
+    bytesSent += static_cast<uint32_t>(length);
+    energyLedger.radioSent(static_cast<uint32_t>(length));
+    return true;
+}
+
+bool receiveExactly(int socket, uint8_t *buffer, size_t length, uint32_t &bytesReceived) {
+    size_t received = 0;
+    while (received < length) {
+        int32_t count = hal::socketReceive(socket, buffer + received, length - received, MQTT_TIMEOUT_MS);
+        if (count <= 0) {
+            return false;
+        }
+        received += static_cast<size_t>(count);
+    }
+    bytesReceived += static_cast<uint32_t>(length);
+    return true;
+}
+
+// CONNACK and PUBACK are both 4 bytes: [type][2][2 bytes]
+bool receiveAck(int socket, uint8_t type, uint8_t ack[2], uint32_t &bytesReceived) {
+    uint8_t packet[4];
+    if (!receiveExactly(socket, packet, sizeof(packet), bytesReceived) || packet[0] != type || packet[1] != 2) {
+        return false;
+    }
+    ack[0] = packet[2];
+    ack[1] = packet[3];
+    return true;
+}
+
+int connectToBroker(Uplink::Stats &stats) {
+    char brokerIp[IP_LENGTH] = {};
+    if (!hal::nvsGet(NVS_KEY_MQTT_BROKER, brokerIp, sizeof(brokerIp)) &&
+        !hal::nvsGet(NVS_KEY_SERVER_IP, brokerIp, sizeof(brokerIp))) {
+        return hal::INVALID_SOCKET;
+    }
+    brokerIp[IP_LENGTH - 1] = '\0';
+    int socket = hal::socketConnect(brokerIp, MQTT_PORT, MQTT_TIMEOUT_MS);
+    if (socket == hal::INVALID_SOCKET) {
+        return socket;
+    }
+    stats.connects++;
+
+    char clientId[ID_LENGTH];
+    std::snprintf(clientId, sizeof(clientId), "daphi-%lu", static_cast<unsigned long>(deviceId()));
+    uint8_t body[10 + 2 + ID_LENGTH] = {0, 4, 'M', 'Q', 'T', 'T', PROTOCOL_LEVEL,
+                                        0x00,   // flags: clean session off, the broker keeps the session
+                                        static_cast<uint8_t>(MQTT_KEEP_ALIVE_S >> 8),
+                                        static_cast<uint8_t>(MQTT_KEEP_ALIVE_S)};
+    uint8_t bodyLength = static_cast<uint8_t>(10 + putString(body + 10, clientId));
+    uint8_t header[2] = {CONNECT, bodyLength};
+    uint8_t ack[2];
+    stats.roundTrips++;
+    if (!sendAll(socket, header, sizeof(header), stats.bytesSent) ||
+        !sendAll(socket, body, bodyLength, stats.bytesSent) ||
+        !receiveAck(socket, CONNACK, ack, stats.bytesReceived) || ack[1] != 0) {
+        hal::socketClose(socket);
+        return hal::INVALID_SOCKET;
+    }
+    return socket;
+}
+
+}  // namespace
+
+Uplink uplink(flashStore);
+RingParker uplinkDue;
+
+bool Uplink::load() {
+    FlashSegment segment;
+    for (bool found = store.firstSegment(StreamId::Uplink, segment); found;
+         found = store.nextSegment(StreamId::Uplink, segment, segment)) {
+        uint16_t position = 0;
+        while (position + RECORD_HEADER_SIZE < segment.length && isWholeRecord(segment, position)) {
+            position += RECORD_HEADER_SIZE + payloadLength(segment.data + position) + 1;
+        }
+        if (position != segment.length) {
+            store.seal(StreamId::Uplink);   // a torn append: what's enqueued next goes to a sector of its own
+        }
+    }
+    uint32_t progress[2];   // sequence base, sent through
+    if (!hal::nvsGet(NVS_KEY_UPLINK_SEQUENCE, progress, sizeof(progress))) {
+        return false;
+    }
+    sequenceBase = progress[0];
+    store.clearThrough(StreamId::Uplink, progress[1]);  // a power cut may have kept the flush from dropping it
+    return true;
+}
+
+bool Uplink::enqueue(MessageType type, const uint8_t *payload, size_t length) {
+    uint8_t record[RECORD_HEADER_SIZE + UPLINK_CHUNK_SIZE + 1];
+    size_t offset = 0;
+    do {
+        uint16_t chunk = static_cast<uint16_t>(std::min<size_t>(length - offset, UPLINK_CHUNK_SIZE));
+        record[0] = static_cast<uint8_t>(type);
+        record[1] = offset + chunk == length ? LAST_CHUNK : 0;
+        record[2] = static_cast<uint8_t>(chunk);
+        record[3] = static_cast<uint8_t>(chunk >> 8);
+        if (chunk > 0) {
+            std::memcpy(record + RECORD_HEADER_SIZE, payload + offset, chunk);
+        }
+        record[RECORD_HEADER_SIZE + chunk] = 0x00;
+        if (!store.append(StreamId::Uplink, record, static_cast<uint16_t>(RECORD_HEADER_SIZE + chunk + 1))) {
+            return false;
+        }
+        offset += chunk;
+    } while (offset < length);
+    return true;
+}
+
+Uplink::Result Uplink::flush(uint32_t nowS) {
+    if (store.size(StreamId::Uplink) == 0) {
+        backoffS = 0;
+        retryAt = 0;
+        return Result::Empty;
+    }
+    if (retryAt != 0 && nowS < retryAt) {
+        return Result::Waiting;
+    }
+    WifiHold link(EnergyTask::Networkings);
+    int socket = connectToBroker(counters);
+    if (socket == hal::INVALID_SOCKET) {
+        backOff(nowS);
+        return Result::Failed;
+    }
+    // what's enqueued from now on goes to new sectors, and waits for the next flush
+    uint32_t through = store.seal(StreamId::Uplink);
+    uint32_t records = 0;
+    bool sent = publishBacklog(socket, through, records);
+    if (sent) {
+        uint8_t disconnect[2] = {DISCONNECT, 0};
+        sendAll(socket, disconnect, sizeof(disconnect), counters.bytesSent);
+    }
+    hal::socketClose(socket);
+    if (!sent) {
+        backOff(nowS);
+        return Result::Failed;
+    }
+    counters.records += records;
+    sequenceBase += records;
+    // one NVS blob, written at once, is the commit point: a power cut before it sends the backlog again under the
+    // same sequence numbers. after it, load() drops the sent sectors if clearThrough didn't get to
+    uint32_t progress[2] = {sequenceBase, through};
+    hal::nvsSet(NVS_KEY_UPLINK_SEQUENCE, progress, sizeof(progress));
+    hal::nvsCommit();
+    store.clearThrough(StreamId::Uplink, through);
+    backoffS = 0;
+    retryAt = 0;
+    return Result::Sent;
+}
+
+bool Uplink::publishBacklog(int socket, uint32_t through, uint32_t &records) {
+    inflightCount = 0;
+    uint16_t used = 0;
+    uint32_t sequence = sequenceBase;
+    FlashSegment segment;
+    bool more = store.firstSegment(StreamId::Uplink, segment) && segment.sequence <= through;
+    while (more) {
+        uint16_t position = 0;
+        while (position + RECORD_HEADER_SIZE < segment.length && isWholeRecord(segment, position)) {
+            const uint8_t *record = segment.data + position;
+            uint16_t length = payloadLength(record);
+            uint16_t size = static_cast<uint16_t>(1 + varintSize(sequence) + 1 + varintSize(length) + length);
+            if (used + size > BATCH_CAPACITY) {
+                if (!publish(socket, batch, used)) {
+                    return false;
+                }
+                used = 0;
+            }
+            batch[used++] = record[0];
+            used += putVarint(batch + used, sequence);
+            batch[used++] = record[1];
+            used += putVarint(batch + used, length);
+            std::memcpy(batch + used, record + RECORD_HEADER_SIZE, length);
+            used += length;
+            sequence++;
+            position += RECORD_HEADER_SIZE + length + 1;
+        }
+        more = store.nextSegment(StreamId::Uplink, segment, segment) && segment.sequence <= through;
+    }
+    if ((used > 0 && !publish(socket, batch, used)) || !awaitInflight(socket)) {
+        return false;
+    }
+    records = sequence - sequenceBase;
+    return true;
+}
+
+bool Uplink::publish(int socket, const uint8_t *payload, uint16_t length) {
+    if (inflightCount == MQTT_MAX_INFLIGHT && !awaitInflight(socket)) {
+        return false;
+    }
+    char topic[ID_LENGTH];
+    std::snprintf(topic, sizeof(topic), "daphi/%lu/up", static_cast<unsigned long>(deviceId()));
+    uint16_t packetId = nextPacketId;
+    nextPacketId = nextPacketId == UINT16_MAX ? 1 : nextPacketId + 1;     // 0 isn't a valid packet id
+
+    uint8_t header[PUBLISH_OVERHEAD];
+    uint8_t variable[2 + ID_LENGTH + 2];
+    uint8_t variableLength = putString(variable, topic);
+    variable[variableLength++] = static_cast<uint8_t>(packetId >> 8);
+    variable[variableLength++] = static_cast<uint8_t>(packetId);
+    header[0] = PUBLISH_QOS1;
+    uint8_t headerLength = static_cast<uint8_t>(1 + putVarint(header + 1, variableLength + length));
+    std::memcpy(header + headerLength, variable, variableLength);
+    headerLength += variableLength;
+    if (!sendAll(socket, header, headerLength, counters.bytesSent) ||
+        !sendAll(socket, payload, length, counters.bytesSent)) {
+        return false;
+    }
+    counters.publishes++;
+    inflight[inflightCount++] = packetId;
+    return true;
+}
+
+bool Uplink::awaitInflight(int socket) {
+    if (inflightCount == 0) {
+        return true;
+    }
+    counters.roundTrips++;
+    for (uint8_t i = 0; i < inflightCount; i++) {
+        uint8_t ack[2];
+        if (!receiveAck(socket, PUBACK, ack, counters.bytesReceived) ||
+            static_cast<uint16_t>((ack[0] << 8) | ack[1]) != inflight[i]) {
+            return false;
+        }
+    }
+    inflightCount = 0;
+    return true;
+}
+
+void Uplink::backOff(uint32_t nowS) {
+    backoffS = backoffS == 0 ? UPLINK_BACKOFF_MIN_S : std::min(backoffS * 2, UPLINK_BACKOFF_MAX_S);
+    retryAt = nowS + backoffS;
+}
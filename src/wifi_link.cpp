@@ -0,0 +1,156 @@
+#include "wifi_link.h"
+
+#include <cstring>
+
+#include "checksum.h"
+#include "credential_vault.h"
+
+namespace {
+
+constexpr uint32_t CACHE_MAGIC = 0x57464331;    // "WFC1"
+constexpr uint8_t MAX_SCAN_RESULTS = 16;
+
+uint32_t ssidHash(const char *ssid) {
+    uint32_t hash = crc32(ssid, std::strlen(ssid));
+    return hash != 0 ? hash : 1;    // 0 marks an empty entry
+}
+
+}  // namespace
+
+HAL_RTC_DATA WifiCache wifiCache;
+WifiLink wifiLink(wifiCache, &credentialVault, &energyLedger);
+
+bool WifiLink::connect(const WifiNetwork *networks, uint8_t count, uint32_t nowS) {
+    if (cache.magic != CACHE_MAGIC) {
+        std::memset(&cache, 0, sizeof(cache));
+        cache.magic = CACHE_MAGIC;
+    }
+    path = Path::None;
+    if (count == 0) {
+        counters.failures++;    // nothing stored: no scan can find anything to join
+        return false;
+    }
+    if (connectCached(networks, count, nowS)) {
+        path = Path::Cached;
+        return true;
+    }
+    if (connectScanned(networks, count, nowS)) {
+        path = Path::Scanned;
+        return true;
+    }
+    counters.failures++;
+    return false;
+}
+
+void WifiLink::disconnect() {
+    hal::wifiDisconnect();
+    path = Path::None;
+}
+
+bool WifiLink::acquire(const WifiNetwork *networks, uint8_t count, uint32_t nowS, EnergyTask holder) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (holding == 0) {
+        if (ledger != nullptr) {
+            ledger->radioOn(holder);    // the scan and the join are radio time too
+        }
+        if (!connect(networks, count, nowS)) {
+            if (ledger != nullptr) {
+                ledger->radioOff();
+            }
+            return false;
+        }
+    }
+    holding++;
+    return true;
+}
+
+void WifiLink::release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (holding > 0 && --holding == 0) {
+        disconnect();
+        if (ledger != nullptr) {
+            ledger->radioOff();
+        }
+    }
+}
+
+bool WifiLink::connectCached(const WifiNetwork *networks, uint8_t count, uint32_t nowS) {
+    uint8_t index = cache.lastGood;
+    if (index >= count) {
+        return false;
+    }
+    WifiCacheEntry &entry = cache.entries[index];
+    const WifiNetwork &network = networks[index];
+    if (entry.ssidHash == 0 || entry.ssidHash != ssidHash(network.ssid)) {
+        return false;
+    }
+    bool leaseFresh = entry.leaseAtS != 0 && nowS >= entry.leaseAtS && nowS - entry.leaseAtS < WIFI_LEASE_REUSE_S;
+    if (!join(network, &entry.accessPoint, leaseFresh ? &entry.lease : nullptr, WIFI_FAST_CONNECT_TIMEOUT_MS)) {
+        counters.fastMisses++;
+        entry = WifiCacheEntry{};
+        return false;
+    }
+    counters.fastHits++;
+    if (!leaseFresh) {
+        remember(index, network, entry.accessPoint, nowS);  // the lease DHCP just gave
+    }
+    return true;
+}
+
+bool WifiLink::connectScanned(const WifiNetwork *networks, uint8_t count, uint32_t nowS) {
+    hal::WifiAccessPoint found[MAX_SCAN_RESULTS];
+    uint8_t foundCount = hal::wifiScan(found, MAX_SCAN_RESULTS);
+    counters.scans++;
+    for (uint8_t i = 0; i < foundCount; i++) {     // the strongest first
+        for (uint8_t index = 0; index < count; index++) {
+            const WifiNetwork &network = networks[index];
+            if (std::strcmp(found[i].ssid, network.ssid) != 0) {
+                continue;
+            }
+            if (join(network, &found[i], nullptr, WIFI_CONNECT_TIMEOUT_MS)) {
+                remember(index, network, found[i], nowS);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool WifiLink::join(const WifiNetwork &network, const hal::WifiAccessPoint *accessPoint, const hal::WifiLease *lease,
+                    uint32_t timeoutMs) {
+    if (vault == nullptr) {
+        return hal::wifiConnect(network.ssid, network.password, accessPoint, lease, timeoutMs);
+    }
+    char password[sizeof(network.password)];
+    if (!vault->find(network.ssid, password)) {
+        return false;
+    }
+    bool joined = hal::wifiConnect(network.ssid, password, accessPoint, lease, timeoutMs);
+    wipeSecret(password, sizeof(password));
+    return joined;
+}
+
+void WifiLink::remember(uint8_t index, const WifiNetwork &network, const hal::WifiAccessPoint &accessPoint,
+                        uint32_t nowS) {
+    WifiCacheEntry &entry = cache.entries[index];
+    entry.ssidHash = ssidHash(network.ssid);
+    entry.accessPoint = accessPoint;
+    entry.leaseAtS = hal::wifiLease(entry.lease) ? nowS : 0;
+    cache.lastGood = index;
+}
+
+WifiHold::WifiHold(EnergyTask holder) {
+    WifiNetwork networks[WIFI_MAX_NETWORKS];
+    uint8_t count = loadWifiNetworks(networks);     // every time: onSetup may have changed them
+    held = wifiLink.acquire(networks, count, hal::epochSeconds(), holder);
+}
+
+WifiHold::~WifiHold() {
+    if (held) {
+        wifiLink.release();
+    }
+}
+
+uint8_t loadWifiNetworks(WifiNetwork networks[WIFI_MAX_NETWORKS]) {
+    return credentialVault.list(networks);
+}
@@ -0,0 +1,124 @@
+// unit test file
+#include <unity.h>
+
+#include <cstring>
+
+#include "aes_gcm.h"
+
+namespace {
+
+// a hex string into bytes. returns the count
+size_t fromHex(const char *hex, uint8_t *bytes) {
+    size_t count = 0;
+    for (; hex[0] != '\0' && hex[1] != '\0'; hex += 2) {
+        auto nibble = [](char c) { return static_cast<uint8_t>(c <= '9' ? c - '0' : c - 'a' + 10); };
+        bytes[count++] = static_cast<uint8_t>(nibble(hex[0]) << 4 | nibble(hex[1]));
+    }
+    return count;
+}
+
+// the AES-256 cases of the GCM specification (McGrew & Viega), test cases 13 to 16
+struct KnownAnswer {
+    const char *key;
+    const char *nonce;
+    const char *plain;
+    const char *aad;
+    const char *cipher;
+    const char *tag;
+};
+
+constexpr const char *SPEC_KEY = "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308";
+constexpr const char *SPEC_PLAIN = "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+                                   "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39";
+constexpr const char *SPEC_CIPHER = "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+                                    "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662";
+
+const KnownAnswer KNOWN_ANSWERS[] = {
+    {"0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000", "", "", "",
+     "530f8afbc74536b9a963b4f1c4cb738b"},
+    {"0000000000000000000000000000000000000000000000000000000000000000", "000000000000000000000000",
+     "00000000000000000000000000000000", "", "cea7403d4d606b6e074ec5d3baf39d18", "d0d1c8a799996bf0265b98b5d48ab919"},
+    {SPEC_KEY, "cafebabefacedbaddecaf888", SPEC_PLAIN, "feedfacedeadbeeffeedfacedeadbeefabaddad2", SPEC_CIPHER,
+     "76fc6ece0f4e1768cddf8853bb2d551b"},
+};
+
+}  // namespace
+
+/** Implement and test:
+ * Given: the AES-256 test cases of the GCM specification: no data, one block, and 60 bytes with 20 bytes of AAD
+ * When: each is sealed, and its ciphertext opened
+ * Then: the ciphertext and the tag are the specification's, and opening gives the plaintext back
+ */
+void test_aes_gcm_known_answers() {
+    for (const KnownAnswer &known : KNOWN_ANSWERS) {
+        uint8_t key[AES_GCM_KEY_SIZE];
+        uint8_t nonce[AES_GCM_NONCE_SIZE];
+        uint8_t plain[64];
+        uint8_t aad[32];
+        uint8_t expectedCipher[64];
+        uint8_t expectedTag[AES_GCM_TAG_SIZE];
+        fromHex(known.key, key);
+        fromHex(known.nonce, nonce);
+        size_t length = fromHex(known.plain, plain);
+        size_t aadLength = fromHex(known.aad, aad);
+        fromHex(known.cipher, expectedCipher);
+        fromHex(known.tag, expectedTag);
+
+        AesGcm gcm;
+        gcm.setKey(key);
+        uint8_t cipher[64];
+        uint8_t tag[AES_GCM_TAG_SIZE];
+        gcm.seal(nonce, aad, aadLength, plain, length, cipher, tag);
+        TEST_ASSERT_EQUAL_MEMORY(expectedTag, tag, AES_GCM_TAG_SIZE);
+        if (length > 0) {
+            TEST_ASSERT_EQUAL_MEMORY(expectedCipher, cipher, length);
+        }
+        uint8_t opened[64];
+        TEST_ASSERT_TRUE(gcm.open(nonce, aad, aadLength, cipher, length, tag, opened));
+        if (length > 0) {
+            TEST_ASSERT_EQUAL_MEMORY(plain, opened, length);
+        }
+    }
+}
+
+/** Implement and test:
+ * Given: a record sealed with its AAD
+ * When: it's opened with one bit flipped in the ciphertext, the tag or the AAD, or with another key
+ * Then: each is refused, and the output is zeroed rather than left half decrypted
+ */
+void test_aes_gcm_refuses_tampering() {
+    uint8_t key[AES_GCM_KEY_SIZE] = {1, 2, 3};
+    uint8_t nonce[AES_GCM_NONCE_SIZE] = {9, 8, 7};
+    const char aad[] = "slot 3";
+    const char secret[] = "compost-heap-42";
+    uint8_t cipher[sizeof(secret)];
+    uint8_t tag[AES_GCM_TAG_SIZE];
+    AesGcm gcm;
+    gcm.setKey(key);
+    gcm.seal(nonce, aad, sizeof(aad), secret, sizeof(secret), cipher, tag);
+    TEST_ASSERT_TRUE(std::memcmp(cipher, secret, sizeof(secret)) != 0);
+
+    char opened[sizeof(secret)];
+    cipher[4] ^= 0x10;
+    TEST_ASSERT_FALSE(gcm.open(nonce, aad, sizeof(aad), cipher, sizeof(cipher), tag, opened));
+    cipher[4] ^= 0x10;
+    tag[15] ^= 0x01;
+    TEST_ASSERT_FALSE(gcm.open(nonce, aad, sizeof(aad), cipher, sizeof(cipher), tag, opened));
+    tag[15] ^= 0x01;
+    TEST_ASSERT_FALSE(gcm.open(nonce, "slot 4", sizeof(aad), cipher, sizeof(cipher), tag, opened));
+    for (char c : opened) {
+        TEST_ASSERT_EQUAL_UINT8(0, static_cast<uint8_t>(c));
+    }
+
+    AesGcm other;
+    key[0] ^= 0x80;
+    other.setKey(key);
+    TEST_ASSERT_FALSE(other.open(nonce, aad, sizeof(aad), cipher, sizeof(cipher), tag, opened));
+    TEST_ASSERT_TRUE(gcm.open(nonce, aad, sizeof(aad), cipher, sizeof(cipher), tag, opened));
+    TEST_ASSERT_EQUAL_STRING(secret, opened);
+}
+
+void runAesGcmTests() {
+    RUN_TEST(test_aes_gcm_known_answers);
+    RUN_TEST(test_aes_gcm_refuses_tampering);
+}
@@ -0,0 +1,273 @@
+// unit test file
+#include <unity.h>
+
+#ifndef ARDUINO
+#include <cstdio>
+#include <cstring>
+
+#include "battery.h"
+#include "credential_vault.h"
+#include "events.h"
+#include "hal.h"
+#include "hal_sim.h"
+#include "logging.h"
+#include "wifi_link.h"
+
+namespace {
+
+constexpr uint32_t MINUTE_MS = 60 * 1000;
+constexpr uint16_t LOW_MV = BATTERY_CONFIG.lowMilliVolts;
+
+/* A noisy battery: every ADC read sees batteryMilliVolts, plus a ripple that holds for a sample (the load of whatever else
+ * is awake), plus read noise, through the divider */
+uint32_t batteryMilliVolts = 0;
+uint32_t readNoiseMilliVolts = 0;
+uint32_t rippleMilliVolts = 0;
+int32_t ripple = 0;
+uint32_t rng = 0x2545F491;
+
+int32_t noise(uint32_t amplitude) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return amplitude == 0 ? 0 : static_cast<int32_t>(rng % (2 * amplitude + 1)) - static_cast<int32_t>(amplitude);
+}
+
+uint32_t noisyBattery(gpio pin, uint32_t nowMs) {
+    (void) pin;
+    (void) nowMs;
+    return static_cast<uint32_t>(static_cast<int32_t>(batteryMilliVolts) + ripple + noise(readNoiseMilliVolts)) /
+           BATTERY_DIVIDER_RATIO;
+}
+
+void useNoisyBattery(uint32_t milliVolts, uint32_t readNoise, uint32_t rippleNoise) {
+    batteryMilliVolts = milliVolts;
+    readNoiseMilliVolts = readNoise;
+    rippleMilliVolts = rippleNoise;
+    rng = 0x2545F491;
+    hal::sim::setAnalogSource(noisyBattery);
+}
+
+// a minute passes, then the monitor samples
+bool sampleEveryMinute(BatteryMonitor &monitor, EnergyLedger &ledger) {
+    hal::sleepMs(MINUTE_MS);
+    ripple = noise(rippleMilliVolts);
+    return monitor.sample(ledger);
+}
+
+size_t renderedLog(char *text, size_t capacity) {
+    static uint8_t file[LOG_FILE_SIZE];
+    size_t length = logFile.readLogFile(file, sizeof(file));
+    return renderLogFile(file, length, text, capacity);
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: the discharge curve
+ * When: voltages at, between, above and below its points are looked up
+ * Then: the points' % is exact, between two points it's linear, above the first 100 % and at or below MIN_BATTERY_POWER 0 %
+ */
+void test_battery_discharge_curve() {
+    const DischargePoint *curve = BATTERY_DISCHARGE_CURVE;
+    uint8_t length = BATTERY_CONFIG.curveLength;
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, dischargePercent(4200, curve, length));
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, dischargePercent(4180, curve, length));
+    TEST_ASSERT_EQUAL_FLOAT(50.0f, dischargePercent(3760, curve, length));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 55.0f, dischargePercent(3785, curve, length));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 7.5f, dischargePercent(3465, curve, length));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, dischargePercent(LOW_MV, curve, length));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, dischargePercent(2900, curve, length));
+
+    BatteryMonitor monitor(BATTERY_CONFIG);
+    EnergyLedger ledger(ENERGY_PROFILE);
+    hal::sim::setAnalogMilliVolts(BATTERY_POWER, 3720 / BATTERY_DIVIDER_RATIO);
+    TEST_ASSERT_TRUE(monitor.sample(ledger));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, BATTERY_CAPACITY_MAH * 0.4f, monitor.remainingMah());
+}
+
+/** Implement and test:
+ * Given: a battery at 3.8 V, read with +-60 mV of noise and +-20 mV of ripple per sample
+ * When: it's sampled every minute for an hour
+ * Then: the filtered voltage stays within 10 mV of 3.8 V, where single reads are off by far more
+ */
+void test_battery_filter_smooths_noise() {
+    BatteryMonitor monitor(BATTERY_CONFIG);
+    EnergyLedger ledger(ENERGY_PROFILE);
+    useNoisyBattery(3800, 60, 20);
+    uint32_t worstRead = 0;
+    for (int minute = 0; minute < 60; minute++) {
+        TEST_ASSERT_TRUE(sampleEveryMinute(monitor, ledger));
+        uint32_t read = hal::analogReadMilliVolts(BATTERY_POWER) * BATTERY_DIVIDER_RATIO;
+        uint32_t readError = read > 3800 ? read - 3800 : 3800 - read;
+        worstRead = readError > worstRead ? readError : worstRead;
+        if (minute >= 8) {
+            TEST_ASSERT_UINT32_WITHIN(10, 3800, monitor.milliVolts());
+        }
+    }
+    TEST_ASSERT_TRUE(worstRead > 30);
+    TEST_ASSERT_FALSE(monitor.isLow());
+}
+
+/** Implement and test:
+ * Given: a noisy battery running down through MIN_BATTERY_POWER and sitting there, then recovering a little (a cold night
+ *        ends), then charged
+ * When: it's sampled every minute
+ * Then: single reads cross the threshold again and again, but the alert goes on once, stays on within the hysteresis,
+ *       and goes off only above it
+ */
+void test_battery_alert_hysteresis() {
+    BatteryMonitor monitor(BATTERY_CONFIG);
+    EnergyLedger ledger(ENERGY_PROFILE);
+    useNoisyBattery(LOW_MV + 80, 60, 20);
+    uint32_t readCrossings = 0;
+    bool readLow = false;
+    for (int minute = 0; minute < 600; minute++) {
+        // 80 mV down to the threshold in 4 hours, then 6 hours on it
+        batteryMilliVolts = minute < 240 ? LOW_MV + 80 - minute / 3 : LOW_MV;
+        TEST_ASSERT_TRUE(sampleEveryMinute(monitor, ledger));
+        bool below = hal::analogReadMilliVolts(BATTERY_POWER) * BATTERY_DIVIDER_RATIO < LOW_MV;
+        readCrossings += below != readLow ? 1 : 0;
+        readLow = below;
+    }
+    TEST_ASSERT_TRUE(readCrossings > 50);
+    TEST_ASSERT_TRUE(monitor.isLow());
+    TEST_ASSERT_EQUAL_UINT32(1, monitor.lowAlerts());
+
+    batteryMilliVolts = LOW_MV + BATTERY_ALERT_HYSTERESIS_MV - 20;     // recovered, but within the hysteresis
+    for (int minute = 0; minute < 120; minute++) {
+        sampleEveryMinute(monitor, ledger);
+    }
+    TEST_ASSERT_TRUE(monitor.isLow());
+
+    batteryMilliVolts = LOW_MV + BATTERY_ALERT_HYSTERESIS_MV + 40;     // charged
+    for (int minute = 0; minute < 120; minute++) {
+        sampleEveryMinute(monitor, ledger);
+    }
+    TEST_ASSERT_FALSE(monitor.isLow());
+    TEST_ASSERT_EQUAL_UINT32(1, monitor.lowAlerts());
+}
+
+/** Implement and test:
+ * Given: a battery monitor with a reading
+ * When: it's sampled while the radio is on, and while the pin reads out of range
+ * Then: neither sample is taken: the filtered voltage is unchanged; without a reading the voltage is 0
+ */
+void test_battery_skips_radio_and_bad_reads() {
+    BatteryMonitor monitor(BATTERY_CONFIG);
+    EnergyLedger ledger(ENERGY_PROFILE);
+    ledger.start();
+    TEST_ASSERT_FALSE(monitor.sample(ledger));              // the pin floats at 0 V
+    TEST_ASSERT_FALSE(monitor.hasReading());
+    TEST_ASSERT_EQUAL_UINT16(0, monitor.milliVolts());
+
+    hal::sim::setAnalogMilliVolts(BATTERY_POWER, 3900 / BATTERY_DIVIDER_RATIO);
+    TEST_ASSERT_TRUE(monitor.sample(ledger));
+    hal::sim::setAnalogMilliVolts(BATTERY_POWER, 3500 / BATTERY_DIVIDER_RATIO);    // sagging under the TX burst
+    ledger.radioOn(EnergyTask::Networkings);
+    TEST_ASSERT_FALSE(monitor.sample(ledger));
+    ledger.radioOff();
+    TEST_ASSERT_EQUAL_UINT16(3900, monitor.milliVolts());
+
+    hal::sim::setAnalogMilliVolts(BATTERY_POWER, BATTERY_VALID_MAX_MV);            // divider shorted
+    TEST_ASSERT_FALSE(monitor.sample(ledger));
+    TEST_ASSERT_EQUAL_UINT16(3900, monitor.milliVolts());
+}
+
+/** Implement and test:
+ * Given: the device's battery monitor with a reading, and a transfer to the main server holding the device's link
+ * When: it's sampled during the transfer, and after
+ * Then: the sample during the transfer isn't taken, the one after is
+ */
+void test_battery_skips_link_held_by_transfer() {
+    batteryMonitor.reset();
+    energyLedger.start();
+    hal::sim::setAnalogMilliVolts(BATTERY_POWER, 3900 / BATTERY_DIVIDER_RATIO);
+    TEST_ASSERT_TRUE(batteryMonitor.sample());
+    hal::sim::addAccessPoint({"daphi-depot", "compost-heap", {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01}, 6, -55});
+    credentialVault.add("daphi-depot", "compost-heap");
+    {
+        WifiHold transfer(EnergyTask::Events);
+        TEST_ASSERT_TRUE(transfer.isUp());
+        hal::sim::setAnalogMilliVolts(BATTERY_POWER, 3500 / BATTERY_DIVIDER_RATIO);    // sagging under the TX burst
+        TEST_ASSERT_FALSE(batteryMonitor.sample());
+    }
+    TEST_ASSERT_EQUAL_UINT16(3900, batteryMonitor.milliVolts());
+    hal::sim::setAnalogMilliVolts(BATTERY_POWER, 3880 / BATTERY_DIVIDER_RATIO);
+    TEST_ASSERT_TRUE(batteryMonitor.sample());
+    batteryMonitor.reset();
+}
+
+/** Implement and test:
+ * Given: a noisy battery running down 12 mV a day
+ * When: it's sampled every minute for 3 days
+ * Then: there's no trend for the first hours, then the trend is -12 mV per day, within 1 mV
+ */
+void test_battery_trend() {
+    BatteryMonitor monitor(BATTERY_CONFIG);
+    EnergyLedger ledger(ENERGY_PROFILE);
+    useNoisyBattery(3900, 60, 20);
+    float milliVoltsPerDay = 0;
+    for (uint32_t minute = 0; minute < 3 * 1440; minute++) {
+        batteryMilliVolts = 3900 - minute * 12 / 1440;
+        sampleEveryMinute(monitor, ledger);
+        if (minute == 60) {
+            TEST_ASSERT_FALSE(monitor.trend(milliVoltsPerDay));
+        }
+    }
+    TEST_ASSERT_TRUE(monitor.trend(milliVoltsPerDay));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, -12.0f, milliVoltsPerDay);
+}
+
+/** Implement and test:
+ * Given: the device's battery low, with a day of falling readings
+ * When: the device status is checked
+ * Then: the log gets the voltage, the low battery alert and the trend, and the days to empty come from the curve
+ */
+void test_battery_reported_by_status_check() {
+    batteryMonitor.reset();
+    energyLedger.start();
+    useNoisyBattery(3060, 0, 0);
+    for (uint32_t minute = 0; minute < 1440; minute++) {
+        batteryMilliVolts = 3060 - minute * 60 / 1440;
+        sampleEveryMinute(batteryMonitor, energyLedger);
+    }
+    hal::sim::setAnalogMilliVolts(BATTERY_POWER, 3000 / BATTERY_DIVIDER_RATIO);
+    for (int minute = 0; minute < 120; minute++) {
+        sampleEveryMinute(batteryMonitor, energyLedger);
+    }
+    logFile.deleteLogFile();
+
+    onCheckDeviceStatus();
+    static char text[4096];
+    TEST_ASSERT_GREATER_THAN(0, renderedLog(text, sizeof(text)));
+    TEST_ASSERT_NOT_NULL(std::strstr(text, "battery 3000 mV\n"));
+    TEST_ASSERT_NOT_NULL(std::strstr(text, "battery low 3000 mV\n"));
+    TEST_ASSERT_NOT_NULL(std::strstr(text, "battery trend -"));
+    TEST_ASSERT_NOT_NULL(std::strstr(text, "battery empty in 0 days\n"));      // below the curve's last point
+
+    batteryMonitor.reset();
+    hal::sim::setAnalogMilliVolts(BATTERY_POWER, 3720 / BATTERY_DIVIDER_RATIO);
+    logFile.deleteLogFile();
+    onCheckDeviceStatus();
+    char expected[48];
+    std::snprintf(expected, sizeof(expected), "battery empty in %u days\n",
+                  static_cast<unsigned>(daysToEmpty(energyLedger.report(), BATTERY_CAPACITY_MAH * 0.4f)));
+    TEST_ASSERT_GREATER_THAN(0, renderedLog(text, sizeof(text)));
+    TEST_ASSERT_NOT_NULL(std::strstr(text, expected));
+    TEST_ASSERT_NULL(std::strstr(text, "battery low"));
+    batteryMonitor.reset();
+}
+#endif
+
+void runBatteryTests() {
+#ifndef ARDUINO
+    RUN_TEST(test_battery_discharge_curve);
+    RUN_TEST(test_battery_filter_smooths_noise);
+    RUN_TEST(test_battery_alert_hysteresis);
+    RUN_TEST(test_battery_skips_radio_and_bad_reads);
+    RUN_TEST(test_battery_skips_link_held_by_transfer);
+    RUN_TEST(test_battery_trend);
+    RUN_TEST(test_battery_reported_by_status_check);
+#endif
+}
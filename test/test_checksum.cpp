@@ -0,0 +1,137 @@
+// unit test file
+#include <unity.h>
+
+#include "checksum.h"
+#include "config.h"
+#include "data.h"
+#include "data_codec.h"
+#ifndef ARDUINO
+#include "hal_sim.h"
+#endif
+
+namespace {
+
+using Crc32Function = uint32_t (*)(uint32_t, const void *, size_t);
+
+constexpr Crc32Function IMPLEMENTATIONS[] = {crc32Update, crc32UpdateBitwise, crc32UpdateNibble, crc32UpdateSliceBy8};
+
+// deterministic bytes, so a failure can be reproduced
+void fillBytes(uint8_t *bytes, size_t length, uint32_t seed) {
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1664525U + 1013904223U;
+        bytes[i] = static_cast<uint8_t>(seed >> 24);
+    }
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: the standard check input "123456789", and no data at all
+ * When: every implementation computes its CRC32
+ * Then: they give the standard check value 0xCBF43926, and 0 for no data
+ */
+void test_checksum_check_value() {
+    for (Crc32Function crc : IMPLEMENTATIONS) {
+        TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc(0, "123456789", 9));
+        TEST_ASSERT_EQUAL_HEX32(0, crc(0, nullptr, 0));
+    }
+    TEST_ASSERT_EQUAL_HEX32(0x414FA339, crc32("The quick brown fox jumps over the lazy dog", 43));
+}
+
+/** Implement and test:
+ * Given: random data of every length up to 70 bytes, at every alignment up to 8
+ * When: every implementation computes its CRC32
+ * Then: they all agree with the bitwise one (slice-by-8's tail and misaligned loads included)
+ */
+void test_checksum_implementations_agree() {
+    static uint8_t buffer[8 + 70];
+    fillBytes(buffer, sizeof(buffer), 42);
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t length = 0; length <= 70; length++) {
+            uint32_t expected = crc32UpdateBitwise(0, buffer + offset, length);
+            for (Crc32Function crc : IMPLEMENTATIONS) {
+                TEST_ASSERT_EQUAL_HEX32(expected, crc(0, buffer + offset, length));
+            }
+        }
+    }
+}
+
+/** Implement and test:
+ * Given: 1000 bytes split into pieces of 1 to 13 bytes
+ * When: the pieces are fed to a Crc32 one by one
+ * Then: the result is the one-pass CRC, and reset starts over
+ */
+void test_checksum_incremental_equals_one_pass() {
+    static uint8_t buffer[1000];
+    fillBytes(buffer, sizeof(buffer), 7);
+    Crc32 crc;
+    size_t piece = 1;
+    for (size_t offset = 0; offset < sizeof(buffer); offset += piece, piece = piece % 13 + 1) {
+        crc.update(buffer + offset, offset + piece <= sizeof(buffer) ? piece : sizeof(buffer) - offset);
+    }
+    TEST_ASSERT_EQUAL_HEX32(crc32(buffer, sizeof(buffer)), crc.value());
+    crc.reset();
+    crc.update(0x31);
+    TEST_ASSERT_EQUAL_HEX32(crc32("1", 1), crc.value());
+}
+
+/** Implement and test:
+ * Given: a data table filled record by record, with gaps, a midnight wrap and a weight over the maximum
+ * When: it's encoded for sending, after every append and after it's deleted
+ * Then: the checksum the table kept while appending is the payload's CRC trailer every time
+ */
+void test_checksum_data_table_keeps_payload_crc() {
+    const Record records[] = {{600, 5000}, {601, 5002}, {700, 4990}, {1439, 200000},
+                              {0, 0}, {1, 3}, {1, 4}, {300, 70000}};
+    DataTable table(16);
+    table.createDataTable();
+    uint8_t payload[maxEncodedDataSize(16)];
+    TEST_ASSERT_EQUAL_HEX32(dataPayloadChecksum(payload, encodeDataTable(table.readTable(), payload, sizeof(payload))),
+                            table.payloadChecksum());
+    for (const Record &record : records) {
+        TEST_ASSERT_TRUE(table.updateTable(record));
+        size_t length = encodeDataTable(table.readTable(), payload, sizeof(payload));
+        TEST_ASSERT_EQUAL_HEX32(dataPayloadChecksum(payload, length), table.payloadChecksum());
+    }
+    table.deleteTable();
+    table.createDataTable();
+    TEST_ASSERT_TRUE(table.updateTable(Record{10, 10}));
+    size_t length = encodeDataTable(table.readTable(), payload, sizeof(payload));
+    TEST_ASSERT_EQUAL_HEX32(dataPayloadChecksum(payload, length), table.payloadChecksum());
+}
+
+#ifndef ARDUINO
+/** Implement and test:
+ * Given: a data table with records in flash
+ * When: the device reboots and the table is created again
+ * Then: the checksum is rebuilt from flash, and appending goes on from it
+ */
+void test_checksum_rebuilt_after_reboot() {
+    DataTable table(16);
+    table.createDataTable();
+    for (uint16_t i = 0; i < 5; i++) {
+        table.updateTable(Record{static_cast<recordTimeType>(360 + i), 1000U + i});
+    }
+    uint32_t before = table.payloadChecksum();
+
+    hal::sim::powerCycle();
+    flashStore.mount(STORAGE_PARTITION);
+    DataTable rebooted(16);
+    rebooted.createDataTable();
+    TEST_ASSERT_EQUAL_HEX32(before, rebooted.payloadChecksum());
+    rebooted.updateTable(Record{370, 1010});
+    uint8_t payload[maxEncodedDataSize(16)];
+    size_t length = encodeDataTable(rebooted.readTable(), payload, sizeof(payload));
+    TEST_ASSERT_EQUAL_HEX32(dataPayloadChecksum(payload, length), rebooted.payloadChecksum());
+}
+#endif
+
+void runChecksumTests() {
+    RUN_TEST(test_checksum_check_value);
+    RUN_TEST(test_checksum_implementations_agree);
+    RUN_TEST(test_checksum_incremental_equals_one_pass);
+    RUN_TEST(test_checksum_data_table_keeps_payload_crc);
+#ifndef ARDUINO
+    RUN_TEST(test_checksum_rebuilt_after_reboot);
+#endif
+}
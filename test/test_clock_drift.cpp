@@ -0,0 +1,254 @@
+// unit test file
+#include <unity.h>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "clock_drift.h"
+
+#ifndef ARDUINO
+#include "hal.h"
+#include "hal_sim.h"
+#endif
+
+namespace {
+
+constexpr uint32_t MIDNIGHT = 1792195200;      // 17/10/2026 00:00 UTC
+constexpr uint32_t HOUR_S = 60 * 60;
+constexpr uint32_t DAY_S = 24 * HOUR_S;
+
+/* A synthetic RTC: runs `ppm` slow (fast if < 0), plus `wobblePpm` that swings with the day's temperature.
+ * The NTP server answers with `jitterMs` of noise either way, and every `outlierEvery`-th answer is `outlierMs` off */
+struct DriftProfile {
+    double ppm;
+    double wobblePpm;
+    int32_t jitterMs;
+    uint32_t outlierEvery;     // 0: never
+    int32_t outlierMs;
+};
+
+struct ProfileResult {
+    uint32_t syncs = 0;
+    double worstErrorMs = 0;    // of the corrected time, at every hour after the first syncs
+    double worstRawMs = 0;      // of the local clock
+};
+
+class SimulatedClock {
+public:
+    explicit SimulatedClock(const DriftProfile &profile) : profile(profile) {}
+
+    uint32_t trueS() const { return static_cast<uint32_t>(trueMs / 1000); }
+    uint32_t localS() const { return static_cast<uint32_t>(localMs / 1000); }
+    double errorMs(ClockDrift &drift) const {
+        return localMs + static_cast<double>(drift.correctionMs(localS())) - static_cast<double>(trueMs);
+    }
+    double rawErrorMs() const { return static_cast<double>(localMs - trueMs); }
+
+    void advance(uint32_t seconds) {
+        double phase = 2 * M_PI * static_cast<double>(trueMs % (DAY_S * 1000ULL)) / (DAY_S * 1000.0);
+        double ppm = profile.ppm + profile.wobblePpm * std::sin(phase);
+        trueMs += seconds * 1000ULL;
+        localMs += static_cast<int64_t>(std::llround(seconds * 1000.0 * (1 - ppm * 1e-6)));
+    }
+
+    // an NTP sync: the offset as the server measures it, then the clock stepped by what the fit returns
+    void sync(ClockDrift &drift) {
+        queries++;
+        seed = seed * 1103515245U + 12345U;
+        int64_t noise = profile.jitterMs == 0 ? 0 : static_cast<int64_t>(seed >> 8) % (2 * profile.jitterMs + 1) - profile.jitterMs;
+        if (profile.outlierEvery != 0 && queries % profile.outlierEvery == 0) {
+            noise += profile.outlierMs;
+        }
+        int32_t stepS = drift.addSync(localS(), static_cast<int64_t>(trueMs) - localMs + noise);
+        localMs += stepS * 1000LL;
+    }
+
+private:
+    DriftProfile profile;
+    uint64_t trueMs = MIDNIGHT * 1000ULL;
+    int64_t localMs = MIDNIGHT * 1000LL;
+    uint32_t queries = 0;
+    uint32_t seed = 42;
+};
+
+// `days` of the profile: the CalibrateClock job wakes up at 03:00 every day and syncs if the drift says so.
+// the error counts from `settleDays` on
+ProfileResult runProfile(ClockDrift &drift, const DriftProfile &profile, uint32_t days, uint32_t settleDays) {
+    SimulatedClock clock(profile);
+    ProfileResult result;
+    for (uint32_t hour = 0; hour < days * 24; hour++) {
+        if (hour % 24 == 3 && drift.isSyncDue(clock.localS())) {
+            clock.sync(drift);
+            result.syncs++;
+        }
+        if (hour >= settleDays * 24) {
+            result.worstErrorMs = std::fmax(result.worstErrorMs, std::fabs(clock.errorMs(drift)));
+            result.worstRawMs = std::fmax(result.worstRawMs, std::fabs(clock.rawErrorMs()));
+        }
+        clock.advance(HOUR_S);
+    }
+    return result;
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: an RTC on the default oscillator, 20 s an hour slow, and NTP answers +-100 ms off
+ * When: it syncs daily for 5 days
+ * Then: the fitted rate is within 1 ppm of it; from the 3rd day on the corrected time is never 1 s off, where the
+ *       local clock gets 8 minutes off between the syncs
+ */
+void test_clock_drift_fits_constant_drift() {
+    ClockDrift drift;
+    double ppm = 20.0 / 3600 * 1e6;
+    ProfileResult result = runProfile(drift, DriftProfile{ppm, 0, 100, 0, 0}, 5, 2);
+    TEST_ASSERT_EQUAL_UINT32(5, result.syncs);
+    double perLocalSecond = ppm / (1 - ppm * 1e-6);    // the fit's rate is of the local clock's seconds
+    TEST_ASSERT_INT32_WITHIN(1000, static_cast<int32_t>(perLocalSecond * 1000), drift.ratePpb());
+    TEST_ASSERT_TRUE(result.worstErrorMs < 1000);
+    TEST_ASSERT_TRUE(result.worstRawMs > 7 * 60 * 1000);
+}
+
+/** Implement and test:
+ * Given: an RTC 60 ppm fast, NTP answers +-50 ms off, and every 3rd answer 40 s off (a bad server in the pool)
+ * When: it syncs daily for CLOCK_DRIFT_SAMPLES days
+ * Then: the fit follows the good syncs: the rate is within 1 ppm, and the day after the last sync the corrected time
+ *       is within 1 s
+ */
+void test_clock_drift_ignores_outliers() {
+    ClockDrift drift;
+    SimulatedClock clock(DriftProfile{-60, 0, 50, 3, 40000});
+    for (uint8_t day = 0; day < CLOCK_DRIFT_SAMPLES; day++) {
+        clock.sync(drift);
+        clock.advance(DAY_S);
+    }
+    TEST_ASSERT_INT32_WITHIN(1000, -60000, drift.ratePpb());
+    clock.sync(drift);      // the 9th, a good one
+    clock.advance(DAY_S);
+    TEST_ASSERT_TRUE(std::fabs(clock.errorMs(drift)) < 1000);
+}
+
+/** Implement and test:
+ * Given: a fit over a few daily syncs of an RTC 100 ppm slow
+ * When: one NTP answer is 2 hours off, and the next day's is good
+ * Then: the clock isn't stepped by the bad one, the next wakeup syncs again, and the good one keeps the fit: its rate
+ *       and the corrected time are as before
+ */
+void test_clock_drift_holds_single_far_sync() {
+    ClockDrift drift;
+    SimulatedClock clock(DriftProfile{100, 0, 0, 0, 0});
+    for (uint8_t day = 0; day < 3; day++) {
+        clock.sync(drift);
+        clock.advance(DAY_S);
+    }
+    int32_t rate = drift.ratePpb();
+    double errorMs = clock.errorMs(drift);
+    TEST_ASSERT_EQUAL_INT32(0, drift.addSync(clock.localS(), static_cast<int64_t>(2 * HOUR_S) * 1000));
+    TEST_ASSERT_EQUAL_UINT8(3, drift.syncs());
+    TEST_ASSERT_TRUE(std::fabs(clock.errorMs(drift) - errorMs) < 1);
+
+    clock.advance(DAY_S);
+    TEST_ASSERT_TRUE(drift.isSyncDue(clock.localS()));
+    clock.sync(drift);
+    TEST_ASSERT_EQUAL_UINT8(4, drift.syncs());
+    TEST_ASSERT_INT32_WITHIN(1000, rate, drift.ratePpb());
+    clock.advance(DAY_S);
+    TEST_ASSERT_TRUE(std::fabs(clock.errorMs(drift)) < 1000);
+}
+
+/** Implement and test:
+ * Given: an RTC on the internal oscillator, 5 s a day slow, swinging +-3 ppm with the day's temperature, and NTP
+ *        answers +-50 ms off
+ * When: it runs for 30 days, the CalibrateClock job waking daily
+ * Then: after CLOCK_DRIFT_MIN_SAMPLES daily syncs they stretch to CLOCK_SYNC_MAX_DAYS apart, and from the second
+ *       sync on the corrected time stays within CLOCK_DRIFT_BUDGET_MS: its readings keep their minute
+ */
+void test_clock_drift_stretches_syncs() {
+    ClockDrift drift;
+    double ppm = 5.0 / DAY_S * 1e6;
+    ProfileResult result = runProfile(drift, DriftProfile{ppm, 3, 50, 0, 0}, 30, 2);
+    TEST_ASSERT_EQUAL_UINT8(CLOCK_SYNC_MAX_DAYS, drift.syncIntervalDays());
+    uint32_t stretched = CLOCK_DRIFT_MIN_SAMPLES + (30 - CLOCK_DRIFT_MIN_SAMPLES + CLOCK_SYNC_MAX_DAYS - 1) / CLOCK_SYNC_MAX_DAYS;
+    TEST_ASSERT_TRUE(result.syncs <= stretched);
+    TEST_ASSERT_TRUE(result.worstErrorMs < CLOCK_DRIFT_BUDGET_MS);
+}
+
+/** Implement and test:
+ * Given: NTP answers +-3 s off (a congested link)
+ * When: the CalibrateClock job wakes daily for 10 days
+ * Then: the residuals keep the syncs daily
+ */
+void test_clock_drift_keeps_daily_syncs_when_noisy() {
+    ClockDrift drift;
+    ProfileResult result = runProfile(drift, DriftProfile{58, 0, 3000, 0, 0}, 10, 0);
+    TEST_ASSERT_EQUAL_UINT32(10, result.syncs);
+    TEST_ASSERT_EQUAL_UINT8(1, drift.syncIntervalDays());
+}
+
+/** Implement and test:
+ * Given: a fit over a few syncs, then two syncs an hour off (the clock was set by hand), then the first sync of a clock
+ *        that was never set
+ * When: each is added
+ * Then: the first one an hour off only makes the next sync due: no step, the fit is kept. the second one, and the
+ *       clock never set, each start the fit over: one sync, no drift, the step is the whole offset, and no correction
+ *       until the next
+ */
+void test_clock_drift_starts_over_when_clock_set() {
+    ClockDrift drift;
+    SimulatedClock clock(DriftProfile{100, 0, 0, 0, 0});
+    for (uint8_t day = 0; day < 3; day++) {
+        clock.sync(drift);
+        clock.advance(DAY_S);
+    }
+    TEST_ASSERT_EQUAL_UINT8(3, drift.syncs());
+    TEST_ASSERT_TRUE(drift.ratePpb() != 0);
+
+    TEST_ASSERT_EQUAL_INT32(0, drift.addSync(MIDNIGHT + 10 * DAY_S, 3600 * 1000LL));
+    TEST_ASSERT_EQUAL_UINT8(3, drift.syncs());
+    TEST_ASSERT_TRUE(drift.isSyncDue(MIDNIGHT + 10 * DAY_S + HOUR_S));
+    TEST_ASSERT_EQUAL_INT32(3600, drift.addSync(MIDNIGHT + 10 * DAY_S + HOUR_S, 3600 * 1000LL));
+    TEST_ASSERT_EQUAL_UINT8(1, drift.syncs());
+    TEST_ASSERT_EQUAL_INT32(0, drift.ratePpb());
+    TEST_ASSERT_TRUE(drift.correctionMs(MIDNIGHT + 11 * DAY_S) == 0);
+
+    TEST_ASSERT_EQUAL_INT32(static_cast<int32_t>(MIDNIGHT), drift.addSync(0, MIDNIGHT * 1000LL));
+    TEST_ASSERT_EQUAL_UINT8(1, drift.syncs());
+    TEST_ASSERT_TRUE(drift.isSyncDue(MIDNIGHT + DAY_S));
+    TEST_ASSERT_FALSE(drift.isSyncDue(MIDNIGHT + HOUR_S));
+}
+
+#ifndef ARDUINO
+/** Implement and test:
+ * Given: the simulated RTC 200 ppm slow, and 2 syncs a day apart
+ * When: the time is read 12 hours after the second, by the local clock and by epochNow
+ * Then: the local clock is 8.6 s behind; epochNow is the true time, within a second. an unset clock reads 0 either way
+ */
+void test_clock_drift_corrects_epoch_now() {
+    ClockDrift drift;
+    TEST_ASSERT_EQUAL_UINT32(0, epochNow(drift));
+    hal::setEpochSeconds(MIDNIGHT);
+    hal::sim::setClockDriftPpm(-200);
+    drift.addSync(MIDNIGHT, 0);
+    hal::sim::advanceMs(DAY_S * 1000);
+    uint32_t local = hal::epochSeconds();
+    int32_t stepS = drift.addSync(local, (MIDNIGHT + DAY_S) * 1000LL - local * 1000LL);
+    hal::setEpochSeconds(local + stepS);
+
+    hal::sim::advanceMs(12 * HOUR_S * 1000);
+    uint32_t trueNow = MIDNIGHT + DAY_S + 12 * HOUR_S;
+    TEST_ASSERT_UINT32_WITHIN(1, trueNow - 9, hal::epochSeconds());
+    TEST_ASSERT_UINT32_WITHIN(1, trueNow, epochNow(drift));
+}
+#endif
+
+void runClockDriftTests() {
+    RUN_TEST(test_clock_drift_fits_constant_drift);
+    RUN_TEST(test_clock_drift_ignores_outliers);
+    RUN_TEST(test_clock_drift_holds_single_far_sync);
+    RUN_TEST(test_clock_drift_stretches_syncs);
+    RUN_TEST(test_clock_drift_keeps_daily_syncs_when_noisy);
+    RUN_TEST(test_clock_drift_starts_over_when_clock_set);
+#ifndef ARDUINO
+    RUN_TEST(test_clock_drift_corrects_epoch_now);
+#endif
+}
@@ -0,0 +1,287 @@
+// unit test file
+#include <unity.h>
+
+#ifndef ARDUINO
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "credential_vault.h"
+#include "hal.h"
+#include "hal_sim.h"
+
+namespace {
+
+using Contents = std::map<std::string, std::string>;    // SSID: password
+
+struct Operation {
+    bool add;
+    const char *ssid;
+    const char *password;
+};
+
+// every stored network, with its password
+Contents contents(CredentialVault &vault) {
+    Contents found;
+    WifiNetwork networks[WIFI_MAX_NETWORKS];
+    uint8_t count = vault.list(networks);
+    for (uint8_t i = 0; i < count; i++) {
+        char password[sizeof(WifiNetwork::password)];
+        TEST_ASSERT_TRUE_MESSAGE(vault.find(networks[i].ssid, password), networks[i].ssid);
+        found[networks[i].ssid] = password;
+    }
+    return found;
+}
+
+// the records in NVS, referenced or not
+uint8_t storedRecords() {
+    uint8_t count = 0;
+    for (uint8_t slot = 0; slot < VAULT_RECORD_SLOTS; slot++) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "%s%u", NVS_KEY_VAULT_RECORD, slot);
+        VaultRecord record;
+        count += hal::nvsGet(key, &record, sizeof(record)) ? 1 : 0;
+    }
+    return count;
+}
+
+bool apply(CredentialVault &vault, const Operation &operation) {
+    return operation.add ? vault.add(operation.ssid, operation.password) : vault.remove(operation.ssid);
+}
+
+void apply(Contents &model, const Operation &operation) {
+    if (!operation.add) {
+        model.erase(operation.ssid);
+    } else if (model.count(operation.ssid) != 0 || model.size() < WIFI_MAX_NETWORKS) {
+        model[operation.ssid] = operation.password;
+    }
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: a mounted vault with WIFI_MAX_NETWORKS networks
+ * When: each password is found, one is replaced, one removed, a fifth added, and the vault is remounted
+ * Then: each find decrypts one record, whatever the count; NVS never holds a password in plaintext; a full vault refuses
+ *       a new SSID but takes a new password for a stored one; the remount finds the same networks
+ */
+void test_credential_vault_round_trip() {
+    CredentialVault vault;
+    TEST_ASSERT_TRUE(vault.mount());
+    const char *ssids[] = {"daphi-depot", "city hall", "library", "cafe"};
+    const char *passwords[] = {"compost-heap", "recycle-bin", "", "espresso-42"};
+    for (uint8_t i = 0; i < WIFI_MAX_NETWORKS; i++) {
+        TEST_ASSERT_TRUE(vault.add(ssids[i], passwords[i]));
+    }
+    TEST_ASSERT_EQUAL_UINT8(WIFI_MAX_NETWORKS, storedRecords());
+    for (uint8_t i = 0; i < WIFI_MAX_NETWORKS; i++) {
+        uint32_t decrypts = vault.stats().decrypts;
+        char password[sizeof(WifiNetwork::password)];
+        TEST_ASSERT_TRUE(vault.find(ssids[i], password));
+        TEST_ASSERT_EQUAL_STRING(passwords[i], password);
+        TEST_ASSERT_EQUAL_UINT32(decrypts + 1, vault.stats().decrypts);
+    }
+    for (uint8_t slot = 0; slot < VAULT_RECORD_SLOTS; slot++) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "%s%u", NVS_KEY_VAULT_RECORD, slot);
+        VaultRecord record;
+        if (hal::nvsGet(key, &record, sizeof(record))) {
+            std::string sealed(reinterpret_cast<const char *>(&record), sizeof(record));
+            TEST_ASSERT_TRUE(sealed.find("compost") == std::string::npos);
+            TEST_ASSERT_TRUE(sealed.find("recycle") == std::string::npos);
+        }
+    }
+
+    char password[sizeof(WifiNetwork::password)];
+    TEST_ASSERT_FALSE(vault.add("airport", "boarding-pass"));
+    TEST_ASSERT_TRUE(vault.add("city hall", "new-recycle-bin"));
+    TEST_ASSERT_TRUE(vault.remove("library"));
+    TEST_ASSERT_FALSE(vault.remove("library"));
+    TEST_ASSERT_FALSE(vault.find("library", password));
+    TEST_ASSERT_TRUE(vault.add("airport", "boarding-pass"));
+    TEST_ASSERT_EQUAL_UINT8(WIFI_MAX_NETWORKS, storedRecords());
+    TEST_ASSERT_EQUAL_UINT32(0, vault.stats().failures);
+
+    CredentialVault remounted;
+    TEST_ASSERT_TRUE(remounted.mount());
+    Contents expected = {{"daphi-depot", "compost-heap"}, {"city hall", "new-recycle-bin"},
+                         {"cafe", "espresso-42"}, {"airport", "boarding-pass"}};
+    TEST_ASSERT_TRUE(contents(remounted) == expected);
+    TEST_ASSERT_FALSE(remounted.add("", "password1"));
+    TEST_ASSERT_FALSE(remounted.add("an SSID far longer than thirty-two", "password1"));
+}
+
+/** Implement and test:
+ * Given: a stored network
+ * When: its record is changed by one bit, or swapped with another network's record, or the vault is mounted on a device
+ *       with another key
+ * Then: find refuses it, counts a failure, and hands out no password
+ */
+void test_credential_vault_refuses_foreign_records() {
+    CredentialVault vault;
+    TEST_ASSERT_TRUE(vault.mount());
+    TEST_ASSERT_TRUE(vault.add("daphi-depot", "compost-heap"));
+    TEST_ASSERT_TRUE(vault.add("city hall", "recycle-bin"));
+    char key0[16];
+    char key1[16];
+    std::snprintf(key0, sizeof(key0), "%s0", NVS_KEY_VAULT_RECORD);
+    std::snprintf(key1, sizeof(key1), "%s1", NVS_KEY_VAULT_RECORD);
+    VaultRecord first;
+    VaultRecord second;
+    TEST_ASSERT_TRUE(hal::nvsGet(key0, &first, sizeof(first)));
+    TEST_ASSERT_TRUE(hal::nvsGet(key1, &second, sizeof(second)));
+
+    char password[sizeof(WifiNetwork::password)];
+    VaultRecord flipped = first;
+    flipped.password[3] ^= 0x04;
+    hal::nvsSet(key0, &flipped, sizeof(flipped));
+    TEST_ASSERT_FALSE(vault.find("daphi-depot", password));
+    TEST_ASSERT_EQUAL_STRING("", password);
+    hal::nvsSet(key0, &second, sizeof(second));     // the other network's record, in this one's slot
+    hal::nvsSet(key1, &first, sizeof(first));
+    TEST_ASSERT_FALSE(vault.find("daphi-depot", password));
+    TEST_ASSERT_FALSE(vault.find("city hall", password));
+    TEST_ASSERT_EQUAL_UINT32(3, vault.stats().failures);
+
+    hal::nvsSet(key0, &first, sizeof(first));
+    hal::nvsSet(key1, &second, sizeof(second));
+    hal::nvsCommit();
+    TEST_ASSERT_TRUE(vault.find("daphi-depot", password));
+    uint8_t otherKey[32] = {0x5A};
+    hal::sim::setDeviceKey(otherKey);
+    CredentialVault elsewhere;
+    TEST_ASSERT_TRUE(elsewhere.mount());
+    TEST_ASSERT_FALSE(elsewhere.find("daphi-depot", password));
+    TEST_ASSERT_EQUAL_UINT32(1, elsewhere.stats().failures);
+}
+
+/** Implement and test:
+ * Given: a stored network, and then a device with no key (no eFuse key burnt)
+ * When: the vault is mounted there
+ * Then: mount fails, and the vault neither finds, lists nor stores a network
+ */
+void test_credential_vault_refuses_without_device_key() {
+    CredentialVault vault;
+    TEST_ASSERT_TRUE(vault.mount());
+    TEST_ASSERT_TRUE(vault.add("daphi-depot", "compost-heap"));
+    hal::sim::setDeviceKey(nullptr);
+
+    CredentialVault locked;
+    TEST_ASSERT_FALSE(locked.mount());
+    TEST_ASSERT_FALSE(locked.isMounted());
+    char password[sizeof(WifiNetwork::password)] = "";
+    TEST_ASSERT_FALSE(locked.find("daphi-depot", password));
+    TEST_ASSERT_EQUAL_STRING("", password);
+    WifiNetwork networks[WIFI_MAX_NETWORKS];
+    TEST_ASSERT_EQUAL_UINT8(0, locked.list(networks));
+    TEST_ASSERT_FALSE(locked.add("city hall", "recycle-bin"));
+    TEST_ASSERT_FALSE(vault.mount());
+    TEST_ASSERT_FALSE(vault.find("daphi-depot", password));
+}
+
+/** Implement and test:
+ * Given: the plaintext networks of earlier firmware in NVS (NVS_KEY_WIFI_NETWORKS)
+ * When: the vault mounts, with the power cut at each of its NVS writes, then mounts again after the power cycle
+ * Then: every network ends up in the vault with its password, and the plaintext is gone
+ */
+void test_credential_vault_imports_legacy_networks() {
+    WifiNetwork legacy[WIFI_MAX_NETWORKS] = {{"daphi-depot", "compost-heap"}, {}, {"city hall", "recycle-bin"}};
+    Contents expected = {{"daphi-depot", "compost-heap"}, {"city hall", "recycle-bin"}};
+    for (uint32_t cut = 0;; cut++) {
+        hal::sim::reset();
+        hal::nvsSet(NVS_KEY_WIFI_NETWORKS, legacy, sizeof(legacy));
+        hal::nvsCommit();
+        hal::sim::cutPowerAfterNvsWrites(cut);
+        CredentialVault interrupted;
+        interrupted.mount();
+        bool wasCut = hal::sim::isPowerCut();
+        hal::sim::powerCycle();
+
+        CredentialVault vault;
+        TEST_ASSERT_TRUE(vault.mount());
+        TEST_ASSERT_TRUE(contents(vault) == expected);
+        TEST_ASSERT_EQUAL_UINT8(2, storedRecords());
+        WifiNetwork left[WIFI_MAX_NETWORKS];
+        TEST_ASSERT_FALSE(hal::nvsGet(NVS_KEY_WIFI_NETWORKS, left, sizeof(left)));
+        if (!wasCut) {
+            break;
+        }
+    }
+}
+
+/** Implement and test:
+ * Given: a scripted sequence of adds, replacements and removals, and 8 random sequences of 50
+ * When: the power is cut at every NVS write of every operation, and the vault is remounted after the power cycle
+ * Then: it holds what it held before the operation, or what it holds after it, never anything else; no record is left
+ *       that no network points to; and it takes the next operation as usual
+ */
+void test_credential_vault_power_cut_fuzz() {
+    const char *ssids[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot"};
+    const char *passwords[] = {"password-1", "password-2", "password-3", "", "password-5", "password-6"};
+    std::vector<std::vector<Operation>> sequences = {{
+        {true, "alpha", "password-1"},  {true, "bravo", "password-2"},   {true, "alpha", "password-9"},
+        {false, "bravo", nullptr},      {true, "charlie", "password-3"}, {true, "delta", ""},
+        {true, "echo", "password-5"},   {true, "foxtrot", "password-6"}, {true, "echo", "password-0"},
+        {false, "alpha", nullptr},      {false, "nobody", nullptr},
+    }};
+    uint32_t x = 0x9E3779B9;
+    for (uint8_t sequence = 0; sequence < 8; sequence++) {
+        sequences.emplace_back();
+        for (uint8_t i = 0; i < 50; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            sequences.back().push_back({(x >> 8) % 3 != 0, ssids[x % 6], passwords[(x >> 16) % 6]});
+        }
+    }
+
+    uint32_t cuts = 0;
+    for (const std::vector<Operation> &operations : sequences) {
+        Contents before;
+        for (size_t at = 0; at < operations.size(); at++) {
+            Contents after = before;
+            apply(after, operations[at]);
+            for (uint32_t cut = 0;; cut++) {
+                // the vault before the operation, replayed from powered-on hardware
+                hal::sim::reset();
+                {
+                    CredentialVault replay;
+                    replay.mount();
+                    for (size_t done = 0; done < at; done++) {
+                        apply(replay, operations[done]);
+                    }
+                    hal::sim::cutPowerAfterNvsWrites(cut);
+                    apply(replay, operations[at]);
+                }
+                bool wasCut = hal::sim::isPowerCut();
+                hal::sim::powerCycle();
+
+                CredentialVault vault;
+                TEST_ASSERT_TRUE(vault.mount());
+                Contents found = contents(vault);
+                TEST_ASSERT_TRUE(found == after || (wasCut && found == before));
+                TEST_ASSERT_EQUAL_UINT32(found.size(), storedRecords());
+                TEST_ASSERT_TRUE(vault.add("zulu", "next-one") || found.size() == WIFI_MAX_NETWORKS);
+                if (!wasCut) {
+                    break;
+                }
+                cuts++;
+            }
+            before = after;
+        }
+    }
+    TEST_ASSERT_TRUE(cuts > 1000);
+}
+#endif
+
+void runCredentialVaultTests() {
+#ifndef ARDUINO
+    RUN_TEST(test_credential_vault_round_trip);
+    RUN_TEST(test_credential_vault_refuses_foreign_records);
+    RUN_TEST(test_credential_vault_refuses_without_device_key);
+    RUN_TEST(test_credential_vault_imports_legacy_networks);
+    RUN_TEST(test_credential_vault_power_cut_fuzz);
+#endif
+}
@@ -1,25 +1,227 @@
 // unit test file
+#include <unity.h>
+
+#include "config.h"
+#include "data.h"
+#include "hal.h"
+
+namespace {
+
+constexpr uint16_t N = 50;
+
+uint16_t countRecords(const RecordSpan &records) {
+    uint16_t count = 0;
+    for (Record record : records) {
+        (void) record;
+        count++;
+    }
+    return count;
+}
+
+}  // namespace
 
 /** Implement and test:
  * Given: a data table instace with a capacity N - constructor
  * When: we create a new table - createTable
  * Then: the new table has 0 records - length of readTable result
  */
+void test_data_new_table_is_empty() {
+    DataTable table(N);
+    TEST_ASSERT_TRUE(table.createDataTable());
+    TEST_ASSERT_EQUAL_UINT16(0, table.readTable().size());
+    TEST_ASSERT_EQUAL_UINT16(0, countRecords(table.readTable()));
+}
 
 /** Implement and test:
  * Given: a data table with a capacity of N which has n (<= N) known records
- * When: we read the table 
+ * When: we read the table
  * Then: we get the same records in the same order
  */
+void test_data_read_returns_records_in_order() {
+    // minute steps of 1, a long gap, a midnight wrap, a repeated minute, and weights above the old 65,535 g limit
+    const Record records[] = {{600, 0}, {601, 1500}, {602, 1499}, {900, 70000}, {901, 131070},
+                              {1439, 42}, {0, 43}, {5, 44}, {5, 45}, {6, 99999}};
+    DataTable table(N);
+    table.createDataTable();
+    for (const Record &record : records) {
+        TEST_ASSERT_TRUE(table.updateTable(record));
+    }
+
+    RecordSpan read = table.readTable();
+    TEST_ASSERT_EQUAL_UINT16(sizeof(records) / sizeof(records[0]), read.size());
+    uint16_t i = 0;
+    for (Record record : read) {
+        TEST_ASSERT_EQUAL_UINT16(records[i].recordTime, record.recordTime);
+        TEST_ASSERT_EQUAL_UINT32(records[i].weight, record.weight);
+        i++;
+    }
+    TEST_ASSERT_EQUAL_UINT16(read.size(), i);
+}
+
+/** Implement and test:
+ * Given: a data table with records one minute apart
+ * When: we check how much flash it takes
+ * Then: every record takes 3 bytes, plus a single time marker for the first one
+ */
+void test_data_records_are_packed_in_three_bytes() {
+    DataTable table(DATA_TABLE_CAPACITY);
+    table.createDataTable();
+    for (uint16_t i = 0; i < DATA_TABLE_CAPACITY; i++) {
+        table.updateTable(Record{static_cast<recordTimeType>((360 + i) % MINUTES_PER_DAY), i * 10U});
+    }
+    TEST_ASSERT_EQUAL_UINT16(DATA_TABLE_CAPACITY, table.length());
+    TEST_ASSERT_EQUAL_UINT32((DATA_TABLE_CAPACITY + 1) * PACKED_RECORD_SIZE, table.flashBytesUsed());
+}
 
 /** Implement and test:
  * Given: an empty data table with a capacity N
  * When: we update the table N times
  * Then: we can no longer update the table
  */
+void test_data_full_table_rejects_updates() {
+    DataTable table(N);
+    table.createDataTable();
+    for (uint16_t i = 0; i < N; i++) {
+        TEST_ASSERT_TRUE(table.updateTable(Record{i, 100}));
+    }
+    TEST_ASSERT_FALSE(table.updateTable(Record{N, 100}));
+    TEST_ASSERT_EQUAL_UINT16(N, table.readTable().size());
+}
 
 /** Implement and test:
  * Given: a data table with a capacity N which have 1 or more records
  * When: we delete table and then read it
  * Then: the answer is of lenght 0
- */
\ No newline at end of file
+ */
+void test_data_delete_empties_table() {
+    DataTable table(N);
+    table.createDataTable();
+    table.updateTable(Record{10, 1});
+    table.updateTable(Record{11, 2});
+    table.deleteTable();
+    TEST_ASSERT_EQUAL_UINT16(0, table.readTable().size());
+    TEST_ASSERT_EQUAL_UINT16(0, countRecords(table.readTable()));
+
+    DataTable reopened(N);
+    reopened.createDataTable();
+    TEST_ASSERT_EQUAL_UINT16(0, reopened.length());
+}
+
+/** Implement and test:
+ * Given: a data table with records in flash
+ * When: the device reboots and the table is created again
+ * Then: the records are still there, and new records continue after them
+ */
+void test_data_survives_reboot() {
+    {
+        DataTable table(N);
+        table.createDataTable();
+        table.updateTable(Record{100, 5000});
+        table.updateTable(Record{101, 5001});
+    }
+    flashStore.mount(STORAGE_PARTITION);
+    DataTable table(N);
+    table.createDataTable();
+    TEST_ASSERT_EQUAL_UINT16(2, table.length());
+    TEST_ASSERT_TRUE(table.updateTable(Record{102, 5002}));
+
+    const weightType expected[] = {5000, 5001, 5002};
+    uint16_t i = 0;
+    for (Record record : table.readTable()) {
+        TEST_ASSERT_EQUAL_UINT16(100 + i, record.recordTime);
+        TEST_ASSERT_EQUAL_UINT32(expected[i], record.weight);
+        i++;
+    }
+    TEST_ASSERT_EQUAL_UINT16(3, i);
+}
+
+/** Implement and test:
+ * Given: a data table whose last append was torn by a power cut, two of its three bytes written
+ * When: the device reboots, the table is created again, and records are added
+ * Then: the torn record is dropped, and the records before and after it read back as they were added
+ */
+void test_data_recovers_from_torn_append() {
+    {
+        DataTable table(N);
+        table.createDataTable();
+        table.updateTable(Record{100, 5000});
+        table.updateTable(Record{101, 5001});
+    }
+    FlashSegment segment;
+    TEST_ASSERT_TRUE(flashStore.firstSegment(StreamId::DataTable, segment));
+    hal::FlashPartition partition;
+    partition.open(STORAGE_PARTITION);
+    const uint8_t torn[2] = {0x12, 0x34};     // the record for minute 102, cut after its second byte
+    partition.write(static_cast<uint32_t>(segment.data + segment.length - partition.data()), torn, sizeof(torn));
+
+    flashStore.mount(STORAGE_PARTITION);
+    DataTable table(N);
+    table.createDataTable();
+    TEST_ASSERT_EQUAL_UINT16(2, table.length());
+    TEST_ASSERT_TRUE(table.updateTable(Record{103, 5003}));
+    TEST_ASSERT_TRUE(table.updateTable(Record{104, 5004}));
+
+    const Record expected[] = {{100, 5000}, {101, 5001}, {103, 5003}, {104, 5004}};
+    uint16_t i = 0;
+    for (Record record : table.readTable()) {
+        TEST_ASSERT_TRUE(i < 4);
+        TEST_ASSERT_EQUAL_UINT16(expected[i].recordTime, record.recordTime);
+        TEST_ASSERT_EQUAL_UINT32(expected[i].weight, record.weight);
+        i++;
+    }
+    TEST_ASSERT_EQUAL_UINT16(4, i);
+
+    flashStore.mount(STORAGE_PARTITION);
+    DataTable rebooted(N);
+    rebooted.createDataTable();
+    TEST_ASSERT_EQUAL_UINT16(4, rebooted.length());
+    TEST_ASSERT_EQUAL_UINT32(table.payloadChecksum(), rebooted.payloadChecksum());
+}
+
+/** Implement and test:
+ * Given: a data table snapshot being sent, and records added while it's sent
+ * When: the send succeeds and the snapshot's records are deleted
+ * Then: the snapshot read only the records before it, and only the records added since are left, also after a reboot
+ */
+void test_data_delete_through_snapshot_keeps_later_records() {
+    DataTable table(N);
+    table.createDataTable();
+    table.updateTable(Record{100, 5000});
+    table.updateTable(Record{101, 5001});
+    DataTable::Snapshot sent = table.snapshot();
+    table.updateTable(Record{102, 5002});
+    table.updateTable(Record{104, 5004});
+    TEST_ASSERT_EQUAL_UINT16(2, sent.records);
+    TEST_ASSERT_EQUAL_UINT16(2, countRecords(table.readTable(sent)));
+
+    table.deleteThrough(sent);
+    TEST_ASSERT_EQUAL_UINT16(2, table.length());
+    const Record expected[] = {{102, 5002}, {104, 5004}};
+    uint16_t i = 0;
+    for (Record record : table.readTable()) {
+        TEST_ASSERT_TRUE(i < 2);
+        TEST_ASSERT_EQUAL_UINT16(expected[i].recordTime, record.recordTime);
+        TEST_ASSERT_EQUAL_UINT32(expected[i].weight, record.weight);
+        i++;
+    }
+    TEST_ASSERT_EQUAL_UINT16(2, i);
+
+    flashStore.mount(STORAGE_PARTITION);
+    DataTable rebooted(N);
+    rebooted.createDataTable();
+    TEST_ASSERT_EQUAL_UINT16(2, rebooted.length());
+    TEST_ASSERT_EQUAL_UINT32(table.payloadChecksum(), rebooted.payloadChecksum());
+    TEST_ASSERT_TRUE(rebooted.updateTable(Record{105, 5005}));
+    TEST_ASSERT_EQUAL_UINT16(3, countRecords(rebooted.readTable()));
+}
+
+void runDataTests() {
+    RUN_TEST(test_data_new_table_is_empty);
+    RUN_TEST(test_data_read_returns_records_in_order);
+    RUN_TEST(test_data_records_are_packed_in_three_bytes);
+    RUN_TEST(test_data_full_table_rejects_updates);
+    RUN_TEST(test_data_delete_empties_table);
+    RUN_TEST(test_data_survives_reboot);
+    RUN_TEST(test_data_recovers_from_torn_append);
+    RUN_TEST(test_data_delete_through_snapshot_keeps_later_records);
+}
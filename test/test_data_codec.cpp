@@ -0,0 +1,88 @@
+// unit test file
+#include <unity.h>
+
+#include "config.h"
+#include "data.h"
+#include "data_codec.h"
+
+namespace {
+
+constexpr uint16_t N = 64;
+
+void fillTable(DataTable &table, const Record *records, uint16_t count) {
+    table.createDataTable();
+    for (uint16_t i = 0; i < count; i++) {
+        table.updateTable(records[i]);
+    }
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: a data table with readings a minute apart, a gap, a midnight wrap and weights going up and down
+ * When: we encode it and decode the payload
+ * Then: we get the same records, and the checksum is the payload's CRC trailer
+ */
+void test_data_codec_round_trip() {
+    const Record records[] = {{1430, 5000}, {1431, 5002}, {1432, 4990}, {1439, 131070},
+                              {0, 0}, {1, 3}, {300, 70000}, {301, 69999}};
+    const uint16_t count = sizeof(records) / sizeof(records[0]);
+    DataTable table(N);
+    fillTable(table, records, count);
+
+    uint8_t payload[maxEncodedDataSize(N)];
+    size_t length = encodeDataTable(table.readTable(), payload, sizeof(payload));
+    TEST_ASSERT_GREATER_THAN(0, length);
+
+    Record decoded[N];
+    uint16_t decodedCount = 0;
+    TEST_ASSERT_TRUE(decodeDataTable(payload, length, decoded, N, decodedCount));
+    TEST_ASSERT_EQUAL_UINT16(count, decodedCount);
+    for (uint16_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT16(records[i].recordTime, decoded[i].recordTime);
+        TEST_ASSERT_EQUAL_UINT32(records[i].weight, decoded[i].weight);
+    }
+}
+
+/** Implement and test:
+ * Given: a full day of readings a minute apart with small weight changes
+ * When: we encode it
+ * Then: every record takes 2 bytes, i.e. less than the 3 bytes it takes on flash
+ */
+void test_data_codec_compresses_slow_changes() {
+    DataTable table(DATA_TABLE_CAPACITY);
+    table.createDataTable();
+    for (uint16_t i = 0; i < DATA_TABLE_CAPACITY; i++) {
+        table.updateTable(Record{static_cast<recordTimeType>(360 + i), 10000U + (i % 7) * 5U});
+    }
+    static uint8_t payload[maxEncodedDataSize(DATA_TABLE_CAPACITY)];
+    size_t length = encodeDataTable(table.readTable(), payload, sizeof(payload));
+    // version + first record (2 + 2 bytes) + 2 bytes per other record + CRC
+    TEST_ASSERT_EQUAL_size_t(1 + 4 + (DATA_TABLE_CAPACITY - 1) * 2 + DATA_CHECKSUM_SIZE, length);
+}
+
+/** Implement and test:
+ * Given: an encoded payload
+ * When: a byte is corrupted, or the buffer is too small
+ * Then: decoding fails, and encoding reports it doesn't fit
+ */
+void test_data_codec_detects_corruption() {
+    const Record records[] = {{10, 100}, {11, 200}, {12, 300}};
+    DataTable table(N);
+    fillTable(table, records, 3);
+
+    uint8_t payload[maxEncodedDataSize(N)];
+    size_t length = encodeDataTable(table.readTable(), payload, sizeof(payload));
+    payload[2] ^= 0x01;
+    Record decoded[N];
+    uint16_t count = 0;
+    TEST_ASSERT_FALSE(decodeDataTable(payload, length, decoded, N, count));
+
+    TEST_ASSERT_EQUAL_size_t(0, encodeDataTable(table.readTable(), payload, 6));
+}
+
+void runDataCodecTests() {
+    RUN_TEST(test_data_codec_round_trip);
+    RUN_TEST(test_data_codec_compresses_slow_changes);
+    RUN_TEST(test_data_codec_detects_corruption);
+}
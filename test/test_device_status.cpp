@@ -1,4 +1,31 @@
 // unit test file
+#include <unity.h>
+
+#include "config.h"
+#include "device_status.h"
+
+#ifndef ARDUINO
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "hal.h"
+#endif
+
+namespace {
+
+// each flag's setter, then its getter
+void checkFlag(void (*set)(bool), bool (*get)(), bool given) {
+    set(given);
+    TEST_ASSERT_EQUAL_UINT8(given, get());
+    set(true);
+    TEST_ASSERT_TRUE(get());
+    set(given);
+    set(false);
+    TEST_ASSERT_FALSE(get());
+}
+
+}  // namespace
 
 /** Implement and test:
  * Given: getIsActive returns false
@@ -7,6 +34,9 @@
  *              V                           V
  * Then: getIsActive returns true   getIsActive returns false
  */
+void test_device_status_is_active_from_false() {
+    checkFlag(setIsActive, getIsActive, false);
+}
 
 /** Implement and test:
  * Given: getIsActive returns true
@@ -15,24 +45,31 @@
  *              V                           V
  * Then: getIsActive returns true   getIsActive returns false
  */
+void test_device_status_is_active_from_true() {
+    checkFlag(setIsActive, getIsActive, true);
+}
 
-
- /** Implement and test:
+/** Implement and test:
  * Given: getHasMainServerCommProblem returns false
  * When: setHasMainServerCommProblem(true)          setHasMainServerCommProblem(false)
  *              |                                           |
  *              V                                           V
  * Then: getHasMainServerCommProblem returns true   getHasMainServerCommProblem returns false
  */
+void test_device_status_comm_problem_from_false() {
+    checkFlag(setHasMainServerCommProblem, getHasMainServerCommProblem, false);
+}
 
- /** Implement and test:
+/** Implement and test:
  * Given: getHasMainServerCommProblem returns true
  * When: setHasMainServerCommProblem(true)          setHasMainServerCommProblem(false)
  *              |                                           |
  *              V                                           V
  * Then: getHasMainServerCommProblem returns true   getHasMainServerCommProblem returns false
  */
-
+void test_device_status_comm_problem_from_true() {
+    checkFlag(setHasMainServerCommProblem, getHasMainServerCommProblem, true);
+}
 
 /** Implement and test:
  * Given: getHasDeviceId returns false
@@ -41,6 +78,9 @@
  *              V                           V
  * Then: getHasDeviceId returns true   getHasDeviceId returns false
  */
+void test_device_status_has_device_id_from_false() {
+    checkFlag(setHasDeviceId, getHasDeviceId, false);
+}
 
 /** Implement and test:
  * Given: getHasDeviceId returns true
@@ -48,4 +88,172 @@
  *              |                           |
  *              V                           V
  * Then: getHasDeviceId returns true   getHasDeviceId returns false
- */
\ No newline at end of file
+ */
+void test_device_status_has_device_id_from_true() {
+    checkFlag(setHasDeviceId, getHasDeviceId, true);
+}
+
+/** Implement and test:
+ * Given: a status with every field set, and the all-zero word of a power-up
+ * When: they're packed and unpacked
+ * Then: the status comes back as it was, in the documented bits; the zero word is no flag, no failure and no tx yet
+ */
+void test_device_status_packs_one_word() {
+    DeviceStatus status{true, false, true, 200, 1439};
+    uint32_t word = packDeviceStatus(status);
+    TEST_ASSERT_EQUAL_HEX32(0x05A0C80BU, word);    // minute 1440 << 16 | 200 << 8 | device ID, active, valid
+    DeviceStatus back = unpackDeviceStatus(word);
+    TEST_ASSERT_TRUE(back.isActive);
+    TEST_ASSERT_FALSE(back.hasMainServerCommProblem);
+    TEST_ASSERT_TRUE(back.hasDeviceId);
+    TEST_ASSERT_EQUAL_UINT8(200, back.commFailures);
+    TEST_ASSERT_EQUAL_UINT16(1439, back.lastTxMinute);
+
+    DeviceStatus none = unpackDeviceStatus(0);
+    TEST_ASSERT_FALSE(none.isActive || none.hasMainServerCommProblem || none.hasDeviceId);
+    TEST_ASSERT_EQUAL_UINT8(0, none.commFailures);
+    TEST_ASSERT_EQUAL_UINT16(NO_TX_MINUTE, none.lastTxMinute);
+    TEST_ASSERT_EQUAL_UINT16(NO_TX_MINUTE, unpackDeviceStatus(packDeviceStatus(none)).lastTxMinute);
+}
+
+/** Implement and test:
+ * Given: a status register and a snapshot of it
+ * When: another writer changes it, then a compare-and-swap from the stale snapshot is tried, then from the fresh one
+ * Then: the stale one fails and hands back what the register holds; the fresh one stores its change
+ */
+void test_device_status_compare_and_swap() {
+    StatusRegister status;
+    DeviceStatus seen = status.snapshot();
+    status.update([](DeviceStatus &now) { now.commFailures = 3; });
+
+    DeviceStatus desired = seen;
+    desired.isActive = true;
+    TEST_ASSERT_FALSE(status.compareAndSwap(seen, desired));
+    TEST_ASSERT_EQUAL_UINT8(3, seen.commFailures);
+    TEST_ASSERT_FALSE(status.snapshot().isActive);
+
+    desired = seen;
+    desired.isActive = true;
+    TEST_ASSERT_TRUE(status.compareAndSwap(seen, desired));
+    TEST_ASSERT_TRUE(status.snapshot().isActive);
+    TEST_ASSERT_EQUAL_UINT8(3, status.snapshot().commFailures);
+}
+
+/** Implement and test:
+ * Given: sends to the main server failing, then one delivering at 13:00
+ * When: each is recorded
+ * Then: the failures count up, the comm problem is raised at COMM_PROBLEM_AFTER_FAILURES, and the delivery clears both
+ *       and keeps its minute
+ */
+void test_device_status_records_sends() {
+    StatusRegister status;
+    for (uint8_t failure = 1; failure <= COMM_PROBLEM_AFTER_FAILURES; failure++) {
+        TEST_ASSERT_FALSE(status.snapshot().hasMainServerCommProblem);
+        recordMainServerSend(false, 12 * 60, status);
+        TEST_ASSERT_EQUAL_UINT8(failure, status.snapshot().commFailures);
+    }
+    TEST_ASSERT_TRUE(status.snapshot().hasMainServerCommProblem);
+    TEST_ASSERT_EQUAL_UINT16(NO_TX_MINUTE, status.snapshot().lastTxMinute);
+
+    recordMainServerSend(true, 13 * 60, status);
+    DeviceStatus now = status.snapshot();
+    TEST_ASSERT_FALSE(now.hasMainServerCommProblem);
+    TEST_ASSERT_EQUAL_UINT8(0, now.commFailures);
+    TEST_ASSERT_EQUAL_UINT16(13 * 60, now.lastTxMinute);
+}
+
+#ifndef ARDUINO
+/** Implement and test:
+ * Given: a device ID in NVS
+ * When: the status is initialised after a power-up (zeroed register), then after a wakeup with the ID since erased
+ * Then: the power-up restores hasDeviceId from NVS; the wakeup keeps the register as it was, without reading NVS
+ */
+void test_device_status_survives_wakeup() {
+    StatusRegister status;
+    uint32_t deviceId = 42;
+    hal::nvsSet(NVS_KEY_DEVICE_ID, &deviceId, sizeof(deviceId));
+    hal::nvsCommit();
+    initDeviceStatus(status);
+    TEST_ASSERT_TRUE(status.isValid());
+    TEST_ASSERT_TRUE(status.snapshot().hasDeviceId);
+    recordMainServerSend(false, 0, status);
+
+    hal::nvsErase(NVS_KEY_DEVICE_ID);
+    initDeviceStatus(status);      // a wakeup: RTC memory kept the register
+    TEST_ASSERT_TRUE(status.snapshot().hasDeviceId);
+    TEST_ASSERT_EQUAL_UINT8(1, status.snapshot().commFailures);
+
+    status.clear();                 // a power-up
+    initDeviceStatus(status);
+    TEST_ASSERT_FALSE(status.snapshot().hasDeviceId);
+    TEST_ASSERT_EQUAL_UINT8(0, status.snapshot().commFailures);
+}
+
+/** Implement and test:
+ * Given: 4 writer threads, each update moving the tx minute on by one and setting the failures and isActive from it
+ * When: 2 reader threads take snapshots all along
+ * Then: every snapshot is one whole update (its fields agree with each other), and no update is lost
+ */
+void test_device_status_no_torn_reads() {
+    constexpr int WRITERS = 4;
+    constexpr int READERS = 2;
+    constexpr int UPDATES = 350;        // per writer, all of them within a day's minutes
+    constexpr int ROUNDS = 20;
+    StatusRegister status;
+    std::atomic<bool> torn{false};
+    for (int round = 0; round < ROUNDS; round++) {
+        status.clear();
+        status.update([](DeviceStatus &now) {
+            now.lastTxMinute = 0;
+            now.hasMainServerCommProblem = true;
+        });
+        std::atomic<int> writing{WRITERS};
+        std::vector<std::thread> threads;
+        for (int w = 0; w < WRITERS; w++) {
+            threads.emplace_back([&status, &writing] {
+                for (int i = 0; i < UPDATES; i++) {
+                    status.update([](DeviceStatus &now) {
+                        now.lastTxMinute = static_cast<recordTimeType>(now.lastTxMinute + 1);
+                        now.commFailures = static_cast<uint8_t>(now.lastTxMinute);
+                        now.isActive = (now.lastTxMinute & 1) != 0;
+                        now.hasMainServerCommProblem = !now.isActive;
+                    });
+                }
+                writing--;
+            });
+        }
+        for (int r = 0; r < READERS; r++) {
+            threads.emplace_back([&status, &writing, &torn] {
+                while (writing.load() > 0) {
+                    DeviceStatus seen = status.snapshot();
+                    if (seen.commFailures != static_cast<uint8_t>(seen.lastTxMinute) ||
+                        seen.isActive != ((seen.lastTxMinute & 1) != 0) || seen.hasMainServerCommProblem == seen.isActive) {
+                        torn = true;
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        TEST_ASSERT_EQUAL_UINT16(WRITERS * UPDATES, status.snapshot().lastTxMinute);
+    }
+    TEST_ASSERT_FALSE(torn.load());
+}
+#endif
+
+void runDeviceStatusTests() {
+    RUN_TEST(test_device_status_is_active_from_false);
+    RUN_TEST(test_device_status_is_active_from_true);
+    RUN_TEST(test_device_status_comm_problem_from_false);
+    RUN_TEST(test_device_status_comm_problem_from_true);
+    RUN_TEST(test_device_status_has_device_id_from_false);
+    RUN_TEST(test_device_status_has_device_id_from_true);
+    RUN_TEST(test_device_status_packs_one_word);
+    RUN_TEST(test_device_status_compare_and_swap);
+    RUN_TEST(test_device_status_records_sends);
+#ifndef ARDUINO
+    RUN_TEST(test_device_status_survives_wakeup);
+    RUN_TEST(test_device_status_no_torn_reads);
+#endif
+}
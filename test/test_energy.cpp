@@ -0,0 +1,205 @@
+// unit test file
+#include <unity.h>
+
+#ifndef ARDUINO
+#include <cstdio>
+#include <cstring>
+
+#include "battery.h"
+#include "energy.h"
+#include "hal.h"
+#include "hal_sim.h"
+#include "logging.h"
+#include "uplink.h"
+
+namespace {
+
+constexpr uint64_t MS = 1000;
+
+uint64_t stateUs(const EnergyReport &report, PowerState state) {
+    return report.stateUs[static_cast<uint8_t>(state)];
+}
+
+uint64_t taskUs(const EnergyReport &report, EnergyTask task) {
+    return report.taskUs[static_cast<uint8_t>(task)];
+}
+
+// a task awake for ms, on the simulated clock
+void work(EnergyLedger &ledger, EnergyTask task, uint32_t ms) {
+    ledger.taskAwake(task);
+    hal::sleepMs(ms);
+    ledger.taskAsleep(task);
+}
+
+/* A day of the device, by the minute: every minute the scheduler wakes (1 ms) and the load cell task takes a reading
+ * (8 ms of CPU, then 2.1 s parked while the HX711 converts, then 2 ms); every hour loop() checks the status (30 ms);
+ * and at the two tx times the networkings task holds the radio for 1.7 s and sends 6000 bytes. */
+constexpr uint32_t SCHEDULER_MS = 1;
+constexpr uint32_t SENSE_MS = 8 + 2;
+constexpr uint32_t SAMPLING_MS = 2100;
+constexpr uint32_t STATUS_MS = 30;
+constexpr uint32_t RADIO_MS = 1700;
+constexpr uint32_t TX_BYTES = 6000;
+constexpr uint16_t TX_MINUTES[2] = {13 * 60, 20 * 60};
+
+void simulateDay(EnergyLedger &ledger) {
+    for (uint16_t minute = 0; minute < 1440; minute++) {
+        uint64_t minuteStart = hal::micros();
+        work(ledger, EnergyTask::Scheduler, SCHEDULER_MS);
+        work(ledger, EnergyTask::LoadCell, 8);
+        hal::sleepMs(SAMPLING_MS);
+        work(ledger, EnergyTask::LoadCell, 2);
+        if (minute % 60 == 0) {
+            work(ledger, EnergyTask::Events, STATUS_MS);
+        }
+        if (minute == TX_MINUTES[0] || minute == TX_MINUTES[1]) {
+            ledger.taskAwake(EnergyTask::Networkings);
+            ledger.radioOn(EnergyTask::Networkings);
+            hal::sleepMs(RADIO_MS);
+            ledger.radioSent(TX_BYTES);
+            ledger.radioOff();
+            ledger.taskAsleep(EnergyTask::Networkings);
+        }
+        hal::sleepMs(static_cast<uint32_t>(60 * MS - (hal::micros() - minuteStart) / MS));
+    }
+}
+
+float mah(uint64_t us, uint32_t microAmps) {
+    return static_cast<float>(us) * static_cast<float>(microAmps) / 3.6e12f;
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: two tasks awake at overlapping times, and a span with every task parked
+ * When: the ledger reports
+ * Then: each task has its own wall time, CpuActive counts the overlap once, and the rest is light sleep
+ */
+void test_energy_states_partition_time() {
+    EnergyLedger ledger(ENERGY_PROFILE);
+    ledger.start();
+    hal::sleepMs(100);                              // all parked
+    ledger.taskAwake(EnergyTask::Scheduler);
+    hal::sleepMs(10);
+    ledger.taskAwake(EnergyTask::LoadCell);
+    hal::sleepMs(5);                                // both awake
+    ledger.taskAsleep(EnergyTask::Scheduler);
+    hal::sleepMs(20);
+    ledger.taskAsleep(EnergyTask::LoadCell);
+    ledger.taskAsleep(EnergyTask::LoadCell);        // twice: ignored
+    hal::sleepMs(65);
+
+    EnergyReport report = ledger.report();
+    TEST_ASSERT_EQUAL_UINT64(200 * MS, report.elapsedUs);
+    TEST_ASSERT_EQUAL_UINT64(15 * MS, taskUs(report, EnergyTask::Scheduler));
+    TEST_ASSERT_EQUAL_UINT64(25 * MS, taskUs(report, EnergyTask::LoadCell));
+    TEST_ASSERT_EQUAL_UINT64(35 * MS, stateUs(report, PowerState::CpuActive));
+    TEST_ASSERT_EQUAL_UINT64(165 * MS, stateUs(report, PowerState::LightSleep));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, mah(35 * MS, CPU_ACTIVE_MICROAMPS) + mah(165 * MS, LIGHT_SLEEP_MICROAMPS),
+                             report.totalMah);
+}
+
+/** Implement and test:
+ * Given: the radio on for 500 ms twice: sending 10000 bytes, then more bytes than fit in the time
+ * When: the ledger reports
+ * Then: TX is the bytes' airtime (capped at the radio time), RX the rest, and the radio's charge goes to its holder
+ */
+void test_energy_radio_split_by_bytes() {
+    EnergyLedger ledger(ENERGY_PROFILE);
+    ledger.start();
+    ledger.taskAwake(EnergyTask::Networkings);
+    ledger.radioOn(EnergyTask::Networkings);
+    hal::sleepMs(500);
+    ledger.radioSent(10000);
+    ledger.radioOff();
+    ledger.radioOn(EnergyTask::Networkings);
+    hal::sleepMs(500);
+    ledger.radioSent(1000000);
+    ledger.radioOff();
+    ledger.taskAsleep(EnergyTask::Networkings);
+
+    EnergyReport report = ledger.report();
+    uint64_t txUs = 10000 * RADIO_TX_US_PER_BYTE + 500 * MS;
+    TEST_ASSERT_EQUAL_UINT64(txUs, stateUs(report, PowerState::RadioTx));
+    TEST_ASSERT_EQUAL_UINT64(1000 * MS - txUs, stateUs(report, PowerState::RadioRx));
+    TEST_ASSERT_EQUAL_UINT64(0, stateUs(report, PowerState::CpuActive));
+    TEST_ASSERT_EQUAL_UINT64(1000 * MS, taskUs(report, EnergyTask::Networkings));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, mah(txUs, RADIO_TX_MICROAMPS) + mah(1000 * MS - txUs, RADIO_RX_MICROAMPS),
+                             report.taskMah[static_cast<uint8_t>(EnergyTask::Networkings)]);
+}
+
+/** Implement and test:
+ * Given: a simulated day of sensing every minute, hourly status checks and two transmissions
+ * When: the ledger reports at the end of it
+ * Then: the report is the day's model: the states add up to 24 h, each state's and task's time and mAh are as planned,
+ *       and the days to empty are the battery's capacity over the day's mAh
+ */
+void test_energy_simulated_day_report() {
+    EnergyLedger ledger(ENERGY_PROFILE);
+    ledger.start();
+    simulateDay(ledger);
+    EnergyReport report = ledger.report();
+
+    const uint64_t dayUs = 86400 * 1000 * MS;
+    const uint64_t cpuUs = (1440 * (SCHEDULER_MS + SENSE_MS) + 24 * STATUS_MS) * MS;
+    const uint64_t txUs = 2 * TX_BYTES * RADIO_TX_US_PER_BYTE;
+    const uint64_t rxUs = 2 * RADIO_MS * MS - txUs;
+    TEST_ASSERT_EQUAL_UINT64(dayUs, report.elapsedUs);
+    TEST_ASSERT_EQUAL_UINT64(cpuUs, stateUs(report, PowerState::CpuActive));
+    TEST_ASSERT_EQUAL_UINT64(txUs, stateUs(report, PowerState::RadioTx));
+    TEST_ASSERT_EQUAL_UINT64(rxUs, stateUs(report, PowerState::RadioRx));
+    TEST_ASSERT_EQUAL_UINT64(dayUs - cpuUs - txUs - rxUs, stateUs(report, PowerState::LightSleep));
+    TEST_ASSERT_EQUAL_UINT64(0, stateUs(report, PowerState::DeepSleep));
+    TEST_ASSERT_EQUAL_UINT64(1440 * SENSE_MS * MS, taskUs(report, EnergyTask::LoadCell));
+    TEST_ASSERT_EQUAL_UINT64(24 * STATUS_MS * MS, taskUs(report, EnergyTask::Events));
+
+    float expectedMah = mah(cpuUs, CPU_ACTIVE_MICROAMPS) + mah(txUs, RADIO_TX_MICROAMPS) +
+                        mah(rxUs, RADIO_RX_MICROAMPS) + mah(dayUs - cpuUs - txUs - rxUs, LIGHT_SLEEP_MICROAMPS);
+    TEST_ASSERT_FLOAT_WITHIN(expectedMah * 1e-4f, expectedMah, report.totalMah);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, mah(1440 * SENSE_MS * MS, CPU_ACTIVE_MICROAMPS),
+                             report.taskMah[static_cast<uint8_t>(EnergyTask::LoadCell)]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, expectedMah / 24, report.averageMilliAmps);
+    uint16_t days = daysToEmpty(report, BATTERY_CAPACITY_MAH);
+    TEST_ASSERT_EQUAL_UINT16(static_cast<uint16_t>(BATTERY_CAPACITY_MAH / expectedMah), days);
+    TEST_ASSERT_TRUE(days > 365);   // light sleep dominates: the sensing duty cycle isn't what drains it
+}
+
+/** Implement and test:
+ * Given: the device's ledger after an hour with a transmission
+ * When: the device status is checked
+ * Then: the log file gets the days to empty and the uplink a Status message with the report
+ */
+void test_energy_reported_by_status_check() {
+    logFile.deleteLogFile();
+    batteryMonitor.reset();     // no reading: the rated capacity less what was used
+    energyLedger.start();
+    work(energyLedger, EnergyTask::Events, 50);
+    energyLedger.radioOn(EnergyTask::Networkings);
+    hal::sleepMs(2000);
+    energyLedger.radioSent(4000);
+    energyLedger.radioOff();
+    hal::sleepMs(3600 * 1000);
+    EnergyReport report = energyLedger.report();
+    uint16_t days = daysToEmpty(report, static_cast<float>(BATTERY_CAPACITY_MAH) - report.totalMah);
+    uint32_t backlog = uplink.backlogBytes();
+
+    reportEnergy();
+    static uint8_t file[LOG_FILE_SIZE];
+    static char text[2048];
+    size_t length = logFile.readLogFile(file, sizeof(file));
+    TEST_ASSERT_GREATER_THAN(0, renderLogFile(file, length, text, sizeof(text)));
+    char expected[48];
+    std::snprintf(expected, sizeof(expected), "battery empty in %u days\n", static_cast<unsigned>(days));
+    TEST_ASSERT_NOT_NULL(std::strstr(text, expected));
+    TEST_ASSERT_TRUE(uplink.backlogBytes() >= backlog + ENERGY_STATUS_SIZE);
+}
+#endif
+
+void runEnergyTests() {
+#ifndef ARDUINO
+    RUN_TEST(test_energy_states_partition_time);
+    RUN_TEST(test_energy_radio_split_by_bytes);
+    RUN_TEST(test_energy_simulated_day_report);
+    RUN_TEST(test_energy_reported_by_status_check);
+#endif
+}
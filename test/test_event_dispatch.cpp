@@ -0,0 +1,142 @@
+// unit test file
+#include <unity.h>
+
+#ifndef ARDUINO
+#include <cstring>
+
+#include "event_dispatch.h"
+#include "events.h"
+#include "hal.h"
+#include "hal_sim.h"
+#include "logging.h"
+#include "uplink.h"
+
+namespace {
+
+uint32_t handlerSleepMs = 0;
+uint32_t handlerRuns = 0;
+
+void sleepingHandler() {
+    handlerRuns++;
+    hal::sleepMs(handlerSleepMs);
+}
+
+void quickHandler() {
+    handlerRuns++;
+}
+
+// quickHandler for every event type, sleepingHandler for SendData
+constexpr EventHandler HANDLERS[EVENT_TYPE_COUNT] = {quickHandler, quickHandler, quickHandler, quickHandler, quickHandler,
+                                                     quickHandler, quickHandler, sleepingHandler, quickHandler};
+
+void dispatchSendData(EventTimings &timings, uint32_t ms) {
+    handlerSleepMs = ms;
+    dispatchEvent(HANDLERS, EventType::SendData, timings);
+}
+
+size_t renderedLog(char *text, size_t capacity) {
+    static uint8_t file[LOG_FILE_SIZE];
+    size_t length = logFile.readLogFile(file, sizeof(file));
+    return renderLogFile(file, length, text, capacity);
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: runs of 0 us to an hour
+ * When: they're put in the histogram
+ * Then: the buckets are a factor of 4 apart, and the last one takes everything from 4^13 us on
+ */
+void test_event_dispatch_buckets() {
+    TEST_ASSERT_EQUAL_UINT8(0, eventTimingBucket(0));
+    TEST_ASSERT_EQUAL_UINT8(0, eventTimingBucket(3));
+    TEST_ASSERT_EQUAL_UINT8(1, eventTimingBucket(4));
+    TEST_ASSERT_EQUAL_UINT8(1, eventTimingBucket(15));
+    TEST_ASSERT_EQUAL_UINT8(2, eventTimingBucket(16));
+    TEST_ASSERT_EQUAL_UINT8(12, eventTimingBucket((1U << 26) - 1));
+    TEST_ASSERT_EQUAL_UINT8(13, eventTimingBucket(1U << 26));
+    TEST_ASSERT_EQUAL_UINT8(EVENT_TIMING_BUCKETS - 1, eventTimingBucket(3600U * 1000000U));
+}
+
+/** Implement and test:
+ * Given: a handler table
+ * When: SendData is dispatched three times, taking 50 ms, 2 ms and 20 s (longer than the cycle counter's half wrap)
+ * Then: only its handler runs, and its count, min, max and histogram are recorded; the other types have none
+ */
+void test_event_dispatch_times_each_handler() {
+    EventTimings timings;
+    handlerRuns = 0;
+    dispatchSendData(timings, 50);
+    dispatchSendData(timings, 2);
+    dispatchSendData(timings, 20000);
+    TEST_ASSERT_EQUAL_UINT32(3, handlerRuns);
+
+    const EventTiming &sendData = timings.of(EventType::SendData);
+    TEST_ASSERT_EQUAL_UINT32(3, sendData.count);
+    TEST_ASSERT_EQUAL_UINT32(2000, sendData.minUs);
+    TEST_ASSERT_EQUAL_UINT32(20000000, sendData.maxUs);
+    TEST_ASSERT_EQUAL_UINT16(1, sendData.buckets[eventTimingBucket(2000)]);
+    TEST_ASSERT_EQUAL_UINT16(1, sendData.buckets[eventTimingBucket(50000)]);
+    TEST_ASSERT_EQUAL_UINT16(1, sendData.buckets[eventTimingBucket(20000000)]);
+    TEST_ASSERT_EQUAL_UINT32(0, timings.of(EventType::SendLogFile).count);
+
+    dispatchEvent(HANDLERS, EventType::Setup, timings);
+    TEST_ASSERT_EQUAL_UINT32(1, timings.of(EventType::Setup).count);
+    TEST_ASSERT_EQUAL_UINT32(0, timings.of(EventType::Setup).maxUs);    // no time passes on the simulated clock
+    timings.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, timings.of(EventType::SendData).count);
+}
+
+/** Implement and test:
+ * Given: timings of two event types
+ * When: they're encoded for the Status message
+ * Then: the payload has a record per event type that ran, in EventType order, with the counts little endian
+ */
+void test_event_dispatch_encodes_status() {
+    EventTimings timings;
+    dispatchSendData(timings, 7);
+    dispatchEvent(HANDLERS, EventType::Activate, timings);
+    uint8_t payload[MAX_EVENT_TIMINGS_SIZE];
+    size_t length = encodeEventTimings(timings, payload, sizeof(payload));
+    TEST_ASSERT_EQUAL_size_t(1 + 2 * EVENT_TIMING_RECORD_SIZE, length);
+    TEST_ASSERT_EQUAL_UINT8(STATUS_EVENT_TIMINGS, payload[0]);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(EventType::Activate), payload[1]);
+    const uint8_t *sendData = payload + 1 + EVENT_TIMING_RECORD_SIZE;
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(EventType::SendData), sendData[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, sendData[1]);                            // count
+    TEST_ASSERT_EQUAL_UINT32(7000, sendData[9] | (sendData[10] << 8));  // max us
+
+    EventTimings none;
+    TEST_ASSERT_EQUAL_size_t(0, encodeEventTimings(none, payload, sizeof(payload)));
+}
+
+/** Implement and test:
+ * Given: SendData ran twice since the last status check, the slowest run taking 12.5 s
+ * When: the device status is checked
+ * Then: the log file gets a row with its runs and slowest run, the uplink a Status message, and the timings start over
+ */
+void test_event_dispatch_reported_by_status_check() {
+    logFile.deleteLogFile();
+    uint32_t backlog = uplink.backlogBytes();
+    eventTimings.reset();
+    dispatchSendData(eventTimings, 300);
+    dispatchSendData(eventTimings, 12500);
+
+    onCheckDeviceStatus();
+    static char text[2048];
+    TEST_ASSERT_GREATER_THAN(0, renderedLog(text, sizeof(text)));
+    TEST_ASSERT_NOT_NULL(std::strstr(text, "device status check\n"));
+    TEST_ASSERT_NOT_NULL(std::strstr(text, "event SendData: 2 runs, slowest 12500 ms\n"));
+    TEST_ASSERT_TRUE(uplink.backlogBytes() > backlog);
+    TEST_ASSERT_EQUAL_UINT32(0, eventTimings.of(EventType::SendData).count);
+}
+#endif
+
+void runEventDispatchTests() {
+#ifndef ARDUINO
+    RUN_TEST(test_event_dispatch_buckets);
+    RUN_TEST(test_event_dispatch_times_each_handler);
+    RUN_TEST(test_event_dispatch_encodes_status);
+    RUN_TEST(test_event_dispatch_reported_by_status_check);
+#endif
+}
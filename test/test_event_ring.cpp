@@ -0,0 +1,141 @@
+// unit test file
+#include <unity.h>
+
+#include "event_ring.h"
+#include "types.h"
+
+#ifndef ARDUINO
+#include <chrono>
+#include <thread>
+#include <vector>
+#endif
+
+namespace {
+
+struct Stamp {
+    uint16_t producer;
+    uint32_t sequence;
+};
+
+}  // namespace
+
+/** Implement and test:
+ * Given: a new ring
+ * When: we pop from it
+ * Then: it's empty and nothing is popped
+ */
+void test_event_ring_new_is_empty() {
+    EventRing<Event, 8> ring;
+    Event event{};
+    TEST_ASSERT_TRUE(ring.isEmpty());
+    TEST_ASSERT_FALSE(ring.tryPop(event));
+    TEST_ASSERT_FALSE(ring.waitPop(event, 1));
+}
+
+/** Implement and test:
+ * Given: a ring with a capacity N
+ * When: we push more than N items and pop it till it's empty, several laps around the ring
+ * Then: the first N items of every lap are popped in order and the rest are rejected
+ */
+void test_event_ring_fifo_and_full() {
+    constexpr uint16_t N = 4;
+    EventRing<Stamp, N> ring;
+    uint32_t sequence = 0;
+    for (int lap = 0; lap < 5; lap++) {
+        for (uint16_t i = 0; i < N; i++) {
+            TEST_ASSERT_TRUE(ring.tryPush(Stamp{0, sequence + i}));
+        }
+        TEST_ASSERT_FALSE(ring.tryPush(Stamp{0, 999}));
+        Stamp stamp{};
+        for (uint16_t i = 0; i < N; i++) {
+            TEST_ASSERT_TRUE(ring.tryPop(stamp));
+            TEST_ASSERT_EQUAL_UINT32(sequence + i, stamp.sequence);
+        }
+        TEST_ASSERT_FALSE(ring.tryPop(stamp));
+        sequence += N;
+    }
+}
+
+#ifndef ARDUINO
+/** Implement and test:
+ * Given: several producer threads pushing into a small ring as fast as they can
+ * When: a single consumer drains it with waitPop
+ * Then: every item arrives exactly once, and each producer's items arrive in the order they were pushed
+ * Then: no waitPop sleeps out its timeout: with the producers always busy, that's a lost wakeup
+ */
+void test_event_ring_stress_multiple_producers() {
+    constexpr uint16_t PRODUCERS = 4;
+    constexpr uint32_t PER_PRODUCER = 50000;
+    EventRing<Stamp, 16> ring;
+
+    std::vector<std::thread> producers;
+    for (uint16_t p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&ring, p] {
+            for (uint32_t i = 0; i < PER_PRODUCER; i++) {
+                while (!ring.tryPush(Stamp{p, i})) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    constexpr uint32_t WAIT_MS = 500;
+    uint32_t next[PRODUCERS] = {};
+    uint32_t received = 0;
+    uint32_t timeouts = 0;
+    bool ordered = true;
+    Stamp stamp{};
+    while (received < PRODUCERS * PER_PRODUCER) {
+        auto start = std::chrono::steady_clock::now();
+        bool popped = ring.waitPop(stamp, WAIT_MS);
+        if (std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(WAIT_MS)) {
+            timeouts++;     // waitPop pops after a timeout too, if an item is there by then
+        }
+        if (!popped) {
+            break;
+        }
+        ordered = ordered && stamp.producer < PRODUCERS && stamp.sequence == next[stamp.producer];
+        next[stamp.producer % PRODUCERS]++;
+        received++;
+    }
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL_UINT32(0, timeouts);
+    TEST_ASSERT_EQUAL_UINT32(PRODUCERS * PER_PRODUCER, received);
+    TEST_ASSERT_FALSE(ring.tryPop(stamp));
+}
+
+/** Implement and test:
+ * Given: a consumer parked in waitPop on an empty ring
+ * When: another thread pushes an item
+ * Then: the consumer wakes up with that item before the timeout
+ */
+void test_event_ring_wait_pop_wakes_up() {
+    EventRing<Event, 8> ring;
+    std::thread producer([&ring] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ring.tryPush(Event{EventType::SendData, 1});
+    });
+    Event event{};
+    auto start = std::chrono::steady_clock::now();
+    bool popped = ring.waitPop(event, 5000);
+    auto waited = std::chrono::steady_clock::now() - start;
+    producer.join();
+
+    TEST_ASSERT_TRUE(popped);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(EventType::SendData), static_cast<uint8_t>(event.eventType));
+    TEST_ASSERT_LESS_THAN(1000, std::chrono::duration_cast<std::chrono::milliseconds>(waited).count());
+}
+#endif
+
+void runEventRingTests() {
+    RUN_TEST(test_event_ring_new_is_empty);
+    RUN_TEST(test_event_ring_fifo_and_full);
+#ifndef ARDUINO
+    RUN_TEST(test_event_ring_stress_multiple_producers);
+    RUN_TEST(test_event_ring_wait_pop_wakes_up);
+#endif
+}
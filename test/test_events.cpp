@@ -1,2 +1,424 @@
 // unit test file
-// TODO: later should write tests
\ No newline at end of file
+#include <unity.h>
+
+#ifndef ARDUINO
+#include <cstring>
+#include <vector>
+
+#include "checksum.h"
+#include "clock_drift.h"
+#include "credential_vault.h"
+#include "data_codec.h"
+#include "events.h"
+#include "hal_sim.h"
+#include "logging.h"
+#include "tx_slots.h"
+
+namespace {
+
+/* A main server stand-in for chunked transfers: replies to every offer with the bitmap of the chunks it kept, keeps
+ * only the chunks whose CRC matches, and assembles the payload once it has them all. It can corrupt the first few
+ * chunks it receives, break the link at a given chunk, or reply busy to the first few offers. It answers a TxSlots
+ * request with `slots`. */
+class FakeMainServer : public hal::sim::SocketPeer {
+public:
+    int corruptChunks = 0;
+    int breakAtChunk = -1;          // -1: never
+    int busyOffers = 0;
+    uint16_t retryAfterS = 0;       // in the busy replies
+    TxSlot slots[2] = {{6 * 60, 600}, {18 * 60, 600}};
+    int slotRequests = 0;
+    uint8_t failuresHint = 0;       // in the last TxSlots request
+    int connects = 0;
+    int offers = 0;
+    int chunksReceived = 0;
+    int tablesReceived = 0;         // complete data tables
+    int logFilesReceived = 0;
+    std::vector<uint8_t> lastPayload;
+
+    bool onConnect(const char *host, uint16_t port) override {
+        pending.clear();
+        connects++;
+        return std::strcmp(host, "192.168.0.118") == 0 && port == MAIN_SERVER_PORT;
+    }
+
+    void onReceive(int socket, const uint8_t *data, size_t length, std::vector<uint8_t> &reply) override {
+        pending.insert(pending.end(), data, data + length);
+        while (pending.size() >= 5) {
+            uint32_t payloadLength = load32(&pending[1]);
+            if (pending.size() < 5 + payloadLength) {
+                return;
+            }
+            MessageType type = static_cast<MessageType>(pending[0]);
+            std::vector<uint8_t> payload(pending.begin() + 5, pending.begin() + 5 + payloadLength);
+            pending.erase(pending.begin(), pending.begin() + 5 + payloadLength);
+            if (type == MessageType::TxSlots) {
+                slotRequests++;
+                failuresHint = payload.at(0);
+                for (const TxSlot &slot : slots) {
+                    reply.insert(reply.end(), {static_cast<uint8_t>(slot.startMinute), static_cast<uint8_t>(slot.startMinute >> 8),
+                                               static_cast<uint8_t>(slot.windowS), static_cast<uint8_t>(slot.windowS >> 8)});
+                }
+            } else if (type == MessageType::TransferOffer && busyOffers > 0) {
+                busyOffers--;
+                offers++;
+                reply.insert(reply.end(), payload.begin(), payload.begin() + 4);
+                reply.insert(reply.end(), {0, 0, static_cast<uint8_t>(retryAfterS), static_cast<uint8_t>(retryAfterS >> 8)});
+            } else if (type == MessageType::TransferOffer) {
+                onOffer(payload, reply);
+            } else if (type == MessageType::TransferChunk && !onChunk(socket, payload)) {
+                return;
+            }
+        }
+    }
+
+private:
+    static uint32_t load32(const uint8_t *bytes) {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    void onOffer(const std::vector<uint8_t> &offer, std::vector<uint8_t> &reply) {
+        offers++;
+        uint32_t id = load32(&offer[0]);
+        if (id != transferId) {     // a new transfer
+            transferId = id;
+            contentType = static_cast<MessageType>(offer[4]);
+            assembled.assign(load32(&offer[5]), 0);
+            chunkSize = offer[9] | (offer[10] << 8);
+            received.assign(offer[11] | (offer[12] << 8), false);
+            delivered = false;
+        }
+        reply.insert(reply.end(), offer.begin(), offer.begin() + 4);
+        reply.push_back(static_cast<uint8_t>(received.size()));
+        reply.push_back(static_cast<uint8_t>(received.size() >> 8));
+        bool complete = true;
+        for (size_t byte = 0; byte < (received.size() + 7) / 8; byte++) {
+            uint8_t bits = 0;
+            for (size_t bit = 0; bit < 8 && byte * 8 + bit < received.size(); bit++) {
+                bits |= received[byte * 8 + bit] ? 1 << bit : 0;
+                complete = complete && received[byte * 8 + bit];
+            }
+            reply.push_back(bits);
+        }
+        if (complete && !delivered) {
+            delivered = true;
+            lastPayload = assembled;
+            (contentType == MessageType::DataTable ? tablesReceived : logFilesReceived)++;
+        }
+    }
+
+    bool onChunk(int socket, std::vector<uint8_t> &chunk) {
+        if (chunksReceived++ == breakAtChunk) {
+            hal::sim::dropSocket(socket);
+            return false;
+        }
+        if (corruptChunks > 0) {
+            corruptChunks--;
+            chunk.back() ^= 0xFF;
+        }
+        uint16_t sequence = chunk[4] | (chunk[5] << 8);
+        if (load32(&chunk[0]) != transferId || crc32(chunk.data() + 10, chunk.size() - 10) != load32(&chunk[6])) {
+            return true;    // dropped, it'll be missing from the next bitmap
+        }
+        std::copy(chunk.begin() + 10, chunk.end(), assembled.begin() + sequence * chunkSize);
+        received[sequence] = true;
+        return true;
+    }
+
+    std::vector<uint8_t> pending;
+    uint32_t transferId = 0;
+    MessageType contentType = MessageType::DataTable;
+    size_t chunkSize = 0;
+    std::vector<uint8_t> assembled;
+    std::vector<bool> received;
+    bool delivered = false;
+};
+
+void storeServerIp() {
+    char serverIp[16] = "192.168.0.118";
+    hal::nvsSet(NVS_KEY_SERVER_IP, serverIp, sizeof(serverIp));
+    hal::nvsCommit();
+}
+
+void fillDataTable(uint16_t count) {
+    dataTable.createDataTable();
+    for (uint16_t i = 0; i < count; i++) {
+        dataTable.updateTable(Record{static_cast<recordTimeType>(420 + i), 3000U + i});
+    }
+}
+
+void drainEvents() {
+    Event event{};
+    while (eventsRing.tryPop(event)) {
+    }
+}
+
+// the last entry of the log file with the code
+bool findLogEntry(LogCode code, LogEntry &found) {
+    static uint8_t file[LOG_FILE_SIZE];
+    size_t length = logFile.readLogFile(file, sizeof(file));
+    bool any = false;
+    for (size_t at = 0; at < length;) {
+        LogEntry entry;
+        size_t size = decodeLogEntry(file + at, length - at, entry);
+        if (size == 0) {
+            return false;
+        }
+        if (entry.code == code) {
+            found = entry;
+            any = true;
+        }
+        at += size;
+    }
+    return any;
+}
+
+
+// a stored network in range: what the sessions' WifiHold joins
+void storeReachableNetwork() {
+    hal::sim::addAccessPoint({"daphi-depot", "compost-heap", {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01}, 6, -55});
+    credentialVault.add("daphi-depot", "compost-heap");
+}
+}  // namespace
+
+/** Implement and test:
+ * Given: a data table and a main server that receives it intact
+ * When: onSendData runs
+ * Then: the server gets the compressed table, the checksums match, the table is emptied and SendLogFile is raised
+ */
+void test_events_send_data_success() {
+    drainEvents();
+    FakeMainServer server;
+    hal::sim::setSocketPeer(&server);
+    storeReachableNetwork();
+    storeServerIp();
+    fillDataTable(100);
+
+    onSendData();
+
+    TEST_ASSERT_EQUAL_INT(1, server.tablesReceived);
+    TEST_ASSERT_EQUAL_INT(2, server.offers);    // the empty bitmap, and the full one
+    Record decoded[100];
+    uint16_t count = 0;
+    TEST_ASSERT_TRUE(decodeDataTable(server.lastPayload.data(), server.lastPayload.size(), decoded, 100, count));
+    TEST_ASSERT_EQUAL_UINT16(100, count);
+    TEST_ASSERT_EQUAL_UINT16(0, dataTable.length());
+
+    Event event{};
+    TEST_ASSERT_TRUE(eventsRing.tryPop(event));
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(EventType::SendLogFile), static_cast<uint8_t>(event.eventType));
+    TEST_ASSERT_EQUAL_UINT8(1, event.priority);
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: a main server that receives the first chunk of a table corrupted
+ * When: onSendData runs
+ * Then: only that chunk is resent, and the table is deleted once the server has it all
+ */
+void test_events_send_data_resends_only_corrupt_chunk() {
+    drainEvents();
+    FakeMainServer server;
+    server.corruptChunks = 1;
+    hal::sim::setSocketPeer(&server);
+    storeReachableNetwork();
+    storeServerIp();
+    fillDataTable(400);
+    static uint8_t payload[maxEncodedDataSize(400)];
+    size_t length = encodeDataTable(dataTable.readTable(), payload, sizeof(payload));
+    int chunkCount = static_cast<int>((length + TRANSFER_CHUNK_SIZE - 1) / TRANSFER_CHUNK_SIZE);
+    TEST_ASSERT_TRUE(chunkCount > 1);
+
+    onSendData();
+
+    TEST_ASSERT_EQUAL_INT(1, server.tablesReceived);
+    TEST_ASSERT_EQUAL_INT(chunkCount + 1, server.chunksReceived);
+    TEST_ASSERT_EQUAL_INT(3, server.offers);
+    TEST_ASSERT_TRUE(server.lastPayload == std::vector<uint8_t>(payload, payload + length));
+    TEST_ASSERT_EQUAL_UINT16(0, dataTable.length());
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: a link that breaks while the third chunk of a table is sent
+ * When: onSendData runs
+ * Then: it reconnects and resumes: only the chunks the server didn't get are sent again
+ */
+void test_events_send_data_resumes_after_disconnect() {
+    drainEvents();
+    FakeMainServer server;
+    server.breakAtChunk = 2;
+    hal::sim::setSocketPeer(&server);
+    storeReachableNetwork();
+    storeServerIp();
+    fillDataTable(400);
+    static uint8_t payload[maxEncodedDataSize(400)];
+    size_t length = encodeDataTable(dataTable.readTable(), payload, sizeof(payload));
+    int chunkCount = static_cast<int>((length + TRANSFER_CHUNK_SIZE - 1) / TRANSFER_CHUNK_SIZE);
+
+    onSendData();
+
+    TEST_ASSERT_EQUAL_INT(2, server.connects);
+    TEST_ASSERT_EQUAL_INT(1, server.tablesReceived);
+    TEST_ASSERT_EQUAL_INT(3 + (chunkCount - 2), server.chunksReceived);
+    TEST_ASSERT_EQUAL_UINT16(0, dataTable.length());
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: a log file with a few rows
+ * When: onSendLogFile runs and the server gets it all
+ * Then: the server has the binary file, and the log starts over
+ */
+void test_events_send_log_file() {
+    FakeMainServer server;
+    hal::sim::setSocketPeer(&server);
+    storeReachableNetwork();
+    storeServerIp();
+    logFile.deleteLogFile();
+    logFile.addLogRow(LogCode::LoadCellNotResponding);
+    uint8_t file[LOG_FILE_SIZE];
+    size_t length = logFile.readLogFile(file, sizeof(file));
+
+    onSendLogFile();
+
+    TEST_ASSERT_EQUAL_INT(1, server.logFilesReceived);
+    TEST_ASSERT_TRUE(server.lastPayload == std::vector<uint8_t>(file, file + length));
+    TEST_ASSERT_TRUE(logFile.length() < length);
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: no reachable main server
+ * When: onSendData runs
+ * Then: the table is kept for the next try
+ */
+void test_events_send_data_keeps_table_when_offline() {
+    drainEvents();
+    storeServerIp();
+    fillDataTable(10);
+    onSendData();
+    TEST_ASSERT_EQUAL_UINT16(10, dataTable.length());
+}
+
+/** Implement and test:
+ * Given: a main server that replies busy to the first offer, with a retry-after hint of 30 s
+ * When: onSendData runs, then again (the retry)
+ * Then: the first run doesn't reconnect, keeps the table and backs off (logged); the retry delivers it
+ */
+void test_events_send_data_backs_off_when_busy() {
+    drainEvents();
+    txSlotState.reset();
+    FakeMainServer server;
+    server.busyOffers = 1;
+    server.retryAfterS = 30;
+    hal::sim::setSocketPeer(&server);
+    storeReachableNetwork();
+    storeServerIp();
+    logFile.deleteLogFile();
+    fillDataTable(10);
+
+    onSendData();
+    TEST_ASSERT_EQUAL_INT(1, server.connects);
+    TEST_ASSERT_EQUAL_UINT16(10, dataTable.length());
+    TEST_ASSERT_EQUAL_UINT8(1, txSlotState.busyInARow());
+    uint8_t file[LOG_FILE_SIZE];
+    size_t length = logFile.readLogFile(file, sizeof(file));
+    bool logged = false;
+    for (size_t at = 0; at < length;) {
+        LogEntry entry;
+        size_t size = decodeLogEntry(file + at, length - at, entry);
+        TEST_ASSERT_TRUE(size > 0);
+        if (entry.code == LogCode::MainServerBusy) {
+            logged = true;
+            TEST_ASSERT_TRUE(entry.payload >= 30 + TX_BACKOFF_BASE_S / 2 && entry.payload <= 30 + TX_BACKOFF_BASE_S);
+        }
+        at += size;
+    }
+    TEST_ASSERT_TRUE(logged);
+
+    onSendData();
+    TEST_ASSERT_EQUAL_INT(1, server.tablesReceived);
+    TEST_ASSERT_EQUAL_UINT16(0, dataTable.length());
+    TEST_ASSERT_EQUAL_UINT8(0, txSlotState.busyInARow());
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: a device whose sends keep getting busy replies
+ * When: TX_RENEGOTIATE_FAILURES of them have failed, and onChangeTxTimes runs
+ * Then: ChangeTxTimes is raised; the server is asked with the failure count, and its slots are stored
+ */
+void test_events_renegotiates_tx_slots() {
+    drainEvents();
+    txSlotState.reset();
+    FakeMainServer server;
+    server.busyOffers = TX_RENEGOTIATE_FAILURES;
+    hal::sim::setSocketPeer(&server);
+    storeReachableNetwork();
+    storeServerIp();
+    fillDataTable(10);
+    for (uint8_t i = 0; i < TX_RENEGOTIATE_FAILURES; i++) {
+        onSendData();
+    }
+    bool raised = false;
+    Event event{};
+    while (eventsRing.tryPop(event)) {
+        raised = raised || event.eventType == EventType::ChangeTxTimes;
+    }
+    TEST_ASSERT_TRUE(raised);
+
+    onChangeTxTimes();
+    TEST_ASSERT_EQUAL_INT(1, server.slotRequests);
+    TEST_ASSERT_EQUAL_UINT8(TX_RENEGOTIATE_FAILURES, server.failuresHint);
+    TEST_ASSERT_FALSE(txSlotState.shouldRenegotiate());
+    TxSlot slots[2];
+    loadTxSlots(slots);
+    TEST_ASSERT_EQUAL_UINT16(6 * 60, slots[0].startMinute);
+    TEST_ASSERT_EQUAL_UINT16(600, slots[1].windowS);
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: a local clock 30 s behind, and no NTP server answering, then one answering
+ * When: onCalibrateClock runs each time
+ * Then: the first logs NtpUnreachable and leaves the clock; the second steps the clock to the NTP time, adds the sync
+ *       to the drift fit and logs the 30 s
+ */
+void test_events_calibrate_clock() {
+    constexpr uint32_t NOW = 1792195200 + 3 * 60 * 60;
+    clockDrift.reset();
+    logFile.deleteLogFile();
+    hal::setEpochSeconds(NOW - 30);
+    storeReachableNetwork();
+
+    onCalibrateClock();
+    LogEntry entry;
+    TEST_ASSERT_TRUE(findLogEntry(LogCode::NtpUnreachable, entry));
+    TEST_ASSERT_EQUAL_UINT8(0, clockDrift.syncs());
+
+    hal::setEpochSeconds(hal::epochSeconds());  // on a whole second again, after the Wi-Fi connect's
+    uint32_t ntpNow = hal::epochSeconds() + 30;
+    hal::sim::setNtpTime(ntpNow);
+    onCalibrateClock();
+    TEST_ASSERT_EQUAL_UINT32(2, hal::sim::ntpQueryCount());
+    TEST_ASSERT_UINT32_WITHIN(1, ntpNow, hal::epochSeconds());
+    TEST_ASSERT_EQUAL_UINT8(1, clockDrift.syncs());
+    TEST_ASSERT_TRUE(findLogEntry(LogCode::ClockCalibrated, entry));
+    TEST_ASSERT_EQUAL_UINT32(30, entry.payload);
+    clockDrift.reset();
+}
+#endif
+
+void runEventsTests() {
+#ifndef ARDUINO
+    RUN_TEST(test_events_send_data_success);
+    RUN_TEST(test_events_send_data_resends_only_corrupt_chunk);
+    RUN_TEST(test_events_send_data_resumes_after_disconnect);
+    RUN_TEST(test_events_send_data_keeps_table_when_offline);
+    RUN_TEST(test_events_send_log_file);
+    RUN_TEST(test_events_send_data_backs_off_when_busy);
+    RUN_TEST(test_events_renegotiates_tx_slots);
+    RUN_TEST(test_events_calibrate_clock);
+#endif
+}
@@ -0,0 +1,215 @@
+// unit test file
+#include <unity.h>
+
+#include <cstring>
+
+#include "config.h"
+#include "flash_log.h"
+#include "hal.h"
+#ifndef ARDUINO
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "hal_sim.h"
+#endif
+
+namespace {
+
+uint32_t readStream(const FlashLog &store, StreamId stream, uint8_t *buffer, uint32_t capacity) {
+    uint32_t length = 0;
+    FlashSegment segment;
+    for (bool found = store.firstSegment(stream, segment); found; found = store.nextSegment(stream, segment, segment)) {
+        TEST_ASSERT_TRUE(length + segment.length <= capacity);
+        std::memcpy(buffer + length, segment.data, segment.length);
+        length += segment.length;
+    }
+    return length;
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: a mounted flash store
+ * When: we append to two streams, interleaved
+ * Then: each stream reads back only its own bytes, in order
+ */
+void test_flash_log_streams_are_separate() {
+    const char rows[][8] = {"a1\n", "b1\n", "a2\n", "b2\n", "a3\n"};
+    for (const char *row : rows) {
+        StreamId stream = row[0] == 'a' ? StreamId::DataTable : StreamId::LogFile;
+        TEST_ASSERT_TRUE(flashStore.append(stream, row, static_cast<uint16_t>(std::strlen(row))));
+    }
+    uint8_t buffer[64];
+    uint32_t length = readStream(flashStore, StreamId::DataTable, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_UINT32(9, length);
+    TEST_ASSERT_EQUAL_MEMORY("a1\na2\na3\n", buffer, 9);
+    length = readStream(flashStore, StreamId::LogFile, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_UINT32(6, length);
+    TEST_ASSERT_EQUAL_MEMORY("b1\nb2\n", buffer, 6);
+}
+
+/** Implement and test:
+ * Given: a stream that's longer than one flash sector
+ * When: we read it
+ * Then: it continues across the sectors in the order it was written, and no append is split between two sectors
+ */
+void test_flash_log_stream_spans_sectors() {
+    uint8_t chunk[1000];
+    for (uint8_t i = 0; i < 10; i++) {
+        std::memset(chunk, i, sizeof(chunk));
+        TEST_ASSERT_TRUE(flashStore.append(StreamId::DataTable, chunk, sizeof(chunk)));
+    }
+    TEST_ASSERT_EQUAL_UINT32(10000, flashStore.size(StreamId::DataTable));
+    FlashSegment segment;
+    uint8_t expected = 0;
+    uint8_t segments = 0;
+    for (bool found = flashStore.firstSegment(StreamId::DataTable, segment); found;
+         found = flashStore.nextSegment(StreamId::DataTable, segment, segment)) {
+        TEST_ASSERT_EQUAL_UINT32(0, segment.length % sizeof(chunk));
+        for (uint16_t offset = 0; offset < segment.length; offset += sizeof(chunk)) {
+            TEST_ASSERT_EQUAL_UINT8(expected++, segment.data[offset]);
+        }
+        segments++;
+    }
+    TEST_ASSERT_EQUAL_UINT8(10, expected);
+    TEST_ASSERT_EQUAL_UINT8(3, segments);   // 4 appends of 1000 bytes fit a 4080 byte sector
+}
+
+/** Implement and test:
+ * Given: a stream with some data
+ * When: we clear it
+ * Then: it's empty right away, without erasing anything, and stays empty after a reboot
+ */
+void test_flash_log_clear_is_logical() {
+    TEST_ASSERT_TRUE(flashStore.append(StreamId::LogFile, "row\n", 4));
+    TEST_ASSERT_TRUE(flashStore.append(StreamId::DataTable, "rec", 3));
+#ifndef ARDUINO
+    uint32_t erases = 0;
+    for (uint32_t sector = 0; sector < 32; sector++) {
+        erases += hal::sim::flashEraseCount(STORAGE_PARTITION, sector);
+    }
+#endif
+    flashStore.clear(StreamId::LogFile);
+    TEST_ASSERT_EQUAL_UINT32(0, flashStore.size(StreamId::LogFile));
+    TEST_ASSERT_EQUAL_UINT32(3, flashStore.size(StreamId::DataTable));
+#ifndef ARDUINO
+    uint32_t erasesAfter = 0;
+    for (uint32_t sector = 0; sector < 32; sector++) {
+        erasesAfter += hal::sim::flashEraseCount(STORAGE_PARTITION, sector);
+    }
+    TEST_ASSERT_EQUAL_UINT32(erases, erasesAfter);
+#endif
+
+    FlashLog rebooted;
+    TEST_ASSERT_TRUE(rebooted.mount(STORAGE_PARTITION));
+    TEST_ASSERT_EQUAL_UINT32(0, rebooted.size(StreamId::LogFile));
+    TEST_ASSERT_EQUAL_UINT32(3, rebooted.size(StreamId::DataTable));
+    TEST_ASSERT_TRUE(rebooted.append(StreamId::DataTable, "abc", 3));
+    TEST_ASSERT_EQUAL_UINT32(6, rebooted.size(StreamId::DataTable));
+}
+
+#ifndef ARDUINO
+/** Implement and test:
+ * Given: a stream that's written and cleared over and over, like the DataTable every day
+ * When: we count the erases of every sector
+ * Then: they're spread evenly over the partition instead of hitting the first sectors
+ */
+void test_flash_log_spreads_erases() {
+    constexpr uint32_t SECTORS = 0x20000 / hal::FLASH_SECTOR_SIZE;
+    uint8_t day[2500];
+    std::memset(day, 0x42, sizeof(day));
+    for (uint32_t cycle = 0; cycle < 10 * SECTORS; cycle++) {
+        TEST_ASSERT_TRUE(flashStore.append(StreamId::DataTable, day, sizeof(day)));
+        flashStore.clear(StreamId::DataTable);
+    }
+    uint32_t least = UINT32_MAX;
+    uint32_t most = 0;
+    for (uint32_t sector = 0; sector < SECTORS; sector++) {
+        uint32_t erases = hal::sim::flashEraseCount(STORAGE_PARTITION, sector);
+        least = erases < least ? erases : least;
+        most = erases > most ? erases : most;
+    }
+    TEST_ASSERT_TRUE(most - least <= 1);
+    TEST_ASSERT_TRUE(most <= 10);
+}
+
+/** Implement and test:
+ * Given: a sector whose header was torn by a power cut
+ * When: the store is mounted
+ * Then: the sector's data is ignored (its header CRC doesn't match) and the sector is reused after an erase
+ */
+void test_flash_log_ignores_torn_header() {
+    TEST_ASSERT_TRUE(flashStore.append(StreamId::LogFile, "kept\n", 5));
+    hal::FlashPartition partition;
+    partition.open(STORAGE_PARTITION);
+    const uint8_t tornHeader[8] = {'D', 'F', 'L', '1', 9, 0, 0, 0};     // the header's first half and a row after it
+    partition.write(hal::FLASH_SECTOR_SIZE, tornHeader, sizeof(tornHeader));
+    partition.write(hal::FLASH_SECTOR_SIZE + FlashLog::SECTOR_HEADER_SIZE, "lost\n", 5);
+
+    FlashLog rebooted;
+    TEST_ASSERT_TRUE(rebooted.mount(STORAGE_PARTITION));
+    TEST_ASSERT_EQUAL_UINT32(5, rebooted.size(StreamId::LogFile));
+    TEST_ASSERT_EQUAL_UINT32(0, rebooted.size(StreamId::DataTable));
+    TEST_ASSERT_TRUE(rebooted.append(StreamId::DataTable, "new", 3));
+    TEST_ASSERT_EQUAL_UINT32(1, hal::sim::flashEraseCount(STORAGE_PARTITION, 1));
+}
+
+/** Implement and test:
+ * Given: the three streams, each appended to by two threads at once (the sensor task and loop() both log), while
+ *        another thread reads the DataTable over and over
+ * When: the threads are done
+ * Then: every stream holds each thread's rows once, whole and in the order they were appended, and the reader never
+ *       saw part of a row
+ */
+void test_flash_log_concurrent_appends() {
+    constexpr uint16_t ROWS = 1000;    // 8000 bytes per stream: two sectors each, taken while the others race for one
+    std::atomic<int> writing{6};
+    std::atomic<bool> torn{false};
+    std::vector<std::thread> threads;
+    for (uint8_t writer = 0; writer < 6; writer++) {
+        threads.emplace_back([writer, &writing] {
+            for (uint16_t row = 0; row < ROWS; row++) {
+                const uint8_t bytes[4] = {writer, static_cast<uint8_t>(row >> 8), static_cast<uint8_t>(row), '\n'};
+                TEST_ASSERT_TRUE(flashStore.append(static_cast<StreamId>(1 + writer / 2), bytes, sizeof(bytes)));
+            }
+            writing--;
+        });
+    }
+    threads.emplace_back([&writing, &torn] {
+        while (writing.load() > 0) {
+            FlashSegment segment;
+            for (bool found = flashStore.firstSegment(StreamId::DataTable, segment); found;
+                 found = flashStore.nextSegment(StreamId::DataTable, segment, segment)) {
+                torn = torn || segment.length % 4 != 0 || segment.data[segment.length - 1] != '\n';
+            }
+        }
+    });
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    TEST_ASSERT_FALSE(torn.load());
+    for (uint8_t stream = 1; stream <= 3; stream++) {
+        static uint8_t buffer[2 * 4 * ROWS];
+        TEST_ASSERT_EQUAL_UINT32(sizeof(buffer), readStream(flashStore, static_cast<StreamId>(stream), buffer,
+                                                            sizeof(buffer)));
+        uint16_t next[2] = {0, 0};
+        for (uint32_t at = 0; at < sizeof(buffer); at += 4) {
+            uint8_t writer = static_cast<uint8_t>(buffer[at] - 2 * (stream - 1));
+            TEST_ASSERT_TRUE(writer < 2);
+            TEST_ASSERT_EQUAL_UINT16(next[writer]++, buffer[at + 1] << 8 | buffer[at + 2]);
+        }
+    }
+}
+#endif
+
+void runFlashLogTests() {
+    RUN_TEST(test_flash_log_streams_are_separate);
+    RUN_TEST(test_flash_log_stream_spans_sectors);
+    RUN_TEST(test_flash_log_clear_is_logical);
+#ifndef ARDUINO
+    RUN_TEST(test_flash_log_spreads_erases);
+    RUN_TEST(test_flash_log_ignores_torn_header);
+    RUN_TEST(test_flash_log_concurrent_appends);
+#endif
+}
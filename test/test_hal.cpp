@@ -0,0 +1,178 @@
+// unit test file
+// Checks the simulated backends of the HAL behave like the hardware the logic expects.
+#include <unity.h>
+
+#ifndef ARDUINO
+#include <cstring>
+
+#include "config.h"
+#include "hal.h"
+#include "hal_sim.h"
+
+namespace {
+
+int fallingEdges = 0;
+
+void countFallingEdge() {
+    fallingEdges++;
+}
+
+class EchoPeer : public hal::sim::SocketPeer {
+public:
+    bool onConnect(const char *host, uint16_t port) override { return std::strcmp(host, "10.0.0.1") == 0 && port == 1900; }
+    void onReceive(int socket, const uint8_t *data, size_t length, std::vector<uint8_t> &reply) override {
+        (void) socket;
+        reply.insert(reply.end(), data, data + length);
+    }
+};
+
+}  // namespace
+
+/** Implement and test:
+ * Given: the simulated clock at boot
+ * When: we sleep, and set the wall clock
+ * Then: millis and epochSeconds advance by the slept time, without really waiting
+ */
+void test_hal_clock_is_simulated() {
+    TEST_ASSERT_EQUAL_UINT32(0, hal::millis());
+    TEST_ASSERT_EQUAL_UINT32(0, hal::epochSeconds());
+    hal::setEpochSeconds(1700000000);
+    hal::sleepMs(24UL * 60 * 60 * 1000);
+    TEST_ASSERT_EQUAL_UINT32(24UL * 60 * 60 * 1000, hal::millis());
+    TEST_ASSERT_EQUAL_UINT32(1700000000 + 24UL * 60 * 60, hal::epochSeconds());
+}
+
+/** Implement and test:
+ * Given: an input pin with a falling-edge interrupt
+ * When: the pin goes high to low, and low to high
+ * Then: the handler runs only on the falling edge
+ */
+void test_hal_gpio_falling_edge_interrupt() {
+    fallingEdges = 0;
+    hal::pinModeInput(BUTTON, true);
+    hal::attachFallingEdgeInterrupt(BUTTON, countFallingEdge);
+    hal::sim::setPinLevel(BUTTON, false);
+    hal::sim::setPinLevel(BUTTON, true);
+    hal::sim::setPinLevel(BUTTON, false);
+    TEST_ASSERT_EQUAL_INT(2, fallingEdges);
+    hal::detachInterrupt(BUTTON);
+    hal::sim::setPinLevel(BUTTON, true);
+    hal::sim::setPinLevel(BUTTON, false);
+    TEST_ASSERT_EQUAL_INT(2, fallingEdges);
+}
+
+/** Implement and test:
+ * Given: the HX711 was just started
+ * When: less than one sample period passes, and then a full one
+ * Then: it's not ready, and then it's ready with the simulated value
+ */
+void test_hal_load_cell_sample_rate() {
+    hal::sim::setLoadCellRaw(-1234);
+    hal::loadCellBegin();
+    hal::sleepMs(hal::sim::LOAD_CELL_SAMPLE_PERIOD_MS - 1);
+    TEST_ASSERT_FALSE(hal::loadCellIsReady());
+    hal::sleepMs(1);
+    TEST_ASSERT_TRUE(hal::loadCellIsReady());
+    TEST_ASSERT_EQUAL_INT32(-1234, hal::loadCellReadRaw());
+    TEST_ASSERT_FALSE(hal::loadCellIsReady());
+    hal::loadCellPowerDown();
+    hal::sleepMs(10 * hal::sim::LOAD_CELL_SAMPLE_PERIOD_MS);
+    TEST_ASSERT_FALSE(hal::loadCellIsReady());
+}
+
+namespace {
+int32_t readInHandler = 0;
+int loadCellInterrupts = 0;
+}  // namespace
+
+/** Implement and test:
+ * Given: a handler on the HX711 DOUT falling edge
+ * When: a conversion completes
+ * Then: the handler fires once, and reads the conversion with 25 SCK pulses
+ */
+void test_hal_load_cell_interrupt_bit_bang() {
+    hal::sim::setLoadCellRaw(0x5A5A5);
+    hal::loadCellBegin();
+    loadCellInterrupts = 0;
+    hal::attachFallingEdgeInterrupt(HX711_DOUT, [] {
+        loadCellInterrupts++;
+        readInHandler = hal::loadCellReadRaw();
+    });
+    uint32_t writesBefore = hal::sim::pinWriteCount(HX711_SCK);
+    hal::sleepMs(hal::sim::LOAD_CELL_SAMPLE_PERIOD_MS);
+    TEST_ASSERT_EQUAL_INT(1, loadCellInterrupts);
+    TEST_ASSERT_EQUAL_INT32(0x5A5A5, readInHandler);
+    TEST_ASSERT_EQUAL_UINT32(2 * 25, hal::sim::pinWriteCount(HX711_SCK) - writesBefore);
+    TEST_ASSERT_FALSE(hal::loadCellIsReady());
+    hal::sleepMs(10 * hal::sim::LOAD_CELL_SAMPLE_PERIOD_MS);
+    TEST_ASSERT_EQUAL_INT(11, loadCellInterrupts);
+    hal::detachInterrupt(HX711_DOUT);
+}
+
+/** Implement and test:
+ * Given: a committed NVS value and a newer uncommitted one
+ * When: the power is cut
+ * Then: the committed value survives and the uncommitted one is lost
+ */
+void test_hal_nvs_commit_survives_power_cut() {
+    uint32_t value = 7;
+    TEST_ASSERT_TRUE(hal::nvsSet("calib", &value, sizeof(value)));
+    TEST_ASSERT_TRUE(hal::nvsCommit());
+    value = 8;
+    hal::nvsSet("calib", &value, sizeof(value));
+    hal::sim::powerCycle();
+
+    uint32_t read = 0;
+    TEST_ASSERT_TRUE(hal::nvsGet("calib", &read, sizeof(read)));
+    TEST_ASSERT_EQUAL_UINT32(7, read);
+    uint16_t wrongSize = 0;
+    TEST_ASSERT_FALSE(hal::nvsGet("calib", &wrongSize, sizeof(wrongSize)));
+    TEST_ASSERT_FALSE(hal::nvsGet("missing", &read, sizeof(read)));
+}
+
+/** Implement and test:
+ * Given: a simulated peer that echoes what it receives
+ * When: we connect without Wi-Fi, then with it, send, receive, and then the link drops
+ * Then: there's no route without Wi-Fi (nor to NTP); with it we get the echo, a receive with nothing pending times
+ *       out, and a dropped socket fails
+ */
+void test_hal_socket_round_trip() {
+    EchoPeer peer;
+    hal::sim::setSocketPeer(&peer);
+    hal::sim::setNtpTime(1792195200);
+    int64_t offsetMs = 0;
+    TEST_ASSERT_EQUAL_INT(hal::INVALID_SOCKET, hal::socketConnect("10.0.0.1", 1900, 100));
+    TEST_ASSERT_FALSE(hal::ntpOffsetMs("10.0.0.3", 100, offsetMs));
+    hal::sim::addAccessPoint({"daphi-depot", "compost", {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01}, 6, -55});
+    TEST_ASSERT_TRUE(hal::wifiConnect("daphi-depot", "compost", nullptr, nullptr, 1000));
+    TEST_ASSERT_TRUE(hal::ntpOffsetMs("10.0.0.3", 100, offsetMs));
+    TEST_ASSERT_EQUAL_INT(hal::INVALID_SOCKET, hal::socketConnect("10.0.0.2", 1900, 100));
+    int socket = hal::socketConnect("10.0.0.1", 1900, 100);
+    TEST_ASSERT_NOT_EQUAL(hal::INVALID_SOCKET, socket);
+
+    const char msg[] = "ping";
+    TEST_ASSERT_EQUAL_INT32(4, hal::socketSend(socket, msg, 4));
+    char buffer[8] = {};
+    TEST_ASSERT_EQUAL_INT32(4, hal::socketReceive(socket, buffer, sizeof(buffer), 100));
+    TEST_ASSERT_EQUAL_MEMORY(msg, buffer, 4);
+    uint32_t before = hal::millis();
+    TEST_ASSERT_EQUAL_INT32(0, hal::socketReceive(socket, buffer, sizeof(buffer), 100));
+    TEST_ASSERT_EQUAL_UINT32(before + 100, hal::millis());
+
+    hal::sim::dropSocket(socket);
+    TEST_ASSERT_EQUAL_INT32(-1, hal::socketSend(socket, msg, 4));
+    hal::socketClose(socket);
+    hal::sim::setSocketPeer(nullptr);
+}
+#endif
+
+void runHalTests() {
+#ifndef ARDUINO
+    RUN_TEST(test_hal_clock_is_simulated);
+    RUN_TEST(test_hal_gpio_falling_edge_interrupt);
+    RUN_TEST(test_hal_load_cell_sample_rate);
+    RUN_TEST(test_hal_load_cell_interrupt_bit_bang);
+    RUN_TEST(test_hal_nvs_commit_survives_power_cut);
+    RUN_TEST(test_hal_socket_round_trip);
+#endif
+}
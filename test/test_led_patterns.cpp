@@ -0,0 +1,173 @@
+// unit test file
+#include <unity.h>
+
+#include "led_patterns.h"
+
+namespace {
+
+constexpr char GOOD_CODE[] = ". . .";
+constexpr auto GOOD = morse<morseStepCount(GOOD_CODE)>(GOOD_CODE);
+static_assert(GOOD.size() == 5, "3 dots and the 2 gaps between them");
+
+}  // namespace
+
+/** Implement and test:
+ * Given: the Morse patterns of types.h
+ * When: they're compiled into steps
+ * Then: dots, dashes and the gaps between symbols and letters have the right lengths, and levels alternate
+ */
+void test_led_patterns_morse_steps() {
+    const LedPatternSpec &calibration = ledPattern(LEDPatternType::RunningCalibration);    // - . -
+    const uint16_t expected[] = {3 * LED_DOT_MS, LED_DOT_MS, LED_DOT_MS, LED_DOT_MS, 3 * LED_DOT_MS};
+    TEST_ASSERT_EQUAL_UINT8(5, calibration.count);
+    for (uint8_t i = 0; i < calibration.count; i++) {
+        TEST_ASSERT_EQUAL_UINT16(expected[i], calibration.steps[i].durationMs);
+        TEST_ASSERT_EQUAL(i % 2 == 0, calibration.steps[i].on);
+    }
+    TEST_ASSERT_EQUAL_UINT16(3 * LED_DOT_MS, GOOD[1].durationMs);     // between letters
+    TEST_ASSERT_EQUAL_UINT8(0, ledPattern(LEDPatternType::None).count);
+    TEST_ASSERT_TRUE(ledPattern(LEDPatternType::RunningSetup).repeat);
+}
+
+#ifndef ARDUINO
+#include "config.h"
+#include "hal.h"
+#include "hal_sim.h"
+
+namespace {
+
+constexpr gpio SECOND_LED = 6;
+
+struct Edge {
+    uint64_t atUs;
+    gpio pin;
+    bool on;
+};
+
+// replays the timer: every expiry plays the due edges, and records them
+struct Recorder {
+    static constexpr gpio PINS[2] = {LED, SECOND_LED};
+
+    LedEngine engine;
+    Edge edges[64];
+    uint8_t edgeCount = 0;
+    bool levels[2] = {false, false};
+
+    Recorder() : engine(PINS, 2) {}
+
+    void record() {
+        for (uint8_t i = 0; i < 2; i++) {
+            bool on = hal::sim::pinLevel(PINS[i]);
+            if (on != levels[i] && edgeCount < 64) {
+                edges[edgeCount++] = Edge{hal::micros(), PINS[i], on};
+            }
+            levels[i] = on;
+        }
+    }
+    static void onTimer(void *arg) {
+        Recorder *recorder = static_cast<Recorder *>(arg);
+        recorder->engine.onTimer();
+        recorder->record();
+    }
+};
+
+}  // namespace
+
+/** Implement and test:
+ * Given: the LED engine on the simulated one-shot timer
+ * When: it plays RunningActivation, [. -] * 3
+ * Then: every edge is on time, the LED ends off, and the CPU wakes up once per edge
+ */
+void test_led_patterns_edges_on_time() {
+    static Recorder recorder;
+    recorder = Recorder();
+    TEST_ASSERT_TRUE(recorder.engine.begin(Recorder::onTimer, &recorder));
+    recorder.engine.play(0, LEDPatternType::RunningActivation);
+    recorder.record();
+    hal::sleepMs(10000);
+
+    const LedPatternSpec &pattern = ledPattern(LEDPatternType::RunningActivation);
+    TEST_ASSERT_EQUAL_UINT8(pattern.count + 1, recorder.edgeCount);   // the first edge is play() itself
+    uint64_t at = 0;
+    for (uint8_t i = 0; i < pattern.count; i++) {
+        TEST_ASSERT_EQUAL_UINT64(at, recorder.edges[i].atUs);
+        TEST_ASSERT_EQUAL(pattern.steps[i].on, recorder.edges[i].on);
+        at += pattern.steps[i].durationMs * 1000ULL;
+    }
+    TEST_ASSERT_EQUAL_UINT64(at, recorder.edges[pattern.count].atUs);
+    TEST_ASSERT_FALSE(recorder.edges[pattern.count].on);
+    TEST_ASSERT_EQUAL_UINT32(pattern.count, hal::sim::timerFireCount());
+    TEST_ASSERT_TRUE(recorder.engine.playing(0) == LEDPatternType::None);
+}
+
+/** Implement and test:
+ * Given: RunningSetup repeating on one LED
+ * When: a MajorError preempts it, and a less urgent ButtonPressed comes during the error
+ * Then: the error plays right away, then ButtonPressed (the most urgent waiting), and RunningSetup is dropped from the wait
+ */
+void test_led_patterns_preemption_by_priority() {
+    static Recorder recorder;
+    recorder = Recorder();
+    recorder.engine.begin(Recorder::onTimer, &recorder);
+    recorder.engine.play(0, LEDPatternType::RunningSetup);
+    hal::sleepMs(2600);     // 2.5 s off, then on
+    TEST_ASSERT_TRUE(hal::sim::pinLevel(LED));
+    recorder.engine.play(0, LEDPatternType::MajorError);
+    TEST_ASSERT_TRUE(recorder.engine.playing(0) == LEDPatternType::MajorError);
+    hal::sleepMs(1000);
+    recorder.engine.play(0, LEDPatternType::ButtonPressed);
+    TEST_ASSERT_TRUE(recorder.engine.playing(0) == LEDPatternType::MajorError);
+    hal::sleepMs(2000);
+    TEST_ASSERT_TRUE(recorder.engine.playing(0) == LEDPatternType::ButtonPressed);
+    hal::sleepMs(1000);
+    TEST_ASSERT_TRUE(recorder.engine.playing(0) == LEDPatternType::None);
+
+    // a repeating pattern that's preempted resumes afterwards
+    recorder.engine.play(0, LEDPatternType::RunningSetup);
+    recorder.engine.play(0, LEDPatternType::CheckingDeviceStatus);
+    hal::sleepMs(3 * LED_DOT_MS);
+    TEST_ASSERT_TRUE(recorder.engine.playing(0) == LEDPatternType::RunningSetup);
+    recorder.engine.stop(0, LEDPatternType::RunningSetup);
+    TEST_ASSERT_TRUE(recorder.engine.playing(0) == LEDPatternType::None);
+}
+
+/** Implement and test:
+ * Given: two LEDs playing different patterns from one timer
+ * When: they run to the end
+ * Then: each LED's edges are on time, and edges that coincide share a wakeup
+ */
+void test_led_patterns_two_leds_one_timer() {
+    static Recorder recorder;
+    recorder = Recorder();
+    recorder.engine.begin(Recorder::onTimer, &recorder);
+    recorder.engine.play(0, LEDPatternType::ButtonPressed);     // on 0-200, off 200-400, on 400-600
+    recorder.engine.play(1, LEDPatternType::ProcessOut);        // on 0-600, off 600-800, on ... 2200
+    recorder.record();
+    hal::sleepMs(5000);
+    TEST_ASSERT_FALSE(hal::sim::pinLevel(LED));
+    TEST_ASSERT_FALSE(hal::sim::pinLevel(SECOND_LED));
+    const uint64_t firstExpected[] = {0, 200000, 400000, 600000};
+    const uint64_t secondExpected[] = {0, 600000, 800000, 1400000, 1600000, 2200000};
+    uint8_t first = 0;
+    uint8_t second = 0;
+    for (uint8_t i = 0; i < recorder.edgeCount; i++) {
+        if (recorder.edges[i].pin == LED) {
+            TEST_ASSERT_EQUAL_UINT64(firstExpected[first++], recorder.edges[i].atUs);
+        } else {
+            TEST_ASSERT_EQUAL_UINT64(secondExpected[second++], recorder.edges[i].atUs);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8(4, first);
+    TEST_ASSERT_EQUAL_UINT8(6, second);
+    TEST_ASSERT_EQUAL_UINT32(7, hal::sim::timerFireCount());    // 200, 400, 600 (both), 800, 1400, 1600, 2200
+}
+#endif
+
+void runLedPatternsTests() {
+    RUN_TEST(test_led_patterns_morse_steps);
+#ifndef ARDUINO
+    RUN_TEST(test_led_patterns_edges_on_time);
+    RUN_TEST(test_led_patterns_preemption_by_priority);
+    RUN_TEST(test_led_patterns_two_leds_one_timer);
+#endif
+}
@@ -0,0 +1,94 @@
+// unit test file
+#include <unity.h>
+
+#include "log_codec.h"
+
+/** Implement and test:
+ * Given: entries without a payload and with payloads of every size
+ * When: we encode and decode them
+ * Then: we get the same entries, each in as few bytes as its payload needs, and none ends with 0xFF
+ */
+void test_log_codec_round_trip() {
+    const LogEntry entries[] = {{LogCode::StatusCheck, 0, false, 0},
+                                {LogCode::Reboot, 1439, true, 0},
+                                {LogCode::BatteryMilliVolts, 754, true, 3912},
+                                {LogCode::ClockCalibrated, 60, true, static_cast<uint32_t>(-3)},
+                                {LogCode::LoadCellCalibrated, 1023, true, 0xFF}};
+    const size_t sizes[] = {3, 4, 5, 7, 4};
+    for (uint8_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+        uint8_t bytes[MAX_LOG_ENTRY_SIZE];
+        size_t length = encodeLogEntry(entries[i], bytes);
+        TEST_ASSERT_EQUAL(sizes[i], length);
+        TEST_ASSERT_NOT_EQUAL(0xFF, bytes[length - 1]);
+
+        LogEntry decoded;
+        TEST_ASSERT_EQUAL(length, decodeLogEntry(bytes, length, decoded));
+        TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(entries[i].code), static_cast<uint8_t>(decoded.code));
+        TEST_ASSERT_EQUAL_UINT16(entries[i].minute, decoded.minute);
+        TEST_ASSERT_EQUAL(entries[i].hasPayload, decoded.hasPayload);
+        TEST_ASSERT_EQUAL_UINT32(entries[i].payload, decoded.payload);
+
+        TEST_ASSERT_EQUAL(0, decodeLogEntry(bytes, length - 1, decoded));     // truncated
+    }
+}
+
+/** Implement and test:
+ * Given: bytes that aren't a log entry (an unknown code, a minute past 23:59)
+ * When: we decode them
+ * Then: they're rejected
+ */
+void test_log_codec_rejects_invalid_entries() {
+    LogEntry decoded;
+    const uint8_t unknownCode[] = {static_cast<uint8_t>(LogCode::Count), 0, 0};
+    TEST_ASSERT_EQUAL(0, decodeLogEntry(unknownCode, sizeof(unknownCode), decoded));
+    const uint8_t badMinute[] = {static_cast<uint8_t>(LogCode::StatusCheck), 0xA0, 0x05};    // 1440
+    TEST_ASSERT_EQUAL(0, decodeLogEntry(badMinute, sizeof(badMinute), decoded));
+}
+
+#ifndef ARDUINO
+/** Implement and test:
+ * Given: a binary log file with a deviceID, dates and rows
+ * When: we render it on the host
+ * Then: we get the text file described in logging.h
+ */
+void test_log_codec_renders_log_file() {
+    const LogEntry entries[] = {{LogCode::DeviceId, 754, true, 42},
+                                {LogCode::Date, 754, true, 20743},      // 17/10/2026
+                                {LogCode::BatteryMilliVolts, 754, true, 3912},
+                                {LogCode::ClockCalibrated, 800, true, static_cast<uint32_t>(-3)},
+                                {LogCode::TxTimesChanged, 801, true, (13U * 60) << 16 | (20U * 60 + 30)},
+                                {LogCode::Date, 5, true, 20744},
+                                {LogCode::SendingData, 5, true, 1689},
+                                {LogCode::LogFileFull, 6, false, 0}};
+    uint8_t log[sizeof(entries) / sizeof(entries[0]) * MAX_LOG_ENTRY_SIZE];
+    size_t length = 0;
+    for (const LogEntry &entry : entries) {
+        length += encodeLogEntry(entry, log + length);
+    }
+
+    char text[512];
+    TEST_ASSERT_GREATER_THAN(0, renderLogFile(log, length, text, sizeof(text)));
+    TEST_ASSERT_EQUAL_STRING("deviceID: 42\n"
+                             "\n"
+                             "date: 17/10/2026\n"
+                             "1234 battery 3912 mV\n"
+                             "1320 clock calibrated, corrected by -3 s\n"
+                             "1321 tx times changed 1300 2030\n"
+                             "\n"
+                             "date: 18/10/2026\n"
+                             "0005 sending data 1689 B\n"
+                             "0006 logfile is full, yet more info is tried to be logged\n",
+                             text);
+
+    TEST_ASSERT_EQUAL(0, renderLogFile(log, length - 1, text, sizeof(text)));   // a torn last entry
+    TEST_ASSERT_EQUAL(0, renderLogFile(log, length, text, 16));                  // no room for the text
+}
+#endif
+
+void runLogCodecTests() {
+    RUN_TEST(test_log_codec_round_trip);
+    RUN_TEST(test_log_codec_rejects_invalid_entries);
+#ifndef ARDUINO
+    RUN_TEST(test_log_codec_renders_log_file);
+#endif
+}
@@ -1,37 +1,204 @@
 // unit test file
+#include <unity.h>
+
+#include "config.h"
+#include "hal.h"
+#include "logging.h"
+
+namespace {
+
+constexpr uint16_t N = 128;
+constexpr uint32_t OCT_17_2026_1234 = 1792240440;   // UTC
+constexpr uint32_t OCT_18_2026_0005 = 1792281900;
+constexpr uint32_t OCT_17_2026 = OCT_17_2026_1234 / 86400;  // days since 1970
+constexpr uint32_t OCT_18_2026 = OCT_18_2026_0005 / 86400;
+constexpr uint16_t MAX_ENTRIES = LOG_FILE_SIZE / MIN_LOG_ENTRY_SIZE;
+
+uint8_t bytes[LOG_FILE_SIZE];
+LogEntry entries[MAX_ENTRIES];
+
+void startDevice() {
+    uint32_t deviceId = 42;
+    hal::nvsSet(NVS_KEY_DEVICE_ID, &deviceId, sizeof(deviceId));
+    hal::nvsCommit();
+    hal::setEpochSeconds(OCT_17_2026_1234);
+}
+
+uint16_t readEntries(const LogFile &log) {
+    size_t length = log.readLogFile(bytes, sizeof(bytes));
+    uint16_t count = 0;
+    size_t offset = 0;
+    while (offset < length) {
+        size_t entryLength = decodeLogEntry(bytes + offset, length - offset, entries[count]);
+        TEST_ASSERT_NOT_EQUAL(0, entryLength);
+        offset += entryLength;
+        count++;
+    }
+    return count;
+}
+
+void assertEntry(uint16_t index, LogCode code, recordTimeType minute, bool hasPayload, uint32_t payload) {
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(code), static_cast<uint8_t>(entries[index].code));
+    TEST_ASSERT_EQUAL_UINT16(minute, entries[index].minute);
+    TEST_ASSERT_EQUAL(hasPayload, entries[index].hasPayload);
+    TEST_ASSERT_EQUAL_UINT32(payload, entries[index].payload);
+}
+
+void assertHeader() {
+    assertEntry(0, LogCode::DeviceId, 12 * 60 + 34, true, 42);
+    assertEntry(1, LogCode::Date, 12 * 60 + 34, true, OCT_17_2026);
+}
+
+}  // namespace
 
 /** Implement and test:
  * Given: a log file instace with a size N - constructor
  * When: we create a new log file
  * Then: the new log file has deviceID and the current date formatted: dd/mm/YYYY
  */
+void test_logging_new_file_has_device_id_and_date() {
+    startDevice();
+    LogFile log(N);
+    TEST_ASSERT_TRUE(log.createLogFile());
+    TEST_ASSERT_EQUAL_UINT16(2, readEntries(log));
+    assertHeader();     // rendered as dd/mm/YYYY by renderLogFile, see test_log_codec.cpp
+}
 
 /** Implement and test:
  * Given: a log file
- * When: we add a log row 
+ * When: we add a log row
  * Then: we get the previous log file and below it, the added row.
  */
+void test_logging_add_row_appends_it() {
+    startDevice();
+    LogFile log(N);
+    log.createLogFile();
+    uint32_t before = log.length();
+    TEST_ASSERT_TRUE(log.addLogRow(LogCode::BatteryMilliVolts, 3912));
+    TEST_ASSERT_TRUE(log.addLogRow(LogCode::StatusCheck));
+    TEST_ASSERT_EQUAL_UINT32(before + 5 + 3, log.length());     // 2 byte payload, no payload
+    TEST_ASSERT_EQUAL_UINT16(4, readEntries(log));
+    assertHeader();
+    assertEntry(2, LogCode::BatteryMilliVolts, 12 * 60 + 34, true, 3912);
+    assertEntry(3, LogCode::StatusCheck, 12 * 60 + 34, false, 0);
+
+    // the date is added by itself when the day changes
+    hal::setEpochSeconds(OCT_18_2026_0005);
+    TEST_ASSERT_TRUE(log.addLogRow(LogCode::SendingData, 1689));
+    TEST_ASSERT_EQUAL_UINT16(6, readEntries(log));
+    assertEntry(4, LogCode::Date, 5, true, OCT_18_2026);
+    assertEntry(5, LogCode::SendingData, 5, true, 1689);
+}
 
 /** Implement and test:
  * Given: a log file
- * When: we add a date 
+ * When: we add a date
  * Then: we get the previous log file and below it the added date
  */
+void test_logging_add_date_appends_it() {
+    startDevice();
+    LogFile log(N);
+    log.createLogFile();
+    TEST_ASSERT_TRUE(log.addDate(951782400));   // 29/02/2000 00:00
+    TEST_ASSERT_EQUAL_UINT16(3, readEntries(log));
+    assertHeader();
+    assertEntry(2, LogCode::Date, 0, true, 951782400 / 86400);
+}
 
 /** Implement and test:
  * Given: a log file
  * When: we add dates more then the size of the file, and read the file
  * Then: we can no longer update the file and the last row has the meaning of "logfile is full, yet more info is tried to be logged"
  */
+void test_logging_full_of_dates() {
+    startDevice();
+    LogFile log(N);
+    log.createLogFile();
+    uint16_t added = 0;
+    while (log.addDate(OCT_17_2026_1234) && added < N) {
+        added++;
+    }
+    TEST_ASSERT_TRUE(added < N);
+    TEST_ASSERT_FALSE(log.addDate(OCT_17_2026_1234));
+    TEST_ASSERT_FALSE(log.addLogRow(LogCode::StatusCheck));
+    uint16_t count = readEntries(log);
+    assertEntry(count - 1, LogCode::LogFileFull, 12 * 60 + 34, false, 0);
+    assertEntry(count - 2, LogCode::Date, 12 * 60 + 34, true, OCT_17_2026);
+    TEST_ASSERT_TRUE(log.length() <= N);
+}
 
 /** Implement and test:
  * Given: a log file
  * When: we add rows more then the size of the file, and read the file
  * Then: we can no longer update the file and the last row has the meaning of "logfile is full, yet more info is tried to be logged"
  */
+void test_logging_full_of_rows() {
+    startDevice();
+    LogFile log(N);
+    log.createLogFile();
+    uint16_t added = 0;
+    while (log.addLogRow(LogCode::LoadCellCalibrated, 1250) && added < N) {
+        added++;
+    }
+    TEST_ASSERT_TRUE(added < N);
+    TEST_ASSERT_FALSE(log.addLogRow(LogCode::LoadCellCalibrated, 1250));
+    uint16_t count = readEntries(log);
+    TEST_ASSERT_EQUAL_UINT16(2 + added + 1, count);
+    assertEntry(count - 1, LogCode::LogFileFull, 12 * 60 + 34, false, 0);
+    TEST_ASSERT_TRUE(log.length() <= N);
+
+    // it's still full after a reboot, and the row isn't logged twice
+    LogFile rebooted(N);
+    rebooted.createLogFile();
+    TEST_ASSERT_FALSE(rebooted.addLogRow(LogCode::Reboot, 1));
+    TEST_ASSERT_EQUAL_UINT32(log.length(), rebooted.length());
+}
 
 /** Implement and test:
  * Given: a non empty log file (with some rows and dates)
  * When: we delete the log file and then read it
  * Then: we get a clean log file (i.e., deviceID and current date)
- */
\ No newline at end of file
+ */
+void test_logging_delete_gives_clean_file() {
+    startDevice();
+    LogFile log(N);
+    log.createLogFile();
+    log.addLogRow(LogCode::Activated);
+    log.addDate(OCT_18_2026_0005);
+    log.addLogRow(LogCode::BatteryLow, 2990);
+    log.deleteLogFile();
+    TEST_ASSERT_EQUAL_UINT16(2, readEntries(log));
+    assertHeader();
+}
+
+/** Implement and test:
+ * Given: a sealed log file being sent, and a row logged while it's sent
+ * When: the send succeeds and the sealed file is deleted
+ * Then: the sent file ends before that row, and what's left is the row under its own deviceID and date
+ */
+void test_logging_delete_through_seal_keeps_later_rows() {
+    startDevice();
+    LogFile log(N);
+    log.createLogFile();
+    log.addLogRow(LogCode::Activated);
+    uint32_t through = log.seal();
+    log.addLogRow(LogCode::BatteryLow, 2990);
+    size_t sentLength = log.readLogFile(bytes, sizeof(bytes), through);
+    TEST_ASSERT_TRUE(sentLength > 0);
+    TEST_ASSERT_TRUE(sentLength < log.length());
+
+    log.deleteThrough(through);
+    TEST_ASSERT_EQUAL_UINT16(3, readEntries(log));
+    assertHeader();
+    assertEntry(2, LogCode::BatteryLow, 12 * 60 + 34, true, 2990);
+}
+
+void runLoggingTests() {
+    RUN_TEST(test_logging_new_file_has_device_id_and_date);
+    RUN_TEST(test_logging_add_row_appends_it);
+    RUN_TEST(test_logging_add_date_appends_it);
+    RUN_TEST(test_logging_full_of_dates);
+    RUN_TEST(test_logging_full_of_rows);
+    RUN_TEST(test_logging_delete_gives_clean_file);
+    RUN_TEST(test_logging_delete_through_seal_keeps_later_rows);
+}
@@ -0,0 +1,96 @@
+// unit test runner
+// PlatformIO builds every file in this directory into one test program, so each test file exposes
+// a run<Module>Tests() function and this file is the single entry point that runs them all.
+#include <unity.h>
+
+#include "config.h"
+#include "credential_vault.h"
+#include "flash_log.h"
+#ifndef ARDUINO
+#include "hal_sim.h"
+#include "wifi_link.h"
+#endif
+
+void runQueueTests();
+void runEventRingTests();
+void runHalTests();
+void runChecksumTests();
+void runAesGcmTests();
+void runCredentialVaultTests();
+void runFlashLogTests();
+void runDataTests();
+void runDataCodecTests();
+void runEventsTests();
+void runDeviceStatusTests();
+void runEventDispatchTests();
+void runEnergyTests();
+void runBatteryTests();
+void runLogCodecTests();
+void runSchedulerTests();
+void runTxSlotsTests();
+void runClockDriftTests();
+void runLoggingTests();
+void runSensorsTests();
+void runLedPatternsTests();
+void runUplinkTests();
+void runWifiLinkTests();
+void runSetupConsoleTests();
+
+void setUp() {
+#ifndef ARDUINO
+    hal::sim::reset();  // every test starts from powered-on simulated hardware
+    wifiCache = WifiCache{};    // power-up zeroes RTC memory
+#endif
+    // and with an empty DataTable, LogFile and uplink backlog
+    flashStore.mount(STORAGE_PARTITION);
+    flashStore.clear(StreamId::DataTable);
+    flashStore.clear(StreamId::LogFile);
+    flashStore.clear(StreamId::Uplink);
+    credentialVault.mount();    // empty: a test that needs Wi-Fi stores its network
+}
+
+void tearDown() {}
+
+static int runAllTests() {
+    UNITY_BEGIN();
+    runQueueTests();
+    runEventRingTests();
+    runHalTests();
+    runChecksumTests();
+    runAesGcmTests();
+    runCredentialVaultTests();
+    runFlashLogTests();
+    runDataTests();
+    runDataCodecTests();
+    runEventsTests();
+    runDeviceStatusTests();
+    runEventDispatchTests();
+    runEnergyTests();
+    runBatteryTests();
+    runLogCodecTests();
+    runLoggingTests();
+    runSchedulerTests();
+    runTxSlotsTests();
+    runClockDriftTests();
+    runSensorsTests();
+    runLedPatternsTests();
+    runUplinkTests();
+    runWifiLinkTests();
+    runSetupConsoleTests();
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup() {
+    delay(2000);    // give the serial monitor time to connect
+    runAllTests();
+}
+
+void loop() {}
+#else
+int main() {
+    return runAllTests();
+}
+#endif
@@ -1,25 +1,121 @@
 // unit test file
+#include <unity.h>
+
+#include "queue.h"
+#include "types.h"
+
+namespace {
+
+constexpr uint16_t N = 8;
+
+Event makeEvent(EventType eventType, uint8_t priority) {
+    return Event{eventType, priority};
+}
+
+}  // namespace
 
 /** Implement and test:
  * Given: a queue instace with a size N - constructor
  * When: we check if its empty
  * Then: it returns true
  */
+void test_queue_new_is_empty() {
+    Queue<Event, N> queue;
+    TEST_ASSERT_TRUE(queue.isEmpty());
+    TEST_ASSERT_EQUAL_UINT16(0, queue.size());
+    TEST_ASSERT_EQUAL_UINT16(N, queue.capacity());
+}
 
 /** Implement and test:
  * Given: a queue with several items with the same priority
  * When: we dequeue it till it's empty
  * Then: it returns the same items in the order of enqueuing
  */
+void test_queue_same_priority_is_fifo() {
+    Queue<Event, N> queue;
+    const EventType order[] = {EventType::SendData, EventType::Setup, EventType::CalibrateClock,
+                               EventType::Activate, EventType::SendLogFile};
+    for (EventType eventType : order) {
+        queue.enqueue(makeEvent(eventType, 3));
+    }
+    for (EventType eventType : order) {
+        TEST_ASSERT_FALSE(queue.isEmpty());
+        TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(eventType), static_cast<uint8_t>(queue.dequeue().eventType));
+    }
+    TEST_ASSERT_TRUE(queue.isEmpty());
+}
 
 /** Implement and test:
  * Given: a queue with several items with the different priorities
  * When: we dequeue it till it's empty
  * Then: it returns the same items but ordered by their priority (smaller priority is more urgent)
  */
+void test_queue_orders_by_priority() {
+    Queue<Event, N> queue;
+    queue.enqueue(makeEvent(EventType::SendData, 5));
+    queue.enqueue(makeEvent(EventType::Setup, 1));
+    queue.enqueue(makeEvent(EventType::CalibrateClock, 9));
+    queue.enqueue(makeEvent(EventType::Activate, 1));
+    queue.enqueue(makeEvent(EventType::SendLogFile, 0));
+    queue.enqueue(makeEvent(EventType::Deactivate, 5));
+
+    const EventType expected[] = {EventType::SendLogFile, EventType::Setup, EventType::Activate,
+                                  EventType::SendData, EventType::Deactivate, EventType::CalibrateClock};
+    for (EventType eventType : expected) {
+        TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(eventType), static_cast<uint8_t>(queue.peek().eventType));
+        TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(eventType), static_cast<uint8_t>(queue.dequeue().eventType));
+    }
+    TEST_ASSERT_TRUE(queue.isEmpty());
+}
 
 /** Implement and test:
  * Given: a queue
  * When: we enqueue with more items than its capacity and dequeue it till its empty
  * Then: we cannot enqueue items more then its capacity and when we dequeue it we don't see any items we tried to enqueue after it became full
- */
\ No newline at end of file
+ */
+void test_queue_rejects_items_when_full() {
+    Queue<Event, N> queue;
+    for (uint16_t i = 0; i < N; i++) {
+        TEST_ASSERT_TRUE(queue.tryEnqueue(makeEvent(EventType::SendData, 2)));
+    }
+    TEST_ASSERT_FALSE(queue.tryEnqueue(makeEvent(EventType::Setup, 2)));
+    queue.enqueue(makeEvent(EventType::Setup, 0));  // silently dropped, even though it's more urgent
+    TEST_ASSERT_EQUAL_UINT16(N, queue.size());
+
+    uint16_t dequeued = 0;
+    Event event{};
+    while (queue.tryDequeue(event)) {
+        TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(EventType::SendData), static_cast<uint8_t>(event.eventType));
+        dequeued++;
+    }
+    TEST_ASSERT_EQUAL_UINT16(N, dequeued);
+}
+
+/** Implement and test:
+ * Given: a queue that was filled and drained many times with interleaved priorities
+ * When: we dequeue it
+ * Then: items are still ordered by their priority
+ */
+void test_queue_refill_keeps_priority_order() {
+    Queue<Event, N> queue;
+    uint8_t lastPriority = 0;
+    for (uint16_t round = 0; round < 100; round++) {
+        queue.enqueue(makeEvent(static_cast<EventType>(round % 9), static_cast<uint8_t>(round % 3)));
+        if (queue.size() == N) {
+            lastPriority = 0;
+            while (!queue.isEmpty()) {
+                Event event = queue.dequeue();
+                TEST_ASSERT_GREATER_OR_EQUAL(lastPriority, event.priority);
+                lastPriority = event.priority;
+            }
+        }
+    }
+}
+
+void runQueueTests() {
+    RUN_TEST(test_queue_new_is_empty);
+    RUN_TEST(test_queue_same_priority_is_fifo);
+    RUN_TEST(test_queue_orders_by_priority);
+    RUN_TEST(test_queue_rejects_items_when_full);
+    RUN_TEST(test_queue_refill_keeps_priority_order);
+}
@@ -1,2 +1,187 @@
 // unit test file
-// TODO: later should write tests
\ No newline at end of file
+#include <unity.h>
+
+#include "scheduler.h"
+
+namespace {
+
+constexpr uint32_t DAY = 86400;
+constexpr uint32_t MIDNIGHT = 1792195200;   // 17/10/2026 00:00 UTC
+
+SchedulerConfig config(uint32_t slackS) {
+    // tx at 13:00:17 and 20:00:43, clock calibration at 03:00:05, status every hour
+    return SchedulerConfig{60, {13 * 3600 + 17, 20 * 3600 + 43}, 3 * 3600 + 5, 3600, slackS};
+}
+
+bool contains(const Job *jobs, uint8_t count, Job job) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (jobs[i] == job) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// runs every wakeup until `until`, returns how many there were
+uint32_t runUntil(Scheduler &scheduler, uint32_t until, uint32_t *runs) {
+    uint32_t wakeups = 0;
+    while (scheduler.nextWakeup() < until) {
+        Job due[JOB_COUNT];
+        uint8_t count = scheduler.runDue(scheduler.nextWakeup(), due);
+        for (uint8_t i = 0; i < count; i++) {
+            runs[static_cast<uint8_t>(due[i])]++;
+        }
+        wakeups++;
+    }
+    return wakeups;
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: a scheduler started in the middle of a minute
+ * When: we ask for the next wakeup
+ * Then: it's the status check right away, then the sensing on the next whole minute
+ */
+void test_scheduler_next_wakeup_is_earliest_deadline() {
+    Scheduler scheduler(config(0));
+    scheduler.start(MIDNIGHT + 6 * 3600 + 29);
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 6 * 3600 + 29, scheduler.nextWakeup());
+    Job due[JOB_COUNT];
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.runDue(scheduler.nextWakeup(), due));
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(Job::CheckDeviceStatus), static_cast<uint8_t>(due[0]));
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 6 * 3600 + 60, scheduler.nextWakeup());
+}
+
+/** Implement and test:
+ * Given: a scheduler running for a whole day without coalescing
+ * When: we run every wakeup
+ * Then: every job runs as often as it should, each at its own wakeup
+ */
+void test_scheduler_runs_every_job_on_time() {
+    Scheduler scheduler(config(0));
+    scheduler.start(MIDNIGHT + 29);
+    uint32_t runs[JOB_COUNT] = {};
+    uint32_t wakeups = runUntil(scheduler, MIDNIGHT + DAY, runs);
+    TEST_ASSERT_EQUAL_UINT32(1439, runs[static_cast<uint8_t>(Job::Sense)]);
+    TEST_ASSERT_EQUAL_UINT32(1, runs[static_cast<uint8_t>(Job::TxFirst)]);
+    TEST_ASSERT_EQUAL_UINT32(1, runs[static_cast<uint8_t>(Job::TxSecond)]);
+    TEST_ASSERT_EQUAL_UINT32(1, runs[static_cast<uint8_t>(Job::CalibrateClock)]);
+    TEST_ASSERT_EQUAL_UINT32(24, runs[static_cast<uint8_t>(Job::CheckDeviceStatus)]);
+    TEST_ASSERT_EQUAL_UINT32(1439 + 1 + 1 + 1 + 24, wakeups);
+}
+
+/** Implement and test:
+ * Given: a sensing wakeup at 13:00:00 and the first transmission at 13:00:17
+ * When: the slack is 30 seconds
+ * Then: both run in the same wakeup, and the sensing stays on whole minutes
+ */
+void test_scheduler_coalesces_within_slack() {
+    Scheduler scheduler(config(30));
+    scheduler.start(MIDNIGHT + 12 * 3600 + 59 * 60 + 20);
+    Job due[JOB_COUNT];
+    scheduler.runDue(scheduler.nextWakeup(), due);      // the status check at start
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 13 * 3600, scheduler.nextWakeup());
+    uint8_t count = scheduler.runDue(scheduler.nextWakeup(), due);
+    TEST_ASSERT_EQUAL_UINT8(2, count);
+    TEST_ASSERT_TRUE(contains(due, count, Job::Sense));
+    TEST_ASSERT_TRUE(contains(due, count, Job::TxFirst));
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 13 * 3600 + 60, scheduler.nextWakeup());
+
+    // and over a day, every job still runs as often, with fewer wakeups
+    scheduler.start(MIDNIGHT + 29);
+    uint32_t runs[JOB_COUNT] = {};
+    uint32_t wakeups = runUntil(scheduler, MIDNIGHT + DAY, runs);
+    TEST_ASSERT_EQUAL_UINT32(1439, runs[static_cast<uint8_t>(Job::Sense)]);
+    TEST_ASSERT_EQUAL_UINT32(24, runs[static_cast<uint8_t>(Job::CheckDeviceStatus)]);
+    TEST_ASSERT_EQUAL_UINT32(1, runs[static_cast<uint8_t>(Job::TxSecond)]);
+    TEST_ASSERT_EQUAL_UINT32(1439 + 1, wakeups);  // only the start's status check wakes up on its own
+}
+
+/** Implement and test:
+ * Given: a scheduler with the default tx times
+ * When: the server changes them
+ * Then: the transmissions move to the new times
+ */
+void test_scheduler_reschedules_tx_times() {
+    Scheduler scheduler(config(0));
+    scheduler.setEnabled(Job::Sense, false, MIDNIGHT);
+    scheduler.setEnabled(Job::CheckDeviceStatus, false, MIDNIGHT);
+    scheduler.setEnabled(Job::CalibrateClock, false, MIDNIGHT);
+    scheduler.start(MIDNIGHT);
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 13 * 3600 + 17, scheduler.nextWakeup());
+    scheduler.setTxTimes(9 * 3600, 1 * 3600, MIDNIGHT + 2 * 3600);
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 9 * 3600, scheduler.nextWakeup());
+    Job due[JOB_COUNT];
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.runDue(scheduler.nextWakeup(), due));
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(Job::TxFirst), static_cast<uint8_t>(due[0]));
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + DAY + 1 * 3600, scheduler.nextWakeup());     // 01:00 passed already today
+}
+
+/** Implement and test:
+ * Given: a scheduler whose device slept through an hour of deadlines
+ * When: it wakes up
+ * Then: every late job runs once and its next deadline is back in the future, on its grid
+ */
+void test_scheduler_skips_missed_deadlines() {
+    Scheduler scheduler(config(0));
+    scheduler.setEnabled(Job::TxFirst, false, MIDNIGHT);
+    scheduler.setEnabled(Job::TxSecond, false, MIDNIGHT);
+    scheduler.setEnabled(Job::CalibrateClock, false, MIDNIGHT);
+    scheduler.start(MIDNIGHT);
+    Job due[JOB_COUNT];
+    uint8_t count = scheduler.runDue(MIDNIGHT + 3600 + 10, due);
+    TEST_ASSERT_EQUAL_UINT8(2, count);
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 3600 + 60, scheduler.nextWakeup());
+    count = scheduler.runDue(scheduler.nextWakeup(), due);
+    TEST_ASSERT_EQUAL_UINT8(1, count);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(Job::Sense), static_cast<uint8_t>(due[0]));
+}
+
+/** Implement and test:
+ * Given: a scheduler that just ran a reading at 10:03
+ * When: the sensing interval changes to 5 minutes, and back to 1
+ * Then: the next reading moves to 10:05, then back to 10:04
+ */
+void test_scheduler_changes_sense_interval() {
+    Scheduler scheduler(config(0));
+    scheduler.setEnabled(Job::CheckDeviceStatus, false, MIDNIGHT);
+    scheduler.start(MIDNIGHT + 10 * 3600 + 2 * 60 + 30);
+    Job due[JOB_COUNT];
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.runDue(MIDNIGHT + 10 * 3600 + 3 * 60, due));
+    scheduler.setSenseInterval(300);
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 10 * 3600 + 5 * 60, scheduler.nextWakeup());
+    scheduler.setSenseInterval(60);
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 10 * 3600 + 4 * 60, scheduler.nextWakeup());
+}
+
+/** Implement and test:
+ * Given: a scheduler with only the tx jobs, at 13:00:40
+ * When: a TxRetry is set for 13:01:10, then moved to 13:02:00
+ * Then: it runs once, at 13:02:00, and isn't rescheduled
+ */
+void test_scheduler_runs_tx_retry_once() {
+    Scheduler scheduler(config(0));
+    scheduler.setEnabled(Job::Sense, false, MIDNIGHT);
+    scheduler.setEnabled(Job::CheckDeviceStatus, false, MIDNIGHT);
+    scheduler.setEnabled(Job::CalibrateClock, false, MIDNIGHT);
+    scheduler.start(MIDNIGHT + 13 * 3600 + 40);
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 20 * 3600 + 43, scheduler.nextWakeup());    // no retry before it's set
+    scheduler.setTxRetry(MIDNIGHT + 13 * 3600 + 70);
+    scheduler.setTxRetry(MIDNIGHT + 13 * 3600 + 120);
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 13 * 3600 + 120, scheduler.nextWakeup());
+    Job due[JOB_COUNT];
+    TEST_ASSERT_EQUAL_UINT8(1, scheduler.runDue(scheduler.nextWakeup(), due));
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(Job::TxRetry), static_cast<uint8_t>(due[0]));
+    TEST_ASSERT_EQUAL_UINT32(MIDNIGHT + 20 * 3600 + 43, scheduler.nextWakeup());
+}
+
+void runSchedulerTests() {
+    RUN_TEST(test_scheduler_next_wakeup_is_earliest_deadline);
+    RUN_TEST(test_scheduler_runs_every_job_on_time);
+    RUN_TEST(test_scheduler_coalesces_within_slack);
+    RUN_TEST(test_scheduler_reschedules_tx_times);
+    RUN_TEST(test_scheduler_skips_missed_deadlines);
+    RUN_TEST(test_scheduler_changes_sense_interval);
+    RUN_TEST(test_scheduler_runs_tx_retry_once);
+}
@@ -1,2 +1,234 @@
 // unit test file
-// TODO: later should write tests
\ No newline at end of file
+#include <unity.h>
+
+#include <algorithm>
+
+#include "config.h"
+#include "data.h"
+#include "hal.h"
+#include "sensors.h"
+#ifndef ARDUINO
+#include "hal_sim.h"
+#endif
+
+/** Implement and test:
+ * Given: a burst with one spike (something brushing the plate)
+ * When: we reduce it with each filter
+ * Then: the spike moves the mean, but not the median or the trimmed mean
+ */
+void test_sensors_filters_reject_a_spike() {
+    const int32_t burst[8] = {1000, 1002, 998, 1001, 999, 1000, 90000, 1000};
+    int32_t samples[8];
+
+    std::copy(burst, burst + 8, samples);
+    TEST_ASSERT_EQUAL_INT32(12125, reduceSamples(samples, 8, SampleFilter::Mean));
+    std::copy(burst, burst + 8, samples);
+    TEST_ASSERT_EQUAL_INT32(1000, reduceSamples(samples, 8, SampleFilter::Median));
+    std::copy(burst, burst + 8, samples);
+    TEST_ASSERT_EQUAL_INT32(1000, reduceSamples(samples, 8, SampleFilter::TrimmedMean));
+}
+
+/** Implement and test:
+ * Given: an even and an odd number of negative samples
+ * When: we take their median and mean
+ * Then: the even median is the rounded average of the two middle samples, and the mean rounds to the nearest
+ */
+void test_sensors_median_and_mean_rounding() {
+    int32_t even[4] = {-7, -1, -4, -10};
+    TEST_ASSERT_EQUAL_INT32(-6, reduceSamples(even, 4, SampleFilter::Median));    // (-7 + -4) / 2 = -5.5
+    int32_t odd[3] = {-7, -1, -4};
+    TEST_ASSERT_EQUAL_INT32(-4, reduceSamples(odd, 3, SampleFilter::Median));
+    int32_t mean[3] = {1, 2, 2};
+    TEST_ASSERT_EQUAL_INT32(2, reduceSamples(mean, 3, SampleFilter::Mean));       // 1.67
+}
+
+/** Implement and test:
+ * Given: a raw reading and a calibration
+ * When: we convert it to grams
+ * Then: it's rounded, and clamped to what a Record can hold
+ */
+void test_sensors_raw_to_grams() {
+    LoadCellCalibration calibration{1000, 20.0f};
+    TEST_ASSERT_EQUAL_UINT32(50, rawToGrams(1000 + 20 * 50 + 9, calibration));
+    TEST_ASSERT_EQUAL_UINT32(0, rawToGrams(-5000, calibration));
+    TEST_ASSERT_EQUAL_UINT32(MAX_RECORD_WEIGHT, rawToGrams(0x7FFFFF, LoadCellCalibration{0, 1.0f}));
+    TEST_ASSERT_EQUAL_FLOAT(LOAD_CELL_DEFAULT_COUNTS_PER_GRAM, loadCellCalibration().countsPerGram);
+}
+
+namespace {
+
+constexpr AdaptiveConfig ADAPTIVE{10, 50, 60, 60, 300, 3};
+
+}  // namespace
+
+/** Implement and test:
+ * Given: an adaptive sampler and a weight that only moves within the dead band
+ * When: readings come in
+ * Then: only the first one and the heartbeats are stored, and the interval drops to idle after the quiet readings
+ */
+void test_sensors_adaptive_stores_heartbeats_only() {
+    AdaptiveSampler sampler(ADAPTIVE);
+    TEST_ASSERT_TRUE(sampler.onReading(Record{600, 2000}));
+    TEST_ASSERT_EQUAL_UINT32(60, sampler.intervalS());
+    TEST_ASSERT_FALSE(sampler.onReading(Record{601, 2008}));
+    TEST_ASSERT_FALSE(sampler.onReading(Record{602, 1992}));
+    TEST_ASSERT_FALSE(sampler.onReading(Record{603, 2004}));
+    TEST_ASSERT_EQUAL_UINT32(300, sampler.intervalS());
+    TEST_ASSERT_FALSE(sampler.onReading(Record{655, 2001}));
+    TEST_ASSERT_TRUE(sampler.onReading(Record{660, 2001}));     // heartbeat
+    TEST_ASSERT_FALSE(sampler.onReading(Record{665, 2001}));
+}
+
+/** Implement and test:
+ * Given: an idle adaptive sampler
+ * When: someone throws a bag in, and the weight settles
+ * Then: nothing is stored while it moves, the settled weight is, and the interval is back to active
+ */
+void test_sensors_adaptive_stores_settled_change() {
+    AdaptiveSampler sampler(ADAPTIVE);
+    sampler.onReading(Record{1435, 2000});
+    for (recordTimeType minute = 1436; minute < 1439; minute++) {
+        sampler.onReading(Record{minute, 2000});
+    }
+    TEST_ASSERT_EQUAL_UINT32(300, sampler.intervalS());
+    TEST_ASSERT_FALSE(sampler.onReading(Record{4, 2600}));      // moving, across midnight
+    TEST_ASSERT_EQUAL_UINT32(60, sampler.intervalS());
+    TEST_ASSERT_FALSE(sampler.onReading(Record{5, 3150}));
+    TEST_ASSERT_TRUE(sampler.onReading(Record{6, 3160}));       // settled
+    TEST_ASSERT_FALSE(sampler.onReading(Record{7, 3158}));
+    TEST_ASSERT_EQUAL_UINT32(60, sampler.intervalS());
+}
+
+#ifndef ARDUINO
+/** Implement and test:
+ * Given: the simulated HX711, powered down between readings
+ * When: we sample it once
+ * Then: every conversion of the burst is read by the DOUT interrupt, the settling ones are dropped,
+ *       and the HX711 is powered down again
+ */
+void test_sensors_samples_by_interrupt() {
+    hal::sim::setLoadCellSource([](uint32_t nowMs) {
+        return nowMs <= LOAD_CELL_SETTLE_SAMPLES * LOAD_CELL_SAMPLE_PERIOD_MS ? -400000 : 123456;  // unsettled, then settled
+    });
+    hal::loadCellBegin();
+    hal::loadCellPowerDown();
+    int32_t raw = 0;
+    TEST_ASSERT_TRUE(sampleLoadCell(SampleFilter::Mean, raw));
+    TEST_ASSERT_EQUAL_INT32(123456, raw);
+    TEST_ASSERT_EQUAL_UINT32(LOAD_CELL_SETTLE_SAMPLES + LOAD_CELL_RING_LENGTH + 1, hal::sim::loadCellReads());
+    TEST_ASSERT_TRUE(hal::sim::loadCellPoweredDown());
+    TEST_ASSERT_EQUAL_UINT32((LOAD_CELL_SETTLE_SAMPLES + LOAD_CELL_RING_LENGTH + 1) * LOAD_CELL_SAMPLE_PERIOD_MS,
+                             hal::millis());
+}
+
+/** Implement and test:
+ * Given: an HX711 that doesn't respond
+ * When: we sample it
+ * Then: sampling fails, after one burst's time
+ */
+void test_sensors_no_samples_fails() {
+    hal::sim::setLoadCellConnected(false);
+    hal::loadCellBegin();
+    int32_t raw = 0;
+    TEST_ASSERT_FALSE(sampleLoadCell(LOAD_CELL_FILTER, raw));
+    TEST_ASSERT_EQUAL_UINT32(0, hal::sim::loadCellReads());
+}
+
+namespace {
+
+constexpr uint32_t COLD_MS = (LOAD_CELL_COLD_SETTLE_SAMPLES + LOAD_CELL_RING_LENGTH + 1) * LOAD_CELL_SAMPLE_PERIOD_MS;
+constexpr uint32_t WARM_MS = (LOAD_CELL_SETTLE_SAMPLES + LOAD_CELL_RING_LENGTH + 1) * LOAD_CELL_SAMPLE_PERIOD_MS;
+
+void storeCalibration(int32_t tareRaw, float countsPerGram) {
+    LoadCellCalibration calibration{tareRaw, countsPerGram};
+    hal::nvsSet(NVS_KEY_LOAD_CELL_CAL, &calibration, sizeof(calibration));
+    hal::nvsCommit();
+}
+
+// the reading's start, and how long it took on the simulated clock
+uint32_t timedRead(LoadCellReading &reading, LoadCellWarmState &state) {
+    uint32_t start = hal::millis();
+    TEST_ASSERT_TRUE(readLoadCell(LOAD_CELL_FILTER, reading, state));
+    return hal::millis() - start;
+}
+
+uint32_t driftUntilMs = 0;
+
+}  // namespace
+
+/** Implement and test:
+ * Given: a calibration in NVS, and an RTC warm state zeroed by a power-up
+ * When: the load cell is read, read again (a wakeup), and read after a new calibration and invalidating the warm state
+ * Then: the first reading starts cold (NVS, the long settling), the second warm (the RTC copy, only the HX711's settling,
+ *       and not the new NVS calibration), the third cold again with the new calibration
+ */
+void test_sensors_warm_start_after_cold() {
+    storeCalibration(1000, 20.0f);
+    hal::sim::setLoadCellRaw(1000 + 20 * 500);
+    hal::loadCellBegin();
+    hal::loadCellPowerDown();
+    LoadCellWarmState state{};
+    LoadCellReading reading;
+
+    TEST_ASSERT_EQUAL_UINT32(COLD_MS, timedRead(reading, state));
+    TEST_ASSERT_TRUE(reading.start == LoadCellStart::Cold);
+    TEST_ASSERT_EQUAL_UINT32(500, reading.grams);
+    TEST_ASSERT_EQUAL_HEX32(LOAD_CELL_WARM_MAGIC, state.magic);
+
+    storeCalibration(1000, 10.0f);
+    TEST_ASSERT_EQUAL_UINT32(WARM_MS, timedRead(reading, state));
+    TEST_ASSERT_TRUE(reading.start == LoadCellStart::Warm);
+    TEST_ASSERT_FALSE(reading.driftFallback);
+    TEST_ASSERT_EQUAL_UINT32(500, reading.grams);
+
+    invalidateLoadCellWarmState(state);
+    TEST_ASSERT_EQUAL_UINT32(COLD_MS, timedRead(reading, state));
+    TEST_ASSERT_TRUE(reading.start == LoadCellStart::Cold);
+    TEST_ASSERT_EQUAL_UINT32(1000, reading.grams);
+}
+
+/** Implement and test:
+ * Given: a warm state, and an HX711 whose readings still creep during the warm burst, or read far below the tare
+ * When: the load cell is read
+ * Then: the warm reading fails its drift check and a cold start follows at once; a cold reading is kept as it is
+ */
+void test_sensors_drift_falls_back_to_cold() {
+    storeCalibration(1000, 20.0f);
+    hal::loadCellBegin();
+    hal::loadCellPowerDown();
+    LoadCellWarmState state{};
+    LoadCellReading reading;
+    hal::sim::setLoadCellRaw(1000 + 20 * 500);
+    timedRead(reading, state);
+
+    driftUntilMs = hal::millis() + WARM_MS;
+    hal::sim::setLoadCellSource([](uint32_t nowMs) {
+        int32_t settled = 1000 + 20 * 500;
+        return nowMs < driftUntilMs ? settled - static_cast<int32_t>(driftUntilMs - nowMs) : settled;   // 1 count a ms
+    });
+    TEST_ASSERT_EQUAL_UINT32(WARM_MS + COLD_MS, timedRead(reading, state));
+    TEST_ASSERT_TRUE(reading.start == LoadCellStart::Cold);
+    TEST_ASSERT_TRUE(reading.driftFallback);
+    TEST_ASSERT_EQUAL_UINT32(500, reading.grams);
+
+    hal::sim::setLoadCellRaw(1000 - 2 * LOAD_CELL_DRIFT_COUNTS);   // the offset moved
+    TEST_ASSERT_EQUAL_UINT32(WARM_MS + COLD_MS, timedRead(reading, state));
+    TEST_ASSERT_TRUE(reading.driftFallback);
+    TEST_ASSERT_EQUAL_UINT32(0, reading.grams);
+    TEST_ASSERT_EQUAL_HEX32(LOAD_CELL_WARM_MAGIC, state.magic);
+}
+#endif
+
+void runSensorsTests() {
+    RUN_TEST(test_sensors_filters_reject_a_spike);
+    RUN_TEST(test_sensors_median_and_mean_rounding);
+    RUN_TEST(test_sensors_raw_to_grams);
+    RUN_TEST(test_sensors_adaptive_stores_heartbeats_only);
+    RUN_TEST(test_sensors_adaptive_stores_settled_change);
+#ifndef ARDUINO
+    RUN_TEST(test_sensors_samples_by_interrupt);
+    RUN_TEST(test_sensors_no_samples_fails);
+    RUN_TEST(test_sensors_warm_start_after_cold);
+    RUN_TEST(test_sensors_drift_falls_back_to_cold);
+#endif
+}
@@ -0,0 +1,321 @@
+// unit test file
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "setup_console.h"
+
+#ifndef ARDUINO
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "credential_vault.h"
+#include "events.h"
+#include "hal.h"
+#include "hal_sim.h"
+
+namespace {
+
+thread_local bool countingAllocations = false;   // other tests' tasks may still allocate on their threads
+uint32_t heapAllocations = 0;
+
+}  // namespace
+
+// every heap allocation of the program goes through these: counted while a test asks for it
+void *operator new(size_t size) {
+    if (countingAllocations) {
+        heapAllocations++;
+    }
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+bool contains(const std::string &text, const char *part) {
+    return text.find(part) != std::string::npos;
+}
+
+uint32_t timerFires = 0;
+
+void countTimer(void *) {
+    timerFires++;
+}
+
+}  // namespace
+#endif
+
+/** Implement and test:
+ * Given: lines with extra spaces, a quoted SSID with spaces, an empty quoted password, and broken ones
+ * When: each is tokenized in place
+ * Then: the words come out without the spaces and quotes; an unclosed quote, a quote in the middle of a word and
+ *       more words than the capacity are refused
+ */
+void test_setup_console_tokenize() {
+    char *tokens[4];
+    char spaced[] = "  wifi   add  home ";
+    TEST_ASSERT_EQUAL_INT(3, tokenize(spaced, tokens, 4));
+    TEST_ASSERT_EQUAL_STRING("wifi", tokens[0]);
+    TEST_ASSERT_EQUAL_STRING("add", tokens[1]);
+    TEST_ASSERT_EQUAL_STRING("home", tokens[2]);
+
+    char quoted[] = "wifi add \"My Home Net\" \"\"";
+    TEST_ASSERT_EQUAL_INT(4, tokenize(quoted, tokens, 4));
+    TEST_ASSERT_EQUAL_STRING("My Home Net", tokens[2]);
+    TEST_ASSERT_EQUAL_STRING("", tokens[3]);
+
+    char empty[] = "   ";
+    TEST_ASSERT_EQUAL_INT(0, tokenize(empty, tokens, 4));
+    char unclosed[] = "wifi add \"home";
+    TEST_ASSERT_EQUAL_INT(-1, tokenize(unclosed, tokens, 4));
+    char glued[] = "wifi add \"home\"net";
+    TEST_ASSERT_EQUAL_INT(-1, tokenize(glued, tokens, 4));
+    char many[] = "a b c d e";
+    TEST_ASSERT_EQUAL_INT(-1, tokenize(many, tokens, 4));
+}
+
+/** Implement and test:
+ * Given: IPv4 addresses, valid and not
+ * When: each is parsed
+ * Then: only 4 dot-separated numbers 0-255, without leading zeros, signs or anything around them, are accepted
+ */
+void test_setup_console_parse_ipv4() {
+    uint8_t octets[4] = {};
+    TEST_ASSERT_TRUE(parseIpv4("192.168.0.10", octets));
+    TEST_ASSERT_EQUAL_UINT8(192, octets[0]);
+    TEST_ASSERT_EQUAL_UINT8(168, octets[1]);
+    TEST_ASSERT_EQUAL_UINT8(0, octets[2]);
+    TEST_ASSERT_EQUAL_UINT8(10, octets[3]);
+    TEST_ASSERT_TRUE(parseIpv4("255.255.255.255", octets));
+    TEST_ASSERT_TRUE(parseIpv4("0.0.0.0", octets));
+
+    const char *invalid[] = {"", "1.2.3", "1.2.3.4.5", "256.1.1.1", "1.2.3.1000", "01.2.3.4", "1..3.4", "1.2.3.4 ",
+                             " 1.2.3.4", "-1.2.3.4", "+1.2.3.4", "1.2.3.a", "1.2.3.", "pool.ntp.org"};
+    for (const char *text : invalid) {
+        TEST_ASSERT_FALSE_MESSAGE(parseIpv4(text, octets), text);
+    }
+}
+
+/** Implement and test:
+ * Given: plate weights, inside, on the edges of and outside [PLATE_TOL_MIN, PLATE_TOL_MAX], and malformed
+ * When: each is parsed
+ * Then: the ones in range are read to the decimal; the rest are refused and leave the weight as it was
+ */
+void test_setup_console_parse_plate_weight() {
+    float grams = 0;
+    TEST_ASSERT_TRUE(parsePlateWeight("250", grams));
+    TEST_ASSERT_EQUAL_FLOAT(250.0f, grams);
+    TEST_ASSERT_TRUE(parsePlateWeight("312.75", grams));
+    TEST_ASSERT_EQUAL_FLOAT(312.75f, grams);
+    TEST_ASSERT_TRUE(parsePlateWeight("1000.", grams));
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f, grams);
+
+    char edge[16];
+    std::snprintf(edge, sizeof(edge), "%d", static_cast<int>(PLATE_TOL_MIN));
+    TEST_ASSERT_TRUE(parsePlateWeight(edge, grams));
+    std::snprintf(edge, sizeof(edge), "%d", static_cast<int>(PLATE_TOL_MAX));
+    TEST_ASSERT_TRUE(parsePlateWeight(edge, grams));
+
+    grams = 123;
+    std::snprintf(edge, sizeof(edge), "%d.9", static_cast<int>(PLATE_TOL_MIN) - 1);
+    TEST_ASSERT_FALSE(parsePlateWeight(edge, grams));
+    std::snprintf(edge, sizeof(edge), "%d.1", static_cast<int>(PLATE_TOL_MAX));
+    TEST_ASSERT_FALSE(parsePlateWeight(edge, grams));
+    const char *invalid[] = {"", ".", "-250", "250g", "2.5.0", "1e3", "nan", "99999999999"};
+    for (const char *text : invalid) {
+        TEST_ASSERT_FALSE_MESSAGE(parsePlateWeight(text, grams), text);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(123.0f, grams);
+}
+
+#ifndef ARDUINO
+/** Implement and test:
+ * Given: nothing stored, and a terminal that types a whole setup, with typos fixed by backspace, an arrow key, CRLF
+ *        and LF line ends, and a line erased by Ctrl-U
+ * When: the console runs
+ * Then: it ends on `done`, and NVS holds the networks where loadWifiNetworks finds them, their passwords in the vault,
+ *       the IPs and the plate weight; the passwords are never echoed back by `show`, nor kept in the settings
+ */
+void test_setup_console_session_stores_settings() {
+    SetupConsole console;
+    console.begin();
+    hal::sim::serialType("wifi add \"Home Net\" secret123\r\n", 200);
+    hal::sim::serialType("wifi add office officepw1\x1b[A\n", 200);
+    hal::sim::serialType("server 10.0.0.9X\b\r", 200);
+    hal::sim::serialType("ntp 8.8.8.8\x15ntp 10.0.0.1\r", 200);
+    hal::sim::serialType("plate 412.5\rshow\rdone\r", 200);
+    TEST_ASSERT_TRUE(console.run(60 * 1000));
+
+    WifiNetwork networks[WIFI_MAX_NETWORKS];
+    TEST_ASSERT_EQUAL_UINT8(2, loadWifiNetworks(networks));
+    TEST_ASSERT_EQUAL_STRING("Home Net", networks[0].ssid);
+    TEST_ASSERT_EQUAL_STRING("", networks[0].password);
+    TEST_ASSERT_EQUAL_STRING("office", networks[1].ssid);
+    char password[sizeof(WifiNetwork::password)];
+    TEST_ASSERT_TRUE(credentialVault.find("Home Net", password));
+    TEST_ASSERT_EQUAL_STRING("secret123", password);
+    TEST_ASSERT_TRUE(credentialVault.find("office", password));
+    TEST_ASSERT_EQUAL_STRING("officepw1", password);
+    TEST_ASSERT_EQUAL_STRING("", console.settings().networks[0].password);
+    char ip[IP_TEXT_LENGTH];
+    TEST_ASSERT_TRUE(hal::nvsGet(NVS_KEY_SERVER_IP, ip, sizeof(ip)));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.9", ip);
+    TEST_ASSERT_TRUE(hal::nvsGet(NVS_KEY_NTP_SERVER, ip, sizeof(ip)));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.1", ip);
+    float plate = 0;
+    TEST_ASSERT_TRUE(hal::nvsGet(NVS_KEY_PLATE_WEIGHT, &plate, sizeof(plate)));
+    TEST_ASSERT_EQUAL_FLOAT(412.5f, plate);
+
+    std::string output = hal::sim::serialOutput();
+    TEST_ASSERT_TRUE(contains(output, "wifi: \"Home Net\" \"office\"\r\n"));
+    TEST_ASSERT_TRUE(contains(output, "plate: 412.5 g"));
+    TEST_ASSERT_TRUE(contains(output, "setup done"));
+    size_t shown = output.find("wifi: \"Home Net\"");
+    TEST_ASSERT_FALSE(contains(output.substr(shown), "secret123"));
+}
+
+/** Implement and test:
+ * Given: stored settings, and a terminal that types an invalid IP, a plate weight out of range, a line longer than
+ *        CONSOLE_LINE_LENGTH, an unknown command, a command missing its argument, a fifth network, and the deletion of
+ *        a stored and an unknown network
+ * When: each line runs
+ * Then: each is reported and changes nothing, neither the edited settings nor NVS
+ */
+void test_setup_console_rejects_invalid_input() {
+    const char *session[] = {
+        "wifi add a password1\r", "wifi add b password2\r", "wifi add c password3\r", "wifi add d password4\r",
+        "server 192.168.1.20\r", "plate 300\r", "save\r",
+    };
+    SetupConsole console;
+    console.begin();
+    for (const char *line : session) {
+        hal::sim::serialType(line);
+    }
+    console.poll();
+    hal::sim::serialOutput();
+    uint32_t commits = hal::sim::nvsCommitCount();
+
+    std::string tooLong(CONSOLE_LINE_LENGTH + 10, 'x');
+    tooLong = "server " + tooLong + "\r";
+    const char *lines[] = {"server 192.168.1.256\r", "plate 5000\r", tooLong.c_str(), "reboot\r", "plate\r",
+                           "wifi add e password5\r", "wifi del a nope\r", "wifi\r"};
+    const char *reports[] = {"invalid IP", "invalid weight", "line too long", "unknown command", "usage: plate",
+                             "no room", "no network \"nope\"", "usage: wifi add"};
+    for (uint8_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        hal::sim::serialType(lines[i]);
+        TEST_ASSERT_TRUE(console.poll());
+        TEST_ASSERT_TRUE_MESSAGE(contains(hal::sim::serialOutput(), reports[i]), reports[i]);
+    }
+    const SetupConsole::Settings &settings = console.settings();
+    TEST_ASSERT_EQUAL_STRING("a", settings.networks[0].ssid);
+    TEST_ASSERT_EQUAL_STRING("d", settings.networks[3].ssid);
+    TEST_ASSERT_EQUAL_STRING("192.168.1.20", settings.serverIp);
+    TEST_ASSERT_EQUAL_FLOAT(300.0f, settings.plateGrams);
+    TEST_ASSERT_EQUAL_UINT32(commits, hal::sim::nvsCommitCount());
+}
+
+/** Implement and test:
+ * Given: a network and the server set, no plate weight
+ * When: `done` is typed, then the weight, then `done` again
+ * Then: the first `done` names what's missing and keeps the session going; the second ends it
+ */
+void test_setup_console_done_needs_every_setting() {
+    SetupConsole console;
+    console.begin();
+    hal::sim::serialType("wifi add home password1\rserver 10.0.0.2\rdone\r");
+    TEST_ASSERT_TRUE(console.poll());
+    std::string output = hal::sim::serialOutput();
+    TEST_ASSERT_TRUE(contains(output, "missing: the plate weight\r\n"));
+    char ip[IP_TEXT_LENGTH];
+    TEST_ASSERT_FALSE(hal::nvsGet(NVS_KEY_SERVER_IP, ip, sizeof(ip)));
+
+    hal::sim::serialType("plate 200\rdone\r");
+    TEST_ASSERT_FALSE(console.poll());
+    TEST_ASSERT_TRUE(contains(hal::sim::serialOutput(), "setup done"));
+}
+
+/** Implement and test:
+ * Given: a console, and a timer due while it waits (another task's work)
+ * When: a command arrives after 1 s, and a burst of 100 commands is handled
+ * Then: the console is its line buffer and settings, with little else; the command is answered within CONSOLE_POLL_MS
+ *       of arriving; the timer fired while it waited; the burst takes no heap allocation
+ */
+void test_setup_console_ram_and_latency() {
+    TEST_ASSERT_TRUE(sizeof(SetupConsole) <= CONSOLE_LINE_LENGTH + sizeof(SetupConsole::Settings) + 16);
+
+    SetupConsole console;
+    console.begin();
+    timerFires = 0;
+    int timer = hal::timerCreate(countTimer, nullptr);
+    hal::timerStartOnce(timer, 500 * 1000);
+    hal::sim::serialType("plate 250\r", 1000);
+    TEST_ASSERT_FALSE(console.run(5000));       // nothing after it: the session times out
+    TEST_ASSERT_EQUAL_UINT32(1, timerFires);
+    TEST_ASSERT_TRUE(hal::sim::serialLastWriteMs() >= 1000);
+    TEST_ASSERT_TRUE(hal::sim::serialLastWriteMs() - 1000 <= CONSOLE_POLL_MS);
+    TEST_ASSERT_TRUE(hal::millis() >= 6000);
+
+    for (uint8_t i = 0; i < 100; i++) {
+        hal::sim::serialType(i % 2 == 0 ? "wifi add \"x y\" password1\r" : "wifi del \"x y\"\r");
+    }
+    hal::sim::serialType("server 10.1.2.3\rshow\rhelp\r");
+    hal::sim::serialOutput();
+    heapAllocations = 0;
+    countingAllocations = true;
+    console.poll();
+    countingAllocations = false;
+    TEST_ASSERT_EQUAL_UINT32(0, heapAllocations);
+    TEST_ASSERT_EQUAL_STRING("10.1.2.3", console.settings().serverIp);
+    TEST_ASSERT_EQUAL_STRING("", console.settings().networks[0].ssid);
+}
+
+/** Implement and test:
+ * Given: a terminal that types a complete setup, and then one that types nothing
+ * When: onSetup runs with each
+ * Then: the first stores the settings and raises CalibrateClock (the network and the clock come next); the second
+ *       gives up after CONSOLE_IDLE_TIMEOUT_MS and says so
+ */
+void test_setup_console_on_setup() {
+    Event event;
+    while (eventsRing.tryPop(event)) {
+    }
+    hal::sim::serialType("wifi add home password1\rserver 10.0.0.2\rplate 250\rdone\r", 3000);
+    onSetup();
+    char ip[IP_TEXT_LENGTH];
+    TEST_ASSERT_TRUE(hal::nvsGet(NVS_KEY_SERVER_IP, ip, sizeof(ip)));
+    TEST_ASSERT_TRUE(eventsRing.tryPop(event));
+    TEST_ASSERT_TRUE(event.eventType == EventType::CalibrateClock);
+
+    hal::sim::serialOutput();
+    uint32_t start = hal::millis();
+    onSetup();
+    TEST_ASSERT_TRUE(hal::millis() - start >= CONSOLE_IDLE_TIMEOUT_MS);
+    TEST_ASSERT_TRUE(contains(hal::sim::serialOutput(), "setup ends"));
+    TEST_ASSERT_FALSE(eventsRing.tryPop(event));
+}
+#endif
+
+void runSetupConsoleTests() {
+    RUN_TEST(test_setup_console_tokenize);
+    RUN_TEST(test_setup_console_parse_ipv4);
+    RUN_TEST(test_setup_console_parse_plate_weight);
+#ifndef ARDUINO
+    RUN_TEST(test_setup_console_session_stores_settings);
+    RUN_TEST(test_setup_console_rejects_invalid_input);
+    RUN_TEST(test_setup_console_done_needs_every_setting);
+    RUN_TEST(test_setup_console_ram_and_latency);
+    RUN_TEST(test_setup_console_on_setup);
+#endif
+}
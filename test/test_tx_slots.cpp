@@ -0,0 +1,143 @@
+// unit test file
+#include <unity.h>
+
+#include "tx_slots.h"
+
+/** Implement and test:
+ * Given: 6000 deviceIDs sharing a 10 minute window, and the same IDs with no window
+ * When: their offsets into it are computed, twice
+ * Then: they're the same each time, within the window, and spread evenly over it (every minute gets 1/10 of the
+ *       devices, +-20%); without a window everyone sends at the start
+ */
+void test_tx_slots_jitter_spreads_evenly() {
+    constexpr uint16_t WINDOW_S = 600;
+    uint32_t perMinute[10] = {};
+    for (uint32_t deviceId = 1; deviceId <= 6000; deviceId++) {
+        uint32_t jitter = txJitterS(deviceId, 0, WINDOW_S);
+        TEST_ASSERT_TRUE(jitter < WINDOW_S);
+        TEST_ASSERT_EQUAL_UINT32(jitter, txJitterS(deviceId, 0, WINDOW_S));
+        perMinute[jitter / 60]++;
+        TEST_ASSERT_EQUAL_UINT32(0, txJitterS(deviceId, 0, 0));
+    }
+    for (uint32_t count : perMinute) {
+        TEST_ASSERT_UINT32_WITHIN(120, 600, count);
+    }
+}
+
+/** Implement and test:
+ * Given: a slot starting at 23:55 with a 15 minute window
+ * When: the send times of many devices in it are computed
+ * Then: some fall after midnight, wrapped into the next day's seconds, and none before 23:55 or after 00:10
+ */
+void test_tx_slots_send_time_wraps_midnight() {
+    TxSlot slot{23 * 60 + 55, 15 * 60};
+    bool wrapped = false;
+    for (uint32_t deviceId = 1; deviceId <= 100; deviceId++) {
+        uint32_t second = txSecondOfDay(slot, 1, deviceId);
+        TEST_ASSERT_TRUE(second >= (23 * 60 + 55) * 60 || second < 10 * 60);
+        wrapped = wrapped || second < 10 * 60;
+    }
+    TEST_ASSERT_TRUE(wrapped);
+}
+
+#ifndef ARDUINO
+/** Implement and test:
+ * Given: nothing in NVS, then slots out of range, then valid ones
+ * When: they're stored and loaded
+ * Then: the defaults load until valid slots are stored; the invalid ones aren't stored
+ */
+void test_tx_slots_store_and_load() {
+    TxSlot slots[2];
+    loadTxSlots(slots);
+    TEST_ASSERT_EQUAL_UINT16(DEFAULT_TX_MINUTES[0], slots[0].startMinute);
+    TEST_ASSERT_EQUAL_UINT16(DEFAULT_TX_WINDOW_S, slots[1].windowS);
+
+    TxSlot invalid[2] = {{24 * 60, 60}, {9 * 60, 60}};
+    TEST_ASSERT_FALSE(storeTxSlots(invalid));
+    loadTxSlots(slots);
+    TEST_ASSERT_EQUAL_UINT16(DEFAULT_TX_MINUTES[0], slots[0].startMinute);
+
+    TxSlot valid[2] = {{7 * 60 + 30, 300}, {19 * 60, 0}};
+    TEST_ASSERT_TRUE(storeTxSlots(valid));
+    loadTxSlots(slots);
+    TEST_ASSERT_EQUAL_UINT16(7 * 60 + 30, slots[0].startMinute);
+    TEST_ASSERT_EQUAL_UINT16(300, slots[0].windowS);
+    TEST_ASSERT_EQUAL_UINT16(19 * 60, slots[1].startMinute);
+    TEST_ASSERT_EQUAL_UINT16(0, slots[1].windowS);
+}
+#endif
+
+/** Implement and test:
+ * Given: a server replying busy, with a 10 s retry-after hint
+ * When: a device keeps getting busy replies, then one more, then a delivery
+ * Then: each retry waits the hint and then 1/2 to 1 of a window that doubles from TX_BACKOFF_BASE_S; after
+ *       TX_BACKOFF_ATTEMPTS of them there's no retry; a failure that isn't busy (unreachable) isn't retried either
+ */
+void test_tx_slots_backoff_doubles_after_busy_replies() {
+    TxSlotState state;
+    uint32_t now = 1792195200 + 13 * 3600;
+    uint32_t window = TX_BACKOFF_BASE_S;
+    for (uint8_t busy = 1; busy <= TX_BACKOFF_ATTEMPTS; busy++) {
+        uint32_t retryS = state.onSend(false, true, 10, 42, now);
+        TEST_ASSERT_TRUE(retryS >= 10 + window / 2 && retryS <= 10 + window);
+        TEST_ASSERT_EQUAL_UINT8(busy, state.busyInARow());
+        now += retryS;
+        window = window * 2 < TX_BACKOFF_MAX_S ? window * 2 : TX_BACKOFF_MAX_S;
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, state.onSend(false, true, 10, 42, now));    // the next tx time
+    TEST_ASSERT_EQUAL_UINT8(0, state.busyInARow());
+    TEST_ASSERT_EQUAL_UINT32(0, state.onSend(false, false, 0, 42, now));
+    TEST_ASSERT_EQUAL_UINT32(0, state.onSend(true, false, 0, 42, now));
+}
+
+/** Implement and test:
+ * Given: 200 devices turned away by the same busy reply, at the same second
+ * When: each picks its retry
+ * Then: the retries spread over the backoff window: no second gets more than 1/4 of them
+ */
+void test_tx_slots_backoff_spreads_devices() {
+    uint32_t perSecond[TX_BACKOFF_BASE_S + 1] = {};
+    for (uint32_t deviceId = 1; deviceId <= 200; deviceId++) {
+        TxSlotState state;
+        uint32_t retryS = state.onSend(false, true, 0, deviceId, 1792195200);
+        TEST_ASSERT_TRUE(retryS <= TX_BACKOFF_BASE_S);
+        perSecond[retryS]++;
+    }
+    for (uint32_t count : perSecond) {
+        TEST_ASSERT_TRUE(count <= 50);
+    }
+}
+
+/** Implement and test:
+ * Given: sends alternating between failed and delivered
+ * When: TX_RENEGOTIATE_FAILURES of the last TX_HISTORY_LENGTH have failed, then the server sent new slots
+ * Then: renegotiation is asked for only then, and the history starts over; failures that fell out of it don't count
+ */
+void test_tx_slots_renegotiates_on_failures() {
+    TxSlotState state;
+    for (uint8_t i = 0; i < 2 * TX_RENEGOTIATE_FAILURES - 1; i++) {
+        TEST_ASSERT_FALSE(state.shouldRenegotiate());
+        state.onSend(i % 2 == 1, false, 0, 42, 0);
+    }
+    TEST_ASSERT_EQUAL_UINT8(TX_RENEGOTIATE_FAILURES, state.failures());
+    TEST_ASSERT_TRUE(state.shouldRenegotiate());
+
+    state.renegotiated();
+    TEST_ASSERT_EQUAL_UINT8(0, state.failures());
+    state.onSend(false, false, 0, 42, 0);
+    for (uint8_t i = 0; i < TX_HISTORY_LENGTH; i++) {
+        state.onSend(true, false, 0, 42, 0);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, state.failures());
+}
+
+void runTxSlotsTests() {
+    RUN_TEST(test_tx_slots_jitter_spreads_evenly);
+    RUN_TEST(test_tx_slots_send_time_wraps_midnight);
+#ifndef ARDUINO
+    RUN_TEST(test_tx_slots_store_and_load);
+#endif
+    RUN_TEST(test_tx_slots_backoff_doubles_after_busy_replies);
+    RUN_TEST(test_tx_slots_backoff_spreads_devices);
+    RUN_TEST(test_tx_slots_renegotiates_on_failures);
+}
@@ -0,0 +1,350 @@
+// unit test file
+#include <unity.h>
+
+#ifndef ARDUINO
+#include <cstring>
+#include <functional>
+#include <set>
+#include <vector>
+
+#include "credential_vault.h"
+#include "hal_sim.h"
+#include "uplink.h"
+
+namespace {
+
+struct ReceivedRecord {
+    MessageType type;
+    uint32_t sequence;
+    uint8_t flags;
+    std::vector<uint8_t> bytes;
+};
+
+/* An MQTT broker stand-in: acknowledges CONNECT and every QoS 1 PUBLISH, and unpacks the batches.
+ * It can be offline (refuses connections), or break the link after some PUBLISH frames. */
+class FakeBroker : public hal::sim::SocketPeer {
+public:
+    bool online = true;
+    int breakAfterPublishes = -1;   // -1: never
+    int publishes = 0;
+    size_t largestFrame = 0;
+    bool cleanSession = true;
+    std::function<void()> duringPublish;    // runs as a PUBLISH frame arrives, e.g. another task enqueueing
+    std::vector<ReceivedRecord> records;
+
+    bool onConnect(const char *host, uint16_t port) override {
+        pending.clear();
+        return online && std::strcmp(host, "192.168.0.118") == 0 && port == MQTT_PORT;
+    }
+
+    void onReceive(int socket, const uint8_t *data, size_t length, std::vector<uint8_t> &reply) override {
+        pending.insert(pending.end(), data, data + length);
+        while (pending.size() >= 2) {
+            size_t remaining = 0;
+            size_t header = 1;
+            for (int shift = 0; header < pending.size(); shift += 7) {
+                remaining |= static_cast<size_t>(pending[header] & 0x7F) << shift;
+                if ((pending[header++] & 0x80) == 0) {
+                    break;
+                }
+            }
+            if (pending.size() < header + remaining) {
+                return;
+            }
+            std::vector<uint8_t> body(pending.begin() + header, pending.begin() + header + remaining);
+            uint8_t type = pending[0];
+            largestFrame = std::max(largestFrame, header + remaining);
+            pending.erase(pending.begin(), pending.begin() + header + remaining);
+            if (type == 0x10) {
+                cleanSession = (body[7] & 0x02) != 0;
+                reply.insert(reply.end(), {0x20, 0x02, 0x00, 0x00});
+            } else if (type == 0x32) {
+                if (duringPublish) {
+                    duringPublish();
+                }
+                if (publishes++ == breakAfterPublishes) {
+                    hal::sim::dropSocket(socket);
+                    return;
+                }
+                size_t topicLength = (body[0] << 8) | body[1];
+                size_t position = 2 + topicLength;
+                uint8_t packetId[2] = {body[position], body[position + 1]};
+                unpack(body, position + 2);
+                reply.insert(reply.end(), {0x40, 0x02, packetId[0], packetId[1]});
+            }
+        }
+    }
+
+private:
+    static uint32_t varint(const std::vector<uint8_t> &bytes, size_t &position) {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = bytes[position++];
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    void unpack(const std::vector<uint8_t> &body, size_t position) {
+        while (position < body.size()) {
+            ReceivedRecord record;
+            record.type = static_cast<MessageType>(body[position++]);
+            record.sequence = varint(body, position);
+            record.flags = body[position++];
+            uint32_t length = varint(body, position);
+            record.bytes.assign(body.begin() + position, body.begin() + position + length);
+            position += length;
+            records.push_back(record);
+        }
+    }
+
+    std::vector<uint8_t> pending;
+};
+
+void storeServerIp() {
+    char serverIp[16] = "192.168.0.118";
+    hal::nvsSet(NVS_KEY_SERVER_IP, serverIp, sizeof(serverIp));
+    hal::nvsCommit();
+}
+
+std::vector<uint8_t> pattern(size_t length, uint8_t seed) {
+    std::vector<uint8_t> bytes(length);
+    for (size_t i = 0; i < length; i++) {
+        bytes[i] = static_cast<uint8_t>(seed + i * 7);
+    }
+    return bytes;
+}
+
+
+// a stored network in range: what the sessions' WifiHold joins
+void storeReachableNetwork() {
+    hal::sim::addAccessPoint({"daphi-depot", "compost-heap", {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01}, 6, -55});
+    credentialVault.add("daphi-depot", "compost-heap");
+}
+}  // namespace
+
+/** Implement and test:
+ * Given: a backlog of 30 status messages and a data table longer than a chunk
+ * When: the uplink flushes it
+ * Then: every record arrives in order, in a few PUBLISH frames within the packet size, in two round trips
+ */
+void test_uplink_coalesces_backlog_into_few_frames() {
+    storeServerIp();
+    FakeBroker broker;
+    hal::sim::setSocketPeer(&broker);
+    storeReachableNetwork();
+    Uplink link(flashStore);
+    link.load();
+    std::vector<uint8_t> status = pattern(20, 1);
+    for (int i = 0; i < 30; i++) {
+        TEST_ASSERT_TRUE(link.enqueue(MessageType::Status, status.data(), status.size()));
+    }
+    std::vector<uint8_t> table = pattern(1800, 9);
+    TEST_ASSERT_TRUE(link.enqueue(MessageType::DataTable, table.data(), table.size()));
+
+    TEST_ASSERT_TRUE(link.flush(1000) == Uplink::Result::Sent);
+    TEST_ASSERT_EQUAL_UINT32(0, link.backlogBytes());
+    TEST_ASSERT_FALSE(broker.cleanSession);
+    TEST_ASSERT_EQUAL_size_t(30 + 3, broker.records.size());   // the table is 3 chunks
+    std::vector<uint8_t> reassembled;
+    for (size_t i = 0; i < broker.records.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, broker.records[i].sequence);
+        if (broker.records[i].type == MessageType::DataTable) {
+            reassembled.insert(reassembled.end(), broker.records[i].bytes.begin(), broker.records[i].bytes.end());
+            TEST_ASSERT_EQUAL_UINT8(reassembled.size() == table.size() ? 1 : 0, broker.records[i].flags);
+        }
+    }
+    TEST_ASSERT_TRUE(reassembled == table);
+    TEST_ASSERT_EQUAL_INT(3, broker.publishes);
+    TEST_ASSERT_TRUE(broker.largestFrame <= MQTT_MAX_PACKET_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(2, link.stats().roundTrips);      // the CONNACK, and one window of PUBACKs
+    TEST_ASSERT_EQUAL_UINT32(33, link.nextSequence());
+    TEST_ASSERT_TRUE(link.flush(1001) == Uplink::Result::Empty);
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: a broker that's unreachable
+ * When: the uplink keeps failing to flush
+ * Then: it waits between tries, twice as long every time up to the maximum, and back to no wait once it's through
+ */
+void test_uplink_backs_off_exponentially() {
+    storeServerIp();
+    FakeBroker broker;
+    broker.online = false;
+    hal::sim::setSocketPeer(&broker);
+    storeReachableNetwork();
+    Uplink link(flashStore);
+    uint8_t status[4] = {1, 2, 3, 4};
+    link.enqueue(MessageType::Status, status, sizeof(status));
+
+    uint32_t now = 1000;
+    TEST_ASSERT_TRUE(link.flush(now) == Uplink::Result::Failed);
+    TEST_ASSERT_EQUAL_UINT32(now + UPLINK_BACKOFF_MIN_S, link.retryAtS());
+    TEST_ASSERT_TRUE(link.flush(now + UPLINK_BACKOFF_MIN_S - 1) == Uplink::Result::Waiting);
+    uint32_t backoff = UPLINK_BACKOFF_MIN_S;
+    while (backoff < UPLINK_BACKOFF_MAX_S) {
+        now = link.retryAtS();
+        TEST_ASSERT_TRUE(link.flush(now) == Uplink::Result::Failed);
+        backoff = backoff * 2 < UPLINK_BACKOFF_MAX_S ? backoff * 2 : UPLINK_BACKOFF_MAX_S;
+        TEST_ASSERT_EQUAL_UINT32(now + backoff, link.retryAtS());
+    }
+    now = link.retryAtS();
+    link.flush(now);
+    TEST_ASSERT_EQUAL_UINT32(now + UPLINK_BACKOFF_MAX_S, link.retryAtS());
+
+    broker.online = true;
+    TEST_ASSERT_TRUE(link.flush(link.retryAtS()) == Uplink::Result::Sent);
+    TEST_ASSERT_EQUAL_UINT32(0, link.retryAtS());
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: a backlog that couldn't be sent, and more messages queued while offline
+ * When: the device reboots and the broker is back
+ * Then: the whole backlog is drained in one connection, and the sequence numbers keep counting across flushes
+ */
+void test_uplink_backlog_survives_reboot() {
+    storeServerIp();
+    FakeBroker broker;
+    hal::sim::setSocketPeer(&broker);
+    storeReachableNetwork();
+    Uplink before(flashStore);
+    uint8_t first[3] = {7, 7, 7};
+    before.enqueue(MessageType::Status, first, sizeof(first));
+    TEST_ASSERT_TRUE(before.flush(1000) == Uplink::Result::Sent);     // sequence 0
+
+    broker.online = false;
+    std::vector<uint8_t> table = pattern(1500, 3);
+    before.enqueue(MessageType::DataTable, table.data(), table.size());
+    before.enqueue(MessageType::Status, first, sizeof(first));
+    TEST_ASSERT_TRUE(before.flush(2000) == Uplink::Result::Failed);
+
+    hal::sim::powerCycle();
+    TEST_ASSERT_TRUE(flashStore.mount(STORAGE_PARTITION));
+    Uplink after(flashStore);
+    TEST_ASSERT_TRUE(after.load());
+    TEST_ASSERT_EQUAL_UINT32(1, after.nextSequence());
+    broker.online = true;
+    TEST_ASSERT_TRUE(after.flush(2010) == Uplink::Result::Sent);
+    TEST_ASSERT_EQUAL_UINT32(1, after.stats().connects);
+    TEST_ASSERT_EQUAL_size_t(1 + 3, broker.records.size());
+    TEST_ASSERT_EQUAL_UINT32(1, broker.records[1].sequence);
+    TEST_ASSERT_EQUAL_UINT32(3, broker.records[3].sequence);
+    TEST_ASSERT_TRUE(broker.records[3].type == MessageType::Status);
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: a link that breaks after the first PUBLISH frame of a flush
+ * When: the uplink tries again
+ * Then: the records of that frame arrive twice, with the same sequence numbers, so the server can drop the copies
+ */
+void test_uplink_resends_with_same_sequence_after_broken_link() {
+    storeServerIp();
+    FakeBroker broker;
+    broker.breakAfterPublishes = 1;
+    hal::sim::setSocketPeer(&broker);
+    storeReachableNetwork();
+    Uplink link(flashStore);
+    std::vector<uint8_t> table = pattern(3000, 5);
+    link.enqueue(MessageType::DataTable, table.data(), table.size());
+    TEST_ASSERT_TRUE(link.flush(1000) == Uplink::Result::Failed);
+    TEST_ASSERT_EQUAL_size_t(1, broker.records.size());
+
+    TEST_ASSERT_TRUE(link.flush(link.retryAtS()) == Uplink::Result::Sent);
+    std::set<uint32_t> sequences;
+    for (const ReceivedRecord &record : broker.records) {
+        sequences.insert(record.sequence);
+    }
+    TEST_ASSERT_EQUAL_size_t(1 + 4, broker.records.size());
+    TEST_ASSERT_EQUAL_size_t(4, sequences.size());
+    TEST_ASSERT_EQUAL_UINT32(0, broker.records[1].sequence);
+    hal::sim::setSocketPeer(nullptr);
+}
+/** Implement and test:
+ * Given: a backlog whose last append was torn by a power cut, a record's header and half its payload written
+ * When: the device reboots, loads the uplink, queues another message and flushes
+ * Then: the records before the torn one and the message after it are all sent
+ */
+void test_uplink_continues_after_torn_append() {
+    storeServerIp();
+    FakeBroker broker;
+    broker.online = false;
+    hal::sim::setSocketPeer(&broker);
+    storeReachableNetwork();
+    Uplink before(flashStore);
+    uint8_t status[3] = {7, 7, 7};
+    before.enqueue(MessageType::Status, status, sizeof(status));
+    FlashSegment segment;
+    TEST_ASSERT_TRUE(flashStore.firstSegment(StreamId::Uplink, segment));
+    hal::FlashPartition partition;
+    partition.open(STORAGE_PARTITION);
+    const uint8_t torn[6] = {static_cast<uint8_t>(MessageType::Status), 0x01, 4, 0, 9, 9};
+    partition.write(static_cast<uint32_t>(segment.data + segment.length - partition.data()), torn, sizeof(torn));
+
+    hal::sim::powerCycle();
+    TEST_ASSERT_TRUE(flashStore.mount(STORAGE_PARTITION));
+    Uplink after(flashStore);
+    after.load();
+    uint8_t next[2] = {8, 8};
+    TEST_ASSERT_TRUE(after.enqueue(MessageType::Status, next, sizeof(next)));
+    broker.online = true;
+    TEST_ASSERT_TRUE(after.flush(1000) == Uplink::Result::Sent);
+    TEST_ASSERT_EQUAL_size_t(2, broker.records.size());
+    TEST_ASSERT_EQUAL_size_t(2, broker.records[1].bytes.size());
+    TEST_ASSERT_EQUAL_UINT8(8, broker.records[1].bytes[0]);
+    hal::sim::setSocketPeer(nullptr);
+}
+
+/** Implement and test:
+ * Given: a backlog being flushed, and a status message enqueued by another task during the flush
+ * When: the flush goes through
+ * Then: that message stays in the backlog, and the next flush sends it with the next sequence number
+ */
+void test_uplink_keeps_messages_enqueued_during_flush() {
+    storeServerIp();
+    FakeBroker broker;
+    hal::sim::setSocketPeer(&broker);
+    storeReachableNetwork();
+    Uplink link(flashStore);
+    link.load();
+    uint8_t status[4] = {1, 2, 3, 4};
+    link.enqueue(MessageType::Status, status, sizeof(status));
+    link.enqueue(MessageType::Status, status, sizeof(status));
+    uint8_t late[2] = {9, 9};
+    broker.duringPublish = [&] {
+        link.enqueue(MessageType::Status, late, sizeof(late));
+        broker.duringPublish = nullptr;
+    };
+
+    TEST_ASSERT_TRUE(link.flush(1000) == Uplink::Result::Sent);
+    TEST_ASSERT_EQUAL_size_t(2, broker.records.size());
+    TEST_ASSERT_TRUE(link.backlogBytes() > 0);
+    TEST_ASSERT_EQUAL_UINT32(2, link.nextSequence());
+
+    hal::sim::powerCycle();
+    TEST_ASSERT_TRUE(flashStore.mount(STORAGE_PARTITION));
+    Uplink after(flashStore);
+    TEST_ASSERT_TRUE(after.load());
+    TEST_ASSERT_TRUE(after.flush(1001) == Uplink::Result::Sent);
+    TEST_ASSERT_EQUAL_size_t(3, broker.records.size());
+    TEST_ASSERT_EQUAL_UINT32(2, broker.records[2].sequence);
+    TEST_ASSERT_EQUAL_size_t(2, broker.records[2].bytes.size());
+    TEST_ASSERT_EQUAL_UINT32(0, after.backlogBytes());
+    hal::sim::setSocketPeer(nullptr);
+}
+#endif
+
+void runUplinkTests() {
+#ifndef ARDUINO
+    RUN_TEST(test_uplink_coalesces_backlog_into_few_frames);
+    RUN_TEST(test_uplink_backs_off_exponentially);
+    RUN_TEST(test_uplink_backlog_survives_reboot);
+    RUN_TEST(test_uplink_resends_with_same_sequence_after_broken_link);
+    RUN_TEST(test_uplink_continues_after_torn_append);
+    RUN_TEST(test_uplink_keeps_messages_enqueued_during_flush);
+#endif
+}
@@ -0,0 +1,222 @@
+// unit test file
+#include <unity.h>
+
+#ifndef ARDUINO
+#include <cstring>
+
+#include "credential_vault.h"
+#include "hal_sim.h"
+#include "wifi_link.h"
+
+namespace {
+
+constexpr uint32_t NOW = 1792195200;    // 17/10/2026 00:00 UTC
+constexpr uint32_t SCAN_MS = hal::sim::WIFI_CHANNELS * WIFI_SCAN_MS_PER_CHANNEL;
+
+const WifiNetwork NETWORKS[] = {{"daphi-depot", "compost"}, {"city-hall", "recycle"}};
+
+hal::sim::AccessPoint accessPoint(const char *ssid, const char *password, uint8_t last, uint8_t channel, int8_t rssi) {
+    return hal::sim::AccessPoint{ssid, password, {0x24, 0x0A, 0xC4, 0x00, 0x00, last}, channel, rssi};
+}
+
+// ms the connect took on the simulated clock
+uint32_t timedConnect(WifiLink &link, uint32_t nowS, bool &connected) {
+    uint64_t start = hal::micros();
+    connected = link.connect(NETWORKS, 2, nowS);
+    link.disconnect();
+    return static_cast<uint32_t>((hal::micros() - start) / 1000);
+}
+
+}  // namespace
+
+/** Implement and test:
+ * Given: a cold boot (empty RTC cache) with both stored networks in range
+ * When: the link connects, and connects again at the next transmission
+ * Then: the first connect scans, joins the strongest and asks DHCP; the second one does neither
+ */
+void test_wifi_link_fast_path_after_first_connect() {
+    hal::sim::addAccessPoint(accessPoint("city-hall", "recycle", 1, 11, -80));
+    hal::sim::addAccessPoint(accessPoint("daphi-depot", "compost", 2, 6, -55));
+    hal::sim::addAccessPoint(accessPoint("cafe", "", 3, 1, -40));
+    WifiCache cache{};
+    WifiLink link(cache);
+
+    bool connected = false;
+    TEST_ASSERT_EQUAL_UINT32(SCAN_MS + hal::sim::WIFI_JOIN_MS + hal::sim::WIFI_DHCP_MS,
+                             timedConnect(link, NOW, connected));
+    TEST_ASSERT_TRUE(connected);
+    TEST_ASSERT_EQUAL_UINT8(0, cache.lastGood);
+    TEST_ASSERT_EQUAL_UINT8(6, cache.entries[0].accessPoint.channel);
+
+    TEST_ASSERT_EQUAL_UINT32(hal::sim::WIFI_JOIN_MS, timedConnect(link, NOW + 7 * 3600, connected));
+    TEST_ASSERT_TRUE(connected);
+    TEST_ASSERT_EQUAL_UINT32(1, hal::sim::wifiScanCount());
+    TEST_ASSERT_EQUAL_UINT32(1, hal::sim::wifiDhcpCount());
+    TEST_ASSERT_EQUAL_UINT32(1, link.stats().fastHits);
+}
+
+/** Implement and test:
+ * Given: a cached access point that moved to another channel
+ * When: the link connects
+ * Then: the fast path times out, the scan finds it, and the new channel is cached
+ */
+void test_wifi_link_falls_back_to_scan_on_miss() {
+    hal::sim::addAccessPoint(accessPoint("daphi-depot", "compost", 2, 6, -55));
+    WifiCache cache{};
+    WifiLink link(cache);
+    bool connected = false;
+    timedConnect(link, NOW, connected);
+
+    hal::sim::removeAccessPoints();
+    hal::sim::addAccessPoint(accessPoint("daphi-depot", "compost", 2, 1, -55));
+    TEST_ASSERT_EQUAL_UINT32(WIFI_FAST_CONNECT_TIMEOUT_MS + SCAN_MS + hal::sim::WIFI_JOIN_MS + hal::sim::WIFI_DHCP_MS,
+                             timedConnect(link, NOW + 3600, connected));
+    TEST_ASSERT_TRUE(connected);
+    TEST_ASSERT_TRUE(link.lastPath() == WifiLink::Path::None);     // disconnected since
+    TEST_ASSERT_EQUAL_UINT32(1, link.stats().fastMisses);
+    TEST_ASSERT_EQUAL_UINT8(1, cache.entries[0].accessPoint.channel);
+    TEST_ASSERT_EQUAL_UINT32(hal::sim::WIFI_JOIN_MS, timedConnect(link, NOW + 2 * 3600, connected));
+}
+
+/** Implement and test:
+ * Given: a cached lease older than WIFI_LEASE_REUSE_S, and a cache from a network onSetup replaced since
+ * When: the link connects
+ * Then: the old lease is renewed through DHCP without a scan, and the replaced network's entry isn't used
+ */
+void test_wifi_link_renews_old_lease_and_ignores_replaced_network() {
+    hal::sim::addAccessPoint(accessPoint("daphi-depot", "compost", 2, 6, -55));
+    WifiCache cache{};
+    WifiLink link(cache);
+    bool connected = false;
+    timedConnect(link, NOW, connected);
+    TEST_ASSERT_EQUAL_UINT32(hal::sim::WIFI_JOIN_MS + hal::sim::WIFI_DHCP_MS,
+                             timedConnect(link, NOW + WIFI_LEASE_REUSE_S, connected));
+    TEST_ASSERT_EQUAL_UINT32(1, hal::sim::wifiScanCount());
+    TEST_ASSERT_EQUAL_UINT32(NOW + WIFI_LEASE_REUSE_S, cache.entries[0].leaseAtS);
+
+    const WifiNetwork replaced[] = {{"library", "books"}};
+    hal::sim::addAccessPoint(accessPoint("library", "books", 4, 6, -60));
+    TEST_ASSERT_TRUE(link.connect(replaced, 1, NOW + WIFI_LEASE_REUSE_S + 60));
+    TEST_ASSERT_TRUE(link.lastPath() == WifiLink::Path::Scanned);
+    TEST_ASSERT_EQUAL_UINT32(0, link.stats().fastMisses);
+}
+
+/** Implement and test:
+ * Given: the cached access point is where it was at a given share of the wakeups (the hit rate)
+ * When: the link connects at 100 wakeups
+ * Then: the mean time to connect is the model's: hit * join + miss * (timeout + scan + join + DHCP),
+ *       and beats always scanning from a hit rate of 50% on
+ */
+void test_wifi_link_expected_time_by_hit_rate() {
+    const uint32_t missMs = WIFI_FAST_CONNECT_TIMEOUT_MS + SCAN_MS + hal::sim::WIFI_JOIN_MS + hal::sim::WIFI_DHCP_MS;
+    const uint32_t scanOnlyMs = SCAN_MS + hal::sim::WIFI_JOIN_MS + hal::sim::WIFI_DHCP_MS;
+    for (uint8_t hitPercent : {0, 50, 90, 100}) {
+        hal::sim::reset();
+        hal::sim::addAccessPoint(accessPoint("daphi-depot", "compost", 2, 6, -55));
+        WifiCache cache{};
+        WifiLink link(cache);
+        bool connected = false;
+        timedConnect(link, NOW, connected);     // the cold boot
+        uint32_t totalMs = 0;
+        uint8_t channel = 6;
+        for (uint32_t wakeup = 0; wakeup < 100; wakeup++) {
+            if (wakeup % 100 >= hitPercent) {   // the access point hops channels before this wakeup
+                channel = channel == 6 ? 11 : 6;
+                hal::sim::removeAccessPoints();
+                hal::sim::addAccessPoint(accessPoint("daphi-depot", "compost", 2, channel, -55));
+            }
+            totalMs += timedConnect(link, NOW + (wakeup + 1) * 60, connected);
+            TEST_ASSERT_TRUE(connected);
+        }
+        uint32_t expectedMs = (hitPercent * hal::sim::WIFI_JOIN_MS + (100 - hitPercent) * missMs) / 100;
+        TEST_ASSERT_EQUAL_UINT32(expectedMs, totalMs / 100);
+        if (hitPercent >= 50) {
+            TEST_ASSERT_TRUE(totalMs / 100 < scanOnlyMs);
+        }
+    }
+}
+
+/** Implement and test:
+ * Given: both networks' passwords in the credential vault, and the networks listed from it without their passwords
+ * When: a vault-backed link connects after a cold boot, then again at the next transmission
+ * Then: it joins both times, decrypting only the password of the network it joins, once per join
+ */
+void test_wifi_link_takes_passwords_from_vault() {
+    hal::sim::addAccessPoint(accessPoint("city-hall", "recycle", 1, 11, -80));
+    hal::sim::addAccessPoint(accessPoint("daphi-depot", "compost", 2, 6, -55));
+    CredentialVault vault;
+    TEST_ASSERT_TRUE(vault.mount());
+    TEST_ASSERT_TRUE(vault.add("daphi-depot", "compost"));
+    TEST_ASSERT_TRUE(vault.add("city-hall", "recycle"));
+    WifiNetwork networks[WIFI_MAX_NETWORKS];
+    TEST_ASSERT_EQUAL_UINT8(2, vault.list(networks));
+    TEST_ASSERT_EQUAL_STRING("", networks[0].password);
+
+    WifiCache cache{};
+    WifiLink link(cache, &vault);
+    TEST_ASSERT_TRUE(link.connect(networks, 2, NOW));
+    TEST_ASSERT_TRUE(link.lastPath() == WifiLink::Path::Scanned);
+    TEST_ASSERT_EQUAL_UINT32(1, vault.stats().decrypts);
+    link.disconnect();
+    TEST_ASSERT_TRUE(link.connect(networks, 2, NOW + 3600));
+    TEST_ASSERT_TRUE(link.lastPath() == WifiLink::Path::Cached);
+    TEST_ASSERT_EQUAL_UINT32(2, vault.stats().decrypts);
+    TEST_ASSERT_EQUAL_UINT32(0, vault.stats().failures);
+}
+
+/** Implement and test:
+ * Given: a stored network in range, and the loop() task holding the device's link for a transfer
+ * When: the networkings task holds it too for its flush and lets go first, then the transfer lets go
+ * Then: the second hold shares the first one's connection (one scan, no second join), the link stays up until the last
+ *       hold is gone, then it's off; with no network stored a hold fails and holds nothing
+ * Then: the ledger has the radio on from the first hold's connect to the last release, all of it the transfer's
+ */
+void test_wifi_link_holds_are_shared() {
+    energyLedger.start();
+    WifiHold none(EnergyTask::Events);
+    TEST_ASSERT_FALSE(none.isUp());
+    TEST_ASSERT_EQUAL_UINT8(0, wifiLink.holders());
+    TEST_ASSERT_FALSE(energyLedger.radioIsOn());
+
+    hal::sim::addAccessPoint(accessPoint("daphi-depot", "compost", 2, 6, -55));
+    TEST_ASSERT_TRUE(credentialVault.add("daphi-depot", "compost"));
+    hal::WifiLease lease;
+    uint64_t heldAt = hal::micros();
+    {
+        WifiHold transfer(EnergyTask::Events);
+        TEST_ASSERT_TRUE(transfer.isUp());
+        uint64_t joinedAt = hal::micros();
+        {
+            WifiHold flush(EnergyTask::Networkings);
+            TEST_ASSERT_TRUE(flush.isUp());
+            TEST_ASSERT_EQUAL_UINT8(2, wifiLink.holders());
+            TEST_ASSERT_EQUAL_UINT64(joinedAt, hal::micros());
+            hal::sleepMs(300);
+        }
+        TEST_ASSERT_TRUE(hal::wifiLease(lease));    // the transfer still has it
+        TEST_ASSERT_TRUE(energyLedger.radioIsOn());
+        TEST_ASSERT_EQUAL_UINT32(1, hal::sim::wifiScanCount());
+    }
+    TEST_ASSERT_FALSE(hal::wifiLease(lease));
+    TEST_ASSERT_EQUAL_UINT8(0, wifiLink.holders());
+    TEST_ASSERT_FALSE(energyLedger.radioIsOn());
+
+    EnergyReport report = energyLedger.report();
+    uint64_t radioUs = report.stateUs[static_cast<uint8_t>(PowerState::RadioTx)] +
+                       report.stateUs[static_cast<uint8_t>(PowerState::RadioRx)];
+    TEST_ASSERT_EQUAL_UINT64(hal::micros() - heldAt, radioUs);
+    TEST_ASSERT_TRUE(report.taskMah[static_cast<uint8_t>(EnergyTask::Events)] > 0);
+    TEST_ASSERT_EQUAL_FLOAT(0, report.taskMah[static_cast<uint8_t>(EnergyTask::Networkings)]);
+}
+#endif
+
+void runWifiLinkTests() {
+#ifndef ARDUINO
+    RUN_TEST(test_wifi_link_fast_path_after_first_connect);
+    RUN_TEST(test_wifi_link_falls_back_to_scan_on_miss);
+    RUN_TEST(test_wifi_link_renews_old_lease_and_ignores_replaced_network);
+    RUN_TEST(test_wifi_link_expected_time_by_hit_rate);
+    RUN_TEST(test_wifi_link_takes_passwords_from_vault);
+    RUN_TEST(test_wifi_link_holds_are_shared);
+#endif
+}